@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ * Bezgałęziowe funkcje pomocnicze próbkowania funkcji BXDF, operujące na pojedynczych składowych (float).
+ * Nie zawierają skoków warunkowych ani wywołań funkcji bibliotecznych (sinf / cosf), dzięki czemu pętle jąder
+ * paczkowych (MaterialKernel::SampleBatch) są wektoryzowane przez kompilator (NEON, SSE, AVX).
+ */
+namespace Onyx::BsdfSampling
+{
+    /**
+     * Funkcja wyznacza bazę ortonormalną (tangent, bitangent, N) dla jednostkowego wektora normalnego
+     * bez rozgałęzień - Duff et al. 2017, "Building an Orthonormal Basis, Revisited".
+     */
+    inline void BuildOrthonormalBasis(
+        float nx, float ny, float nz,
+        float& tx, float& ty, float& tz,
+        float& bx, float& by, float& bz)
+    {
+        const float sign = std::copysign(1.0f, nz);
+        const float a = -1.0f / (sign + nz);
+        const float b = nx * ny * a;
+
+        tx = 1.0f + sign * nx * nx * a;
+        ty = sign * b;
+        tz = -sign * nx;
+
+        bx = b;
+        by = sign + ny * ny * a;
+        bz = -ny;
+    }
+
+
+    /**
+     * Sinus i cosinus kąta z przedziału [-PI/4, PI/4] wyznaczane szeregiem Taylora.
+     * Błąd w tym przedziale nie przekracza 4e-7.
+     */
+    inline void SinCosQuarterPi(float x, float& sine, float& cosine)
+    {
+        const float x2 = x * x;
+
+        sine = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+        cosine = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f))));
+    }
+
+
+    /**
+     * Odwzorowanie kwadratu jednostkowego na dysk jednostkowy zachowujące stratyfikację próbek
+     * (Shirley, Chiu 1997, "A Low Distortion Map Between Disk and Square").
+     * Kąt odwzorowania nie przekracza PI/4, co pozwala na użycie funkcji SinCosQuarterPi.
+     * @param radius Odległość punktu od środka dysku ze znakiem.
+     */
+    inline void SampleConcentricDisk(float u, float v, float& diskX, float& diskY, float& radius)
+    {
+        const float a = 2.0f * u - 1.0f;
+        const float b = 2.0f * v - 1.0f;
+
+        const bool horizontal = std::abs(a) > std::abs(b);
+
+        radius = horizontal ? a : b;
+        const float numerator = horizontal ? b : a;
+
+        // Środek dysku (radius = 0) - mianownik ograniczony od zera, aby uniknąć dzielenia 0 / 0.
+        const float denominator = std::copysign(std::max(std::abs(radius), 1e-30f), radius);
+
+        float sine, cosine;
+        SinCosQuarterPi(float(M_PI_4) * (numerator / denominator), sine, cosine);
+
+        // Dla sektorów pionowych kąt wynosi PI/2 - x, więc sinus i cosinus zamieniają się miejscami.
+        diskX = radius * (horizontal ? cosine : sine);
+        diskY = radius * (horizontal ? sine : cosine);
+    }
+
+
+    /**
+     * Próbka hemisfery z rozkładem proporcjonalnym do cosinusa kąta względem osi Z (Malley's method) -
+     * punkt dysku jest rzutowany na powierzchnię hemisfery.
+     * @return Cosinus kąta między próbką a osią Z.
+     */
+    inline float SampleCosineHemisphere(float u, float v, float& localX, float& localY)
+    {
+        float radius;
+        SampleConcentricDisk(u, v, localX, localY, radius);
+
+        // Odległość od środka dysku jest wyznaczana dokładnie (bez błędu aproksymacji sinusa i cosinusa),
+        // a wyrażenie pod pierwiastkiem nie jest ujemne - próbka leży zawsze w górnej hemisferze.
+        return std::sqrt(1.0f - radius * radius);
+    }
+
+}
@@ -1,20 +1,44 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
+#include "BsdfSampling.h"
 #include "Material.h"
 
 
 namespace Onyx
 {
 
-    class DiffuseMaterial: public Material
+    struct DiffuseMaterialParameters
+    {
+        pxr::GfVec3f DiffuseReflectance;
+        std::shared_ptr<const MaterialProgram> Program;
+    };
+
+
+    template<>
+    struct MaterialKernel<MaterialKind::Diffuse>
     {
-    public:
+        using Parameters = DiffuseMaterialParameters;
+
+
+        static Parameters CreateParameters(const MaterialParameters& materialParameters)
+        {
+            return Parameters{materialParameters.DiffuseColor, materialParameters.Program};
+        }
+
+
+        static pxr::GfVec3f GetBaseColor(const Parameters& parameters)
+        {
+            return parameters.DiffuseReflectance;
+        }
 
-        DiffuseMaterial() = delete;
 
-        DiffuseMaterial(const pxr::GfVec3f& diffuseReflectance)
-        : m_DiffuseReflectance{diffuseReflectance}
-        {}
+        static const MaterialProgram* GetProgram(const Parameters& parameters)
+        {
+            return parameters.Program.get();
+        }
 
 
         /**
@@ -24,35 +48,95 @@ namespace Onyx
          * @param random2D Dwa numery losowe do wygenerowania próbki
          * @return Próbka w world-space
          */
-        pxr::GfVec3f Sample(const pxr::GfVec3f& N, const pxr::GfVec2f& random2D) override;
+        static pxr::GfVec3f Sample(const Parameters& parameters, const pxr::GfVec3f& N, const pxr::GfVec2f& random2D)
+        {
+            pxr::GfVec3f sample;
+            SampleDirection(N[0], N[1], N[2], random2D[0], random2D[1], sample[0], sample[1], sample[2]);
+
+            return sample;
+        }
+
+
+        /**
+         * Metoda generuje próbki dla pełnej paczki uderzeń (Cosine Weighted Importance Sampling).
+         * Dla funkcji Lambert BRDF iloraz BRDF * cos / PDF jest równy Diffuse Reflectance (kolor bazowy paczki).
+         */
+        static void SampleBatch(const Parameters& parameters, MaterialSampleBatch& batch)
+        {
+            for (uint32_t lane = 0; lane < MaterialBatchWidth; lane++)
+            {
+                const float cosine = SampleDirection(
+                    batch.NormalX[lane], batch.NormalY[lane], batch.NormalZ[lane],
+                    batch.RandomU[lane], batch.RandomV[lane],
+                    batch.DirectionX[lane], batch.DirectionY[lane], batch.DirectionZ[lane]);
+
+                // Próbka na krawędzi hemisfery (cosinus równy 0) nie niesie energii.
+                const float weightScale = cosine > 0.0f ? 1.0f : 0.0f;
+
+                batch.Pdf[lane] = cosine / float(M_PI);
+                batch.WeightR[lane] = batch.BaseColorR[lane] * weightScale;
+                batch.WeightG[lane] = batch.BaseColorG[lane] * weightScale;
+                batch.WeightB[lane] = batch.BaseColorB[lane] * weightScale;
+            }
+        }
 
 
         /**
          * Metoda oblicza Lambert BRDF dla materiału.
          * Lambert BRDF = Diffuse Reflectance / PI
-         * Jednak ze względu na zastosowanie Importance Samplingu PI skraca się z funkcją PDF
-         * @param sample Wygenerowana próbka materiału.
-         * @return Rezultat obliczenia funkcji BRDF dla przekazanej próbki.
-         * @note Funkcja Lambert BRDF jest stała i niezależna od promienia padania (sample).
+         * @param baseColor Diffuse Reflectance w punkcie uderzenia (GetBaseColor lub wartość tekstury).
+         * @param N Wektor normalny powierzchni.
+         * @param sample Kierunek odbicia (próbka materiału lub kierunek do światła).
+         * @return Rezultat obliczenia funkcji BRDF dla przekazanej próbki. 0 dla kierunków pod powierzchnią.
+         * @note Funkcja Lambert BRDF jest stała w górnej hemisferze i niezależna od promienia padania.
          */
-        pxr::GfVec3f Evaluate(const pxr::GfVec3f& sample) override;
+        static pxr::GfVec3f Evaluate(
+            const Parameters& parameters, const pxr::GfVec3f& baseColor,
+            const pxr::GfVec3f& N, const pxr::GfVec3f& sample)
+        {
+            // Materiał nie przepuszcza światła - kierunki pod powierzchnią nie niosą energii.
+            if (pxr::GfDot(N, sample) <= 0.0f) return pxr::GfVec3f(0.0f);
+
+            // Funkcja Lambert BRDF jest stała.
+            return baseColor / float(M_PI);
+        }
 
 
         /**
          * Metoda oblicza prawdopodobieństwo wygenerowania próbki.
-         * Korzystamy z metody Cosine Weighted Importance Sampling dla funkcji Lambert(ian) BRDF
-         * w efekcie iloraz skalowania mocy ścieżki ogranicza się do wartości Diffuse Reflectance.
-         * Skraca sięPI oraz "cosine term" który skaluje moc w zalezności od kąta padania.
-         * @param sample Próbka wygenerowana przez metodę Sample()
-         * @return Prawdopodobieństwo 1.0 wynikające z redukcji opisanej powyżej.
+         * Korzystamy z metody Cosine Weighted Importance Sampling dla funkcji Lambert(ian) BRDF,
+         * PDF = cos(theta) / PI. Iloraz BRDF * cos(theta) / PDF ogranicza się więc do Diffuse Reflectance.
+         * @param N Wektor normalny powierzchni.
+         * @param sample Kierunek odbicia w world-space.
+         * @return Prawdopodobieństwo względem kąta bryłowego. 0 dla kierunków pod powierzchnią.
          */
-        float PDF(const pxr::GfVec3f& sample) override;
+        static float PDF(const Parameters& parameters, const pxr::GfVec3f& N, const pxr::GfVec3f& sample)
+        {
+            // Cosine Weighted Importance Sampling - prawdopodobieństwo proporcjonalne do cosinusa kąta padania.
+            return std::max(pxr::GfDot(N, sample), 0.0f) / float(M_PI);
+        }
 
     private:
 
-        pxr::GfVec3f m_DiffuseReflectance;
+        // Próbka hemisfery w local-space przeniesiona do world-space bazą ortonormalną wektora normalnego.
+        // Wspólna dla Sample i SampleBatch - obie metody generują identyczne kierunki.
+        // @return Cosinus kąta między próbką a wektorem normalnym.
+        static float SampleDirection(
+            float nx, float ny, float nz, float u, float v,
+            float& directionX, float& directionY, float& directionZ)
+        {
+            float tx, ty, tz, bx, by, bz;
+            BsdfSampling::BuildOrthonormalBasis(nx, ny, nz, tx, ty, tz, bx, by, bz);
+
+            float localX, localY;
+            const float localZ = BsdfSampling::SampleCosineHemisphere(u, v, localX, localY);
+
+            directionX = tx * localX + bx * localY + nx * localZ;
+            directionY = ty * localX + by * localY + ny * localZ;
+            directionZ = tz * localX + bz * localY + nz * localZ;
+
+            return localZ;
+        }
     };
 
 }
-
-
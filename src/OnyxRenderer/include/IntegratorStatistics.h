@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace Onyx
+{
+    /**
+     * Statystyki wydajności integratora raportowane aplikacji (Render Stats).
+     * Pozwalają na porównanie przepustowości trybu skalarnego oraz trybów pakietowych bez logowania
+     * w pętli renderowania.
+     */
+    struct IntegratorStatistics
+    {
+        // Liczba zebranych próbek piksela od ostatniego resetu stanu integratora.
+        uint32_t SampleCount = 0;
+
+        // Szerokość pakietu promieni (1 - tryb skalarny).
+        uint32_t PacketWidth = 1;
+
+        // Liczba kafelków które nie osiągnęły progu szumu oraz liczba wszystkich kafelków obrazu.
+        uint32_t ActiveTileCount = 0;
+        uint32_t TileCount = 0;
+
+        // Promienie (primary, bounce, shadow) przetestowane w ostatniej iteracji oraz czas jej wykonania.
+        uint64_t IterationRayCount = 0;
+        double IterationSeconds = 0.0;
+
+        // Promienie przetestowane oraz czas śledzenia od ostatniego resetu stanu integratora.
+        uint64_t TotalRayCount = 0;
+        double TotalSeconds = 0.0;
+
+        // Próbki pikseli (ścieżki) zebrane od ostatniego resetu stanu integratora.
+        uint64_t TotalPathSampleCount = 0;
+
+        // Średni błąd względny pikseli (odchylenie standardowe średniej / średnia luminancja).
+        // Porównany przy równym czasie renderowania określa poziom szumu obrazu.
+        float MeanRelativeError = 0.0f;
+
+
+        double GetRaysPerSecond() const
+        {
+            return TotalSeconds > 0.0 ? double(TotalRayCount) / TotalSeconds : 0.0;
+        }
+
+        // Średnia liczba promieni (primary, bounce, shadow) na próbkę piksela.
+        double GetRaysPerSample() const
+        {
+            return TotalPathSampleCount > 0 ? double(TotalRayCount) / double(TotalPathSampleCount) : 0.0;
+        }
+    };
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+
+
+namespace Onyx
+{
+    /**
+     * Dane światła o kształcie czworokąta (RectLight) wymagane do bezpośredniego próbkowania
+     * światła (Next Event Estimation). Czworokąt jest przechowywany w world-space jako narożnik
+     * oraz dwie krawędzie, co pozwala na wygenerowanie punktu na powierzchni światła
+     * bez transformacji macierzą przy każdej próbce.
+     */
+    struct LightData
+    {
+        // Moc emisji światła wyrażona w Nitach.
+        pxr::GfVec3f Emission;
+
+        // Narożnik czworokąta oraz jego krawędzie w world-space.
+        pxr::GfVec3f Corner;
+        pxr::GfVec3f EdgeU;
+        pxr::GfVec3f EdgeV;
+
+        // Znormalizowany wektor normalny powierzchni światła.
+        pxr::GfVec3f Normal;
+
+        // Pole powierzchni światła w world-space.
+        float Area = 0.0f;
+
+
+        /**
+         * Metoda tworząca dane światła na podstawie transformacji instancji.
+         * Bazowy czworokąt ma rozmiar 1x1 i leży na płaszczyźnie XY (zgodnie z OpenUSD), transformacja
+         * zawiera więc również skalowanie wynikające z parametrów width i height.
+         * @param transform Transformacja instancji światła (object-space -> world-space).
+         * @param emission Moc emisji światła.
+         */
+        static LightData CreateRectLight(const pxr::GfMatrix4f& transform, const pxr::GfVec3f& emission)
+        {
+            LightData lightData;
+            lightData.Emission = emission;
+
+            lightData.Corner = transform.Transform(pxr::GfVec3f(-0.5f, -0.5f, 0.0f));
+            lightData.EdgeU = transform.TransformDir(pxr::GfVec3f(1.0f, 0.0f, 0.0f));
+            lightData.EdgeV = transform.TransformDir(pxr::GfVec3f(0.0f, 1.0f, 0.0f));
+
+            // Długość iloczynu wektorowego krawędzi odpowiada polu powierzchni równoległoboku.
+            pxr::GfVec3f crossEdges = pxr::GfCross(lightData.EdgeU, lightData.EdgeV);
+            lightData.Area = crossEdges.GetLength();
+            lightData.Normal = lightData.Area > 0.0f ? crossEdges / lightData.Area : pxr::GfVec3f(0.0f, 0.0f, 1.0f);
+
+            return lightData;
+        }
+
+
+        /**
+         * Metoda generująca punkt na powierzchni światła z rozkładem jednorodnym względem pola powierzchni.
+         * @param random2D Dwie liczby losowe z przedziału [0, 1).
+         * @return Punkt na powierzchni światła w world-space.
+         */
+        pxr::GfVec3f SamplePosition(const pxr::GfVec2f& random2D) const
+        {
+            return Corner + EdgeU * random2D[0] + EdgeV * random2D[1];
+        }
+
+
+        /**
+         * Metoda przeliczająca gęstość próbkowania względem pola powierzchni (1 / Area)
+         * na gęstość względem kąta bryłowego widzianego z punktu cieniowania.
+         * @param distance Odległość pomiędzy punktem cieniowania a punktem na świetle.
+         * @param cosine Cosinus kąta pomiędzy normalną światła a kierunkiem do punktu cieniowania.
+         * @return Gęstość prawdopodobieństwa względem kąta bryłowego. 0 dla stycznych kierunków.
+         */
+        float GetSolidAnglePdf(float distance, float cosine) const
+        {
+            if (cosine <= 0.0f || Area <= 0.0f) return 0.0f;
+            return (distance * distance) / (cosine * Area);
+        }
+    };
+
+}
@@ -4,50 +4,117 @@
 #include <pxr/base/gf/vec3f.h>
 #include <pxr/base/gf/vec2f.h>
 
+#include <cstdint>
+#include <memory>
+
+#include "MaterialProgram.h"
+
 
 namespace Onyx
 {
     /**
-     * Interfejs materiału reprezentowanego przez funkcję BXDF (BRDF / BTDF)
-     * który pozwala na ewaluację wymiany energi na powierzchni obiektów oraz generowanie
-     * kierunków odbicia / załamania dla których wymiana energii jest najmniej stratna (Importance Sampling).
+     * Rodzaj materiału (znacznik rekordu w tabeli materiałów). Każdy rodzaj posiada własną tablicę parametrów
+     * oraz jądro cieniowania (MaterialKernel) wybierane w czasie kompilacji.
      */
-    class Material
+    enum class MaterialKind : uint8_t
     {
-    public:
-        virtual ~Material() = default;
-
-        /**
-         * Za pomocą tej metody materiał powinien generować kierunek odbicia / załamania
-         * na podstawie wykonania procesu Importance Sampling.
-         * @return Kierunek odbicia załamania w świecie sceny (world-space).
-         */
-        virtual pxr::GfVec3f Sample(const pxr::GfVec3f& N, const pxr::GfVec2f& random2D)
-        {
-            return {0.0, 0.0, 1.0};
-        };
+        Diffuse
+    };
 
 
-        /**
-         * Za pomocą tej metody materiał powinien obliczyć wymianę energi dla wektora wejściowego i wyjściowego
-         * biorąc pod uwagę swoją charakterystykę.
-         */
-        virtual pxr::GfVec3f Evaluate(const pxr::GfVec3f& sample)
-        {
-            return {0.0, 0.0, 0.0};
-        };
+    /**
+     * Parametry materiału przekazywane przez Render Delegate.
+     * Na ich podstawie tabela materiałów wybiera rodzaj materiału i zapisuje parametry jądra cieniowania.
+     */
+    struct MaterialParameters
+    {
+        pxr::GfVec3f DiffuseColor = {0.18f, 0.18f, 0.18f};
+
+        // Program wyznaczający wejścia podłączone do sieci węzłów (np. tekstura diffuseColor).
+        // Wyjścia programu zastępują wartości stałe. Brak programu - materiał korzysta jedynie ze stałych.
+        std::shared_ptr<const MaterialProgram> Program;
+
+        // Indeks załamania - przechowywany dla przyszłych materiałów dielektrycznych.
+        float IOR = 1.5f;
+
 
+        bool operator==(const MaterialParameters& other) const
+        {
+            return DiffuseColor == other.DiffuseColor && Program == other.Program && IOR == other.IOR;
+        }
 
-        /**
-         * Za pomocą tej metody materiał powinien zwrócić prawdopodobieństwo dla wygenerowanego kierunku
-         * wg. funkcji PDF (Probability Distribution Function) materiału.
-         * @param sample Kierunek odbicia / załamania dla którego obliczone zostanie prawdopodobieństwo
-         * @return Szacunek prawdopodobieństwa dla kierunku.
-         */
-        virtual float PDF(const pxr::GfVec3f& sample)
+        struct Hash
         {
-            return 0.0;
+            size_t operator()(const MaterialParameters& parameters) const;
         };
     };
 
+
+    /**
+     * Rekord tabeli materiałów - rodzaj materiału oraz indeks w tablicy parametrów danego rodzaju.
+     */
+    struct MaterialRecord
+    {
+        MaterialKind Kind = MaterialKind::Diffuse;
+        uint32_t ParameterIndex = 0;
+    };
+
+
+    // Liczba uderzeń przetwarzanych jednocześnie przez paczkowe jądra cieniowania.
+    // Wielokrotność szerokości rejestrów wektorowych (4 dla NEON / SSE, 8 dla AVX).
+    constexpr uint32_t MaterialBatchWidth = 8;
+
+
+    /**
+     * Paczka uderzeń w układzie SoA przekazywana do paczkowego jądra cieniowania (MaterialKernel::SampleBatch).
+     * Jądro przetwarza zawsze pełną paczkę - niewykorzystane pozycje muszą zawierać poprawne dane wejściowe
+     * (np. wektor normalny (0, 0, 1)), a ich wyniki są pomijane.
+     */
+    struct alignas(32) MaterialSampleBatch
+    {
+        // Wejście - jednostkowy wektor normalny powierzchni oraz dwa numery losowe.
+        float NormalX[MaterialBatchWidth];
+        float NormalY[MaterialBatchWidth];
+        float NormalZ[MaterialBatchWidth];
+        float RandomU[MaterialBatchWidth];
+        float RandomV[MaterialBatchWidth];
+
+        // Wejście - kolor bazowy w punkcie uderzenia (wartość stała materiału lub wynik próbkowania tekstury).
+        float BaseColorR[MaterialBatchWidth];
+        float BaseColorG[MaterialBatchWidth];
+        float BaseColorB[MaterialBatchWidth];
+
+        // Wyjście - kierunek próbki w world-space, jej prawdopodobieństwo względem kąta bryłowego
+        // oraz iloraz BXDF * cos / PDF (estymator Monte Carlo). Zerowe PDF oznacza kierunek bez energii.
+        float DirectionX[MaterialBatchWidth];
+        float DirectionY[MaterialBatchWidth];
+        float DirectionZ[MaterialBatchWidth];
+        float Pdf[MaterialBatchWidth];
+        float WeightR[MaterialBatchWidth];
+        float WeightG[MaterialBatchWidth];
+        float WeightB[MaterialBatchWidth];
+    };
+
+
+    /**
+     * Jądro cieniowania materiału reprezentowanego przez funkcję BXDF (BRDF / BTDF), specjalizowane dla każdego
+     * rodzaju materiału. Specjalizacja definiuje typ Parameters oraz statyczne funkcje (bez wywołań wirtualnych):
+     *
+     * - GetBaseColor(parameters) oraz GetProgram(parameters) - stały kolor bazowy materiału oraz program
+     *   materiału (lub nullptr), którego wyjście BaseColor go zastępuje. Integrator wykonuje program raz
+     *   dla całego przedziału materiału, a kolor bazowy przekazuje do SampleBatch (MaterialSampleBatch::BaseColor)
+     *   i Evaluate,
+     * - Sample(parameters, N, random2D) - kierunek odbicia / załamania w world-space wygenerowany
+     *   zgodnie z rozkładem materiału (Importance Sampling),
+     * - SampleBatch(parameters, batch) - próbkowanie pełnej paczki uderzeń (MaterialSampleBatch) wraz z PDF
+     *   i wagą próbki; pętla po paczce nie zawiera rozgałęzień, aby kompilator mógł ją zwektoryzować.
+     *   Dla tych samych danych wejściowych wynik jest zgodny z Sample, PDF i Evaluate,
+     * - Evaluate(parameters, baseColor, N, sample) - wymiana energii dla kierunku, bez członu cosinusa (cosine term),
+     *   co pozwala na ewaluację materiału również dla kierunków wygenerowanych przez próbkowanie świateł,
+     * - PDF(parameters, N, sample) - prawdopodobieństwo kierunku względem kąta bryłowego, porównywalne
+     *   z prawdopodobieństwem próbkowania świateł (Multiple Importance Sampling).
+     */
+    template<MaterialKind Kind>
+    struct MaterialKernel;
+
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <pxr/base/gf/vec3f.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Texture.h"
+
+
+namespace Onyx
+{
+    /**
+     * Operacje programu materiału. Rejestry programu przechowują trzy składowe (float):
+     * kolor RGB lub współrzędne tekstury (U, V) wraz z szerokością śladu stożka promienia w trzeciej składowej.
+     */
+    enum class MaterialOpcode : uint8_t
+    {
+        // Target = Constants[Operand].
+        LoadConstant,
+
+        // Target = (U, V, ślad) współrzędnych tekstury geometrii w punkcie uderzenia (primvar "st").
+        LoadTextureCoordinate,
+
+        // Target = przekształcenie afiniczne (UsdTransform2d) współrzędnych z rejestru Source.
+        // Wiersze macierzy 2 x 3 są zapisane w Constants[Operand] oraz Constants[Operand + 1].
+        TransformTextureCoordinate,
+
+        // Target = Textures[Operand] próbkowana we współrzędnych z rejestru Source, kanał wybiera Channel.
+        SampleTexture,
+
+        // Wyjście programu Target (MaterialProgramOutput) = rejestr Source.
+        StoreOutput
+    };
+
+
+    /**
+     * Kanał wyniku próbkowania tekstury (wyjście węzła UsdUVTexture). Pojedynczy kanał jest powielany na RGB.
+     */
+    enum class MaterialChannel : uint8_t
+    {
+        RGB,
+        R,
+        G,
+        B,
+        // Pamięć podręczna tekstur nie przechowuje kanału alfa - wyjście "a" zwraca 1.
+        A
+    };
+
+
+    /**
+     * Wyjścia programu materiału - wejścia jądra cieniowania wyznaczane w punkcie uderzenia.
+     */
+    enum class MaterialProgramOutput : uint8_t
+    {
+        BaseColor
+    };
+
+
+    // Instrukcja programu materiału (8 bajtów).
+    struct MaterialInstruction
+    {
+        MaterialOpcode Opcode;
+        uint8_t Target;
+        uint8_t Source;
+        MaterialChannel Channel;
+
+        // Indeks stałej lub tekstury programu.
+        uint32_t Operand;
+    };
+
+
+    /**
+     * Program materiału skompilowany z sieci węzłów materiału (UsdPrimvarReader, UsdTransform2d, UsdUVTexture)
+     * podłączonych do wejść UsdPreviewSurface. Program jest kompilowany raz podczas synchronizacji materiału,
+     * a integrator wykonuje go dla przedziału uderzeń o wspólnym materiale - każda instrukcja przetwarza
+     * wszystkie uderzenia przedziału (rejestry w układzie SoA).
+     *
+     * Identyczne sieci materiałów współdzielą jeden program (pamięć podręczna kompilacji Render Delegate),
+     * dlatego porównanie wskaźników programów jest wystarczające do deduplikacji materiałów.
+     */
+    struct MaterialProgram
+    {
+        std::vector<MaterialInstruction> Instructions;
+        std::vector<pxr::GfVec3f> Constants;
+        std::vector<TextureBinding> Textures;
+
+        uint32_t RegisterCount = 0;
+
+
+        size_t ByteSize() const
+        {
+            return sizeof(MaterialProgram)
+                + Instructions.capacity() * sizeof(MaterialInstruction)
+                + Constants.capacity() * sizeof(pxr::GfVec3f)
+                + Textures.capacity() * sizeof(TextureBinding);
+        }
+    };
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Material.h"
+#include "MaterialTable.h"
+
+
+namespace Onyx
+{
+    /**
+     * Stabilny uchwyt materiału - indeks przechowywany przez instancje geometrii (DataIndexInBuffer).
+     * Uchwyt ścieżki nie zmienia się przy edycji parametrów ani po usunięciu materiału.
+     * Uchwyt 0 wskazuje na materiał domyślny używany w przypadku braku powiązania.
+     */
+    using MaterialHandle = uint32_t;
+
+
+    /**
+     * Rejestr materiałów silnika. Ścieżka materiału jest odwzorowana na stabilny uchwyt (mapa haszująca),
+     * a uchwyt wskazuje na rekord płaskiej tabeli materiałów. Materiały o identycznych parametrach
+     * współdzielą jeden rekord, liczba uchwytów wskazujących na rekord jest zliczana - nieużywane rekordy
+     * są zwalniane, a ich miejsce w tabeli ponownie używane.
+     *
+     * Uchwyty są rezerwowane podczas synchronizacji Hydry (mapa ścieżek), natomiast tablice odczytywane
+     * przez integrator (rekordy uchwytów, tabela materiałów) są modyfikowane jedynie przy zatrzymanym
+     * wątku renderującym - Render Delegate kolejkuje te modyfikacje (OnyxRenderer::QueueSceneUpdate).
+     */
+    class MaterialRegistry
+    {
+    public:
+
+        MaterialRegistry();
+
+        /**
+         * Metoda zwracająca uchwyt materiału o wskazanej ścieżce. Jeśli materiał nie został jeszcze
+         * zsynchronizowany, uchwyt jest rezerwowany i do czasu synchronizacji wskazuje na materiał domyślny.
+         * Tablice odczytywane przez integrator nie są modyfikowane - zarezerwowane uchwyty otrzymują rekord
+         * w CommitHandles.
+         * @note Metoda może być wywoływana równolegle (synchronizacja meshy w wielu wątkach Hydry).
+         * @param materialPath Ścieżka materiału w scenie OpenUSD. Pusta ścieżka zwraca uchwyt domyślny.
+         * @param newHandle Flaga ustawiana gdy uchwyt został zarezerwowany przez to wywołanie (opcjonalnie).
+         */
+        MaterialHandle GetOrCreateHandle(const pxr::SdfPath& materialPath, bool* newHandle = nullptr);
+
+        /**
+         * Metoda przydzielająca rekordy uchwytom zarezerwowanym od ostatniego wywołania.
+         * Nowe uchwyty wskazują na materiał domyślny.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void CommitHandles();
+
+        /**
+         * Metoda ustawiająca parametry materiału. Uchwyt pozostaje bez zmian, dzięki czemu
+         * geometria powiązana z materiałem nie wymaga ponownej synchronizacji.
+         * @param handle Uchwyt zwrócony przez GetOrCreateHandle.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void SetMaterialParameters(MaterialHandle handle, const MaterialParameters& parameters);
+
+        /**
+         * Metoda zwalniająca obiekt materiału usuniętego ze sceny. Uchwyt wskazuje od teraz
+         * na materiał domyślny (geometria może wciąż przechowywać uchwyt) i zostanie ponownie użyty
+         * jeśli materiał powróci.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void ReleaseMaterial(MaterialHandle handle);
+
+        /**
+         * Metoda zwracająca rekord tabeli materiałów dla uchwytu. Wywoływana przez integrator bez blokady -
+         * tablice rejestru nie są modyfikowane podczas renderowania.
+         */
+        const MaterialRecord& GetMaterialRecord(MaterialHandle handle) const
+        {
+            return m_MaterialTable.GetRecord(m_HandleSlots[handle]);
+        }
+
+        const MaterialTable& GetMaterialTable() const { return m_MaterialTable; }
+
+        /**
+         * @return Liczba uchwytów (ścieżek materiałów) oraz liczba unikalnych rekordów materiałów.
+         */
+        size_t GetHandleCount() const;
+        size_t GetUniqueMaterialCount() const;
+
+    private:
+
+        // Zwraca rekord tabeli o wskazanych parametrach (istniejący lub nowy) i zwiększa licznik.
+        uint32_t AcquireSlot(const MaterialParameters& parameters);
+
+        // Zmniejsza licznik odwołań do rekordu, nieużywany rekord jest zwalniany.
+        void ReleaseSlot(uint32_t slot);
+
+        // Rozszerza tablicę rekordów uchwytów o uchwyty zarezerwowane przez GetOrCreateHandle.
+        void CommitHandlesLocked();
+
+        mutable std::mutex m_RegistryLock;
+
+        // Uchwyty rezerwowane podczas synchronizacji Hydry.
+        std::unordered_map<pxr::SdfPath, MaterialHandle, pxr::SdfPath::Hash> m_PathHandles;
+
+        // Rekord tabeli materiałów indeksowany uchwytem (odczytywany przez integrator).
+        std::vector<uint32_t> m_HandleSlots;
+
+        // Tabela materiałów. Rekord 0 przechowuje materiał domyślny (nie podlega deduplikacji).
+        MaterialTable m_MaterialTable;
+        std::vector<MaterialParameters> m_SlotParameters;
+        std::vector<uint32_t> m_SlotReferenceCounts;
+        std::vector<uint32_t> m_FreeSlots;
+
+        // Deduplikacja - rekord tabeli o identycznych parametrach.
+        std::unordered_map<MaterialParameters, uint32_t, MaterialParameters::Hash> m_ParameterSlots;
+    };
+
+}
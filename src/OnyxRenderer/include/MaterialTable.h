@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "DiffuseMaterial.h"
+#include "Material.h"
+
+
+namespace Onyx
+{
+    /**
+     * Płaska tabela materiałów. Rekord (rodzaj materiału + indeks parametrów) jest adresowany miejscem
+     * przydzielonym przez rejestr materiałów, a parametry są przechowywane w ciągłych tablicach
+     * osobnych dla każdego rodzaju materiału. Integrator odczytuje rekord raz na przedział promieni
+     * o wspólnym materiale i wywołuje jądro cieniowania wybrane w czasie kompilacji.
+     *
+     * Integrator odczytuje tabelę bez blokady, dlatego modyfikacje (Assign, Release) są wykonywane jedynie
+     * przy zatrzymanym wątku renderującym - rejestr materiałów jest modyfikowany przez kolejkę operacji sceny.
+     */
+    class MaterialTable
+    {
+    public:
+
+        /**
+         * Metoda zapisująca materiał o wskazanych parametrach w rekordzie tabeli.
+         * Poprzednie parametry rekordu (jeśli istniały) muszą zostać zwolnione metodą Release.
+         * @param slot Indeks rekordu (miejsce przydzielone przez rejestr materiałów).
+         * @param parameters Parametry materiału.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void Assign(uint32_t slot, const MaterialParameters& parameters);
+
+        /**
+         * Metoda zwalniająca parametry rekordu. Miejsce w tablicy parametrów zostanie ponownie użyte.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void Release(uint32_t slot);
+
+        const MaterialRecord& GetRecord(uint32_t slot) const { return m_Records[slot]; }
+
+        template<MaterialKind Kind>
+        const typename MaterialKernel<Kind>::Parameters& GetParameters(uint32_t parameterIndex) const
+        {
+            if constexpr (Kind == MaterialKind::Diffuse) return m_DiffuseParameters.Values[parameterIndex];
+        }
+
+    private:
+
+        // Ciągła tablica parametrów jednego rodzaju materiału wraz z listą wolnych miejsc.
+        template<typename ParameterType>
+        struct ParameterArray
+        {
+            std::vector<ParameterType> Values;
+            std::vector<uint32_t> FreeIndices;
+
+            uint32_t Allocate(const ParameterType& parameters)
+            {
+                if (FreeIndices.empty())
+                {
+                    Values.push_back(parameters);
+                    return uint32_t(Values.size() - 1);
+                }
+
+                uint32_t parameterIndex = FreeIndices.back();
+                FreeIndices.pop_back();
+
+                Values[parameterIndex] = parameters;
+                return parameterIndex;
+            }
+
+            void Release(uint32_t parameterIndex) { FreeIndices.push_back(parameterIndex); }
+        };
+
+        // Wybiera rodzaj materiału na podstawie parametrów Render Delegate.
+        static MaterialKind SelectKind(const MaterialParameters& parameters);
+
+        std::vector<MaterialRecord> m_Records;
+
+        ParameterArray<MaterialKernel<MaterialKind::Diffuse>::Parameters> m_DiffuseParameters;
+    };
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace Onyx
+{
+    /**
+     * Statystyki pamięci silnika raportowane aplikacji (Render Stats).
+     * Wszystkie wartości są wyrażone w bajtach.
+     */
+    struct MemoryStatistics
+    {
+        // Pamięć zaalokowana przez urządzenie Embree (BVH, bufory geometrii zarządzane przez Embree).
+        size_t EmbreeBytes = 0;
+
+        // Najwyższa zaobserwowana wartość EmbreeBytes.
+        size_t EmbreePeakBytes = 0;
+
+        // Bufor promieni integratora wraz z kolejkami promieni.
+        size_t RayPayloadBytes = 0;
+
+        // Bufory akumulacji próbek oraz statystyk pikseli.
+        size_t AccumulationBytes = 0;
+
+        // Bufory punktów, indeksów i normalnych współdzielone z Embree (raportowane przez Render Delegate).
+        size_t GeometryBufferBytes = 0;
+
+        // Wczytane kafelki tekstur (pamięć podręczna tekstur).
+        size_t TextureCacheBytes = 0;
+
+        // Limit pamięci silnika. Wartość 0 oznacza brak limitu.
+        size_t BudgetBytes = 0;
+
+        // Flaga wskazująca na tryb oszczędzania pamięci po przekroczeniu limitu.
+        bool BudgetFallback = false;
+
+
+        size_t GetTotalBytes() const
+        {
+            return EmbreeBytes + RayPayloadBytes + AccumulationBytes + GeometryBufferBytes + TextureCacheBytes;
+        }
+    };
+
+}
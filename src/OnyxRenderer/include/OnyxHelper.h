@@ -10,6 +10,22 @@
 
 namespace Onyx
 {
+    /**
+     * Współrzędne tekstur w punkcie uderzenia wraz z danymi trójkąta wymaganymi do wyboru poziomu MIP.
+     */
+    struct HitTextureCoordinate
+    {
+        pxr::GfVec2f UV;
+
+        // Stosunek rozmiaru trójkąta w przestrzeni tekstury do jego rozmiaru w world-space
+        // (pierwiastek ilorazu pól) - przelicza szerokość stożka promienia na szerokość w przestrzeni tekstury.
+        float UVPerWorldUnit = 0.0f;
+
+        // Jednostkowy wektor geometryczny trójkąta w world-space.
+        pxr::GfVec3f WorldNormal;
+    };
+
+
     class OnyxHelper
     {
     public:
@@ -36,16 +52,45 @@ namespace Onyx
         * wskaźnik do bufora wektorów normalnych. Jeśli tak, używamy wektora z bufora, w innym przypadku
         * korzystamy z wektora geometrycznego powierzchni.
         *
-        * @param rayHitData Promień który otrzymał poprawne dane intersekcji.
+        * @param instanceID Identyfikator uderzonej instancji w scenie.
+        * @param instancePrimitiveID Indeks kopii w tablicy instancji (0 dla pojedynczej instancji).
+        * @param primitiveID Identyfikator uderzonego trójkąta instancji.
+        * @param hitUV Współrzędne barycentryczne punktu uderzenia.
+        * @param geometricNormal Wektor geometryczny trójkąta obliczony przez Embree (object-space).
         * @param embreeScene Scena z którą promień testował intersekcję.
         * @return Wektor normalny powierzchni w globalnej przestrzeni sceny (world-space).
         */
         static pxr::GfVec3f EvaluateHitSurfaceNormal(
-            const RTCRayHit& rayHitData,
+            uint instanceID,
+            uint instancePrimitiveID,
+            uint primitiveID,
+            const pxr::GfVec2f& hitUV,
+            const pxr::GfVec3f& geometricNormal,
             const RTCScene& embreeScene
         );
 
 
+        /**
+         * Metoda pomocnicza służąca do ewaluacji współrzędnych tekstur (primvar "st") w punkcie uderzenia.
+         *
+         * @param instanceID Identyfikator uderzonej instancji w scenie.
+         * @param instancePrimitiveID Indeks kopii w tablicy instancji (0 dla pojedynczej instancji).
+         * @param primitiveID Identyfikator uderzonego trójkąta instancji.
+         * @param hitUV Współrzędne barycentryczne punktu uderzenia.
+         * @param embreeScene Scena z którą promień testował intersekcję.
+         * @param textureCoordinate Wynik - współrzędne tekstur oraz dane trójkąta.
+         * @return False jeśli geometria nie posiada współrzędnych tekstur.
+         */
+        static bool EvaluateHitTextureCoordinate(
+            uint instanceID,
+            uint instancePrimitiveID,
+            uint primitiveID,
+            const pxr::GfVec2f& hitUV,
+            const RTCScene& embreeScene,
+            HitTextureCoordinate& textureCoordinate
+        );
+
+
         /**
          * Metoda pomocnicza służąca do tworzenia promienia wychodzącego z kamery (primary ray).
          *
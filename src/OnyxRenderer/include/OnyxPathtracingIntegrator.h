@@ -5,37 +5,81 @@
 #include <pxr/base/gf/vec2i.h>
 #include <pxr/base/gf/vec3f.h>
 #include <pxr/usd/sdf/path.h>
-#include <random>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+#include <atomic>
+#include <mutex>
 
 
 #include "Integrator.h"
+#include "IntegratorStatistics.h"
+#include "LightData.h"
+#include "MaterialRegistry.h"
+#include "RayPayloadBuffer.h"
 #include "RenderArgument.h"
+#include "RenderSettings.h"
+#include "Sampler.h"
+#include "TextureCache.h"
 
 namespace Onyx
 {
-    class Material;
+    /**
+     * Prostokątny fragment obrazu (kafelek) przetwarzany przez pojedyncze zadanie puli wątków.
+     * Każdy piksel należy do dokładnie jednego kafelka, dzięki czemu zapis do buforów próbek
+     * oraz buforów AOV odbywa się bez wyścigów pomiędzy wątkami.
+     */
+    struct RenderTile
+    {
+        uint MinX;
+        uint MinY;
+
+        // Granice kafelka są wyłączne (MaxX oraz MaxY nie należą do kafelka).
+        uint MaxX;
+        uint MaxY;
+
+        // Początek segmentu promieni kamery kafelka w kolejce promieni pierwotnych.
+        uint PrimaryQueueOffset;
+
+        uint GetPixelCount() const { return (MaxX - MinX) * (MaxY - MinY); }
+    };
 
-    struct RayPayload
+    /**
+     * Stan estymatora wariancji luminancji próbek piksela (algorytm Welforda).
+     * Pozwala na wyznaczenie wariancji bez przechowywania próbek, z zachowaniem stabilności numerycznej.
+     */
+    struct PixelVariance
     {
-        RTCRayHit RayHit;
-        bool Terminated = false;
-        uint8_t Bounce = 0;
+        float Mean = 0.0f;
 
-        pxr::GfVec3f Throughput = pxr::GfVec3f(1.0);
-        pxr::GfVec3f Radiance = pxr::GfVec3f(0.0);
+        // Suma kwadratów odchyleń od średniej.
+        float M2 = 0.0f;
+    };
+
+    /**
+     * Struktura przechowująca wskaźniki do zmapowanych buforów AOV na czas jednej iteracji odbicia.
+     * Brak bufora jest oznaczony pustym wskaźnikiem.
+     */
+    struct AovOutput
+    {
+        uint8_t* ColorBuffer = nullptr;
+        size_t ColorElementSize = 0;
+
+        uint8_t* NormalBuffer = nullptr;
+        size_t NormalElementSize = 0;
     };
 
     struct DataPayload
     {
         RTCScene* Scene;
-        std::vector<pxr::GfVec3f>* LightBuffer;
-        std::vector<std::pair<pxr::SdfPath, std::unique_ptr<Material>>>* MaterialBuffer;
+        std::vector<LightData>* LightBuffer;
+        MaterialRegistry* Materials;
+        TextureCache* Textures;
     };
 
     class OnyxPathtracingIntegrator final : Integrator
     {
     public:
-        OnyxPathtracingIntegrator() = default;
+        OnyxPathtracingIntegrator();
         OnyxPathtracingIntegrator(const DataPayload& payload);
 
         ~OnyxPathtracingIntegrator() override;
@@ -50,34 +94,366 @@ namespace Onyx
 
         void SetRenderArgument(const std::shared_ptr<RenderArgument>& renderArgument);
 
+        /**
+         * Metoda aktualizująca ustawienia integratora.
+         * Zmiana limitu wątków powoduje utworzenie nowej puli zadań.
+         * @param renderSettings Nowe ustawienia silnika.
+         */
+        void SetRenderSettings(const RenderSettings& renderSettings);
+
+        /**
+         * @return Pamięć bufora promieni oraz kolejek promieni kafelków (w bajtach).
+         * @note Wartość jest aktualizowana przy resecie stanu integratora, odczyt jest bezpieczny z wątku Hydry.
+         */
+        size_t GetRayPayloadMemoryFootprint() const { return m_RayPayloadMemoryBytes; }
+
+        /**
+         * @return Pamięć buforów akumulacji próbek oraz statystyk pikseli (w bajtach).
+         */
+        size_t GetAccumulationMemoryFootprint() const { return m_AccumulationMemoryBytes; }
+
+        /**
+         * @return Statystyki wydajności ostatniej iteracji oraz sumaryczne od ostatniego resetu stanu.
+         * @note Odczyt jest bezpieczny z wątku Hydry w trakcie pracy wątku renderującego.
+         */
+        IntegratorStatistics GetStatistics() const;
+
     private:
 
         void PerformRayBounceIteration();
+
+        /**
+         * Metoda wykonująca jedną iterację odbicia dla promieni należących do kafelka.
+         * Wywoływana równolegle dla wielu kafelków przez pulę wątków.
+         * @param tile Kafelek obrazu którego promienie zostaną przetworzone.
+         * @param aovOutput Wskaźniki do zmapowanych buforów AOV.
+         */
+        void PerformRayBounceIterationForTile(size_t tileIndex, const AovOutput& aovOutput);
+
+        /**
+         * Metoda wykonująca test intersekcji dla promieni wskazanych przez segment kolejki.
+         * W zależności od ustawień promienie są testowane pojedynczo lub w pakietach.
+         * @param rayIndices Początek segmentu kolejki aktywnych promieni.
+         * @param rayCount Liczba promieni w segmencie.
+         */
+        void IntersectRays(const uint32_t* rayIndices, uint rayCount);
+
+        /**
+         * Metoda grupująca kolejne promienie segmentu kolejki w pakiety o zadanej szerokości
+         * i wykonująca dla nich test intersekcji za pomocą rtcIntersect4/8/16.
+         * Kolejka promieni kamery jest uporządkowana blokami 4x4 pikseli, dzięki czemu pakiety
+         * pierwszego odbicia zawierają sąsiadujące (spójne) promienie.
+         */
+        template<int PacketWidth>
+        void IntersectRaysPacketed(const uint32_t* rayIndices, uint rayCount);
+
+        /**
+         * Metoda wykonująca test przesłonięcia promieni cienia (rtcOccluded1 lub rtcOccluded4/8/16)
+         * i dodająca wkład nieprzesłoniętych próbek światła do radiancji ścieżek.
+         * @param rayIndices Początek segmentu kolejki promieni cienia.
+         * @param rayCount Liczba promieni w segmencie.
+         */
+        void TraceShadowRays(const uint32_t* rayIndices, uint rayCount);
+
+        template<int PacketWidth>
+        void OccludedRaysPacketed(const uint32_t* rayIndices, uint rayCount);
+
+        /**
+         * Metoda sortująca uderzenia w powierzchnie kafelka według indeksu materiału (sortowanie przez zliczanie).
+         * Posortowane indeksy materiałów są zapisywane z powrotem do bufora materialIndices.
+         * @param rayIndices Indeksy promieni w kolejności kafelka.
+         * @param materialIndices Indeksy materiałów odpowiadające promieniom.
+         * @param rayCount Liczba promieni.
+         * @param minMaterialIndex Najmniejszy indeks materiału wśród uderzeń.
+         * @param maxMaterialIndex Największy indeks materiału wśród uderzeń.
+         * @param sortedRayIndices Bufor wyjściowy posortowanych indeksów promieni.
+         */
+        void SortShadingQueueByMaterial(
+            const uint32_t* rayIndices, uint32_t* materialIndices, uint rayCount,
+            uint32_t minMaterialIndex, uint32_t maxMaterialIndex, uint32_t* sortedRayIndices);
+
+        /**
+         * Metoda cieniująca przedział uderzeń o wspólnym materiale. Rodzaj materiału jest parametrem szablonu,
+         * dzięki czemu jądro cieniowania jest wywoływane bezpośrednio (bez wywołań wirtualnych na uderzenie).
+         * Kierunki odbić są generowane paczkami (MaterialBatchWidth uderzeń) przez wektoryzowane jądro materiału.
+         * Promienie kontynuujące ścieżkę trafiają do kolejki kafelka, promienie cienia do kolejki cieni.
+         * @param parameters Parametry materiału z tabeli materiałów.
+         * @param rayIndices Indeksy promieni przedziału.
+         * @param rayCount Liczba promieni przedziału.
+         */
+        template<MaterialKind Kind>
+        void ShadeMaterialBin(
+            const typename MaterialKernel<Kind>::Parameters& parameters,
+            const uint32_t* rayIndices, uint rayCount,
+            uint32_t* tileRayQueue, uint& survivorCount,
+            uint32_t* tileShadowQueue, uint& shadowRayCount);
+
+        /**
+         * Metoda wykonująca program materiału dla przedziału uderzeń (etap programu materiału).
+         * Każda instrukcja przetwarza wszystkie uderzenia przedziału, dzięki czemu próbkowanie tekstury
+         * wymaga jednego zapytania do pamięci podręcznej tekstur na przedział. Poziom MIP jest wyznaczany
+         * szerokością stożka promienia (Ray Cones) w punkcie uderzenia.
+         * @param program Program materiału.
+         * @param rayIndices Indeksy promieni przedziału.
+         * @param rayCount Liczba promieni przedziału.
+         * @param baseColors Wyjście BaseColor dla każdego promienia przedziału (niezmienione jeśli program
+         * nie zapisuje wyjścia).
+         */
+        void ExecuteMaterialProgram(
+            const MaterialProgram& program, const uint32_t* rayIndices, uint rayCount, pxr::GfVec3f* baseColors);
+
+        /**
+         * Metoda cieniująca uderzenie w powierzchnię - generuje promień odbicia na podstawie próbki materiału,
+         * aktualizuje moc ścieżki oraz próbkuje bezpośrednio światła sceny.
+         * @param rayIndex Indeks promienia w buforze.
+         * @param parameters Parametry materiału uderzonej powierzchni.
+         * @param batch Paczka z wektorem normalnym, kolorem bazowym i próbką materiału wygenerowaną przez jądro.
+         * @param lane Pozycja uderzenia w paczce.
+         * @param castShadowRay Flaga ustawiana jeśli wygenerowano promień cienia.
+         * @return Prawda, jeśli ścieżka kontynuuje z promieniem odbicia.
+         */
+        template<MaterialKind Kind>
+        bool ShadeSurfaceHit(
+            uint32_t rayIndex, const typename MaterialKernel<Kind>::Parameters& parameters,
+            const MaterialSampleBatch& batch, uint lane, bool& castShadowRay);
+
+        /**
+         * Metoda próbkująca bezpośrednio jedno z świateł sceny w punkcie uderzenia (Next Event Estimation).
+         * Wkład światła jest ważony heurystyką potęgową (Multiple Importance Sampling) względem próbkowania
+         * materiału i zapisywany w buforze promieni wraz z promieniem cienia.
+         * Punkt cieniowania odpowiada początkowi promienia odbicia zapisanego w buforze.
+         * @param rayIndex Indeks promienia w buforze.
+         * @param parameters Parametry materiału uderzonej powierzchni.
+         * @param baseColor Kolor bazowy materiału w punkcie uderzenia.
+         * @param N Wektor normalny powierzchni.
+         * @return Prawda, jeśli wygenerowano promień cienia o niezerowym wkładzie.
+         */
+        template<MaterialKind Kind>
+        bool SampleDirectLight(
+            uint32_t rayIndex, const typename MaterialKernel<Kind>::Parameters& parameters,
+            const pxr::GfVec3f& baseColor, const pxr::GfVec3f& N);
+
+        /**
+         * @return Gęstość prawdopodobieństwa (względem kąta bryłowego) wybrania kierunku do punktu światła
+         * przez próbkowanie świateł, uwzględniająca jednorodny wybór jednego ze świateł sceny.
+         */
+        float GetLightSamplePdf(const LightData& light, const pxr::GfVec3f& direction, float distance) const;
+
+        /**
+         * Metoda konwertująca akumulowane próbki pikseli do formatu bufora AOV koloru
+         * (float32, float16 lub UNorm8). Wykonywana raz na iterację, poza pętlą śledzenia promieni.
+         */
+        void ResolveColorAov();
+
+        /**
+         * Metoda oceniająca zbieżność kafelków na podstawie wariancji próbek pikseli.
+         * Kafelki o błędzie względnym poniżej progu szumu są wyłączane z kolejnych iteracji.
+         */
+        void UpdateTileConvergence();
+
+        /**
+         * @return Błąd względny średniej luminancji piksela.
+         */
+        float GetPixelRelativeError(uint32_t pixelIndex) const;
+
+        /**
+         * @return Średni błąd względny pikseli które zebrały co najmniej dwie próbki (statystyki szumu).
+         */
+        float ComputeMeanRelativeError();
+
+        /**
+         * Metoda kompaktująca kolejkę aktywnych promieni po iteracji odbicia.
+         * Segmenty kafelków z ocalałymi promieniami są przepisywane do ciągłej kolejki
+         * na podstawie sumy prefiksowej liczby ocalałych promieni.
+         */
+        void CompactActiveRayQueue();
+
         bool IsRayBufferConverged();
 
-        pxr::GfVec2f GenerateUniformRandomNumber2D();
+        /**
+         * Metoda zwracająca parę liczb losowych dla aktualnej próbki piksela.
+         * @param rayIndex Indeks promienia (piksela) w buforze.
+         * @param dimension Wymiar próbkowania (SampleDimension).
+         */
+        pxr::GfVec2f GetSample2D(uint32_t rayIndex, uint32_t dimension) const;
+
+        /**
+         * Metoda rozpoczynająca nową ścieżkę w slocie promienia - generuje promień kamery
+         * dla piksela odpowiadającego slotowi oraz zeruje stan ścieżki.
+         * @param rayIndex Indeks promienia (piksela) w buforze.
+         */
+        void StartCameraPath(uint32_t rayIndex);
+
+        /**
+         * Metoda kończąca ścieżkę promienia. Zebrana radiancja jest dodawana do próbek piksela.
+         * W trybie regeneracji slot otrzymuje nową ścieżkę jeśli piksel nie zebrał jeszcze
+         * docelowej liczby próbek iteracji.
+         * @return Prawda, jeśli slot rozpoczął nową ścieżkę i pozostaje w kolejce aktywnych promieni.
+         */
+        bool FinishPathSample(uint32_t rayIndex);
+
+        /**
+         * @return Liczba próbek na piksel zbieranych w aktualnej iteracji.
+         */
+        uint GetIterationSampleCount() const;
 
         void ResetRayPayloadsWithPrimaryRays();
         void ResetSampleBuffer();
 
+        /**
+         * Metoda dzieląca obraz o aktualnej rozdzielczości na kafelki
+         * oraz budująca kolejkę promieni pierwotnych.
+         */
+        void RebuildTiles();
+
+        /**
+         * Metoda wykonująca przekazaną funkcję dla każdego kafelka obrazu
+         * w puli wątków z uwzględnieniem limitu wątków.
+         * Funkcja otrzymuje indeks kafelka w buforze kafelków.
+         */
+        template<typename TileFunction>
+        void ForEachTileParallel(const TileFunction& tileFunction);
+
         std::shared_ptr<RenderArgument> m_RenderArgument;
 
-        std::vector<RayPayload> m_RayPayloadBuffer;
+        /**
+         * Stan wszystkich promieni (ścieżek) integratora w układzie SoA.
+         * Jeden promień odpowiada jednemu pikselowi obrazu.
+         */
+        RayPayloadBuffer m_RayPayloadBuffer;
 
         std::optional<pxr::GfVec2i> m_IntegrationResolution;
         std::optional<DataPayload> m_Data;
 
-        std::random_device m_RandomDevice;
-        std::mt19937 m_MersenneTwister;
-        std::uniform_real_distribution<float> m_UniformDistributionGenerator;
+        /**
+         * Rozmiar boku kwadratowego kafelka w pikselach.
+         * Kafelki na krawędziach obrazu mogą być mniejsze.
+         */
+        static constexpr uint m_TileSize = 32;
+
+        std::vector<RenderTile> m_TileBuffer;
+
+        /**
+         * Indeksy pikseli (promieni) uporządkowane kafelkami, a wewnątrz kafelka blokami 4x4.
+         * Kolejka jest kopiowana do kolejki aktywnych promieni na początku każdej iteracji.
+         */
+        std::vector<uint32_t> m_PrimaryRayQueue;
+
+        /**
+         * Kolejka indeksów aktywnych promieni (nie zakończonych ścieżek) podzielona na segmenty kafelków.
+         * Koszt kolejnych odbić jest proporcjonalny do liczby aktywnych ścieżek, a nie do rozdzielczości.
+         * Kolejka kompaktowana jest zapisywana do drugiego bufora, po czym bufory są zamieniane.
+         */
+        std::vector<uint32_t> m_ActiveRayQueue;
+        std::vector<uint32_t> m_CompactedRayQueue;
+
+        // Początek oraz długość segmentu każdego z kafelków w kolejce aktywnych promieni.
+        std::vector<uint> m_TileQueueOffsets;
+        std::vector<uint> m_TileQueueCounts;
+        std::vector<uint> m_CompactedTileQueueOffsets;
+
+        /**
+         * Kolejka indeksów promieni z wygenerowanym promieniem cienia. Segment kafelka zaczyna się
+         * w tym samym miejscu co segment kafelka w kolejce aktywnych promieni.
+         */
+        std::vector<uint32_t> m_ShadowRayQueue;
+
+        /**
+         * Kolejka uderzeń w powierzchnie oraz odpowiadających im indeksów materiałów (segmenty kafelków).
+         * Uderzenia są sortowane według materiału przed cieniowaniem, dzięki czemu każdy materiał
+         * jest ewaluowany dla ciągłego przedziału promieni.
+         */
+        std::vector<uint32_t> m_ShadingRayQueue;
+        std::vector<uint32_t> m_ShadingMaterialQueue;
+
+        // Liczba promieni które przetrwały iterację odbicia (zapisywana niezależnie przez każdy kafelek).
+        std::vector<uint> m_TileSurvivorCounts;
+
+        /**
+         * Bufory pomocnicze etapu cieniowania kafelka. Każdy wątek puli posiada własny zestaw buforów,
+         * które zachowują pojemność pomiędzy kafelkami i odbiciami (brak alokacji w pętli śledzenia).
+         */
+        struct ShadingScratch
+        {
+            // Histogram oraz przesunięcia przedziałów materiałów (SortShadingQueueByMaterial).
+            std::vector<uint> MaterialOffsets;
+
+            // Kolory bazowe przedziału wyznaczone przez program materiału (ShadeMaterialBin).
+            std::vector<pxr::GfVec3f> ProgramBaseColors;
+
+            // Rejestry programu materiału oraz zapytania do pamięci podręcznej tekstur (ExecuteMaterialProgram).
+            std::vector<pxr::GfVec3f> ProgramRegisters;
+            std::vector<TextureLookup> TextureLookups;
+        };
 
-        const uint8_t m_BounceLimit = 1;
+        tbb::enumerable_thread_specific<ShadingScratch> m_ShadingScratch;
+
+        uint m_ActiveRayCount = 0;
+
+        /**
+         * Pula zadań (work-stealing) ograniczona do liczby wątków określonej w ustawieniach.
+         */
+        std::unique_ptr<tbb::task_arena> m_TaskArena;
+
+        RenderSettings m_RenderSettings;
+
+        /**
+         * Bezstanowy generator próbek współdzielony przez wszystkie wątki.
+         */
+        Sampler m_Sampler;
+
+        /**
+         * Efektywny limit odbić ścieżki wyznaczany z ustawień silnika.
+         * Promień którego licznik odbić przekroczy limit kończy ścieżkę bez testu intersekcji.
+         */
+        uint8_t m_BounceLimit = 1;
+
+        /**
+         * Kąt rozwarcia stożka promienia kamery (Ray Cones) - kąt pomiędzy promieniami sąsiednich pikseli
+         * w centrum obrazu. Wyznacza szerokość śladu uderzenia, a więc poziom MIP tekstur.
+         */
+        float m_PixelSpreadAngle = 0.0f;
 
         uint m_SampleCount = 1;
         uint m_SampleLimit = 1000;
 
-        bool m_IncreaseSampleCount = true;
+        /**
+         * Liczba promieni przetestowanych w aktualnej iteracji oraz czas jej wykonania.
+         * Statystyki pozwalają na porównanie przepustowości (promienie / sekundę) trybów śledzenia.
+         */
+        std::atomic<uint64_t> m_IterationRayCount = 0;
+        double m_IterationSeconds = 0.0;
+
+        // Liczba pikseli (nie zbieżnych kafelków) próbkowanych w aktualnej iteracji.
+        // Pozwala na wyznaczenie średniej liczby promieni na próbkę.
+        uint m_IterationPixelCount = 0;
+
+        // Statystyki zakończonych iteracji odczytywane przez wątek Hydry (GetStatistics).
+        IntegratorStatistics m_Statistics;
+        mutable std::mutex m_StatisticsLock;
+
+        // Flaga modyfikowana równolegle przez wiele wątków.
+        std::atomic<bool> m_IncreaseSampleCount = true;
         std::vector<pxr::GfVec3f> m_SampleBuffer;
+
+        // Liczba próbek zebranych przez każdy piksel, wykorzystywana do uśrednienia bufora próbek.
+        std::vector<uint> m_PixelSampleCount;
+
+        std::vector<PixelVariance> m_PixelVariance;
+
+        // Flagi kafelków których wszystkie piksele osiągnęły wymagany poziom szumu.
+        std::vector<uint8_t> m_TileConverged;
+        std::atomic<uint> m_ActiveTileCount = 0;
+
+        // Suma błędów względnych oraz liczba ocenionych pikseli kafelków (ComputeMeanRelativeError).
+        std::vector<std::pair<double, uint32_t>> m_TileRelativeErrors;
+
+        // Rozmiary buforów integratora odczytywane przez wątek Hydry (statystyki pamięci).
+        std::atomic<size_t> m_RayPayloadMemoryBytes = 0;
+        std::atomic<size_t> m_AccumulationMemoryBytes = 0;
+
+        // Flaga odczytywana przez wątek Hydry (IsConverged) w trakcie pracy wątku renderującego.
+        std::atomic<bool> m_AdaptiveConverged = false;
     };
 
 }
\ No newline at end of file
@@ -1,14 +1,25 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <embree4/rtcore.h>
 
 #include <pxr/base/gf/matrix4d.h>
 #include <pxr/imaging/hd/renderThread.h>
 #include <pxr/usd/sdf/path.h>
 
+#include "IntegratorStatistics.h"
+#include "LightData.h"
 #include "Material.h"
+#include "MaterialRegistry.h"
+#include "MemoryStatistics.h"
 #include "RenderArgument.h"
+#include "RenderSettings.h"
+#include "TextureCache.h"
 
 #include "../../hdOnyx/include/mesh.h"
 #include "OnyxPathtracingIntegrator.h"
@@ -42,31 +53,208 @@ namespace Onyx
         }
 
 
+        /**
+         * Metoda przekazująca nowe ustawienia silnika do integratora.
+         * @param renderSettings Ustawienia zdefiniowane przez użytkownika.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void SetRenderSettings(const RenderSettings& renderSettings);
+
+
+        /**
+         * Metoda zwracająca statystyki pamięci silnika.
+         * @param geometryBufferBytes Rozmiar buforów geometrii współdzielonych z Embree.
+         */
+        MemoryStatistics GetMemoryStatistics(size_t geometryBufferBytes = 0) const;
+
+
+        /**
+         * Metoda zwracająca statystyki wydajności integratora (przepustowość śledzenia promieni).
+         */
+        IntegratorStatistics GetIntegratorStatistics() const { return m_Integrator.value()->GetStatistics(); }
+
+
+        /**
+         * Metoda sprawdzająca limit pamięci silnika. Po jego przekroczeniu silnik przechodzi w tryb oszczędzania
+         * pamięci: BVH sceny jest budowane w formacie kompaktowym, a moc ścieżek przechowywana w formacie half.
+         * Tryb pozostaje aktywny do czasu usunięcia limitu.
+         * @param geometryBufferBytes Rozmiar buforów geometrii współdzielonych z Embree.
+         * @return True jeśli tryb oszczędzania pamięci został właśnie włączony.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        bool EnforceMemoryBudget(size_t geometryBufferBytes);
+
+
+        /**
+         * @return True jeśli silnik pracuje w trybie oszczędzania pamięci (przekroczony limit).
+         */
+        bool IsMemoryBudgetFallbackEnabled() const { return m_MemoryBudgetFallback; }
+
+
+        /**
+         * @return True jeśli suma pamięci silnika przekracza ustawiony limit.
+         */
+        bool IsMemoryBudgetExceeded(size_t geometryBufferBytes) const;
+
+
+        /**
+         * Metoda unieważniająca dotychczasowy wynik integracji (np. po zmianie kamery).
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        void InvalidateIntegratorState() { m_ResetIntegratorState = true; }
+
+
+        /**
+         * @return True jeśli integrator zakończył zbieranie próbek (limit próbek lub osiągnięty próg szumu).
+         * Oczekujący reset stanu integratora oznacza brak zbieżności.
+         */
+        bool IsConverged() const
+        {
+            return !m_ResetIntegratorState && m_Integrator.value()->IsConverged();
+        }
+
+
         /**
          * Metoda podpinająca geometrię do sceny Embree silnika.
          * @param geometrySource Geometria do powiązania ze sceną
          * @return Indeks powiązania obiektu ze sceną. Przydatny w przypadku konieczności cofnięcia operacji.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
          */
         uint AttachGeometryToScene(const RTCGeometry& geometrySource);
 
 
-        uint AttachLightInstanceToScene(
-            pxr::HdOnyxInstanceData* instanceData,
+        /**
+         * Metoda rezerwująca identyfikator geometrii w scenie i kolejkująca jej podpięcie.
+         * Scena Embree nie jest modyfikowana - operacja zostanie wykonana przez ApplyPendingSceneOperations.
+         * @note Metoda może być wywoływana równolegle (synchronizacja meshy w wielu wątkach Hydry).
+         * @param geometrySource Zatwierdzona geometria do powiązania ze sceną. Kolejka przechowuje referencję,
+         * dlatego geometria może zostać zwolniona przez wywołującego przed wykonaniem operacji.
+         * @return Zarezerwowany identyfikator geometrii w scenie.
+         */
+        uint QueueAttachGeometry(const RTCGeometry& geometrySource);
+
+
+        /**
+         * Metoda kolejkująca odpięcie geometrii od sceny. Identyfikator jest zwalniany po wykonaniu operacji.
+         * @note Metoda może być wywoływana równolegle (synchronizacja meshy w wielu wątkach Hydry).
+         * @param geometryID Identyfikator zwrócony przez QueueAttachGeometry.
+         * @param retainedResources Zasoby odczytywane przez integrator za pośrednictwem odpinanej geometrii
+         * (struktury pomocnicze instancji, bufory transformacji, geometria BLAS). Wątek renderujący korzysta
+         * z nich do czasu wykonania operacji, dlatego są zwalniane dopiero przez ApplyPendingSceneOperations.
+         */
+        void QueueDetachGeometry(uint geometryID, std::shared_ptr<const void> retainedResources = nullptr);
+
+
+        /**
+         * Metoda kolejkująca modyfikację geometrii podpiętej do sceny (transformacja instancji, bufory punktów)
+         * lub danych odczytywanych przez integrator podczas śledzenia promieni.
+         * Modyfikacja jest wykonywana przez ApplyPendingSceneOperations przy zatrzymanym wątku renderującym,
+         * w kolejności zgłoszenia względem podpięć i odpięć geometrii.
+         * @note Metoda może być wywoływana równolegle (synchronizacja meshy w wielu wątkach Hydry).
+         * @param sceneUpdate Funkcja modyfikująca. Przechwycone zasoby są zwalniane po jej wykonaniu.
+         */
+        void QueueSceneUpdate(std::function<void()> sceneUpdate);
+
+
+        /**
+         * Metoda wykonująca zakolejkowane podpięcia, odpięcia i modyfikacje geometrii w jednej partii,
+         * w kolejności ich zgłoszenia.
+         * @return Liczba wykonanych operacji.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
+         */
+        size_t ApplyPendingSceneOperations();
+
+
+        /**
+         * @return True jeśli kolejka operacji na scenie nie jest pusta.
+         */
+        bool HasPendingSceneOperations() const;
+
+
+        /**
+         * Metoda rezerwująca miejsce w buforze świateł i kolejkująca podpięcie instancji światła do sceny.
+         * Geometria instancji, jej struktura pomocnicza oraz wpis w buforze świateł są tworzone przez
+         * ApplyPendingSceneOperations - bufory odczytywane przez integrator (NEE) nie rosną podczas renderowania.
+         * @param transform Transformacja instancji światła (uwzględnia rozmiar światła).
+         * @param totalEmissionPower Moc emisji światła.
+         * @return Indeks światła w buforze świateł.
+         */
+        uint AttachLightInstanceToScene(const pxr::GfMatrix4f& transform, const pxr::GfVec3f& totalEmissionPower);
+
+
+        /**
+         * Metoda kolejkująca odpięcie instancji światła od sceny. Geometria oraz struktura pomocnicza instancji
+         * są zwalniane po wykonaniu odpięcia, a miejsce w buforze świateł zostanie użyte przez kolejne światło.
+         * @param lightIndex Indeks światła w buforze świateł zwrócony przez AttachLightInstanceToScene.
+         */
+        void DetachLightInstance(uint lightIndex);
+
+
+        /**
+         * @return Liczba miejsc w buforze świateł (światła podpięte, zakolejkowane oraz wolne miejsca).
+         */
+        size_t GetLightSlotCount() const;
+
+
+        /**
+         * Metoda kolejkująca aktualizację istniejącej instancji światła (transformacja, moc emisji) bez jej
+         * ponownego podpinania. Identyfikator geometrii w scenie oraz indeks w buforze świateł pozostają bez zmian.
+         * Struktura pomocnicza instancji oraz bufor świateł są modyfikowane przez ApplyPendingSceneOperations.
+         * @param lightIndex Indeks światła w buforze świateł zwrócony przez AttachLightInstanceToScene.
+         * @param transform Nowa transformacja instancji światła.
+         * @param totalEmissionPower Moc emisji światła.
+         */
+        void UpdateLightInstance(
+            uint lightIndex,
+            const pxr::GfMatrix4f& transform,
             const pxr::GfVec3f& totalEmissionPower);
 
 
         /**
-         * Metoda dodająca lub aktualizująca dane materiału w silniku.
-         * @param diffuseColor Kolor materiału matowego (idealny rozpraszacz)
-         * @param IOR Indeks załamania materiału.
+         * Metoda aktualizująca transformację instancji podpiętej do sceny.
+         * Geometria zachowuje swój identyfikator w scenie, a przy zatwierdzeniu sceny przebudowie
+         * podlega jedynie struktura najwyższego poziomu (TLAS) - BLAS instancji pozostaje bez zmian.
+         * @param instanceSource Geometria typu instance podpięta do sceny silnika.
+         * @param transform Nowa transformacja instancji (object-space -> world-space).
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany (QueueSceneUpdate).
+         */
+        void UpdateInstanceTransform(const RTCGeometry& instanceSource, const pxr::GfMatrix4f& transform);
+
+
+        /**
+         * Metoda dodająca lub aktualizująca dane materiału w silniku. Parametry są aktualizowane w miejscu -
+         * uchwyt materiału pozostaje bez zmian. Materiały o identycznych parametrach współdzielą jeden obiekt.
+         * Modyfikacja tabeli materiałów jest kolejkowana (QueueSceneUpdate) - integrator nie odczytuje
+         * tabeli podczas jej modyfikacji.
+         * @note Metoda może być wywoływana równolegle (synchronizacja materiałów w wielu wątkach Hydry).
+         * @param parameters Parametry materiału.
+         * @param materialPath Ścieżka materiału w scenie
+         * @return Stabilny uchwyt materiału.
+         */
+        MaterialHandle AttachOrUpdateMaterial(const MaterialParameters& parameters, const pxr::SdfPath& materialPath);
+
+
+        /**
+         * Metoda rejestrująca teksturę w pamięci podręcznej tekstur silnika (wczytywanie następuje na żądanie).
+         * @param filePath Ścieżka pliku tekstury.
+         * @param colorSpace Przestrzeń kolorów danych tekstury.
+         * @return Uchwyt tekstury do zapisania w parametrach materiału lub InvalidTextureHandle.
+         */
+        TextureHandle RegisterTexture(const std::string& filePath, TextureColorSpace colorSpace)
+        {
+            return m_TextureCache.RegisterTexture(filePath, colorSpace);
+        }
+
+
+        TextureCacheStatistics GetTextureCacheStatistics() const { return m_TextureCache.GetStatistics(); }
+
+
+        /**
+         * Metoda zwalniająca materiał usunięty ze sceny. Geometria powiązana z materiałem używa od teraz
+         * materiału domyślnego. Zwolnienie jest kolejkowane (QueueSceneUpdate).
          * @param materialPath Ścieżka materiału w scenie
-         * @param newMaterial Flaga wskazująca czy materiał jest nowy
          */
-        void AttachOrUpdateMaterial(
-            const pxr::GfVec3f& diffuseColor,
-            const float& IOR,
-            const pxr::SdfPath& materialPath,
-            bool newMaterial = false);
+        void DetachMaterial(const pxr::SdfPath& materialPath);
 
 
         /**
@@ -77,12 +265,33 @@ namespace Onyx
 
 
         /**
-         * Metoda szukająca powiązania ścieżki materiału z obiektem w buforze materiałów
+         * Metoda zwracająca stabilny uchwyt materiału na podstawie ścieżki (mapa haszująca rejestru materiałów).
          * @param materialPath Ścieżka szukanego materiału w scenie OpenUSD
-         * @return Indeks materiału jeśli ścieżka została znaleziona. 0 jeśli materiał nie istnieje.
-         * @remark Materiał pod indeksem 0 w buforze materiałów odpowiada domyślnemu materiałowi sceny.
+         * @return Uchwyt materiału. Materiał który nie został jeszcze zsynchronizowany otrzymuje uchwyt
+         * wskazujący na materiał domyślny do czasu synchronizacji. 0 dla pustej ścieżki.
+         * @remark Uchwyt 0 odpowiada domyślnemu materiałowi sceny.
+         * @note Metoda może być wywoływana równolegle (synchronizacja meshy w wielu wątkach Hydry).
+         */
+        uint GetIndexOfMaterialByPath(const pxr::SdfPath& materialPath);
+
+
+        /**
+         * Metoda oznaczająca scenę Embree jako zmodyfikowaną (np. po zmianie transformacji instancji
+         * bez ponownego podpięcia geometrii). Scena zostanie zatwierdzona przed kolejną iteracją.
+         * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany.
          */
-        uint GetIndexOfMaterialByPath(const pxr::SdfPath& materialPath) const;
+        void MarkSceneDirty() { m_SceneDirty = true; }
+
+
+        /**
+         * @return Liczba zatwierdzeń sceny (rtcCommitScene) wykonanych przez wątek renderowania.
+         */
+        uint64_t GetSceneCommitCount() const { return m_SceneCommitCount; }
+
+        /**
+         * @return Liczba iteracji które nie wymagały zatwierdzenia sceny (scena bez zmian).
+         */
+        uint64_t GetSkippedSceneCommitCount() const { return m_SkippedSceneCommitCount; }
 
 
         RTCDevice GetEmbreeDeviceHandle() const { return m_EmbreeDevice; };
@@ -123,18 +332,58 @@ namespace Onyx
          */
         RTCScene m_EmbreeScene;
 
+        /**
+         * Flaga wskazująca na modyfikację sceny (podpięcie / odpięcie geometrii, zmiana instancji)
+         * od ostatniego zatwierdzenia. Zatwierdzenie niezmienionej sceny jest pomijane.
+         */
+        std::atomic<bool> m_SceneDirty = true;
+
+        // Liczniki zatwierdzeń sceny, odczytywane również przez wątek Hydry.
+        std::atomic<uint64_t> m_SceneCommitCount = 0;
+        std::atomic<uint64_t> m_SkippedSceneCommitCount = 0;
+
+        /**
+         * Operacja na scenie zgłoszona podczas synchronizacji primów. Pusta geometria oznacza odpięcie,
+         * a niepusta funkcja SceneUpdate - modyfikację geometrii lub danych integratora.
+         */
+        struct SceneOperation
+        {
+            RTCGeometry Geometry;
+            uint GeometryID;
+
+            // Zasoby odpinanej geometrii zwalniane po wykonaniu operacji (przy zatrzymanym wątku renderującym).
+            std::shared_ptr<const void> RetainedResources;
+
+            std::function<void()> SceneUpdate;
+        };
+
+        // Rezerwuje identyfikator geometrii w scenie. Wymaga blokady m_SceneOperationLock.
+        uint ReserveGeometryID();
+
+        // Chroni kolejkę operacji oraz pulę identyfikatorów geometrii.
+        mutable std::mutex m_SceneOperationLock;
+
+        std::vector<SceneOperation> m_PendingSceneOperations;
+
+        // Identyfikatory geometrii są przydzielane przez silnik (rtcAttachGeometryByID), co pozwala meshom
+        // poznać identyfikator przed podpięciem. Zwolnione identyfikatory są ponownie używane,
+        // dzięki czemu tablica geometrii sceny pozostaje zwarta.
+        uint m_NextGeometryID = 0;
+        std::vector<uint> m_FreeGeometryIDs;
+
         /* MATERIAŁY */
 
-        using PathMaterialPair = std::pair<pxr::SdfPath, std::unique_ptr<Material>>;
         /**
-         * Bufor materiałów indeksowanych pośrednio za pomocą ścieżki materiału
-         * w scenie. Użycie mapy nie jest wskazane ze względu na brak możliwości
-         * szybkiego czytania za pomocą indeksu.
-         * Przechowywanie ścieżki SdfPath jest wymagane do poprawnego powiązania
-         * geometrii z materiałem.
-         * Pierwszy materiał w buforze jest materiałem domyślnym używanym w przypadku braku powiązania.
+         * Rejestr materiałów odwzorowujący ścieżkę materiału w scenie na stabilny uchwyt (indeks)
+         * przechowywany przez instancje geometrii. Materiały o identycznych parametrach są deduplikowane.
          */
-        std::vector<PathMaterialPair> m_MaterialDataBuffer;
+        MaterialRegistry m_MaterialRegistry;
+
+        /**
+         * Pamięć podręczna tekstur materiałów - kafelki tekstur są wczytywane z dysku przy pierwszym odczycie
+         * przez integrator i usuwane po przekroczeniu limitu pamięci (RenderSettings::TextureCacheMB).
+         */
+        TextureCache m_TextureCache;
 
         /* ŚWIATŁA */
 
@@ -143,9 +392,38 @@ namespace Onyx
          * Indeksowanie bufora odbywa się za pomocą indeksu powiązanego z
          * deskryptorem instancji który jest tworzony podczas tworzenia instancji światła.
          *
-         * Aktualnie zawarte dane to moc emisji wyrażona w Nitach.
+         * Dane zawierają moc emisji wyrażoną w Nitach oraz kształt światła w world-space
+         * wymagany do bezpośredniego próbkowania światła przez integrator.
+         */
+        std::vector<LightData> m_LightDataBuffer;
+
+        /**
+         * Instancja światła w głównej scenie silnika.
          */
-        std::vector<pxr::GfVec3f> m_LightDataBuffer;
+        struct LightInstance
+        {
+            // Geometria instancji - pozwala na aktualizację transformacji światła bez tworzenia nowej instancji.
+            RTCGeometry Source = nullptr;
+
+            // Identyfikator powiązania instancji ze sceną (wymagany do odpięcia światła).
+            uint GeometryID = RTC_INVALID_GEOMETRY_ID;
+
+            // Struktura pomocnicza instancji (user data) - adres nie zmienia się przy zmianie rozmiaru bufora.
+            std::unique_ptr<pxr::HdOnyxInstanceData> InstanceData;
+        };
+
+        /**
+         * Instancje świateł indeksowane tak samo jak bufor danych świateł.
+         * Bufory świateł są modyfikowane jedynie przez zakolejkowane operacje (zatrzymany wątek renderujący).
+         */
+        std::vector<LightInstance> m_LightInstances;
+
+        // Liczba zarezerwowanych miejsc w buforze świateł. Wymaga blokady m_SceneOperationLock.
+        uint m_LightSlotCount = 0;
+
+        // Indeksy usuniętych świateł w buforze świateł, ponownie używane przez nowe światła.
+        // Wymaga blokady m_SceneOperationLock.
+        std::vector<uint> m_FreeLightSlots;
 
 
         /**
@@ -162,11 +440,32 @@ namespace Onyx
          */
         std::optional<OnyxPathtracingIntegrator*> m_Integrator;
 
+        /* PAMIĘĆ */
+
+        /**
+         * Funkcja wywoływana przez Embree przy każdej alokacji (bytes > 0) oraz zwolnieniu (bytes < 0) pamięci.
+         * Nie odrzucamy alokacji - przekroczenie limitu jest obsługiwane trybem oszczędzania pamięci.
+         */
+        static bool EmbreeMemoryMonitor(void* userPtr, ssize_t bytes, bool post);
+
+        /**
+         * Metoda przekazująca ustawienia do integratora z uwzględnieniem trybu oszczędzania pamięci.
+         */
+        void ApplyRenderSettings();
+
+        // Ustawienia zdefiniowane przez użytkownika (przed modyfikacją przez tryb oszczędzania pamięci).
+        RenderSettings m_RenderSettings;
+
+        std::atomic<int64_t> m_EmbreeMemoryBytes = 0;
+        std::atomic<int64_t> m_EmbreePeakMemoryBytes = 0;
+
+        std::atomic<bool> m_MemoryBudgetFallback = false;
+
         /**
          * Flaga wskazująca na potrzebę zresetowania wewnętrznego stanu integratora
          * w przypadku zmiany wymaganych parametrów silnika (rozmiar renderu, parametry kamery).
          */
-        bool m_ResetIntegratorState = true;
+        std::atomic<bool> m_ResetIntegratorState = true;
     };
 
 }
\ No newline at end of file
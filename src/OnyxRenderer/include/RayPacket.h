@@ -0,0 +1,163 @@
+#pragma once
+
+#include <embree4/rtcore.h>
+#include <embree4/rtcore_ray.h>
+
+#include "RayPayloadBuffer.h"
+
+
+namespace Onyx
+{
+    /**
+     * Cechy pakietu promieni o zadanej szerokości. Łączą typ pakietu Embree (RTCRayHit4/8/16)
+     * z odpowiadającą mu funkcją testu intersekcji (rtcIntersect4/8/16), a typ pakietu promieni
+     * cienia (RTCRay4/8/16) z funkcją testu przesłonięcia (rtcOccluded4/8/16).
+     * Pakiety pozwalają bibliotece Embree na równoczesne przejście drzewa BVH przez wiele promieni
+     * z wykorzystaniem instrukcji SIMD, co jest szczególnie efektywne dla spójnych promieni kamery.
+     */
+    template<int PacketWidth>
+    struct RayPacketTraits;
+
+    template<>
+    struct RayPacketTraits<4>
+    {
+        using RayHitPacket = RTCRayHit4;
+        using RayPacket = RTCRay4;
+
+        static void Intersect(const int* validMask, RTCScene scene, RayHitPacket* packet)
+        {
+            rtcIntersect4(validMask, scene, packet);
+        }
+
+        static void Occluded(const int* validMask, RTCScene scene, RayPacket* packet)
+        {
+            rtcOccluded4(validMask, scene, packet);
+        }
+    };
+
+    template<>
+    struct RayPacketTraits<8>
+    {
+        using RayHitPacket = RTCRayHit8;
+        using RayPacket = RTCRay8;
+
+        static void Intersect(const int* validMask, RTCScene scene, RayHitPacket* packet)
+        {
+            rtcIntersect8(validMask, scene, packet);
+        }
+
+        static void Occluded(const int* validMask, RTCScene scene, RayPacket* packet)
+        {
+            rtcOccluded8(validMask, scene, packet);
+        }
+    };
+
+    template<>
+    struct RayPacketTraits<16>
+    {
+        using RayHitPacket = RTCRayHit16;
+        using RayPacket = RTCRay16;
+
+        static void Intersect(const int* validMask, RTCScene scene, RayHitPacket* packet)
+        {
+            rtcIntersect16(validMask, scene, packet);
+        }
+
+        static void Occluded(const int* validMask, RTCScene scene, RayPacket* packet)
+        {
+            rtcOccluded16(validMask, scene, packet);
+        }
+    };
+
+
+    /**
+     * Metoda kopiująca dane promienia z bufora promieni do wybranego toru (lane) pakietu.
+     * @param packet Pakiet promieni w formacie SoA (Structure of Arrays).
+     * @param lane Indeks toru pakietu.
+     * @param payloadBuffer Bufor promieni integratora.
+     * @param rayIndex Indeks promienia w buforze.
+     */
+    template<typename RayHitPacket>
+    void StoreRayInPacket(RayHitPacket& packet, int lane, const RayPayloadBuffer& payloadBuffer, size_t rayIndex)
+    {
+        packet.ray.org_x[lane] = payloadBuffer.OriginX[rayIndex];
+        packet.ray.org_y[lane] = payloadBuffer.OriginY[rayIndex];
+        packet.ray.org_z[lane] = payloadBuffer.OriginZ[rayIndex];
+        packet.ray.dir_x[lane] = payloadBuffer.DirectionX[rayIndex];
+        packet.ray.dir_y[lane] = payloadBuffer.DirectionY[rayIndex];
+        packet.ray.dir_z[lane] = payloadBuffer.DirectionZ[rayIndex];
+        packet.ray.tnear[lane] = 0.0f;
+        packet.ray.tfar[lane] = payloadBuffer.TFar[rayIndex];
+        packet.ray.time[lane] = 0.0f;
+        packet.ray.mask[lane] = UINT_MAX;
+        packet.ray.id[lane] = lane;
+        packet.ray.flags[lane] = 0;
+
+        // Brak intersekcji jest oznaczony nieprawidłowym identyfikatorem geometrii.
+        packet.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+        for (int level = 0; level < RTC_MAX_INSTANCE_LEVEL_COUNT; level++)
+        {
+            packet.hit.instID[level][lane] = RTC_INVALID_GEOMETRY_ID;
+        }
+    }
+
+
+    /**
+     * Metoda kopiująca promień cienia z bufora promieni do wybranego toru pakietu.
+     * @param packet Pakiet promieni cienia w formacie SoA.
+     * @param lane Indeks toru pakietu.
+     * @param payloadBuffer Bufor promieni integratora.
+     * @param rayIndex Indeks promienia w buforze.
+     */
+    template<typename RayPacket>
+    void StoreShadowRayInPacket(RayPacket& packet, int lane, const RayPayloadBuffer& payloadBuffer, size_t rayIndex)
+    {
+        packet.org_x[lane] = payloadBuffer.OriginX[rayIndex];
+        packet.org_y[lane] = payloadBuffer.OriginY[rayIndex];
+        packet.org_z[lane] = payloadBuffer.OriginZ[rayIndex];
+        packet.dir_x[lane] = payloadBuffer.ShadowDirectionX[rayIndex];
+        packet.dir_y[lane] = payloadBuffer.ShadowDirectionY[rayIndex];
+        packet.dir_z[lane] = payloadBuffer.ShadowDirectionZ[rayIndex];
+        packet.tnear[lane] = 0.0f;
+        packet.tfar[lane] = payloadBuffer.ShadowTFar[rayIndex];
+        packet.time[lane] = 0.0f;
+        packet.mask[lane] = UINT_MAX;
+        packet.id[lane] = lane;
+        packet.flags[lane] = 0;
+    }
+
+
+    /**
+     * Metoda kopiująca wynik testu intersekcji z wybranego toru pakietu do bufora promieni.
+     * @param packet Pakiet promieni po wykonaniu testu intersekcji.
+     * @param lane Indeks toru pakietu.
+     * @param payloadBuffer Bufor promieni integratora.
+     * @param rayIndex Indeks promienia w buforze który otrzyma dane intersekcji.
+     */
+    template<typename RayHitPacket>
+    void LoadHitFromPacket(const RayHitPacket& packet, int lane, RayPayloadBuffer& payloadBuffer, size_t rayIndex)
+    {
+        // Odległość intersekcji jest zapisywana przez Embree w polu tfar promienia.
+        payloadBuffer.TFar[rayIndex] = packet.ray.tfar[lane];
+
+        // Wszystkie obiekty głównej sceny są instancjami (jedno-poziomowy instancing).
+        payloadBuffer.InstanceID[rayIndex] = packet.hit.geomID[lane] == RTC_INVALID_GEOMETRY_ID
+            ? RTC_INVALID_GEOMETRY_ID
+            : packet.hit.instID[0][lane];
+
+#if defined(RTC_GEOMETRY_INSTANCE_ARRAY)
+        payloadBuffer.InstancePrimID[rayIndex] = packet.hit.instPrimID[0][lane];
+#else
+        payloadBuffer.InstancePrimID[rayIndex] = 0;
+#endif
+
+        payloadBuffer.PrimitiveID[rayIndex] = packet.hit.primID[lane];
+        payloadBuffer.HitU[rayIndex] = packet.hit.u[lane];
+        payloadBuffer.HitV[rayIndex] = packet.hit.v[lane];
+
+        payloadBuffer.NormalX[rayIndex] = packet.hit.Ng_x[lane];
+        payloadBuffer.NormalY[rayIndex] = packet.hit.Ng_y[lane];
+        payloadBuffer.NormalZ[rayIndex] = packet.hit.Ng_z[lane];
+    }
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <embree4/rtcore_ray.h>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+
+#include <cstdlib>
+#include <memory>
+
+
+namespace Onyx
+{
+    /**
+     * Tablica o stałym rozmiarze której dane są wyrównane do rozmiaru linii pamięci podręcznej.
+     * Wyrównanie pozwala na wydajne ładowanie danych instrukcjami SIMD.
+     * @note Elementy nie są inicjalizowane - typ powinien być trywialny.
+     */
+    template<typename T>
+    class AlignedArray
+    {
+    public:
+
+        static constexpr size_t Alignment = 64;
+
+        void Resize(size_t elementCount)
+        {
+            if (elementCount == m_Size) return;
+
+            m_Size = elementCount;
+            if (elementCount == 0)
+            {
+                m_Data.reset();
+                return;
+            }
+
+            // Rozmiar alokacji musi być wielokrotnością wyrównania.
+            size_t byteCount = ((elementCount * sizeof(T) + Alignment - 1) / Alignment) * Alignment;
+            m_Data.reset(static_cast<T*>(std::aligned_alloc(Alignment, byteCount)));
+        }
+
+        size_t Size() const { return m_Size; }
+        size_t ByteSize() const { return m_Size * sizeof(T); }
+
+        T* Data() { return m_Data.get(); }
+        const T* Data() const { return m_Data.get(); }
+
+        T& operator[](size_t index) { return m_Data.get()[index]; }
+        const T& operator[](size_t index) const { return m_Data.get()[index]; }
+
+    private:
+
+        struct AlignedDeleter
+        {
+            void operator()(T* data) const { std::free(data); }
+        };
+
+        std::unique_ptr<T, AlignedDeleter> m_Data;
+        size_t m_Size = 0;
+    };
+
+
+    /**
+     * Bufor stanu promieni (ścieżek) integratora w układzie SoA (Structure of Arrays).
+     * Każde pole promienia jest przechowywane w osobnej, wyrównanej tablicy, dzięki czemu
+     * poszczególne etapy iteracji (generowanie promieni, test intersekcji, cieniowanie)
+     * odczytują z pamięci jedynie wymagane pola.
+     *
+     * W porównaniu do tablicy struktur zawierających pełny RTCRayHit nie przechowujemy
+     * pól stałych (tnear, mask, time) oraz identyfikatora geometrii (wszystkie obiekty sceny
+     * są instancjami, brak intersekcji oznaczamy nieprawidłowym identyfikatorem instancji).
+     * Bufor nie przechowuje flagi zakończenia ścieżki - aktywne promienie są wskazywane
+     * przez kolejkę indeksów integratora.
+     */
+    class RayPayloadBuffer
+    {
+    public:
+
+        /**
+         * Metoda dostosowująca rozmiar wszystkich tablic bufora.
+         * @param rayCount Liczba promieni (zazwyczaj liczba pikseli obrazu).
+         * @param halfPrecisionThroughput Flaga wskazująca na przechowywanie mocy ścieżki w formacie half (16 bit).
+         */
+        void Resize(size_t rayCount, bool halfPrecisionThroughput);
+
+        size_t Size() const { return m_Size; }
+
+        /**
+         * @return Całkowity rozmiar danych bufora w bajtach.
+         */
+        size_t GetMemoryFootprint() const;
+
+        /**
+         * Metoda zapisująca nowy promień pod wskazanym indeksem. Dane intersekcji zostają wyczyszczone.
+         * @param rayIndex Indeks promienia w buforze.
+         * @param ray Promień wygenerowany przez OnyxHelper.
+         */
+        void SetRay(size_t rayIndex, const RTCRay& ray);
+
+        /**
+         * Metoda tworząca strukturę Embree dla promienia (wymagana przez rtcIntersect1).
+         */
+        RTCRayHit GetRayHit(size_t rayIndex) const;
+
+        /**
+         * Metoda zapisująca wynik testu intersekcji promienia.
+         */
+        void SetHit(size_t rayIndex, const RTCRayHit& rayHit);
+
+        bool IsHit(size_t rayIndex) const { return InstanceID[rayIndex] != RTC_INVALID_GEOMETRY_ID; }
+
+        pxr::GfVec3f GetOrigin(size_t rayIndex) const
+        {
+            return {OriginX[rayIndex], OriginY[rayIndex], OriginZ[rayIndex]};
+        }
+
+        pxr::GfVec3f GetDirection(size_t rayIndex) const
+        {
+            return {DirectionX[rayIndex], DirectionY[rayIndex], DirectionZ[rayIndex]};
+        }
+
+        pxr::GfVec2f GetHitUV(size_t rayIndex) const
+        {
+            return {HitU[rayIndex], HitV[rayIndex]};
+        }
+
+        pxr::GfVec3f GetHitGeometricNormal(size_t rayIndex) const
+        {
+            return {NormalX[rayIndex], NormalY[rayIndex], NormalZ[rayIndex]};
+        }
+
+        /**
+         * @return Pozycja intersekcji w world-space (kierunek * odległość + początek).
+         */
+        pxr::GfVec3f GetHitPosition(size_t rayIndex) const
+        {
+            return GetDirection(rayIndex) * TFar[rayIndex] + GetOrigin(rayIndex);
+        }
+
+        /**
+         * Metoda zapisująca promień cienia (test widoczności próbki światła) wraz z jego potencjalnym wkładem.
+         * Promień cienia zaczyna się w punkcie początkowym promienia odbicia (Origin).
+         * @param rayIndex Indeks promienia w buforze.
+         * @param direction Znormalizowany kierunek do punktu na świetle.
+         * @param distance Maksymalna odległość testu (nieco krótsza niż odległość do światła).
+         * @param radiance Wkład światła dodawany do ścieżki jeśli próbka nie jest przesłonięta.
+         */
+        void SetShadowRay(size_t rayIndex, const pxr::GfVec3f& direction, float distance, const pxr::GfVec3f& radiance);
+
+        /**
+         * Metoda tworząca strukturę Embree dla promienia cienia (wymagana przez rtcOccluded1).
+         */
+        RTCRay GetShadowRay(size_t rayIndex) const;
+
+        pxr::GfVec3f GetShadowRadiance(size_t rayIndex) const
+        {
+            return {ShadowRadianceR[rayIndex], ShadowRadianceG[rayIndex], ShadowRadianceB[rayIndex]};
+        }
+
+        pxr::GfVec3f GetThroughput(size_t rayIndex) const;
+        void SetThroughput(size_t rayIndex, const pxr::GfVec3f& throughput);
+
+        pxr::GfVec3f GetRadiance(size_t rayIndex) const
+        {
+            return {RadianceR[rayIndex], RadianceG[rayIndex], RadianceB[rayIndex]};
+        }
+
+        void SetRadiance(size_t rayIndex, const pxr::GfVec3f& radiance)
+        {
+            RadianceR[rayIndex] = radiance[0];
+            RadianceG[rayIndex] = radiance[1];
+            RadianceB[rayIndex] = radiance[2];
+        }
+
+        /* PROMIEŃ */
+
+        AlignedArray<float> OriginX, OriginY, OriginZ;
+        AlignedArray<float> DirectionX, DirectionY, DirectionZ;
+
+        // Maksymalna odległość testu, po intersekcji - odległość punktu uderzenia.
+        AlignedArray<float> TFar;
+
+        /* DANE INTERSEKCJI */
+
+        AlignedArray<uint32_t> InstanceID;
+
+        // Indeks kopii w tablicy instancji Embree (RTC_GEOMETRY_TYPE_INSTANCE_ARRAY).
+        AlignedArray<uint32_t> InstancePrimID;
+
+        AlignedArray<uint32_t> PrimitiveID;
+        AlignedArray<float> HitU, HitV;
+
+        // Nieznormalizowany wektor geometryczny trójkąta w object-space.
+        AlignedArray<float> NormalX, NormalY, NormalZ;
+
+        /* STAN ŚCIEŻKI */
+
+        AlignedArray<float> RadianceR, RadianceG, RadianceB;
+        AlignedArray<uint8_t> Bounce;
+
+        // Prawdopodobieństwo (względem kąta bryłowego) wygenerowania kierunku promienia przez materiał.
+        // Wartość 0 oznacza promień kamery, dla którego trafienie w światło nie podlega wadze MIS.
+        AlignedArray<float> BsdfPdf;
+
+        // Liczba próbek kamery które slot promienia wygeneruje jeszcze w tej iteracji (regeneracja ścieżek).
+        AlignedArray<uint16_t> PendingSamples;
+
+        /* PROMIEŃ CIENIA */
+
+        // Kierunek oraz odległość testu widoczności próbki światła (Next Event Estimation).
+        // Po teście przesłonięcia odległość jest ujemna jeśli promień trafił w geometrię (konwencja Embree).
+        AlignedArray<float> ShadowDirectionX, ShadowDirectionY, ShadowDirectionZ;
+        AlignedArray<float> ShadowTFar;
+
+        // Wkład próbki światła dodawany do ścieżki w przypadku braku przesłonięcia.
+        AlignedArray<float> ShadowRadianceR, ShadowRadianceG, ShadowRadianceB;
+
+    private:
+
+        // Moc ścieżki przechowywana w jednym z dwóch formatów (float lub half).
+        AlignedArray<float> m_ThroughputR, m_ThroughputG, m_ThroughputB;
+        AlignedArray<pxr::GfHalf> m_ThroughputHalfR, m_ThroughputHalfG, m_ThroughputHalfB;
+
+        bool m_HalfPrecisionThroughput = false;
+        size_t m_Size = 0;
+    };
+
+}
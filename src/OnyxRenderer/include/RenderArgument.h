@@ -3,6 +3,7 @@
 #include <sys/types.h>
 #include <pxr/base/tf/token.h>
 #include <pxr/base/gf/matrix4d.h>
+#include <pxr/imaging/hd/types.h>
 
 namespace Onyx
 {
@@ -23,6 +24,9 @@ namespace Onyx
         // Identyfikator bufora, index w mappedBuffers.
         std::vector<BufferLayoutPair> MappedLayout;
 
+        // Format danych bufora, index odpowiada indeksowi w mappedBuffers.
+        std::vector<pxr::HdFormat> MappedFormats;
+
         std::optional<BufferDataPair> GetBufferData(const pxr::TfToken& AovToken) const
         {
             // Bufor dla wymaganego AOV jest niedostępny
@@ -33,6 +37,16 @@ namespace Onyx
         }
 
 
+        std::optional<pxr::HdFormat> GetBufferFormat(const pxr::TfToken& AovToken) const
+        {
+            uint foundBufferIndex;
+            if(!IsAvailable(AovToken, foundBufferIndex)) return std::nullopt;
+            if(foundBufferIndex >= MappedFormats.size()) return std::nullopt;
+
+            return { MappedFormats[foundBufferIndex] };
+        }
+
+
         bool SizeChanged(uint testWidth, uint testHeight) const
         {
             if (testHeight != Height || (testWidth != Width)) return true;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include "Sampler.h"
+
+
+namespace Onyx
+{
+    /**
+     * Struktura przechowująca ustawienia silnika które mogą być modyfikowane przez użytkownika
+     * (w przypadku Hydra - za pomocą Render Settings przekazywanych przez Render Delegate).
+     * Wartości domyślne odpowiadają zachowaniu silnika bez ustawień użytkownika.
+     */
+    struct RenderSettings
+    {
+        /**
+         * Maksymalna liczba wątków wykorzystywanych przez integrator podczas śledzenia promieni.
+         * Wartość 0 oznacza brak limitu - silnik korzysta ze wszystkich dostępnych rdzeni.
+         */
+        uint ThreadLimit = 0;
+
+        /**
+         * Liczba promieni testowanych jednocześnie w jednym pakiecie Embree (4, 8 lub 16).
+         * Wartość 1 oznacza śledzenie skalarne (rtcIntersect1) każdego promienia osobno.
+         */
+        uint PacketWidth = 1;
+
+        /**
+         * Flaga wskazująca na przechowywanie mocy ścieżek (throughput) w formacie half (16 bit)
+         * zamiast float (32 bit). Zmniejsza zużycie pamięci bufora promieni kosztem precyzji.
+         */
+        bool HalfPrecisionThroughput = false;
+
+        /**
+         * Flaga włączająca regenerację ścieżek. Zakończona ścieżka natychmiast otrzymuje nową próbkę
+         * kamery dla tego samego piksela, dzięki czemu kolejne odbicia nie pracują na pustym buforze.
+         */
+        bool PathRegeneration = false;
+
+        /**
+         * Docelowa liczba próbek na piksel zbieranych w jednej iteracji integratora
+         * w trybie regeneracji ścieżek. Bez regeneracji iteracja zawsze zbiera jedną próbkę.
+         */
+        uint SamplesPerIteration = 4;
+
+        /**
+         * Rodzaj sekwencji liczb losowych wykorzystywanej do generowania promieni kamery oraz odbić.
+         */
+        SamplerType Sampler = SamplerType::Sobol;
+
+        /**
+         * Liczba próbek piksela po której integrator kończy renderowanie (obraz zbieżny).
+         */
+        uint SampleLimit = 1000;
+
+        /**
+         * Dopuszczalny błąd względny (odchylenie standardowe średniej / średnia luminancja) pikseli.
+         * Kafelki których wszystkie piksele osiągnęły próg nie otrzymują kolejnych próbek.
+         * Wartość 0 (domyślna) wyłącza próbkowanie adaptacyjne - wszystkie kafelki otrzymują próbki do limitu.
+         */
+        float NoiseThreshold = 0.0f;
+
+        /**
+         * Minimalna liczba próbek piksela przed oceną jego zbieżności.
+         * Zbyt mała liczba próbek nie pozwala na wiarygodne oszacowanie wariancji.
+         */
+        uint AdaptiveMinSamples = 32;
+
+        /**
+         * Maksymalna liczba odbić ścieżki niezależnie od rodzaju odbicia.
+         */
+        uint MaxBounces = 1;
+
+        /**
+         * Maksymalna liczba odbić rozproszonych (diffuse). Ścieżka kończy się po przekroczeniu
+         * dowolnego z limitów - limity kolejnych rodzajów odbić (np. specular) mogą być dodawane obok.
+         */
+        uint MaxDiffuseBounces = 1;
+
+        /**
+         * Liczba odbić po której ścieżki podlegają ruletce rosyjskiej (Russian Roulette).
+         * Ścieżka kontynuuje z prawdopodobieństwem proporcjonalnym do swojej mocy, a moc ocalałych
+         * ścieżek jest odpowiednio zwiększana, co zachowuje nieobciążoność estymatora.
+         */
+        uint RussianRouletteMinBounce = 3;
+
+        /**
+         * Limit pamięci silnika w megabajtach (BVH, bufory geometrii, bufor promieni, bufory akumulacji).
+         * Po jego przekroczeniu silnik przechodzi w tryb oszczędzania pamięci (kompaktowe BVH, moc ścieżek
+         * w formacie half) zamiast dalszego wzrostu zużycia. Wartość 0 oznacza brak limitu.
+         */
+        uint MemoryBudgetMB = 0;
+
+        /**
+         * Limit pamięci kafelków tekstur w megabajtach. Po jego przekroczeniu usuwane są najdawniej
+         * używane kafelki (wczytywane ponownie przy kolejnym odczycie). Wartość 0 oznacza brak limitu.
+         */
+        uint TextureCacheMB = 2048;
+    };
+
+}
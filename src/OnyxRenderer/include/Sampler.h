@@ -0,0 +1,118 @@
+#pragma once
+
+#include <pxr/base/gf/vec2f.h>
+
+#include <cstdint>
+#include <sys/types.h>
+
+
+namespace Onyx
+{
+    /**
+     * Rodzaj sekwencji liczb losowych wykorzystywanej przez integrator.
+     */
+    enum class SamplerType
+    {
+        // Niezależne liczby pseudo-losowe (biały szum) z bezstanowego generatora PCG.
+        Independent = 0,
+
+        // Sekwencja Sobol z mieszaniem Owen, niezależna dla każdego piksela i wymiaru (padding).
+        Sobol = 1,
+
+        // Sekwencja Sobol indeksowana kodem Mortona pikseli (Z-Sobol). Błąd pomiędzy sąsiednimi
+        // pikselami ma charakter szumu niebieskiego.
+        BlueNoise = 2
+    };
+
+
+    /**
+     * Rozkład wymiarów próbkowania ścieżki. Każdy wymiar odpowiada parze liczb losowych
+     * o niezależnej (zdekorelowanej) sekwencji.
+     */
+    struct SampleDimension
+    {
+        // Przesunięcie promienia kamery wewnątrz piksela.
+        static constexpr uint32_t Camera = 0;
+
+        // Liczba wymiarów wykorzystywanych przy jednym odbiciu ścieżki.
+        static constexpr uint32_t DimensionsPerBounce = 4;
+
+        // Kierunek odbicia generowany przez materiał.
+        static constexpr uint32_t BounceDirection(uint32_t bounce)
+        {
+            return 1 + bounce * DimensionsPerBounce;
+        }
+
+        // Wybór światła próbkowanego bezpośrednio (Next Event Estimation).
+        static constexpr uint32_t LightSelection(uint32_t bounce)
+        {
+            return BounceDirection(bounce) + 1;
+        }
+
+        // Punkt na powierzchni wybranego światła.
+        static constexpr uint32_t LightPosition(uint32_t bounce)
+        {
+            return BounceDirection(bounce) + 2;
+        }
+
+        // Decyzja ruletki rosyjskiej o kontynuacji ścieżki.
+        static constexpr uint32_t RussianRoulette(uint32_t bounce)
+        {
+            return BounceDirection(bounce) + 3;
+        }
+    };
+
+
+    /**
+     * Bezstanowy generator próbek. Wartość próbki zależy wyłącznie od piksela, indeksu próbki piksela
+     * oraz wymiaru, dzięki czemu generator może być używany równolegle przez wiele wątków
+     * bez synchronizacji, a sekwencja każdego piksela jest powtarzalna.
+     */
+    class Sampler
+    {
+    public:
+
+        /**
+         * Metoda konfigurująca generator dla rozdzielczości obrazu.
+         * @param samplerType Rodzaj sekwencji.
+         * @param width Szerokość obrazu w pikselach.
+         * @param height Wysokość obrazu w pikselach.
+         * @param samplesPerPixel Maksymalna liczba próbek piksela (wymagana przez sekwencję Z-Sobol).
+         * @param seed Ziarno generatora.
+         */
+        void Configure(SamplerType samplerType, uint width, uint height, uint samplesPerPixel, uint32_t seed = 0);
+
+        /**
+         * @param pixelIndex Jedno-wymiarowy indeks piksela (y * szerokość + x).
+         * @param sampleIndex Indeks próbki piksela.
+         * @param dimension Wymiar próbkowania (SampleDimension).
+         * @return Dwie liczby z przedziału [0, 1).
+         */
+        pxr::GfVec2f Get2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const;
+
+        SamplerType GetType() const { return m_Type; }
+
+    private:
+
+        pxr::GfVec2f GetIndependent2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const;
+        pxr::GfVec2f GetSobol2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const;
+        pxr::GfVec2f GetBlueNoise2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const;
+
+        /**
+         * Metoda wyznaczająca indeks sekwencji Z-Sobol dla piksela oraz próbki.
+         * Cyfry (o podstawie 4) kodu Mortona są losowo permutowane, co zachowuje
+         * stratyfikację pomiędzy sąsiednimi pikselami przy braku widocznych wzorów.
+         */
+        uint64_t GetBlueNoiseSequenceIndex(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const;
+
+        SamplerType m_Type = SamplerType::Sobol;
+
+        uint m_Width = 0;
+        uint32_t m_Seed = 0;
+
+        // Parametry sekwencji Z-Sobol.
+        uint m_Log2SamplesPerPixel = 0;
+        uint m_Base4DigitCount = 0;
+    };
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <pxr/base/gf/vec3f.h>
+
+#include <cstdint>
+
+
+namespace Onyx
+{
+    /**
+     * Uchwyt tekstury zarejestrowanej w pamięci podręcznej tekstur. Uchwyt 0 oznacza brak tekstury.
+     */
+    using TextureHandle = uint32_t;
+
+    constexpr TextureHandle InvalidTextureHandle = 0;
+
+
+    /**
+     * Sposób adresowania tekstury poza przedziałem [0, 1] (wrapS / wrapT węzła UsdUVTexture).
+     */
+    enum class TextureWrap : uint8_t
+    {
+        Repeat,
+        Clamp,
+        Mirror,
+        // Próbki poza teksturą są czarne.
+        Black
+    };
+
+
+    /**
+     * Przestrzeń kolorów danych tekstury (sourceColorSpace węzła UsdUVTexture).
+     */
+    enum class TextureColorSpace : uint8_t
+    {
+        // Wybór na podstawie metadanych pliku - tekstury 8-bitowe są zwykle zapisane w sRGB.
+        Auto,
+        Raw,
+        SRGB
+    };
+
+
+    /**
+     * Powiązanie parametru materiału z teksturą (węzeł UsdUVTexture podłączony do wejścia UsdPreviewSurface).
+     * Wynik próbkowania jest liniowy: wartość tekstury * Scale + Bias.
+     */
+    struct TextureBinding
+    {
+        TextureHandle Texture = InvalidTextureHandle;
+
+        TextureWrap WrapS = TextureWrap::Repeat;
+        TextureWrap WrapT = TextureWrap::Repeat;
+
+        pxr::GfVec3f Scale = {1.0f, 1.0f, 1.0f};
+        pxr::GfVec3f Bias = {0.0f, 0.0f, 0.0f};
+
+
+        bool IsValid() const { return Texture != InvalidTextureHandle; }
+
+        bool operator==(const TextureBinding& other) const
+        {
+            return Texture == other.Texture && WrapS == other.WrapS && WrapT == other.WrapT
+                && Scale == other.Scale && Bias == other.Bias;
+        }
+    };
+
+
+    /**
+     * Zapytanie o wartość tekstury w punkcie uderzenia.
+     */
+    struct TextureLookup
+    {
+        float U = 0.0f;
+        float V = 0.0f;
+
+        // Szerokość śladu stożka promienia w przestrzeni tekstury (jednostki UV) - wyznacza poziom MIP.
+        float Footprint = 0.0f;
+    };
+
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/imaging/hio/types.h>
+#include <tbb/enumerable_thread_specific.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Texture.h"
+
+
+namespace Onyx
+{
+    /**
+     * Statystyki pamięci podręcznej tekstur raportowane aplikacji (Render Stats).
+     */
+    struct TextureCacheStatistics
+    {
+        size_t TextureCount = 0;
+        size_t ResidentTileCount = 0;
+        size_t ResidentBytes = 0;
+        size_t BudgetBytes = 0;
+
+        size_t TileHits = 0;
+        size_t TileMisses = 0;
+        size_t EvictedTiles = 0;
+    };
+
+
+    /**
+     * Pamięć podręczna tekstur. Tekstury są dzielone na kafelki (TileSize x TileSize tekseli) wczytywane
+     * z dysku dopiero przy pierwszym odczycie. Poziomy MIP są odczytywane z pliku (jeśli je zawiera)
+     * lub budowane na żądanie z czterech kafelków poziomu poprzedniego. Rozmiar wczytanych kafelków
+     * jest ograniczony limitem pamięci - po jego przekroczeniu usuwane są najdawniej używane kafelki (LRU).
+     *
+     * Integrator odczytuje tekstury paczkami (jedno wywołanie SampleBatch na etap cieniowania przedziału
+     * materiału), dzięki czemu blokada pamięci podręcznej jest pobierana raz na paczkę, a nie na odczyt.
+     */
+    class TextureCache
+    {
+    public:
+
+        // Rozmiar boku kafelka tekstury w tekselach.
+        static constexpr uint32_t TileSize = 64;
+
+        /**
+         * Metoda rejestrująca teksturę. Plik jest otwierany jedynie w celu odczytu nagłówka (rozmiar, format),
+         * dane tekseli są wczytywane na żądanie. Ponowna rejestracja pliku zwraca ten sam uchwyt.
+         * @param filePath Ścieżka pliku tekstury (po rozwiązaniu ścieżki zasobu).
+         * @param colorSpace Przestrzeń kolorów danych tekstury.
+         * @return Uchwyt tekstury lub InvalidTextureHandle jeśli pliku nie można odczytać.
+         */
+        TextureHandle RegisterTexture(const std::string& filePath, TextureColorSpace colorSpace);
+
+        /**
+         * Metoda próbkująca teksturę dla paczki zapytań (filtrowanie dwuliniowe na poziomie MIP
+         * wybranym szerokością śladu zapytania). Brakujące kafelki są wczytywane poza blokadą.
+         * @note Metoda może być wywoływana równolegle przez wiele wątków integratora.
+         * @param binding Powiązanie z teksturą (adresowanie, skala i przesunięcie wartości).
+         * @param lookups Zapytania o wartość tekstury.
+         * @param lookupCount Liczba zapytań.
+         * @param results Wynik - liniowa wartość RGB dla każdego zapytania.
+         */
+        void SampleBatch(
+            const TextureBinding& binding,
+            const TextureLookup* lookups, size_t lookupCount,
+            pxr::GfVec3f* results);
+
+        /**
+         * Metoda ustawiająca limit pamięci kafelków. Nadmiarowe kafelki są usuwane natychmiast.
+         * @param budgetBytes Limit w bajtach. Wartość 0 oznacza brak limitu.
+         */
+        void SetBudget(size_t budgetBytes);
+
+        /**
+         * @return Pamięć zajmowana przez wczytane kafelki (w bajtach).
+         */
+        size_t GetResidentBytes() const { return m_ResidentBytes; }
+
+        TextureCacheStatistics GetStatistics() const;
+
+    private:
+
+        // Rozmiar poziomu MIP w tekselach oraz w kafelkach.
+        struct TextureLevel
+        {
+            uint32_t Width;
+            uint32_t Height;
+            uint32_t TilesX;
+            uint32_t TilesY;
+        };
+
+        struct TextureEntry
+        {
+            std::string FilePath;
+            TextureColorSpace ColorSpace;
+
+            // Dane 8-bitowe są przechowywane bez konwersji (3 bajty na teksel), pozostałe jako float RGB.
+            bool FloatTexels;
+
+            // Dane 8-bitowe zapisane w sRGB są dekodowane przy odczycie (tablica 256 wartości).
+            bool SRGB;
+
+            // Liczba poziomów MIP zapisanych w pliku. Pozostałe poziomy są budowane przez pamięć podręczną.
+            int FileLevelCount;
+
+            // Format pliku pozwala na odczyt fragmentu obrazu (kafelki lub linie, np. OpenEXR, TIFF).
+            // Pozostałe formaty (PNG, JPEG) są dekodowane w całości przy każdym odczycie - poziom jest
+            // dekodowany raz, a wszystkie jego kafelki są wycinane z jednego zdekodowanego obrazu.
+            bool CroppedReads;
+
+            // Blokada dekodowania całego poziomu - jeden wątek dekoduje plik, pozostałe czekają na kafelki.
+            std::shared_ptr<std::mutex> DecodeLock;
+
+            std::vector<TextureLevel> Levels;
+        };
+
+        // Kafelek tekstury - TileSize x TileSize tekseli RGB (kafelki na krawędzi poziomu mogą być mniejsze).
+        struct TextureTile
+        {
+            uint32_t Width;
+            uint32_t Height;
+            bool FloatTexels;
+            bool SRGB;
+
+            std::vector<uint8_t> Texels;
+
+            // Zwraca liniową wartość teksela o współrzędnych względem kafelka.
+            pxr::GfVec3f GetTexel(uint32_t x, uint32_t y) const;
+
+            size_t ByteSize() const { return sizeof(TextureTile) + Texels.capacity(); }
+        };
+
+        using TileHandle = std::shared_ptr<const TextureTile>;
+
+        // Wpis pamięci podręcznej - kafelek oraz jego pozycja na liście LRU.
+        struct CacheEntry
+        {
+            TileHandle Tile;
+            std::list<uint64_t>::iterator RecentUse;
+        };
+
+        // Klucz kafelka: tekstura (24 bity), poziom MIP (8 bitów), wiersz i kolumna kafelka (po 16 bitów).
+        static uint64_t GetTileKey(TextureHandle texture, uint32_t level, uint32_t tileX, uint32_t tileY)
+        {
+            return (uint64_t(texture) << 40) | (uint64_t(level) << 32) | (uint64_t(tileY) << 16) | uint64_t(tileX);
+        }
+
+        // Zwraca kafelek z pamięci podręcznej lub wczytuje go (wraz z kafelkami wymaganymi do budowy MIP).
+        TileHandle AcquireTile(TextureHandle texture, uint32_t level, uint32_t tileX, uint32_t tileY);
+
+        // Szuka kafelka w pamięci podręcznej i oznacza go jako ostatnio używany. Wymaga blokady m_CacheLock.
+        TileHandle FindTile(uint64_t tileKey);
+
+        // Dodaje wczytany kafelek i usuwa najdawniej używane kafelki ponad limit. Wymaga blokady m_CacheLock.
+        // Jeśli inny wątek wczytał już kafelek, zwracany jest kafelek istniejący.
+        TileHandle InsertTile(uint64_t tileKey, TileHandle tile);
+
+        void EvictOverBudget();
+
+        // Wczytuje kafelek z pliku (poziom 0 lub poziom MIP zapisany w pliku) odczytując jedynie jego obszar.
+        TileHandle LoadTileFromFile(const TextureEntry& texture, uint32_t level, uint32_t tileX, uint32_t tileY);
+
+        // Dekoduje cały poziom pliku bez odczytu fragmentów i wycina z niego wszystkie kafelki poziomu.
+        // Zwraca wskazany kafelek, pozostałe kafelki są dodawane do pamięci podręcznej w granicach limitu.
+        TileHandle LoadLevelFromFile(
+            TextureHandle texture, const TextureEntry& textureEntry, uint32_t level, uint32_t tileX, uint32_t tileY);
+
+        // Tworzy kafelek z obszaru danych w formacie pliku (konwersja do RGB, dekodowanie danych float).
+        static TileHandle CreateTileFromFileTexels(
+            const TextureEntry& texture, pxr::HioFormat fileFormat,
+            const uint8_t* fileTexels, uint32_t rowTexelCount,
+            uint32_t originX, uint32_t originY, uint32_t tileWidth, uint32_t tileHeight);
+
+        // Buduje kafelek poziomu MIP uśredniając teksele (2 x 2) poziomu poprzedniego.
+        TileHandle BuildTileFromFinerLevel(TextureHandle texture, uint32_t level, uint32_t tileX, uint32_t tileY);
+
+        // Opis tekstury. Wpisy nie są modyfikowane po rejestracji, a kolejka (deque) nie przenosi istniejących
+        // wpisów przy dodawaniu kolejnych - referencja pozostaje ważna po zwolnieniu blokady.
+        const TextureEntry& GetTextureEntry(TextureHandle texture) const;
+
+        // Cztery teksele filtrowania dwuliniowego zapytania.
+        struct BilinearFootprint
+        {
+            uint32_t Level;
+            int32_t X[2];
+            int32_t Y[2];
+            float WeightX;
+            float WeightY;
+        };
+
+        // Bufory pomocnicze paczki zapytań, ponownie używane przez kolejne paczki tego samego wątku.
+        struct SampleScratch
+        {
+            std::vector<BilinearFootprint> Footprints;
+            std::vector<uint64_t> TileKeys;
+            std::vector<TileHandle> Tiles;
+        };
+
+        tbb::enumerable_thread_specific<SampleScratch> m_SampleScratch;
+
+        // Chroni rejestr tekstur, mapę kafelków oraz listę LRU.
+        mutable std::mutex m_CacheLock;
+
+        // Tekstury indeksowane uchwytem (uchwyt 0 - brak tekstury, nie posiada wpisu).
+        std::deque<TextureEntry> m_Textures;
+        std::map<std::pair<std::string, TextureColorSpace>, TextureHandle> m_TextureHandles;
+
+        std::unordered_map<uint64_t, CacheEntry> m_Tiles;
+
+        // Klucze kafelków od ostatnio do najdawniej używanego.
+        std::list<uint64_t> m_RecentTiles;
+
+        size_t m_BudgetBytes = 0;
+        std::atomic<size_t> m_ResidentBytes = 0;
+
+        size_t m_TileHits = 0;
+        size_t m_TileMisses = 0;
+        size_t m_EvictedTiles = 0;
+    };
+
+}
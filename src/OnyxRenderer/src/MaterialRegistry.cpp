@@ -0,0 +1,147 @@
+#include "MaterialRegistry.h"
+
+#include <functional>
+
+using namespace Onyx;
+
+
+size_t MaterialParameters::Hash::operator()(const MaterialParameters& parameters) const
+{
+    std::hash<float> floatHash;
+
+    size_t hash = floatHash(parameters.IOR);
+    auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+
+    // Identyczne sieci materiałów współdzielą program (pamięć podręczna kompilacji), wystarczy więc wskaźnik.
+    combine(std::hash<const MaterialProgram*>()(parameters.Program.get()));
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+        combine(floatHash(parameters.DiffuseColor[channel]));
+    }
+
+    return hash;
+}
+
+
+MaterialRegistry::MaterialRegistry()
+{
+    // Wymowny kolor materiału sygnalizujący brak powiązania geometria-materiał.
+    m_SlotParameters.push_back(MaterialParameters{pxr::GfVec3f(1.0, 0.0, 0.85)});
+    m_MaterialTable.Assign(0, m_SlotParameters[0]);
+    m_SlotReferenceCounts.push_back(0);
+
+    // Uchwyt 0 - pusta ścieżka (brak powiązania) wskazuje na materiał domyślny.
+    m_HandleSlots.push_back(0);
+    m_PathHandles.emplace(pxr::SdfPath::EmptyPath(), 0);
+}
+
+
+MaterialHandle MaterialRegistry::GetOrCreateHandle(const pxr::SdfPath& materialPath, bool* newHandle)
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+
+    // Kolejny uchwyt jest równy liczbie ścieżek - uchwyty nie są zwalniane.
+    auto [pathEntry, newPath] = m_PathHandles.try_emplace(materialPath, MaterialHandle(m_PathHandles.size()));
+
+    if (newHandle) *newHandle = newPath;
+
+    return pathEntry->second;
+}
+
+
+void MaterialRegistry::CommitHandles()
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+    CommitHandlesLocked();
+}
+
+
+void MaterialRegistry::CommitHandlesLocked()
+{
+    // Materiał nie został jeszcze zsynchronizowany - do tego czasu uchwyt wskazuje na materiał domyślny.
+    if (m_HandleSlots.size() < m_PathHandles.size()) m_HandleSlots.resize(m_PathHandles.size(), 0);
+}
+
+
+void MaterialRegistry::SetMaterialParameters(MaterialHandle handle, const MaterialParameters& parameters)
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+
+    // Uchwyt mógł zostać zarezerwowany po ostatnim przydzieleniu rekordów.
+    CommitHandlesLocked();
+
+    // Nowy rekord pobieramy przed zwolnieniem poprzedniego - niezmienione parametry nie zwalniają rekordu.
+    const uint32_t previousSlot = m_HandleSlots[handle];
+    m_HandleSlots[handle] = AcquireSlot(parameters);
+    ReleaseSlot(previousSlot);
+}
+
+
+void MaterialRegistry::ReleaseMaterial(MaterialHandle handle)
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+
+    if (handle == 0 || handle >= m_HandleSlots.size()) return;
+
+    ReleaseSlot(m_HandleSlots[handle]);
+    m_HandleSlots[handle] = 0;
+}
+
+
+size_t MaterialRegistry::GetHandleCount() const
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+    return m_PathHandles.size();
+}
+
+
+size_t MaterialRegistry::GetUniqueMaterialCount() const
+{
+    std::lock_guard<std::mutex> registryLock(m_RegistryLock);
+    return m_SlotParameters.size() - m_FreeSlots.size();
+}
+
+
+uint32_t MaterialRegistry::AcquireSlot(const MaterialParameters& parameters)
+{
+    auto parameterEntry = m_ParameterSlots.find(parameters);
+    if (parameterEntry != m_ParameterSlots.end())
+    {
+        m_SlotReferenceCounts[parameterEntry->second]++;
+        return parameterEntry->second;
+    }
+
+    uint32_t slot;
+    if (!m_FreeSlots.empty())
+    {
+        slot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+
+        m_SlotParameters[slot] = parameters;
+        m_SlotReferenceCounts[slot] = 1;
+    }
+    else
+    {
+        slot = uint32_t(m_SlotParameters.size());
+
+        m_SlotParameters.push_back(parameters);
+        m_SlotReferenceCounts.push_back(1);
+    }
+
+    m_MaterialTable.Assign(slot, parameters);
+    m_ParameterSlots.emplace(parameters, slot);
+    return slot;
+}
+
+
+void MaterialRegistry::ReleaseSlot(uint32_t slot)
+{
+    // Materiał domyślny nie jest zliczany i nigdy nie jest zwalniany.
+    if (slot == 0 || --m_SlotReferenceCounts[slot] > 0) return;
+
+    m_ParameterSlots.erase(m_SlotParameters[slot]);
+    m_MaterialTable.Release(slot);
+    m_FreeSlots.push_back(slot);
+}
+
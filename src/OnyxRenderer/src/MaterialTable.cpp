@@ -0,0 +1,43 @@
+#include "MaterialTable.h"
+
+using namespace Onyx;
+
+
+void MaterialTable::Assign(uint32_t slot, const MaterialParameters& parameters)
+{
+    // Rekord jest kompletowany poza tabelą - znacznik rodzaju i indeks parametrów są zapisywane razem,
+    // a tabela nigdy nie przechowuje rekordu wskazującego na parametry innego rodzaju materiału.
+    MaterialRecord record;
+    record.Kind = SelectKind(parameters);
+
+    switch (record.Kind)
+    {
+        case MaterialKind::Diffuse:
+            record.ParameterIndex = m_DiffuseParameters.Allocate(
+                MaterialKernel<MaterialKind::Diffuse>::CreateParameters(parameters));
+            break;
+    }
+
+    if (slot >= m_Records.size()) m_Records.resize(slot + 1);
+    m_Records[slot] = record;
+}
+
+
+void MaterialTable::Release(uint32_t slot)
+{
+    const MaterialRecord& record = m_Records[slot];
+
+    switch (record.Kind)
+    {
+        case MaterialKind::Diffuse:
+            m_DiffuseParameters.Release(record.ParameterIndex);
+            break;
+    }
+}
+
+
+MaterialKind MaterialTable::SelectKind(const MaterialParameters& parameters)
+{
+    // Silnik nie posiada jeszcze materiałów dielektrycznych - IOR nie zmienia rodzaju materiału.
+    return MaterialKind::Diffuse;
+}
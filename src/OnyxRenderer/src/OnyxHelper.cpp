@@ -1,7 +1,10 @@
 #include "OnyxHelper.h"
 
+#include <embree4/rtcore_geometry.h>
 #include <embree4/rtcore_scene.h>
 
+#include <cmath>
+
 using namespace Onyx;
 
 
@@ -19,7 +22,11 @@ pxr::GfVec3f OnyxHelper::InterpolateWithBarycentricCoordinates(
 
 
 pxr::GfVec3f OnyxHelper::EvaluateHitSurfaceNormal(
-    const RTCRayHit& hitRayData,
+    uint instanceID,
+    uint instancePrimitiveID,
+    uint primitiveID,
+    const pxr::GfVec2f& hitUV,
+    const pxr::GfVec3f& geometricNormal,
     const RTCScene& embreeScene)
 {
     pxr::GfVec3f hitLocalNormal;
@@ -30,37 +37,60 @@ pxr::GfVec3f OnyxHelper::EvaluateHitSurfaceNormal(
         rtcGetGeometryUserData(
             // Identyfikator instancji zakłada jedno-poziomowy instancing ([0]).
             // Zgodne z założeniem w HdOnyxMesh który tworzy geometrię.
-            rtcGetGeometry(embreeScene, hitRayData.hit.instID[0])
+            rtcGetGeometry(embreeScene, instanceID)
         )
     );
 
-    // Identyfikator uderzonego trójkąta instancji.
-    uint primitiveID = hitRayData.hit.primID;
+    const pxr::HdOnyxSharedGeometry* hitGeometry = hitInstanceData->Geometry;
+    const pxr::HdOnyxShadingNormals* shadingNormals = hitGeometry ? &hitGeometry->ShadingNormals : nullptr;
+
+    // Wektory normalne typu "vertex" (jeden na punkt) w pełnej precyzji są buforem atrybutu wierzchołków
+    // geometrii Embree - interpolację w punkcie trafienia wykonuje Embree.
+    if (shadingNormals && shadingNormals->Interpolation == pxr::HdOnyxPrimvarInterpolation::Vertex
+        && !shadingNormals->IsQuantized())
+    {
+        rtcInterpolate1(
+            hitGeometry->Geometry, primitiveID, hitUV[0], hitUV[1],
+            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, hitLocalNormal.data(), nullptr, nullptr, 3);
+
+        hitLocalNormal.Normalize();
+    }
+    // Skwantyzowane wektory "vertex" dekodujemy dla trzech punktów trafionego trójkąta.
+    else if (shadingNormals && shadingNormals->Interpolation == pxr::HdOnyxPrimvarInterpolation::Vertex
+        && hitGeometry->IndexArray.size() > primitiveID)
+    {
+        const pxr::GfVec3i& triangle = hitGeometry->IndexArray[primitiveID];
+
+        auto N0 = shadingNormals->GetNormal(triangle[0]);
+        auto N1 = shadingNormals->GetNormal(triangle[1]);
+        auto N2 = shadingNormals->GetNormal(triangle[2]);
 
-    // Jeśli mamy dostęp do bufora wektorów normalnych, używamy go do otrzymania "wygładzonego" wektora.
-    if (hitInstanceData->SmoothNormalsArray && hitInstanceData->SmoothNormalsArray->size() > primitiveID)
+        hitLocalNormal = InterpolateWithBarycentricCoordinates(hitUV, N0, N1, N2);
+        hitLocalNormal.Normalize();
+    }
+    // Jeśli mamy dostęp do bufora ztriangulowanych wektorów (face-varying), używamy go
+    // do otrzymania "wygładzonego" wektora.
+    else if (shadingNormals && shadingNormals->Interpolation == pxr::HdOnyxPrimvarInterpolation::FaceVarying
+        && shadingNormals->Size() > 3 * primitiveID + 2)
     {
         // Każdy punkt ma swój odpowiednik w buforach primvar (Primitive-variable).
         // Używamy primID (index trójkąta) do otrzymania wektora dla każdego punktu uderzonego trójkąta.
         // Obliczamy bazowy offset trójkąta w buforze (3 * index - wierzchołek podstawowy)
         // i uzyskujemy pozostałe dwa wierzchołki.
-        auto N0 = hitInstanceData->SmoothNormalsArray->cdata()[3 * primitiveID + 0];
-        auto N1 = hitInstanceData->SmoothNormalsArray->cdata()[3 * primitiveID + 1];
-        auto N2 = hitInstanceData->SmoothNormalsArray->cdata()[3 * primitiveID + 2];
+        auto N0 = shadingNormals->GetNormal(3 * primitiveID + 0);
+        auto N1 = shadingNormals->GetNormal(3 * primitiveID + 1);
+        auto N2 = shadingNormals->GetNormal(3 * primitiveID + 2);
 
         // Dokonujemy interpolacji danych na podstawie współrzędnych barycentrycznych
         // których dostarcza Embree dla uderzonego trójkąta.
-        hitLocalNormal = InterpolateWithBarycentricCoordinates(
-            {hitRayData.hit.u, hitRayData.hit.v},
-            N0, N1, N2
-        );
+        hitLocalNormal = InterpolateWithBarycentricCoordinates(hitUV, N0, N1, N2);
 
         hitLocalNormal.Normalize();
     }
     else
     {
         // Musimy pobrać wektor geometryczny (obliczony przez Embree na podstawie wierzchołków trójkąta).
-        hitLocalNormal = { hitRayData.hit.Ng_x, hitRayData.hit.Ng_y, hitRayData.hit.Ng_z };
+        hitLocalNormal = geometricNormal;
 
         // Normalizujemy in-place.
         hitLocalNormal.Normalize();
@@ -69,14 +99,77 @@ pxr::GfVec3f OnyxHelper::EvaluateHitSurfaceNormal(
     // Obliczony wektor wymaga przekształcenia. Dane w buforze oraz obliczony wektor geometryczny
     // są zdefiniowane w object-space (local). Aby otrzymać prawidłowy wektor normalny musimy
     // obliczyć jego przekształcenie na podstawie transformacji instancji.
-    // Używamy macierzy transformacji instancji do transformacji wektora (dir - ignorujemy translację) do world-space.
-    pxr::GfVec3f hitWorldNormal = hitInstanceData->TransformMatrix.TransformDir(hitLocalNormal);
+    // Wektory normalne przekształcamy transpozycją odwrotności macierzy instancji (dir - ignorujemy translację) -
+    // przy skalowaniu niejednorodnym macierz instancji nie zachowuje prostopadłości wektora do powierzchni.
+    // Kopie instancera współdzielą strukturę pomocniczą, transformacja jest wybierana indeksem kopii.
+    const pxr::GfMatrix4f& instanceTransform = hitInstanceData->GetTransform(instancePrimitiveID);
+    pxr::GfVec3f hitWorldNormal = instanceTransform.GetInverse().GetTranspose().TransformDir(hitLocalNormal);
     hitWorldNormal.Normalize();
 
     return hitWorldNormal;
 }
 
 
+bool OnyxHelper::EvaluateHitTextureCoordinate(
+    uint instanceID,
+    uint instancePrimitiveID,
+    uint primitiveID,
+    const pxr::GfVec2f& hitUV,
+    const RTCScene& embreeScene,
+    HitTextureCoordinate& textureCoordinate)
+{
+    auto* hitInstanceData = static_cast<pxr::HdOnyxInstanceData*>(
+        rtcGetGeometryUserData(rtcGetGeometry(embreeScene, instanceID)));
+
+    const pxr::HdOnyxSharedGeometry* hitGeometry = hitInstanceData->Geometry;
+    if (!hitGeometry || hitGeometry->IndexArray.size() <= primitiveID) return false;
+
+    const pxr::HdOnyxTextureCoordinates& coordinates = hitGeometry->TextureCoordinates;
+    const pxr::GfVec3i& triangle = hitGeometry->IndexArray[primitiveID];
+
+    // Współrzędne "vertex" wskazujemy indeksami punktów trójkąta, face-varying - pozycją trójkąta w buforze.
+    pxr::GfVec2f UV0, UV1, UV2;
+    if (coordinates.Interpolation == pxr::HdOnyxPrimvarInterpolation::Vertex)
+    {
+        UV0 = coordinates.Coordinates[triangle[0]];
+        UV1 = coordinates.Coordinates[triangle[1]];
+        UV2 = coordinates.Coordinates[triangle[2]];
+    }
+    else if (coordinates.Interpolation == pxr::HdOnyxPrimvarInterpolation::FaceVarying
+        && coordinates.Coordinates.size() > 3 * primitiveID + 2)
+    {
+        UV0 = coordinates.Coordinates[3 * primitiveID + 0];
+        UV1 = coordinates.Coordinates[3 * primitiveID + 1];
+        UV2 = coordinates.Coordinates[3 * primitiveID + 2];
+    }
+    else
+    {
+        return false;
+    }
+
+    textureCoordinate.UV = (1.0f - hitUV[0] - hitUV[1]) * UV0 + hitUV[0] * UV1 + hitUV[1] * UV2;
+
+    // Pola trójkąta w world-space oraz w przestrzeni tekstury (podwojone - czynnik 1/2 skraca się w ilorazie).
+    const pxr::GfMatrix4f& transform = hitInstanceData->GetTransform(instancePrimitiveID);
+
+    pxr::GfVec3f P0 = transform.Transform(hitGeometry->PointArray[triangle[0]]);
+    pxr::GfVec3f P1 = transform.Transform(hitGeometry->PointArray[triangle[1]]);
+    pxr::GfVec3f P2 = transform.Transform(hitGeometry->PointArray[triangle[2]]);
+
+    pxr::GfVec3f worldCross = pxr::GfCross(P1 - P0, P2 - P0);
+    float worldArea = worldCross.GetLength();
+
+    pxr::GfVec2f edgeUV1 = UV1 - UV0;
+    pxr::GfVec2f edgeUV2 = UV2 - UV0;
+    float textureArea = std::abs(edgeUV1[0] * edgeUV2[1] - edgeUV1[1] * edgeUV2[0]);
+
+    textureCoordinate.UVPerWorldUnit = worldArea > 0.0f ? std::sqrt(textureArea / worldArea) : 0.0f;
+    textureCoordinate.WorldNormal = worldArea > 0.0f ? worldCross / worldArea : pxr::GfVec3f(0.0f);
+
+    return true;
+}
+
+
 RTCRayHit OnyxHelper::GeneratePrimaryRay(
     const float& pixelOffsetX, const float& pixelOffsetY,
     const float& maxX, const float& maxY,
@@ -1,25 +1,38 @@
 #include "../include/OnyxPathtracingIntegrator.h"
 
 #include <embree4/rtcore.h>
+#include <pxr/base/work/loops.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
 
 #include "OnyxHelper.h"
+#include "RayPacket.h"
 
-#include "Material.h"
+#include "MaterialTable.h"
 
 using namespace Onyx;
 
 
+OnyxPathtracingIntegrator::OnyxPathtracingIntegrator()
+: m_TaskArena(std::make_unique<tbb::task_arena>())
+{
+}
+
+
 OnyxPathtracingIntegrator::OnyxPathtracingIntegrator(const DataPayload& payload)
 : m_Data(payload)
-, m_MersenneTwister(m_RandomDevice())
-, m_UniformDistributionGenerator(std::uniform_real_distribution<float>(0.0f, 1.0f))
+, m_TaskArena(std::make_unique<tbb::task_arena>())
 {
 }
 
 
 OnyxPathtracingIntegrator::~OnyxPathtracingIntegrator()
 {
-    m_RayPayloadBuffer.clear();
+    m_RayPayloadBuffer.Resize(0, false);
 }
 
 void OnyxPathtracingIntegrator::Initialise(const DataPayload& payload)
@@ -32,14 +45,31 @@ bool OnyxPathtracingIntegrator::IsConverged()
 {
     // Jeżeli zebraliśmy wymaganą ilość próbek.
     if (m_SampleCount >= m_SampleLimit) return true;
-    return false;
+
+    // Jeżeli wszystkie kafelki osiągnęły wymagany poziom szumu.
+    return m_AdaptiveConverged;
 }
 
 
 void OnyxPathtracingIntegrator::ResetState()
 {
-    ResetRayPayloadsWithPrimaryRays();
+    // Podział na kafelki zależy od rozdzielczości, odświeżamy go przed wygenerowaniem promieni.
+    RebuildTiles();
+
+    m_Sampler.Configure(m_RenderSettings.Sampler, m_RenderArgument->Width, m_RenderArgument->Height, m_SampleLimit);
+
+    // Bufor próbek przechowuje liczniki próbek pikseli, z których korzysta generator promieni kamery.
     ResetSampleBuffer();
+    ResetRayPayloadsWithPrimaryRays();
+
+    auto vectorBytes = [](const auto& vector) { return vector.capacity() * sizeof(*vector.data()); };
+
+    m_RayPayloadMemoryBytes = m_RayPayloadBuffer.GetMemoryFootprint()
+        + vectorBytes(m_PrimaryRayQueue) + vectorBytes(m_ActiveRayQueue) + vectorBytes(m_CompactedRayQueue)
+        + vectorBytes(m_ShadowRayQueue) + vectorBytes(m_ShadingRayQueue) + vectorBytes(m_ShadingMaterialQueue);
+
+    m_AccumulationMemoryBytes = vectorBytes(m_SampleBuffer) + vectorBytes(m_PixelSampleCount)
+        + vectorBytes(m_PixelVariance) + vectorBytes(m_TileConverged);
 }
 
 
@@ -51,11 +81,118 @@ void OnyxPathtracingIntegrator::SetRenderArgument(const std::shared_ptr<RenderAr
 }
 
 
-pxr::GfVec2f OnyxPathtracingIntegrator::GenerateUniformRandomNumber2D()
+void OnyxPathtracingIntegrator::SetRenderSettings(const RenderSettings& renderSettings)
+{
+    if (m_RenderSettings.ThreadLimit != renderSettings.ThreadLimit)
+    {
+        // Limit 0 oznacza automatyczny dobór liczby wątków przez pulę zadań.
+        m_TaskArena = renderSettings.ThreadLimit > 0
+            ? std::make_unique<tbb::task_arena>(int(renderSettings.ThreadLimit))
+            : std::make_unique<tbb::task_arena>();
+    }
+
+    m_RenderSettings = renderSettings;
+
+    // Sekwencje próbnika są konfigurowane dla limitu próbek przy kolejnym resecie stanu.
+    m_SampleLimit = std::max(renderSettings.SampleLimit, 1u);
+
+    // Wszystkie materiały silnika są aktualnie rozpraszające (diffuse), więc każde odbicie
+    // podlega zarówno limitowi całkowitemu, jak i limitowi odbić rozproszonych.
+    m_BounceLimit = uint8_t(std::min(renderSettings.MaxBounces, renderSettings.MaxDiffuseBounces));
+}
+
+
+pxr::GfVec2f OnyxPathtracingIntegrator::GetSample2D(uint32_t rayIndex, uint32_t dimension) const
+{
+    // Indeksem próbki jest liczba próbek zebranych dotychczas przez piksel, dzięki czemu
+    // sekwencja piksela jest kontynuowana niezależnie od trybu (regeneracja ścieżek lub pełne iteracje).
+    return m_Sampler.Get2D(rayIndex, m_PixelSampleCount[rayIndex], dimension);
+}
+
+
+void OnyxPathtracingIntegrator::RebuildTiles()
+{
+    // Rozmiar bloku pikseli z którego budowana jest kolejka promieni kamery.
+    // Blok 4x4 odpowiada największemu pakietowi promieni (rtcIntersect16).
+    constexpr uint queueBlockSize = 4;
+
+    m_TileBuffer.clear();
+    m_PrimaryRayQueue.clear();
+    m_PrimaryRayQueue.reserve(m_RenderArgument->Width * m_RenderArgument->Height);
+
+    // Dzielimy obraz na kafelki wierszami. Kafelki na prawej oraz dolnej krawędzi
+    // są przycinane do rozdzielczości obrazu.
+    for (uint tileY = 0; tileY < m_RenderArgument->Height; tileY += m_TileSize)
+    {
+        for (uint tileX = 0; tileX < m_RenderArgument->Width; tileX += m_TileSize)
+        {
+            RenderTile tile{
+                .MinX = tileX,
+                .MinY = tileY,
+                .MaxX = std::min(tileX + m_TileSize, m_RenderArgument->Width),
+                .MaxY = std::min(tileY + m_TileSize, m_RenderArgument->Height),
+                .PrimaryQueueOffset = uint(m_PrimaryRayQueue.size())
+            };
+
+            // Piksele kafelka dodajemy do kolejki blokami. Kolejne promienie w kolejce
+            // są sąsiadami w obrazie, więc pakiety promieni kamery pozostają spójne.
+            for (uint blockY = tile.MinY; blockY < tile.MaxY; blockY += queueBlockSize)
+            {
+                for (uint blockX = tile.MinX; blockX < tile.MaxX; blockX += queueBlockSize)
+                {
+                    for (uint currentY = blockY; currentY < std::min(blockY + queueBlockSize, tile.MaxY); currentY++)
+                    {
+                        for (uint currentX = blockX; currentX < std::min(blockX + queueBlockSize, tile.MaxX); currentX++)
+                        {
+                            m_PrimaryRayQueue.push_back((currentY * m_RenderArgument->Width) + currentX);
+                        }
+                    }
+                }
+            }
+
+            m_TileBuffer.push_back(tile);
+        }
+    }
+
+    m_ActiveRayQueue.resize(m_PrimaryRayQueue.size());
+    m_CompactedRayQueue.resize(m_PrimaryRayQueue.size());
+    m_ShadowRayQueue.resize(m_PrimaryRayQueue.size());
+    m_ShadingRayQueue.resize(m_PrimaryRayQueue.size());
+    m_ShadingMaterialQueue.resize(m_PrimaryRayQueue.size());
+
+    m_TileQueueOffsets.resize(m_TileBuffer.size());
+    m_TileQueueCounts.resize(m_TileBuffer.size());
+    m_CompactedTileQueueOffsets.resize(m_TileBuffer.size());
+    m_TileSurvivorCounts.resize(m_TileBuffer.size());
+}
+
+
+template<typename TileFunction>
+void OnyxPathtracingIntegrator::ForEachTileParallel(const TileFunction& tileFunction)
+{
+    // Zadania wykonywane są wewnątrz puli z ograniczoną liczbą wątków.
+    // Pula działa na zasadzie "work-stealing" - wolne wątki przejmują kafelki
+    // z kolejek wątków które są nadal zajęte.
+    m_TaskArena->execute([&]()
+    {
+        // Rozmiar ziarna równy 1 - każdy kafelek jest osobnym zadaniem.
+        // Kafelki mają zróżnicowany koszt (np. niebo vs geometria), drobny podział
+        // pozwala na równomierne rozłożenie pracy.
+        pxr::WorkParallelForN(m_TileBuffer.size(), [&](size_t beginTile, size_t endTile)
+        {
+            for (size_t tileIndex = beginTile; tileIndex < endTile; tileIndex++)
+            {
+                tileFunction(tileIndex);
+            }
+        }, 1);
+    });
+}
+
+
+IntegratorStatistics OnyxPathtracingIntegrator::GetStatistics() const
 {
-    return {
-        m_UniformDistributionGenerator(m_MersenneTwister),
-        m_UniformDistributionGenerator(m_MersenneTwister)};
+    std::lock_guard<std::mutex> statisticsLock(m_StatisticsLock);
+    return m_Statistics;
 }
 
 
@@ -64,35 +201,71 @@ void OnyxPathtracingIntegrator::ResetRayPayloadsWithPrimaryRays()
     uint requiredBufferSize = m_RenderArgument->Width * m_RenderArgument->Height;
 
     // Resize dostosuje wielkość bufora. Nie ulegnie zmianie jeśli wymagany rozmiar == aktualny rozmiar.
-    m_RayPayloadBuffer.resize(requiredBufferSize);
+    m_RayPayloadBuffer.Resize(requiredBufferSize, m_RenderSettings.HalfPrecisionThroughput);
+
+    // Każdy slot promienia generuje w iteracji tyle ścieżek ile próbek zbiera piksel.
+    // Pierwsza ścieżka jest generowana poniżej, pozostałe podczas regeneracji.
+    auto pendingSamples = uint16_t(GetIterationSampleCount() - 1);
 
-    // Dla każdego pixela w buforze.
-    for (auto currentY = 0; currentY < m_RenderArgument->Height; currentY++)
+    // Promienie kamery generujemy równolegle dla każdego kafelka.
+    ForEachTileParallel([this, pendingSamples](size_t tileIndex)
     {
-        for (auto currentX = 0; currentX < m_RenderArgument->Width; currentX++)
-        {
-            // Obliczamy jedno-wymiarowy offset promienia w buforze.
-            uint32_t rayOffsetInBuffer = (currentY * m_RenderArgument->Width) + currentX;
+        const RenderTile& tile = m_TileBuffer[tileIndex];
 
-            // Generujemy dwie liczby losowe do wygenerowania promienia.
-            auto uniform2D = pxr::GfVec2f{
-                m_UniformDistributionGenerator(m_MersenneTwister),
-                m_UniformDistributionGenerator(m_MersenneTwister)
-            };
+        m_TileQueueOffsets[tileIndex] = tile.PrimaryQueueOffset;
+
+        // Kafelki które osiągnęły wymagany poziom szumu nie otrzymują promieni.
+        m_TileQueueCounts[tileIndex] = m_TileConverged[tileIndex] ? 0 : tile.GetPixelCount();
 
-            // Generujemy promień z kamery.
-            RTCRayHit primaryRayHit = OnyxHelper::GeneratePrimaryRay(
-                currentX, currentY, m_RenderArgument->Width, m_RenderArgument->Height,
-                m_RenderArgument->MatrixInverseProjection, m_RenderArgument->MatrixInverseView,
-                uniform2D);
-
-            m_RayPayloadBuffer[rayOffsetInBuffer].RayHit = primaryRayHit;
-            m_RayPayloadBuffer[rayOffsetInBuffer].Terminated = false;
-            m_RayPayloadBuffer[rayOffsetInBuffer].Bounce = 0;
-            m_RayPayloadBuffer[rayOffsetInBuffer].Throughput = pxr::GfVec3f{1.0};
-            m_RayPayloadBuffer[rayOffsetInBuffer].Radiance = pxr::GfVec3f{0.0};
+        for (uint queueIndex = tile.PrimaryQueueOffset;
+             queueIndex < tile.PrimaryQueueOffset + m_TileQueueCounts[tileIndex]; queueIndex++)
+        {
+            // Jedno-wymiarowy offset promienia w buforze.
+            uint32_t rayOffsetInBuffer = m_PrimaryRayQueue[queueIndex];
+            m_ActiveRayQueue[queueIndex] = rayOffsetInBuffer;
+
+            m_RayPayloadBuffer.PendingSamples[rayOffsetInBuffer] = pendingSamples;
+            StartCameraPath(rayOffsetInBuffer);
         }
-    }
+    });
+
+    // Liczba aktywnych promieni obejmuje jedynie kafelki które nie osiągnęły zbieżności.
+    m_ActiveRayCount = std::accumulate(m_TileQueueCounts.begin(), m_TileQueueCounts.end(), 0u);
+    m_IterationPixelCount = m_ActiveRayCount;
+}
+
+
+void OnyxPathtracingIntegrator::StartCameraPath(uint32_t rayIndex)
+{
+    uint currentX = rayIndex % m_RenderArgument->Width;
+    uint currentY = rayIndex / m_RenderArgument->Width;
+
+    // Generujemy dwie liczby losowe do wygenerowania promienia.
+    auto uniform2D = GetSample2D(rayIndex, SampleDimension::Camera);
+
+    // Generujemy promień z kamery.
+    RTCRayHit primaryRayHit = OnyxHelper::GeneratePrimaryRay(
+        currentX, currentY, m_RenderArgument->Width, m_RenderArgument->Height,
+        m_RenderArgument->MatrixInverseProjection, m_RenderArgument->MatrixInverseView,
+        uniform2D);
+
+    m_RayPayloadBuffer.SetRay(rayIndex, primaryRayHit.ray);
+    m_RayPayloadBuffer.Bounce[rayIndex] = 0;
+    m_RayPayloadBuffer.BsdfPdf[rayIndex] = 0.0f;
+    m_RayPayloadBuffer.SetThroughput(rayIndex, pxr::GfVec3f{1.0});
+    m_RayPayloadBuffer.SetRadiance(rayIndex, pxr::GfVec3f{0.0});
+}
+
+
+uint OnyxPathtracingIntegrator::GetIterationSampleCount() const
+{
+    if (!m_RenderSettings.PathRegeneration) return 1;
+
+    // Nie przekraczamy limitu próbek ani zakresu licznika próbek slotu.
+    uint remainingSamples = m_SampleLimit >= m_SampleCount ? m_SampleLimit - m_SampleCount + 1 : 1;
+    uint iterationSamples = std::min(m_RenderSettings.SamplesPerIteration, remainingSamples);
+
+    return std::clamp(iterationSamples, 1u, uint(std::numeric_limits<uint16_t>::max()));
 }
 
 
@@ -108,7 +281,40 @@ void OnyxPathtracingIntegrator::ResetSampleBuffer()
         sample.Set(0.0, 0.0, 0.0);
     }
 
+    m_PixelSampleCount.assign(requiredBufferSize, 0);
+    m_PixelVariance.assign(requiredBufferSize, PixelVariance());
+
+    // Wszystkie kafelki ponownie otrzymują próbki.
+    m_TileConverged.assign(m_TileBuffer.size(), false);
+    m_TileRelativeErrors.assign(m_TileBuffer.size(), {0.0, 0});
+    m_ActiveTileCount = uint(m_TileBuffer.size());
+    m_AdaptiveConverged = false;
+
     m_SampleCount = 1;
+
+    {
+        // Przepustowość jest mierzona od nowa dla nowego stanu integratora (scena, kamera, ustawienia).
+        std::lock_guard<std::mutex> statisticsLock(m_StatisticsLock);
+        m_Statistics = IntegratorStatistics{
+            .PacketWidth = m_RenderSettings.PacketWidth,
+            .ActiveTileCount = m_ActiveTileCount,
+            .TileCount = uint32_t(m_TileBuffer.size())
+        };
+    }
+}
+
+
+/**
+ * Heurystyka potęgowa (Veach) o wykładniku 2 - waga estymatora o gęstości firstPdf
+ * w połączeniu z estymatorem o gęstości secondPdf.
+ */
+float powerHeuristic(float firstPdf, float secondPdf)
+{
+    float firstSquared = firstPdf * firstPdf;
+    float secondSquared = secondPdf * secondPdf;
+
+    if (firstSquared + secondSquared <= 0.0f) return 0.0f;
+    return firstSquared / (firstSquared + secondSquared);
 }
 
 
@@ -120,13 +326,62 @@ void writeNormalDataAOV(uint8_t* pixelDataStart, pxr::GfVec3f normal)
     pixelDataStart[3] = 255;
 }
 
-void writeColorDataAOV(uint8_t* pixelDataStart, pxr::GfVec3f color)
+template<typename ComponentType, int ComponentCount>
+void resolveColorRow(ComponentType* output, const pxr::GfVec3f* samples, const uint* sampleCounts, uint pixelCount)
 {
-    auto floatToRGB = pxr::GfCompMult(color, pxr::GfVec3f(255.0));
-    pixelDataStart[0] = std::clamp(uint(floatToRGB[0]), 0u, 255u);
-    pixelDataStart[1] = std::clamp(uint(floatToRGB[1]), 0u, 255u);
-    pixelDataStart[2] = std::clamp(uint(floatToRGB[2]), 0u, 255u);
-    pixelDataStart[3] = 255u;
+    for (uint pixel = 0; pixel < pixelCount; pixel++)
+    {
+        // Piksel bez zebranych próbek pozostaje czarny.
+        float inverseSampleCount = sampleCounts[pixel] > 0 ? 1.0f / float(sampleCounts[pixel]) : 0.0f;
+
+        for (int component = 0; component < 3; component++)
+        {
+            output[pixel * ComponentCount + component] = ComponentType(samples[pixel][component] * inverseSampleCount);
+        }
+
+        if constexpr (ComponentCount == 4) output[pixel * ComponentCount + 3] = ComponentType(1.0f);
+    }
+}
+
+void resolveColorRowUNorm8(uint8_t* output, const pxr::GfVec3f* samples, const uint* sampleCounts, uint pixelCount)
+{
+    for (uint pixel = 0; pixel < pixelCount; pixel++)
+    {
+        float inverseSampleCount = sampleCounts[pixel] > 0 ? 255.0f / float(sampleCounts[pixel]) : 0.0f;
+
+        for (int component = 0; component < 3; component++)
+        {
+            float scaledComponent = samples[pixel][component] * inverseSampleCount;
+            output[pixel * 4 + component] = uint8_t(std::clamp(scaledComponent, 0.0f, 255.0f));
+        }
+
+        output[pixel * 4 + 3] = 255u;
+    }
+}
+
+
+bool OnyxPathtracingIntegrator::FinishPathSample(uint32_t rayIndex)
+{
+    // Zakończona ścieżka stanowi jedną próbkę piksela (również ścieżka która nie trafiła w światło).
+    // Próbki są jedynie akumulowane - konwersja do formatu bufora AOV odbywa się raz na iterację.
+    auto pathRadiance = m_RayPayloadBuffer.GetRadiance(rayIndex);
+    m_SampleBuffer[rayIndex] += pathRadiance;
+    m_PixelSampleCount[rayIndex] += 1;
+
+    // Aktualizujemy estymator wariancji luminancji piksela.
+    float luminance = pxr::GfDot(pathRadiance, pxr::GfVec3f(0.2126f, 0.7152f, 0.0722f));
+    auto& pixelVariance = m_PixelVariance[rayIndex];
+    float delta = luminance - pixelVariance.Mean;
+    pixelVariance.Mean += delta / float(m_PixelSampleCount[rayIndex]);
+    pixelVariance.M2 += delta * (luminance - pixelVariance.Mean);
+
+    // W trybie regeneracji slot natychmiast rozpoczyna kolejną próbkę kamery dla tego samego piksela.
+    if (m_RayPayloadBuffer.PendingSamples[rayIndex] == 0) return false;
+
+    m_RayPayloadBuffer.PendingSamples[rayIndex] -= 1;
+    StartCameraPath(rayIndex);
+
+    return true;
 }
 
 
@@ -141,9 +396,34 @@ void OnyxPathtracingIntegrator::PerformIteration()
         ResetState();
     }
 
-    if(m_SampleCount > m_SampleLimit) return;
+    if(m_SampleCount > m_SampleLimit || m_AdaptiveConverged) return;
+
+    // Kąt pomiędzy promieniami sąsiednich pikseli w centrum obrazu (kamera mogła zmienić ogniskową).
+    {
+        uint centerX = m_RenderArgument->Width / 2;
+        uint centerY = m_RenderArgument->Height / 2;
+        const pxr::GfVec2f pixelCenter(0.5f, 0.5f);
+
+        RTCRayHit centerRay = OnyxHelper::GeneratePrimaryRay(
+            centerX, centerY, m_RenderArgument->Width, m_RenderArgument->Height,
+            m_RenderArgument->MatrixInverseProjection, m_RenderArgument->MatrixInverseView, pixelCenter);
+        RTCRayHit neighbourRay = OnyxHelper::GeneratePrimaryRay(
+            centerX + 1, centerY, m_RenderArgument->Width, m_RenderArgument->Height,
+            m_RenderArgument->MatrixInverseProjection, m_RenderArgument->MatrixInverseView, pixelCenter);
+
+        float directionCosine = centerRay.ray.dir_x * neighbourRay.ray.dir_x
+            + centerRay.ray.dir_y * neighbourRay.ray.dir_y
+            + centerRay.ray.dir_z * neighbourRay.ray.dir_z;
+
+        m_PixelSpreadAngle = std::acos(std::clamp(directionCosine, -1.0f, 1.0f));
+    }
 
     m_IncreaseSampleCount = true;
+    m_IterationRayCount = 0;
+
+    uint iterationSampleCount = GetIterationSampleCount();
+
+    auto iterationStart = std::chrono::steady_clock::now();
 
     // Wykonujemy śledzenie segmentu ścieżki do momentu zatrzymania każdego z promieni w buforze.
     while(!IsRayBufferConverged())
@@ -152,10 +432,41 @@ void OnyxPathtracingIntegrator::PerformIteration()
         PerformRayBounceIteration();
     }
 
+    m_IterationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - iterationStart).count();
+
+    // Zebrane w iteracji próbki konwertujemy do formatu bufora koloru.
+    ResolveColorAov();
+
+    // Kafelki które osiągnęły wymagany poziom szumu nie otrzymają promieni w kolejnej iteracji.
+    if (m_IncreaseSampleCount) UpdateTileConvergence();
+
     // Jedna iteracja integratora = wykonanie śledzenia ścieżek (grupy segmentów) dla jednego piksela.
     // Wykonanie wielu iteracji integratora pozwala nam na poprawę jakości aproksymacji
-    // zgodnie z teorią Monte Carlo. Wyniki zostaną uśrednione przez ilość zebranych próbek (Sample Count).
-    if (m_IncreaseSampleCount) m_SampleCount += 1;
+    // zgodnie z teorią Monte Carlo. Wyniki zostaną uśrednione przez ilość zebranych próbek piksela.
+    // W trybie regeneracji jedna iteracja zbiera wiele próbek każdego piksela.
+    if (m_IncreaseSampleCount) m_SampleCount += iterationSampleCount;
+
+    // Błąd pikseli jest wyznaczany poza blokadą statystyk (równoległy przebieg po kafelkach).
+    float meanRelativeError = ComputeMeanRelativeError();
+
+    {
+        // Przepustowość śledzenia promieni jest udostępniana aplikacji przez statystyki silnika,
+        // co pozwala na porównanie wydajności trybu skalarnego oraz trybów pakietowych.
+        std::lock_guard<std::mutex> statisticsLock(m_StatisticsLock);
+        m_Statistics.SampleCount = m_SampleCount - 1;
+        m_Statistics.PacketWidth = m_RenderSettings.PacketWidth;
+        m_Statistics.ActiveTileCount = m_ActiveTileCount;
+        m_Statistics.TileCount = uint32_t(m_TileBuffer.size());
+        m_Statistics.IterationRayCount = m_IterationRayCount;
+        m_Statistics.IterationSeconds = m_IterationSeconds;
+        m_Statistics.TotalRayCount += m_IterationRayCount;
+        m_Statistics.TotalSeconds += m_IterationSeconds;
+        if (m_IncreaseSampleCount)
+        {
+            m_Statistics.TotalPathSampleCount += uint64_t(m_IterationPixelCount) * iterationSampleCount;
+        }
+        m_Statistics.MeanRelativeError = meanRelativeError;
+    }
 
     // Wykonanie nowej iteracji ponownie zaczyna się w kamerze. Wypełniamy bufor promieni promieniem "primary"
     // (promień wychodzący z kamery).
@@ -163,64 +474,263 @@ void OnyxPathtracingIntegrator::PerformIteration()
 }
 
 
+void OnyxPathtracingIntegrator::UpdateTileConvergence()
+{
+    // Próbkowanie adaptacyjne jest wyłączone.
+    if (m_RenderSettings.NoiseThreshold <= 0.0f) return;
+
+    // Wariancja wymaga co najmniej dwóch próbek.
+    uint minSampleCount = std::max(m_RenderSettings.AdaptiveMinSamples, 2u);
+
+    ForEachTileParallel([this, minSampleCount](size_t tileIndex)
+    {
+        if (m_TileConverged[tileIndex]) return;
+
+        // Kafelek jest zbieżny jeśli błąd każdego z jego pikseli jest mniejszy od progu.
+        // Pojedynczy zaszumiony piksel (np. rzadko trafiane światło) utrzymuje kafelek aktywnym.
+        const RenderTile& tile = m_TileBuffer[tileIndex];
+        for (uint currentY = tile.MinY; currentY < tile.MaxY; currentY++)
+        {
+            for (uint currentX = tile.MinX; currentX < tile.MaxX; currentX++)
+            {
+                uint32_t pixelIndex = (currentY * m_RenderArgument->Width) + currentX;
+
+                if (m_PixelSampleCount[pixelIndex] < minSampleCount) return;
+                if (GetPixelRelativeError(pixelIndex) > m_RenderSettings.NoiseThreshold) return;
+            }
+        }
+
+        m_TileConverged[tileIndex] = true;
+        m_ActiveTileCount -= 1;
+    });
+
+    if (m_ActiveTileCount == 0)
+    {
+        std::cout << "[Onyx] Wszystkie kafelki osiągnęły próg szumu po " << m_SampleCount << " próbkach." << std::endl;
+        m_AdaptiveConverged = true;
+    }
+}
+
+
+float OnyxPathtracingIntegrator::GetPixelRelativeError(uint32_t pixelIndex) const
+{
+    const auto& pixelVariance = m_PixelVariance[pixelIndex];
+    float sampleCount = float(m_PixelSampleCount[pixelIndex]);
+
+    // Odchylenie standardowe średniej (błąd estymatora Monte Carlo).
+    float sampleVariance = pixelVariance.M2 / (sampleCount - 1.0f);
+    float standardError = std::sqrt(std::max(sampleVariance, 0.0f) / sampleCount);
+
+    // Stała w mianowniku ogranicza wymagania dla bardzo ciemnych pikseli,
+    // dla których błąd względny nie jest widoczny na obrazie.
+    return standardError / (pixelVariance.Mean + 0.01f);
+}
+
+
+float OnyxPathtracingIntegrator::ComputeMeanRelativeError()
+{
+    ForEachTileParallel([this](size_t tileIndex)
+    {
+        double errorSum = 0.0;
+        uint32_t pixelCount = 0;
+
+        const RenderTile& tile = m_TileBuffer[tileIndex];
+        for (uint currentY = tile.MinY; currentY < tile.MaxY; currentY++)
+        {
+            for (uint currentX = tile.MinX; currentX < tile.MaxX; currentX++)
+            {
+                uint32_t pixelIndex = (currentY * m_RenderArgument->Width) + currentX;
+
+                // Wariancja wymaga co najmniej dwóch próbek.
+                if (m_PixelSampleCount[pixelIndex] < 2) continue;
+
+                errorSum += GetPixelRelativeError(pixelIndex);
+                pixelCount++;
+            }
+        }
+
+        m_TileRelativeErrors[tileIndex] = {errorSum, pixelCount};
+    });
+
+    double errorSum = 0.0;
+    uint64_t pixelCount = 0;
+    for (const auto& [tileErrorSum, tilePixelCount] : m_TileRelativeErrors)
+    {
+        errorSum += tileErrorSum;
+        pixelCount += tilePixelCount;
+    }
+
+    return pixelCount > 0 ? float(errorSum / double(pixelCount)) : 0.0f;
+}
+
+
+void OnyxPathtracingIntegrator::ResolveColorAov()
+{
+    auto colorAovBufferData = m_RenderArgument->GetBufferData(pxr::HdAovTokens->color);
+    auto colorAovFormat = m_RenderArgument->GetBufferFormat(pxr::HdAovTokens->color);
+    if (!colorAovBufferData.has_value() || !colorAovFormat.has_value()) return;
+
+    auto* colorBuffer = static_cast<uint8_t*>(colorAovBufferData.value().first);
+    size_t colorElementSize = colorAovBufferData.value().second;
+    pxr::HdFormat colorFormat = colorAovFormat.value();
+
+    // Konwersja odbywa się wierszami kafelków. Wiersz kafelka jest ciągłym fragmentem
+    // bufora próbek oraz bufora AOV, co pozwala kompilatorowi na wektoryzację pętli.
+    ForEachTileParallel([&](size_t tileIndex)
+    {
+        const RenderTile& tile = m_TileBuffer[tileIndex];
+        uint rowLength = tile.MaxX - tile.MinX;
+
+        for (uint currentY = tile.MinY; currentY < tile.MaxY; currentY++)
+        {
+            uint rowStart = (currentY * m_RenderArgument->Width) + tile.MinX;
+
+            void* rowOutput = &colorBuffer[rowStart * colorElementSize];
+            const pxr::GfVec3f* rowSamples = &m_SampleBuffer[rowStart];
+            const uint* rowSampleCounts = &m_PixelSampleCount[rowStart];
+
+            switch (colorFormat)
+            {
+                case pxr::HdFormatFloat32Vec4:
+                    resolveColorRow<float, 4>(static_cast<float*>(rowOutput), rowSamples, rowSampleCounts, rowLength);
+                    break;
+                case pxr::HdFormatFloat32Vec3:
+                    resolveColorRow<float, 3>(static_cast<float*>(rowOutput), rowSamples, rowSampleCounts, rowLength);
+                    break;
+                case pxr::HdFormatFloat16Vec4:
+                    resolveColorRow<pxr::GfHalf, 4>(
+                        static_cast<pxr::GfHalf*>(rowOutput), rowSamples, rowSampleCounts, rowLength);
+                    break;
+                case pxr::HdFormatFloat16Vec3:
+                    resolveColorRow<pxr::GfHalf, 3>(
+                        static_cast<pxr::GfHalf*>(rowOutput), rowSamples, rowSampleCounts, rowLength);
+                    break;
+                case pxr::HdFormatUNorm8Vec4:
+                    resolveColorRowUNorm8(static_cast<uint8_t*>(rowOutput), rowSamples, rowSampleCounts, rowLength);
+                    break;
+                default:
+                    // Nieobsługiwany format bufora koloru.
+                    return;
+            }
+        }
+    });
+}
+
+
 void OnyxPathtracingIntegrator::PerformRayBounceIteration()
 {
     // Wyciągamy bufory danych do których silnik będzie wpisywał rezultat renderowania różnych zmiennych.
     auto colorAovBufferData = m_RenderArgument->GetBufferData(pxr::HdAovTokens->color);
     auto normalAovBufferData = m_RenderArgument->GetBufferData(pxr::HdAovTokens->normal);
 
-    bool writeColorAOV = colorAovBufferData.has_value();
-    bool writeNormalAOV = normalAovBufferData.has_value();
-
-    uint8_t* colorAovBuffer;
-    uint8_t* normalAovBuffer;
-    size_t colorElementSize, normalElementSize;
-    if (writeColorAOV)
+    AovOutput aovOutput;
+    if (colorAovBufferData.has_value())
     {
-        colorAovBuffer = static_cast<uint8_t*>(colorAovBufferData.value().first);
-        colorElementSize = colorAovBufferData.value().second;
+        aovOutput.ColorBuffer = static_cast<uint8_t*>(colorAovBufferData.value().first);
+        aovOutput.ColorElementSize = colorAovBufferData.value().second;
     }
 
-    if (writeNormalAOV)
+    if (normalAovBufferData.has_value())
     {
-        normalAovBuffer = static_cast<uint8_t*>(normalAovBufferData.value().first);
-        normalElementSize = normalAovBufferData.value().second;
+        aovOutput.NormalBuffer = static_cast<uint8_t*>(normalAovBufferData.value().first);
+        aovOutput.NormalElementSize = normalAovBufferData.value().second;
     }
 
-    for (int rayIndex = 0; rayIndex < m_RayPayloadBuffer.size(); rayIndex++)
+    // Każdy kafelek jest przetwarzany niezależnie. Promienie kafelka zapisują dane jedynie
+    // do pikseli kafelka, więc zapis do buforów nie wymaga synchronizacji.
+    ForEachTileParallel([this, &aovOutput](size_t tileIndex)
     {
-        // Znajdujemy początek danych piksela odpowiadającego promieniowi w buforze AOV
-        uint8_t* pixelDataNormal = writeNormalAOV ? &normalAovBuffer[rayIndex * normalElementSize] : nullptr;
-        uint8_t* pixelDataColor = writeColorAOV ? &colorAovBuffer[rayIndex * colorElementSize] : nullptr;
+        PerformRayBounceIterationForTile(tileIndex, aovOutput);
+    });
 
-        auto& currentPayload = m_RayPayloadBuffer[rayIndex];
+    // Usuwamy z kolejki promienie których ścieżki zostały zakończone.
+    CompactActiveRayQueue();
+}
 
-        // Jeśli działanie promienia zostało już wcześniej zakończone, pomijamy go.
-        if (currentPayload.Terminated) continue;
+
+void OnyxPathtracingIntegrator::PerformRayBounceIterationForTile(size_t tileIndex, const AovOutput& aovOutput)
+{
+    // Segment kolejki aktywnych promieni należący do kafelka.
+    uint32_t* tileRayQueue = m_ActiveRayQueue.data() + m_TileQueueOffsets[tileIndex];
+    uint tileRayCount = m_TileQueueCounts[tileIndex];
+
+    bool writeColorAOV = aovOutput.ColorBuffer != nullptr;
+    bool writeNormalAOV = aovOutput.NormalBuffer != nullptr;
+
+    // Etap pierwszy - kończymy działanie promieni które przekroczyły limit odbić lub zostały
+    // odrzucone przez ruletkę rosyjską, aby nie brały udziału w teście intersekcji. Pozostałe promienie
+    // przesuwamy na początek segmentu (zapis nigdy nie wyprzedza odczytu, więc nie wymaga drugiego bufora).
+    // Decyzja ruletki zapada dopiero tutaj, gdy radiancja ścieżki zawiera już wkład promieni cienia.
+    uint activeRayCount = 0;
+    for (uint queueIndex = 0; queueIndex < tileRayCount; queueIndex++)
+    {
+        uint32_t rayIndex = tileRayQueue[queueIndex];
+        uint8_t bounce = m_RayPayloadBuffer.Bounce[rayIndex];
 
         // Jeśli promień przekroczył limit ilości odbić bez znalezienia światła.
-        if (currentPayload.Bounce > m_BounceLimit)
+        bool terminatePath = bounce > m_BounceLimit;
+
+        // Ruletka rosyjska - ścieżka o małej mocy kontynuuje z proporcjonalnie małym prawdopodobieństwem.
+        // Górna granica prawdopodobieństwa zapewnia zakończenie ścieżek o mocy bliskiej 1.
+        if (!terminatePath && bounce >= m_RenderSettings.RussianRouletteMinBounce)
         {
-            if (writeNormalAOV) writeNormalDataAOV(pixelDataNormal, pxr::GfVec3f(0.0));
+            pxr::GfVec3f throughput = m_RayPayloadBuffer.GetThroughput(rayIndex);
+            float survivalProbability = std::min(std::max({throughput[0], throughput[1], throughput[2]}), 0.95f);
 
-            // Kończymy działanie promienia.
-            currentPayload.Radiance.Set(0.0, 0.0, 0.0);
-            currentPayload.Terminated = true;
+            float roulette = GetSample2D(rayIndex, SampleDimension::RussianRoulette(bounce))[0];
+            terminatePath = roulette >= survivalProbability;
 
-            // Przechodzimy do następnego promienia.
-            continue;
+            // Ocalałe ścieżki kompensują energię ścieżek odrzuconych.
+            if (!terminatePath) m_RayPayloadBuffer.SetThroughput(rayIndex, throughput / survivalProbability);
         }
 
-        // Dokonujemy testu intersekcji promienia ze sceną.
-        rtcIntersect1(*m_Data->Scene, &currentPayload.RayHit, nullptr);
+        if (terminatePath)
+        {
+            if (writeNormalAOV)
+                writeNormalDataAOV(&aovOutput.NormalBuffer[rayIndex * aovOutput.NormalElementSize], pxr::GfVec3f(0.0));
+
+            // Kończymy działanie promienia. Promień pozostaje w kolejce jedynie jeśli slot
+            // rozpoczął nową ścieżkę (regeneracja) - nowy promień kamery bierze udział w teście intersekcji.
+            if (!FinishPathSample(rayIndex)) continue;
+        }
+
+        tileRayQueue[activeRayCount++] = rayIndex;
+    }
+
+    // Etap drugi - test intersekcji aktywnych promieni kafelka (pojedynczo lub w pakietach).
+    IntersectRays(tileRayQueue, activeRayCount);
+    m_IterationRayCount += activeRayCount;
+
+    // Etap trzeci - klasyfikacja uderzeń. Ścieżki które nie trafiły w geometrię lub trafiły w światło
+    // są kończone od razu, uderzenia w powierzchnie trafiają do kolejki cieniowania wraz z indeksem materiału.
+    // Zakończone ścieżki są usuwane z segmentu kafelka, zregenerowane sloty pozostają na jego początku.
+    uint32_t* tileShadingQueue = m_ShadingRayQueue.data() + m_TileQueueOffsets[tileIndex];
+    uint32_t* tileShadingMaterials = m_ShadingMaterialQueue.data() + m_TileQueueOffsets[tileIndex];
+    uint shadingRayCount = 0;
+
+    // Zakres indeksów materiałów uderzonych przez kafelek ogranicza rozmiar histogramu sortowania.
+    uint32_t minMaterialIndex = std::numeric_limits<uint32_t>::max();
+    uint32_t maxMaterialIndex = 0;
+
+    uint survivorCount = 0;
+    for (uint queueIndex = 0; queueIndex < activeRayCount; queueIndex++)
+    {
+        uint32_t rayIndex = tileRayQueue[queueIndex];
+
+        // Znajdujemy początek danych piksela odpowiadającego promieniowi w buforze AOV
+        uint8_t* pixelDataNormal = writeNormalAOV
+            ? &aovOutput.NormalBuffer[rayIndex * aovOutput.NormalElementSize]
+            : nullptr;
 
         // Jeżeli promień nie trafił w geometrię.
-        if (currentPayload.RayHit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+        if (!m_RayPayloadBuffer.IsHit(rayIndex))
         {
             if (writeNormalAOV)
                 writeNormalDataAOV(pixelDataNormal, pxr::GfVec3f(0.0));
 
-            currentPayload.Terminated = true;
+            // Kończymy ścieżkę, zregenerowany slot pozostaje w kolejce.
+            if (FinishPathSample(rayIndex)) tileRayQueue[survivorCount++] = rayIndex;
+
             // Przechodzimy do następnego promienia.
             continue;
         }
@@ -229,93 +739,639 @@ void OnyxPathtracingIntegrator::PerformRayBounceIteration()
         auto* hitInstanceData = static_cast<pxr::HdOnyxInstanceData*>(rtcGetGeometryUserData(
             // Identyfikator instancji zakłada jedno-poziomowy instancing ([0])
             // zgodne z założeniem w HdOnyxMesh który tworzy geometrię.
-            rtcGetGeometry(*m_Data->Scene, currentPayload.RayHit.hit.instID[0])));
+            rtcGetGeometry(*m_Data->Scene, m_RayPayloadBuffer.InstanceID[rayIndex])));
 
         // Jeśli promień uderzył w światło
         if (hitInstanceData->Light)
         {
             // Pobieramy dane instancji światła
-            auto& lightEmission = m_Data->LightBuffer->at(hitInstanceData->DataIndexInBuffer);
+            auto& hitLight = m_Data->LightBuffer->at(hitInstanceData->DataIndexInBuffer);
+
+            // Promień odbicia mógł trafić w światło, które zostało już spróbkowane bezpośrednio
+            // w poprzednim punkcie ścieżki. Oba estymatory są łączone wagą heurystyki potęgowej (MIS).
+            // Promienie kamery (BsdfPdf = 0) nie podlegają ważeniu.
+            float misWeight = 1.0f;
+            float bsdfPdf = m_RayPayloadBuffer.BsdfPdf[rayIndex];
+            if (bsdfPdf > 0.0f)
+            {
+                float lightPdf = GetLightSamplePdf(
+                    hitLight, m_RayPayloadBuffer.GetDirection(rayIndex), m_RayPayloadBuffer.TFar[rayIndex]);
+                misWeight = powerHeuristic(bsdfPdf, lightPdf);
+            }
 
             // Dodajemy moc światła przeskalowaną przez ścieżki (moc ścieżki jest skalowana przez
             // refleksyjność powierzchni przy każdym odbiciu od geometrii).
-            currentPayload.Radiance += GfCompMult(currentPayload.Throughput, lightEmission);
+            auto pathRadiance = m_RayPayloadBuffer.GetRadiance(rayIndex)
+                + GfCompMult(m_RayPayloadBuffer.GetThroughput(rayIndex), hitLight.Emission) * misWeight;
+            m_RayPayloadBuffer.SetRadiance(rayIndex, pathRadiance);
 
-            m_SampleBuffer[rayIndex] += pxr::GfVec3f(currentPayload.Radiance);
-            if (writeColorAOV) writeColorDataAOV(pixelDataColor, m_SampleBuffer[rayIndex] / m_SampleCount);
-
-            // Kończymy działanie promienia.
-            currentPayload.Terminated = true;
+            // Kończymy działanie promienia, zregenerowany slot pozostaje w kolejce.
+            if (FinishPathSample(rayIndex)) tileRayQueue[survivorCount++] = rayIndex;
 
             // Przechodzimy do następnego piksela.
             continue;
         }
 
-        // Obliczamy wektor normalny powierzchni.
-        pxr::GfVec3f hitWorldNormal = OnyxHelper::EvaluateHitSurfaceNormal(currentPayload.RayHit, *m_Data->Scene);
-
         // Jeżeli wymagane jest jedynie zrwócenie wektora normalnego dla pierwszego uderzenia.
         if (writeNormalAOV && !writeColorAOV)
         {
-            writeNormalDataAOV(pixelDataNormal, hitWorldNormal);
-            currentPayload.Terminated = true;
+            writeNormalDataAOV(pixelDataNormal, OnyxHelper::EvaluateHitSurfaceNormal(
+                m_RayPayloadBuffer.InstanceID[rayIndex],
+                m_RayPayloadBuffer.InstancePrimID[rayIndex],
+                m_RayPayloadBuffer.PrimitiveID[rayIndex],
+                m_RayPayloadBuffer.GetHitUV(rayIndex),
+                m_RayPayloadBuffer.GetHitGeometricNormal(rayIndex),
+                *m_Data->Scene));
             m_IncreaseSampleCount = false;
             continue;
         }
 
-        // Promień nie uderzył w światło lecz geometrię.
-        // Pobieramy materiał powiązany z geometrią aby wygenerować odbicie promienia na powierzchni.
-        auto dataID = hitInstanceData->DataIndexInBuffer;
-        auto& boundMaterial = m_Data->MaterialBuffer->at(dataID);
-
-        // Generujemy odbicie na powierzchni materiału za pomocą dedykowanej metody.
-        // Metoda generuje próbkę w local space na podstawie parametrów materiału.
-        // Przekazanie wektora normalnego pozwala na transformację wygenerowanej próbki
-        // do world-space w orientacji zgodnej z wektorem normalnym powierzchni.
-        auto rand2D = pxr::GfVec2f{m_UniformDistributionGenerator(m_MersenneTwister),
-                                   m_UniformDistributionGenerator(m_MersenneTwister)};
-        auto materialSampleDir = boundMaterial.second->Sample(hitWorldNormal, rand2D);
-
-        // Skalujemy siłę naszego promienia przez funkcję BXDF materiału.
-        // Funkcja BXDR określa stosunek mocy wejściowej do mocy wyjściowej na podstawie charakterystyki materiału.
-        currentPayload.Throughput = pxr::GfCompMult(
-            boundMaterial.second->Evaluate(materialSampleDir) / boundMaterial.second->PDF(materialSampleDir),
-            currentPayload.Throughput
-        );
-
-        // Obliczamy pozycję intersekcji w świecie.
-        // Pozycja = kierunek * czas + początek
-        auto origin = pxr::GfVec3f(currentPayload.RayHit.ray.org_x, currentPayload.RayHit.ray.org_y,
-                                   currentPayload.RayHit.ray.org_z);
-        auto direction = pxr::GfVec3f(currentPayload.RayHit.ray.dir_x, currentPayload.RayHit.ray.dir_y,
-                                      currentPayload.RayHit.ray.dir_z);
-
-        auto hitPosition = direction * currentPayload.RayHit.ray.tfar + origin;
-
-        // Generujemy promień odbicia który zaczyna się w punkcie ostatniej intersekcji z geometrią
-        // o kierunku odbicia który został wygenerowany na podstawie funkcji BXDF materiału.
-        // Dokonujemy śledzenia ścieżki do momentu zakończenia tego procesu przez trafienie w światło.
-        auto bounceRay = OnyxHelper::GenerateBounceRay(materialSampleDir, hitPosition, hitWorldNormal);
-
-        // Podmieniamy promień dla następnej iteracji.
-        currentPayload.RayHit = bounceRay;
-
-        // Odbicie oznacza kolejną iterację.
-        currentPayload.Terminated = false;
-        currentPayload.Bounce += 1;
+        // Promień nie uderzył w światło lecz geometrię - odkładamy go do cieniowania.
+        uint32_t materialIndex = hitInstanceData->DataIndexInBuffer;
+        minMaterialIndex = std::min(minMaterialIndex, materialIndex);
+        maxMaterialIndex = std::max(maxMaterialIndex, materialIndex);
+
+        tileShadingQueue[shadingRayCount] = rayIndex;
+        tileShadingMaterials[shadingRayCount] = materialIndex;
+        shadingRayCount++;
     }
+
+    // Etap czwarty - sortowanie uderzeń w powierzchnie według materiału (sortowanie przez zliczanie).
+    // Posortowane promienie są zapisywane za ocalałymi promieniami w segmencie kafelka
+    // (liczba ocalałych oraz cieniowanych promieni nie przekracza liczby aktywnych promieni).
+    uint32_t* sortedShadingQueue = tileRayQueue + survivorCount;
+    SortShadingQueueByMaterial(
+        tileShadingQueue, tileShadingMaterials, shadingRayCount, minMaterialIndex, maxMaterialIndex,
+        sortedShadingQueue);
+
+    // Etap piąty - cieniowanie uderzeń w powierzchnie. Każdy materiał jest ewaluowany dla ciągłego
+    // przedziału promieni, dzięki czemu dane oraz kod materiału pozostają w pamięci podręcznej.
+    // Promienie odbicia pozostają w segmencie kafelka, zapis nigdy nie wyprzedza odczytu.
+    uint32_t* tileShadowQueue = m_ShadowRayQueue.data() + m_TileQueueOffsets[tileIndex];
+    uint shadowRayCount = 0;
+
+    const MaterialTable& materialTable = m_Data->Materials->GetMaterialTable();
+
+    for (uint binStart = 0; binStart < shadingRayCount;)
+    {
+        // Przedział promieni o wspólnym materiale (indeksy materiałów zostały posortowane razem z promieniami).
+        uint32_t materialIndex = tileShadingMaterials[binStart];
+
+        uint binEnd = binStart + 1;
+        while (binEnd < shadingRayCount && tileShadingMaterials[binEnd] == materialIndex) binEnd++;
+
+        // Rodzaj materiału jest rozstrzygany raz na przedział,
+        // a jądro cieniowania jest wybierane w czasie kompilacji.
+        const MaterialRecord& materialRecord = m_Data->Materials->GetMaterialRecord(materialIndex);
+
+        switch (materialRecord.Kind)
+        {
+            case MaterialKind::Diffuse:
+                ShadeMaterialBin<MaterialKind::Diffuse>(
+                    materialTable.GetParameters<MaterialKind::Diffuse>(materialRecord.ParameterIndex),
+                    sortedShadingQueue + binStart, binEnd - binStart,
+                    tileRayQueue, survivorCount, tileShadowQueue, shadowRayCount);
+                break;
+        }
+
+        binStart = binEnd;
+    }
+
+    // Etap szósty - test przesłonięcia promieni cienia wygenerowanych przez kafelek.
+    // Wkład nieprzesłoniętych próbek światła jest dodawany do radiancji ścieżek przed kolejnym odbiciem.
+    TraceShadowRays(tileShadowQueue, shadowRayCount);
+    m_IterationRayCount += shadowRayCount;
+
+    m_TileSurvivorCounts[tileIndex] = survivorCount;
 }
 
 
-bool OnyxPathtracingIntegrator::IsRayBufferConverged()
+void OnyxPathtracingIntegrator::SortShadingQueueByMaterial(
+    const uint32_t* rayIndices, uint32_t* materialIndices, uint rayCount,
+    uint32_t minMaterialIndex, uint32_t maxMaterialIndex, uint32_t* sortedRayIndices)
 {
-    if(m_RayPayloadBuffer.empty()) return true;
+    if (rayCount == 0) return;
 
-    for(auto& rayPayload : m_RayPayloadBuffer)
+    // Wszystkie uderzenia kafelka dotyczą jednego materiału - kolejność nie wymaga zmiany.
+    if (minMaterialIndex == maxMaterialIndex)
     {
-        if(!rayPayload.Terminated) return false;
+        std::copy_n(rayIndices, rayCount, sortedRayIndices);
+        return;
     }
 
+    // Histogram obejmuje jedynie zakres materiałów uderzonych przez kafelek.
+    // Bufor wątku zachowuje pojemność - alokacja następuje jedynie przy większym zakresie materiałów.
+    std::vector<uint>& materialOffsets = m_ShadingScratch.local().MaterialOffsets;
+    materialOffsets.assign(maxMaterialIndex - minMaterialIndex + 1, 0);
+    for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+    {
+        materialOffsets[materialIndices[queueIndex] - minMaterialIndex]++;
+    }
+
+    // Suma prefiksowa (wyłączna) wyznacza początek przedziału każdego materiału.
+    std::exclusive_scan(materialOffsets.begin(), materialOffsets.end(), materialOffsets.begin(), 0u);
+
+    // Sortowanie przez zliczanie jest stabilne - wewnątrz przedziału zachowujemy kolejność kafelka.
+    for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+    {
+        uint& materialOffset = materialOffsets[materialIndices[queueIndex] - minMaterialIndex];
+        sortedRayIndices[materialOffset++] = rayIndices[queueIndex];
+    }
+
+    // Po rozproszeniu przesunięcia wskazują końce przedziałów, co pozwala na zapis
+    // posortowanych indeksów materiałów bez dodatkowego bufora.
+    uint binStart = 0;
+    for (uint32_t materialIndex = minMaterialIndex; materialIndex <= maxMaterialIndex; materialIndex++)
+    {
+        uint binEnd = materialOffsets[materialIndex - minMaterialIndex];
+        std::fill(materialIndices + binStart, materialIndices + binEnd, materialIndex);
+        binStart = binEnd;
+    }
+}
+
+
+template<MaterialKind Kind>
+void OnyxPathtracingIntegrator::ShadeMaterialBin(
+    const typename MaterialKernel<Kind>::Parameters& parameters,
+    const uint32_t* rayIndices, uint rayCount,
+    uint32_t* tileRayQueue, uint& survivorCount,
+    uint32_t* tileShadowQueue, uint& shadowRayCount)
+{
+    using Kernel = MaterialKernel<Kind>;
+
+    // Etap programu materiału - wejścia podłączone do sieci węzłów (tekstury) są wyznaczane raz
+    // dla całego przedziału materiału. Wyjścia nieobecne w programie przyjmują wartości stałe.
+    const MaterialProgram* program = Kernel::GetProgram(parameters);
+    const pxr::GfVec3f baseColor = Kernel::GetBaseColor(parameters);
+
+    // Bufor wątku jest współdzielony przez kolejne przedziały - pusty wskaźnik oznacza brak programu.
+    const pxr::GfVec3f* programBaseColors = nullptr;
+    if (program)
+    {
+        std::vector<pxr::GfVec3f>& baseColorScratch = m_ShadingScratch.local().ProgramBaseColors;
+        baseColorScratch.assign(rayCount, baseColor);
+        ExecuteMaterialProgram(*program, rayIndices, rayCount, baseColorScratch.data());
+        programBaseColors = baseColorScratch.data();
+    }
+
+    MaterialSampleBatch batch;
+
+    for (uint batchStart = 0; batchStart < rayCount; batchStart += MaterialBatchWidth)
+    {
+        const uint batchCount = std::min<uint>(MaterialBatchWidth, rayCount - batchStart);
+
+        // Zbieramy wektory normalne oraz numery losowe paczki do układu SoA.
+        for (uint lane = 0; lane < batchCount; lane++)
+        {
+            uint32_t rayIndex = rayIndices[batchStart + lane];
+
+            // Obliczamy wektor normalny powierzchni.
+            pxr::GfVec3f hitWorldNormal = OnyxHelper::EvaluateHitSurfaceNormal(
+                m_RayPayloadBuffer.InstanceID[rayIndex],
+                m_RayPayloadBuffer.InstancePrimID[rayIndex],
+                m_RayPayloadBuffer.PrimitiveID[rayIndex],
+                m_RayPayloadBuffer.GetHitUV(rayIndex),
+                m_RayPayloadBuffer.GetHitGeometricNormal(rayIndex),
+                *m_Data->Scene);
+
+            auto rand2D = GetSample2D(rayIndex, SampleDimension::BounceDirection(m_RayPayloadBuffer.Bounce[rayIndex]));
+
+            const pxr::GfVec3f& hitBaseColor = programBaseColors
+                ? programBaseColors[batchStart + lane]
+                : baseColor;
+
+            batch.NormalX[lane] = hitWorldNormal[0];
+            batch.NormalY[lane] = hitWorldNormal[1];
+            batch.NormalZ[lane] = hitWorldNormal[2];
+            batch.RandomU[lane] = rand2D[0];
+            batch.RandomV[lane] = rand2D[1];
+            batch.BaseColorR[lane] = hitBaseColor[0];
+            batch.BaseColorG[lane] = hitBaseColor[1];
+            batch.BaseColorB[lane] = hitBaseColor[2];
+        }
+
+        // Niepełna paczka (koniec przedziału) - jądro przetwarza pełną paczkę, wypełniamy ją poprawnymi danymi.
+        for (uint lane = batchCount; lane < MaterialBatchWidth; lane++)
+        {
+            batch.NormalX[lane] = 0.0f;
+            batch.NormalY[lane] = 0.0f;
+            batch.NormalZ[lane] = 1.0f;
+            batch.RandomU[lane] = 0.5f;
+            batch.RandomV[lane] = 0.5f;
+            batch.BaseColorR[lane] = 0.0f;
+            batch.BaseColorG[lane] = 0.0f;
+            batch.BaseColorB[lane] = 0.0f;
+        }
+
+        // Generujemy odbicia całej paczki jednym wywołaniem wektoryzowanego jądra materiału.
+        Kernel::SampleBatch(parameters, batch);
+
+        for (uint lane = 0; lane < batchCount; lane++)
+        {
+            uint32_t rayIndex = rayIndices[batchStart + lane];
+
+            bool castShadowRay = false;
+            if (ShadeSurfaceHit<Kind>(rayIndex, parameters, batch, lane, castShadowRay))
+            {
+                if (castShadowRay) tileShadowQueue[shadowRayCount++] = rayIndex;
+
+                // Odbicie oznacza kolejną iterację - promień pozostaje w kolejce.
+                tileRayQueue[survivorCount++] = rayIndex;
+                continue;
+            }
+
+            // Kierunek odbicia nie niesie energii - kończymy ścieżkę, zregenerowany slot pozostaje w kolejce.
+            if (FinishPathSample(rayIndex)) tileRayQueue[survivorCount++] = rayIndex;
+        }
+    }
+}
+
+
+void OnyxPathtracingIntegrator::ExecuteMaterialProgram(
+    const MaterialProgram& program, const uint32_t* rayIndices, uint rayCount, pxr::GfVec3f* baseColors)
+{
+    // Bufory wątku zachowują pojemność pomiędzy przedziałami - brak alokacji na przedział materiału.
+    ShadingScratch& shadingScratch = m_ShadingScratch.local();
+
+    // Rejestry programu w układzie SoA - rejestr r uderzenia i znajduje się pod indeksem r * rayCount + i.
+    std::vector<pxr::GfVec3f>& registers = shadingScratch.ProgramRegisters;
+    registers.assign(size_t(program.RegisterCount) * rayCount, pxr::GfVec3f(0.0f));
+    auto getRegister = [&registers, rayCount](uint8_t registerIndex)
+    {
+        return registers.data() + size_t(registerIndex) * rayCount;
+    };
+
+    std::vector<TextureLookup>& lookups = shadingScratch.TextureLookups;
+
+    for (const MaterialInstruction& instruction : program.Instructions)
+    {
+        pxr::GfVec3f* target = getRegister(instruction.Target);
+
+        switch (instruction.Opcode)
+        {
+            case MaterialOpcode::LoadConstant:
+            {
+                std::fill_n(target, rayCount, program.Constants[instruction.Operand]);
+                break;
+            }
+            case MaterialOpcode::LoadTextureCoordinate:
+            {
+                for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+                {
+                    uint32_t rayIndex = rayIndices[queueIndex];
+
+                    // Uderzenia w geometrię bez współrzędnych tekstur odczytują punkt (0, 0).
+                    target[queueIndex] = pxr::GfVec3f(0.0f);
+
+                    HitTextureCoordinate hitTextureCoordinate;
+                    bool hasTextureCoordinate = OnyxHelper::EvaluateHitTextureCoordinate(
+                        m_RayPayloadBuffer.InstanceID[rayIndex],
+                        m_RayPayloadBuffer.InstancePrimID[rayIndex],
+                        m_RayPayloadBuffer.PrimitiveID[rayIndex],
+                        m_RayPayloadBuffer.GetHitUV(rayIndex),
+                        *m_Data->Scene,
+                        hitTextureCoordinate);
+
+                    if (!hasTextureCoordinate) continue;
+
+                    // Szerokość stożka promienia rośnie liniowo z odległością od początku segmentu ścieżki,
+                    // a jej rzut na powierzchnię wydłuża się odwrotnie proporcjonalnie do cosinusa kąta padania
+                    // (ograniczonego, aby promienie styczne nie wybierały najmniejszego poziomu MIP).
+                    float coneWidth = m_PixelSpreadAngle * m_RayPayloadBuffer.TFar[rayIndex];
+                    float incidenceCosine = std::abs(pxr::GfDot(
+                        hitTextureCoordinate.WorldNormal, m_RayPayloadBuffer.GetDirection(rayIndex)));
+
+                    target[queueIndex] = pxr::GfVec3f(
+                        hitTextureCoordinate.UV[0],
+                        hitTextureCoordinate.UV[1],
+                        hitTextureCoordinate.UVPerWorldUnit * coneWidth / std::max(incidenceCosine, 0.1f));
+                }
+                break;
+            }
+            case MaterialOpcode::TransformTextureCoordinate:
+            {
+                const pxr::GfVec3f& rowU = program.Constants[instruction.Operand];
+                const pxr::GfVec3f& rowV = program.Constants[instruction.Operand + 1];
+
+                // Ślad skaluje się pierwiastkiem wyznacznika części liniowej przekształcenia.
+                float footprintScale = std::sqrt(std::abs(rowU[0] * rowV[1] - rowU[1] * rowV[0]));
+
+                const pxr::GfVec3f* source = getRegister(instruction.Source);
+                for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+                {
+                    const pxr::GfVec3f coordinate = source[queueIndex];
+
+                    target[queueIndex] = pxr::GfVec3f(
+                        rowU[0] * coordinate[0] + rowU[1] * coordinate[1] + rowU[2],
+                        rowV[0] * coordinate[0] + rowV[1] * coordinate[1] + rowV[2],
+                        coordinate[2] * footprintScale);
+                }
+                break;
+            }
+            case MaterialOpcode::SampleTexture:
+            {
+                const pxr::GfVec3f* source = getRegister(instruction.Source);
+
+                lookups.resize(rayCount);
+                for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+                {
+                    lookups[queueIndex] = TextureLookup{
+                        .U = source[queueIndex][0],
+                        .V = source[queueIndex][1],
+                        .Footprint = source[queueIndex][2]
+                    };
+                }
+
+                // Jedno zapytanie do pamięci podręcznej tekstur dla całego przedziału materiału.
+                m_Data->Textures->SampleBatch(program.Textures[instruction.Operand], lookups.data(), rayCount, target);
+
+                if (instruction.Channel == MaterialChannel::RGB) break;
+
+                for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+                {
+                    float channelValue = instruction.Channel == MaterialChannel::A
+                        ? 1.0f
+                        : target[queueIndex][uint(instruction.Channel) - uint(MaterialChannel::R)];
+                    target[queueIndex] = pxr::GfVec3f(channelValue);
+                }
+                break;
+            }
+            case MaterialOpcode::StoreOutput:
+            {
+                const pxr::GfVec3f* source = getRegister(instruction.Source);
+
+                if (MaterialProgramOutput(instruction.Target) == MaterialProgramOutput::BaseColor)
+                {
+                    std::copy_n(source, rayCount, baseColors);
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+template<MaterialKind Kind>
+bool OnyxPathtracingIntegrator::ShadeSurfaceHit(
+    uint32_t rayIndex, const typename MaterialKernel<Kind>::Parameters& parameters,
+    const MaterialSampleBatch& batch, uint lane, bool& castShadowRay)
+{
+    // Odbicie na powierzchni materiału zostało wygenerowane przez paczkowe jądro materiału.
+    // Próbka została przeniesiona do world-space w orientacji zgodnej z wektorem normalnym powierzchni.
+    const pxr::GfVec3f hitWorldNormal(batch.NormalX[lane], batch.NormalY[lane], batch.NormalZ[lane]);
+    const pxr::GfVec3f materialSampleDir(batch.DirectionX[lane], batch.DirectionY[lane], batch.DirectionZ[lane]);
+    const pxr::GfVec3f baseColor(batch.BaseColorR[lane], batch.BaseColorG[lane], batch.BaseColorB[lane]);
+
+    float materialPdf = batch.Pdf[lane];
+    float materialCosine = pxr::GfDot(hitWorldNormal, materialSampleDir);
+
+    // Kierunek o zerowym prawdopodobieństwie (lub pod powierzchnią) nie niesie energii.
+    if (materialPdf <= 0.0f || materialCosine <= 0.0f) return false;
+
+    // Obliczamy pozycję intersekcji w świecie.
+    // Pozycja = kierunek * czas + początek
+    auto hitPosition = m_RayPayloadBuffer.GetHitPosition(rayIndex);
+
+    // Generujemy promień odbicia który zaczyna się w punkcie ostatniej intersekcji z geometrią
+    // o kierunku odbicia który został wygenerowany na podstawie funkcji BXDF materiału.
+    // Dokonujemy śledzenia ścieżki do momentu zakończenia tego procesu przez trafienie w światło.
+    auto bounceRay = OnyxHelper::GenerateBounceRay(materialSampleDir, hitPosition, hitWorldNormal);
+
+    // Podmieniamy promień dla następnej iteracji.
+    m_RayPayloadBuffer.SetRay(rayIndex, bounceRay.ray);
+
+    // Bezpośrednie próbkowanie światła wykonujemy jedynie wtedy, gdy promień odbicia również
+    // może trafić w światło (limit odbić) - w przeciwnym razie wagi MIS nie sumowałyby się do jedności.
+    // Promień cienia zaczyna się w punkcie początkowym promienia odbicia (z przesunięciem od powierzchni).
+    castShadowRay = m_RayPayloadBuffer.Bounce[rayIndex] < m_BounceLimit
+        && !m_Data->LightBuffer->empty()
+        && SampleDirectLight<Kind>(rayIndex, parameters, baseColor, hitWorldNormal);
+
+    // Skalujemy siłę naszego promienia przez funkcję BXDF materiału.
+    // Funkcja BXDF określa stosunek mocy wejściowej do mocy wyjściowej na podstawie charakterystyki materiału,
+    // iloraz BXDF * cos / PDF (waga próbki z jądra) jest estymatorem Monte Carlo dla kierunku materiału.
+    m_RayPayloadBuffer.SetThroughput(rayIndex, pxr::GfCompMult(
+        pxr::GfVec3f(batch.WeightR[lane], batch.WeightG[lane], batch.WeightB[lane]),
+        m_RayPayloadBuffer.GetThroughput(rayIndex)
+    ));
+    m_RayPayloadBuffer.BsdfPdf[rayIndex] = materialPdf;
+    m_RayPayloadBuffer.Bounce[rayIndex] += 1;
+
+    return true;
+}
+
+
+template<MaterialKind Kind>
+bool OnyxPathtracingIntegrator::SampleDirectLight(
+    uint32_t rayIndex, const typename MaterialKernel<Kind>::Parameters& parameters,
+    const pxr::GfVec3f& baseColor, const pxr::GfVec3f& N)
+{
+    using Kernel = MaterialKernel<Kind>;
+
+    auto& lightBuffer = *m_Data->LightBuffer;
+    uint8_t bounce = m_RayPayloadBuffer.Bounce[rayIndex];
+
+    // Wybieramy jedno ze świateł z jednorodnym prawdopodobieństwem.
+    float lightSelection = GetSample2D(rayIndex, SampleDimension::LightSelection(bounce))[0];
+    size_t lightIndex = std::min(size_t(lightSelection * float(lightBuffer.size())), lightBuffer.size() - 1);
+    const LightData& light = lightBuffer[lightIndex];
+
+    // Punkt na powierzchni światła z rozkładem jednorodnym względem pola powierzchni.
+    pxr::GfVec3f shadingPosition = m_RayPayloadBuffer.GetOrigin(rayIndex);
+    pxr::GfVec3f lightPosition = light.SamplePosition(GetSample2D(rayIndex, SampleDimension::LightPosition(bounce)));
+
+    pxr::GfVec3f toLight = lightPosition - shadingPosition;
+    float distance = toLight.GetLength();
+    if (distance <= 0.0f) return false;
+
+    pxr::GfVec3f lightDirection = toLight / distance;
+
+    // Światło poniżej powierzchni nie oświetla punktu.
+    float surfaceCosine = pxr::GfDot(N, lightDirection);
+    if (surfaceCosine <= 0.0f) return false;
+
+    float lightPdf = GetLightSamplePdf(light, lightDirection, distance);
+    if (lightPdf <= 0.0f) return false;
+
+    pxr::GfVec3f bsdfValue = Kernel::Evaluate(parameters, baseColor, N, lightDirection);
+    float misWeight = powerHeuristic(lightPdf, Kernel::PDF(parameters, N, lightDirection));
+
+    // Wkład próbki światła względem aktualnej mocy ścieżki (przed odbiciem).
+    pxr::GfVec3f lightContribution = pxr::GfCompMult(
+        pxr::GfCompMult(m_RayPayloadBuffer.GetThroughput(rayIndex), bsdfValue), light.Emission)
+        * (surfaceCosine * misWeight / lightPdf);
+
+    if (lightContribution == pxr::GfVec3f(0.0f)) return false;
+
+    // Skracamy test przesłonięcia, aby sama powierzchnia światła nie przesłaniała próbki.
+    m_RayPayloadBuffer.SetShadowRay(rayIndex, lightDirection, distance * (1.0f - 1e-3f), lightContribution);
     return true;
 }
 
+
+float OnyxPathtracingIntegrator::GetLightSamplePdf(
+    const LightData& light, const pxr::GfVec3f& direction, float distance) const
+{
+    // Światła czworokątne emitują w obu kierunkach (geometria nie jest jednostronna),
+    // dlatego bierzemy pod uwagę wartość bezwzględną cosinusa.
+    float lightCosine = std::abs(pxr::GfDot(light.Normal, direction));
+
+    return light.GetSolidAnglePdf(distance, lightCosine) / float(m_Data->LightBuffer->size());
+}
+
+
+void OnyxPathtracingIntegrator::TraceShadowRays(const uint32_t* rayIndices, uint rayCount)
+{
+    switch (m_RenderSettings.PacketWidth)
+    {
+        case 4:  OccludedRaysPacketed<4>(rayIndices, rayCount); break;
+        case 8:  OccludedRaysPacketed<8>(rayIndices, rayCount); break;
+        case 16: OccludedRaysPacketed<16>(rayIndices, rayCount); break;
+        default:
+        {
+            // Tryb skalarny - każdy promień cienia testujemy osobno.
+            for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+            {
+                uint32_t rayIndex = rayIndices[queueIndex];
+
+                RTCRay shadowRay = m_RayPayloadBuffer.GetShadowRay(rayIndex);
+                rtcOccluded1(*m_Data->Scene, &shadowRay, nullptr);
+                m_RayPayloadBuffer.ShadowTFar[rayIndex] = shadowRay.tfar;
+            }
+            break;
+        }
+    }
+
+    // Przesłonięty promień otrzymuje od Embree ujemną odległość (-inf).
+    for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+    {
+        uint32_t rayIndex = rayIndices[queueIndex];
+        if (m_RayPayloadBuffer.ShadowTFar[rayIndex] < 0.0f) continue;
+
+        m_RayPayloadBuffer.SetRadiance(rayIndex,
+            m_RayPayloadBuffer.GetRadiance(rayIndex) + m_RayPayloadBuffer.GetShadowRadiance(rayIndex));
+    }
+}
+
+
+template<int PacketWidth>
+void OnyxPathtracingIntegrator::OccludedRaysPacketed(const uint32_t* rayIndices, uint rayCount)
+{
+    using Traits = RayPacketTraits<PacketWidth>;
+
+    typename Traits::RayPacket shadowPacket;
+    int validMask[PacketWidth];
+
+    for (uint packetStart = 0; packetStart < rayCount; packetStart += PacketWidth)
+    {
+        int packetSize = int(std::min<uint>(PacketWidth, rayCount - packetStart));
+
+        for (int lane = 0; lane < packetSize; lane++)
+        {
+            StoreShadowRayInPacket(shadowPacket, lane, m_RayPayloadBuffer, rayIndices[packetStart + lane]);
+        }
+
+        for (int lane = 0; lane < PacketWidth; lane++) validMask[lane] = lane < packetSize ? -1 : 0;
+
+        Traits::Occluded(validMask, *m_Data->Scene, &shadowPacket);
+
+        for (int lane = 0; lane < packetSize; lane++)
+        {
+            m_RayPayloadBuffer.ShadowTFar[rayIndices[packetStart + lane]] = shadowPacket.tfar[lane];
+        }
+    }
+}
+
+
+void OnyxPathtracingIntegrator::IntersectRays(const uint32_t* rayIndices, uint rayCount)
+{
+    switch (m_RenderSettings.PacketWidth)
+    {
+        case 4:  return IntersectRaysPacketed<4>(rayIndices, rayCount);
+        case 8:  return IntersectRaysPacketed<8>(rayIndices, rayCount);
+        case 16: return IntersectRaysPacketed<16>(rayIndices, rayCount);
+        default: break;
+    }
+
+    // Tryb skalarny - każdy aktywny promień testujemy osobno.
+    for (uint queueIndex = 0; queueIndex < rayCount; queueIndex++)
+    {
+        uint32_t rayIndex = rayIndices[queueIndex];
+
+        // Dokonujemy testu intersekcji promienia ze sceną.
+        RTCRayHit rayHit = m_RayPayloadBuffer.GetRayHit(rayIndex);
+        rtcIntersect1(*m_Data->Scene, &rayHit, nullptr);
+        m_RayPayloadBuffer.SetHit(rayIndex, rayHit);
+    }
+}
+
+
+template<int PacketWidth>
+void OnyxPathtracingIntegrator::IntersectRaysPacketed(const uint32_t* rayIndices, uint rayCount)
+{
+    using Traits = RayPacketTraits<PacketWidth>;
+
+    typename Traits::RayHitPacket rayPacket;
+    int validMask[PacketWidth];
+
+    // Kolejka zawiera wyłącznie aktywne promienie, więc pakiety są wypełniane ciągle
+    // (jedynie ostatni pakiet segmentu może być niepełny).
+    for (uint packetStart = 0; packetStart < rayCount; packetStart += PacketWidth)
+    {
+        int packetSize = int(std::min<uint>(PacketWidth, rayCount - packetStart));
+
+        for (int lane = 0; lane < packetSize; lane++)
+        {
+            StoreRayInPacket(rayPacket, lane, m_RayPayloadBuffer, rayIndices[packetStart + lane]);
+        }
+
+        // Nieużywane tory pakietu są wyłączone z testu za pomocą maski.
+        for (int lane = 0; lane < PacketWidth; lane++) validMask[lane] = lane < packetSize ? -1 : 0;
+
+        Traits::Intersect(validMask, *m_Data->Scene, &rayPacket);
+
+        for (int lane = 0; lane < packetSize; lane++)
+        {
+            LoadHitFromPacket(rayPacket, lane, m_RayPayloadBuffer, rayIndices[packetStart + lane]);
+        }
+    }
+}
+
+
+void OnyxPathtracingIntegrator::CompactActiveRayQueue()
+{
+    // Suma prefiksowa (wyłączna) liczby ocalałych promieni kafelków wyznacza początek segmentu
+    // każdego kafelka w kompaktowanej kolejce. Liczniki kafelków zostały wyznaczone równolegle
+    // w trakcie iteracji odbicia, więc sekwencyjna suma obejmuje jedynie jedną wartość na kafelek.
+    std::exclusive_scan(
+        m_TileSurvivorCounts.begin(), m_TileSurvivorCounts.end(),
+        m_CompactedTileQueueOffsets.begin(), 0u);
+
+    m_ActiveRayCount = m_TileBuffer.empty()
+        ? 0
+        : m_CompactedTileQueueOffsets.back() + m_TileSurvivorCounts.back();
+
+    if (m_ActiveRayCount == 0) return;
+
+    // Przepisujemy segmenty ocalałych promieni równolegle do ciągłej kolejki.
+    ForEachTileParallel([this](size_t tileIndex)
+    {
+        std::copy_n(
+            m_ActiveRayQueue.begin() + m_TileQueueOffsets[tileIndex],
+            m_TileSurvivorCounts[tileIndex],
+            m_CompactedRayQueue.begin() + m_CompactedTileQueueOffsets[tileIndex]);
+    });
+
+    // Kompaktowana kolejka staje się kolejką aktywnych promieni następnej iteracji.
+    std::swap(m_ActiveRayQueue, m_CompactedRayQueue);
+    std::swap(m_TileQueueOffsets, m_CompactedTileQueueOffsets);
+    std::swap(m_TileQueueCounts, m_TileSurvivorCounts);
+}
+
+
+bool OnyxPathtracingIntegrator::IsRayBufferConverged()
+{
+    // Brak aktywnych promieni w kolejce oznacza zakończenie wszystkich ścieżek.
+    return m_ActiveRayCount == 0;
+}
+
@@ -1,10 +1,10 @@
 #include "OnyxRenderer.h"
 
+#include <algorithm>
 #include <iostream>
 #include <pxr/imaging/hd/renderThread.h>
 #include <pxr/imaging/hd/tokens.h>
 
-#include "DiffuseMaterial.h"
 #include "OnyxHelper.h"
 
 using namespace Onyx;
@@ -13,20 +13,17 @@ using namespace Onyx;
 OnyxRenderer::OnyxRenderer()
 {
     m_EmbreeDevice = rtcNewDevice(NULL);
-    m_EmbreeScene = rtcNewScene(m_EmbreeDevice);
 
-    m_MaterialDataBuffer.emplace_back(
-        PathMaterialPair{
-            pxr::SdfPath::EmptyPath(),
-            // Wymowny kolor materiału sygnalizujący brak powiązania geometria-materiał.
-            std::make_unique<DiffuseMaterial>(pxr::GfVec3f(1.0, 0.0, 0.85))
-        }
-    );
+    // Rejestrujemy funkcję zliczającą pamięć urządzenia Embree (BVH oraz bufory zarządzane przez Embree).
+    rtcSetDeviceMemoryMonitorFunction(m_EmbreeDevice, EmbreeMemoryMonitor, this);
+
+    m_EmbreeScene = rtcNewScene(m_EmbreeDevice);
 
     const DataPayload payload = {
         .Scene = &m_EmbreeScene,
         .LightBuffer = &m_LightDataBuffer,
-        .MaterialBuffer = &m_MaterialDataBuffer
+        .Materials = &m_MaterialRegistry,
+        .Textures = &m_TextureCache
     };
 
     m_Integrator = new OnyxPathtracingIntegrator(payload);
@@ -35,6 +32,23 @@ OnyxRenderer::OnyxRenderer()
 
 OnyxRenderer::~OnyxRenderer()
 {
+    // Integrator przechowuje wskaźniki do buforów silnika - zwalniamy go jako pierwszy.
+    if (m_Integrator.has_value()) delete m_Integrator.value();
+
+    // Kolejka przechowuje referencje geometrii oczekujących na podpięcie oraz zasoby odpinanych geometrii.
+    for (const SceneOperation& sceneOperation : m_PendingSceneOperations)
+    {
+        if (sceneOperation.Geometry) rtcReleaseGeometry(sceneOperation.Geometry);
+    }
+    m_PendingSceneOperations.clear();
+
+    for (const LightInstance& lightInstance : m_LightInstances)
+    {
+        if (lightInstance.Source) rtcReleaseGeometry(lightInstance.Source);
+    }
+
+    if (m_RectLightPrimitiveScene.has_value()) rtcReleaseScene(m_RectLightPrimitiveScene.value());
+
     rtcReleaseScene(m_EmbreeScene);
     rtcReleaseDevice(m_EmbreeDevice);
 }
@@ -43,122 +57,415 @@ OnyxRenderer::~OnyxRenderer()
 
 uint OnyxRenderer::AttachGeometryToScene(const RTCGeometry& geometrySource)
 {
-    auto meshID = rtcAttachGeometry(m_EmbreeScene, geometrySource);
-
-    if (meshID == RTC_INVALID_GEOMETRY_ID)
+    uint meshID;
     {
-        std::cout << "[Onyx] Związanie geometrii do sceny nie jest możliwe dla meshID: " << meshID << std::endl;
+        // Identyfikatory pochodzą z tej samej puli co identyfikatory zakolejkowanych geometrii.
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+        meshID = ReserveGeometryID();
     }
 
+    rtcAttachGeometryByID(m_EmbreeScene, geometrySource, meshID);
+    m_SceneDirty = true;
+
     return meshID;
 }
 
 
-uint OnyxRenderer::AttachLightInstanceToScene(
-    pxr::HdOnyxInstanceData* instanceData,
-    const pxr::GfVec3f& totalEmissionPower)
+uint OnyxRenderer::ReserveGeometryID()
+{
+    if (m_FreeGeometryIDs.empty()) return m_NextGeometryID++;
+
+    uint geometryID = m_FreeGeometryIDs.back();
+    m_FreeGeometryIDs.pop_back();
+
+    return geometryID;
+}
+
+
+uint OnyxRenderer::QueueAttachGeometry(const RTCGeometry& geometrySource)
+{
+    // Geometria musi przetrwać do wykonania operacji, nawet jeśli mesh zwolni ją wcześniej.
+    rtcRetainGeometry(geometrySource);
+
+    std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+
+    uint geometryID = ReserveGeometryID();
+    m_PendingSceneOperations.push_back(SceneOperation{geometrySource, geometryID, nullptr});
+
+    return geometryID;
+}
+
+
+void OnyxRenderer::QueueDetachGeometry(uint geometryID, std::shared_ptr<const void> retainedResources)
+{
+    std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+    m_PendingSceneOperations.push_back(SceneOperation{nullptr, geometryID, std::move(retainedResources)});
+}
+
+
+void OnyxRenderer::QueueSceneUpdate(std::function<void()> sceneUpdate)
+{
+    std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+    m_PendingSceneOperations.push_back(SceneOperation{nullptr, 0, nullptr, std::move(sceneUpdate)});
+}
+
+
+bool OnyxRenderer::HasPendingSceneOperations() const
+{
+    std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+    return !m_PendingSceneOperations.empty();
+}
+
+
+size_t OnyxRenderer::ApplyPendingSceneOperations()
 {
-    if(!m_RectLightPrimitiveScene.has_value())
+    std::vector<SceneOperation> sceneOperations;
     {
-        PrepareRectLightGeometrySource();
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+        sceneOperations.swap(m_PendingSceneOperations);
     }
 
-    // Tworzymy nową geometrię typu - instance
-    // Korzystamy w ten sposób z możliwości utworzenia wirtualnej kopii bazowej geometrii
-    // z własnym przekształceniem, zamiast modyfikacji bazowej geometrii transformacją.
-    RTCGeometry rectInstanceGeometrySource = rtcNewGeometry(m_EmbreeDevice, RTC_GEOMETRY_TYPE_INSTANCE);
-
-    // Ustawiamy źródło instancji - bazowy obiekt geometrii
-    rtcSetGeometryInstancedScene(rectInstanceGeometrySource, m_RectLightPrimitiveScene.value());
-    rtcSetGeometryTimeStepCount(rectInstanceGeometrySource, 1);
-
-    // Wywołanie funkcji SetGeometryTransform jest możliwe tylko i wyłącznie na
-    // instancjach. Korzystająć z prymitywnego typu geometrii - triangle w Embree
-    // możemy osiągnąć poprawną transformację, transformując wierzchołki (punkty) geometrii.
-    // Jednak, lepszym rozwiązaniem jest wykorzystanie instancingu.
-    rtcSetGeometryTransform(
-        rectInstanceGeometrySource,
-        0,
-        RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
-        instanceData->TransformMatrix.GetArray()
-    );
+    if (sceneOperations.empty()) return 0;
 
-    // Powiązujemy małą strukturę z instancją. Podczas testu intersekcji,
-    // możemy otrzymać poniższy wskaźnik do struktury powiązany z instancją.
-    rtcSetGeometryUserData(rectInstanceGeometrySource, instanceData);
+    std::vector<uint> releasedGeometryIDs;
 
-    // Finalnie wnioskujemy o utworzenie geometrii.
-    rtcCommitGeometry(rectInstanceGeometrySource);
+    // Kolejność operacji jest zachowana - geometria podpięta i odpięta w tej samej partii nie pozostaje w scenie.
+    for (const SceneOperation& sceneOperation : sceneOperations)
+    {
+        if (sceneOperation.SceneUpdate)
+        {
+            sceneOperation.SceneUpdate();
+        }
+        else if (sceneOperation.Geometry)
+        {
+            rtcAttachGeometryByID(m_EmbreeScene, sceneOperation.Geometry, sceneOperation.GeometryID);
 
-    // Doczepiamy instancję światła do sceny silnika.
-    // Do rozróżniania obiektów światła służy nam struktura pomocnicza instancji.
-    AttachGeometryToScene(rectInstanceGeometrySource);
+            // Scena przechowuje własną referencję geometrii.
+            rtcReleaseGeometry(sceneOperation.Geometry);
+        }
+        else
+        {
+            rtcDetachGeometry(m_EmbreeScene, sceneOperation.GeometryID);
+            releasedGeometryIDs.push_back(sceneOperation.GeometryID);
+        }
+    }
 
-    m_LightDataBuffer.emplace_back(totalEmissionPower);
+    {
+        // Identyfikatory odpiętych geometrii mogą zostać użyte dopiero po wykonaniu odpięcia.
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+        m_FreeGeometryIDs.insert(m_FreeGeometryIDs.end(), releasedGeometryIDs.begin(), releasedGeometryIDs.end());
+    }
 
+    // Jedno zatwierdzenie sceny dla całej partii.
+    m_SceneDirty = true;
     m_ResetIntegratorState = true;
 
-    // Zwracamy indeks pod jakim przechowujemy dane światła.
-    return m_LightDataBuffer.size() - 1;
+    // Zasoby odpiętych geometrii (user data, bufory transformacji, BLAS) nie są już osiągalne ze sceny -
+    // zwalniamy je przed wznowieniem wątku renderującego, który najpierw zatwierdzi scenę.
+    size_t appliedOperationCount = sceneOperations.size();
+    sceneOperations.clear();
+
+    return appliedOperationCount;
 }
 
 
-void OnyxRenderer::AttachOrUpdateMaterial(
-    const pxr::GfVec3f& diffuseColor,
-    const float& IOR,
-    const pxr::SdfPath& materialPath,
-    bool newMaterial)
+uint OnyxRenderer::AttachLightInstanceToScene(const pxr::GfMatrix4f& transform, const pxr::GfVec3f& totalEmissionPower)
 {
-    if (!newMaterial)
+    uint lightIndex;
     {
-        // Szukamy materiału do edycji, materiał powinien już istnieć.
-        for (auto& material : m_MaterialDataBuffer)
+        // Ponownie używamy miejsca po usuniętym świetle, dzięki czemu bufor świateł nie rośnie
+        // podczas długich sesji w których światła są tworzone i usuwane.
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+
+        if (!m_FreeLightSlots.empty())
         {
-            if (material.first != materialPath) continue;
+            lightIndex = m_FreeLightSlots.back();
+            m_FreeLightSlots.pop_back();
+        }
+        else
+        {
+            lightIndex = m_LightSlotCount++;
+        }
+    }
 
-            material.second.reset();
+    // Integrator odczytuje bufor świateł przy każdym trafieniu (NEE) - zmiana rozmiaru bufora mogłaby
+    // przenieść go w trakcie odczytu. Instancja jest tworzona po zatrzymaniu wątku renderującego.
+    QueueSceneUpdate([this, lightIndex, transform, totalEmissionPower]()
+    {
+        if(!m_RectLightPrimitiveScene.has_value())
+        {
+            PrepareRectLightGeometrySource();
+        }
 
-            material.second = IOR > 1.0
-            ? std::make_unique<DiffuseMaterial>(DiffuseMaterial(diffuseColor))
-            : std::make_unique<DiffuseMaterial>(DiffuseMaterial(diffuseColor));
+        if (lightIndex >= m_LightInstances.size())
+        {
+            m_LightInstances.resize(lightIndex + 1);
+            m_LightDataBuffer.resize(lightIndex + 1);
         }
+
+        LightInstance& lightInstance = m_LightInstances[lightIndex];
+
+        // Ustawiamy flagę Light w celu rozróżnienia instancji geometrii i świateł
+        // które są zdefiniowanej w tej samej globalnej scenie silnika.
+        lightInstance.InstanceData = std::make_unique<pxr::HdOnyxInstanceData>(pxr::HdOnyxInstanceData{
+            .TransformMatrix = transform,
+            .Geometry = nullptr,
+            .DataIndexInBuffer = lightIndex,
+            .Light = true
+        });
+
+        // Tworzymy nową geometrię typu - instance
+        // Korzystamy w ten sposób z możliwości utworzenia wirtualnej kopii bazowej geometrii
+        // z własnym przekształceniem, zamiast modyfikacji bazowej geometrii transformacją.
+        RTCGeometry rectInstanceGeometrySource = rtcNewGeometry(m_EmbreeDevice, RTC_GEOMETRY_TYPE_INSTANCE);
+
+        // Ustawiamy źródło instancji - bazowy obiekt geometrii
+        rtcSetGeometryInstancedScene(rectInstanceGeometrySource, m_RectLightPrimitiveScene.value());
+        rtcSetGeometryTimeStepCount(rectInstanceGeometrySource, 1);
+
+        // Wywołanie funkcji SetGeometryTransform jest możliwe tylko i wyłącznie na
+        // instancjach. Korzystająć z prymitywnego typu geometrii - triangle w Embree
+        // możemy osiągnąć poprawną transformację, transformując wierzchołki (punkty) geometrii.
+        // Jednak, lepszym rozwiązaniem jest wykorzystanie instancingu.
+        rtcSetGeometryTransform(
+            rectInstanceGeometrySource,
+            0,
+            RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+            lightInstance.InstanceData->TransformMatrix.GetArray()
+        );
+
+        // Powiązujemy małą strukturę z instancją. Podczas testu intersekcji,
+        // możemy otrzymać poniższy wskaźnik do struktury powiązany z instancją.
+        rtcSetGeometryUserData(rectInstanceGeometrySource, lightInstance.InstanceData.get());
+
+        // Finalnie wnioskujemy o utworzenie geometrii.
+        rtcCommitGeometry(rectInstanceGeometrySource);
+
+        // Doczepiamy instancję światła do sceny silnika.
+        // Do rozróżniania obiektów światła służy nam struktura pomocnicza instancji.
+        lightInstance.Source = rectInstanceGeometrySource;
+        lightInstance.GeometryID = AttachGeometryToScene(rectInstanceGeometrySource);
+
+        // Kształt światła w world-space pozwala integratorowi na próbkowanie punktów na jego powierzchni.
+        m_LightDataBuffer[lightIndex] = LightData::CreateRectLight(transform, totalEmissionPower);
+    });
+
+    // Zwracamy indeks pod jakim przechowujemy dane światła.
+    return lightIndex;
+}
+
+
+void OnyxRenderer::DetachLightInstance(uint lightIndex)
+{
+    QueueSceneUpdate([this, lightIndex]()
+    {
+        if (lightIndex >= m_LightInstances.size() || !m_LightInstances[lightIndex].Source) return;
+
+        LightInstance& lightInstance = m_LightInstances[lightIndex];
+
+        // Geometria oraz struktura pomocnicza są zwalniane dopiero po odpięciu od sceny.
+        DetachGeometryFromScene(lightInstance.GeometryID);
+        rtcReleaseGeometry(lightInstance.Source);
+
+        lightInstance = LightInstance{};
+
+        // Pusty wpis (zerowe pole powierzchni i emisja) nie wnosi wkładu podczas próbkowania świateł,
+        // a indeksy pozostałych świateł nie ulegają zmianie.
+        m_LightDataBuffer[lightIndex] = LightData{};
+
+        // Miejsce może zostać ponownie użyte dopiero po wykonaniu odpięcia.
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+        m_FreeLightSlots.push_back(lightIndex);
+    });
+}
+
+
+size_t OnyxRenderer::GetLightSlotCount() const
+{
+    std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+    return m_LightSlotCount;
+}
+
+
+void OnyxRenderer::UpdateLightInstance(
+    uint lightIndex,
+    const pxr::GfMatrix4f& transform,
+    const pxr::GfVec3f& totalEmissionPower)
+{
+    // Integrator odczytuje bufor świateł (NEE) oraz strukturę pomocniczą instancji przy każdym trafieniu -
+    // modyfikacja następuje po zatrzymaniu wątku renderującego.
+    QueueSceneUpdate([this, lightIndex, transform, totalEmissionPower]()
+    {
+        if (lightIndex >= m_LightInstances.size() || !m_LightInstances[lightIndex].Source) return;
+
+        LightInstance& lightInstance = m_LightInstances[lightIndex];
+        lightInstance.InstanceData->TransformMatrix = transform;
+
+        UpdateInstanceTransform(lightInstance.Source, transform);
+
+        // Kształt światła w world-space musi odpowiadać nowej transformacji instancji.
+        m_LightDataBuffer[lightIndex] = LightData::CreateRectLight(transform, totalEmissionPower);
+    });
+}
+
+
+void OnyxRenderer::UpdateInstanceTransform(const RTCGeometry& instanceSource, const pxr::GfMatrix4f& transform)
+{
+    rtcSetGeometryTransform(instanceSource, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, transform.GetArray());
+    rtcCommitGeometry(instanceSource);
+
+    // Geometria nie jest odpinana - wystarczy ponowne zatwierdzenie sceny (przebudowa TLAS).
+    m_SceneDirty = true;
+    m_ResetIntegratorState = true;
+}
+
+
+void OnyxRenderer::SetRenderSettings(const RenderSettings& renderSettings)
+{
+    m_RenderSettings = renderSettings;
+
+    m_TextureCache.SetBudget(size_t(m_RenderSettings.TextureCacheMB) * 1024 * 1024);
+
+    // Usunięcie limitu pamięci kończy tryb oszczędzania pamięci.
+    if (m_RenderSettings.MemoryBudgetMB == 0 && m_MemoryBudgetFallback)
+    {
+        m_MemoryBudgetFallback = false;
+        rtcSetSceneFlags(m_EmbreeScene, RTC_SCENE_FLAG_NONE);
+        m_SceneDirty = true;
     }
 
-    // Jeśli materiał do edycji nie został znaleziony lub wymaga stworzenia na nowo,
-    // dodajemy nowy obiekt do mapy.
-    m_MaterialDataBuffer.emplace_back(
-        IOR > 1.0
-        ? PathMaterialPair(materialPath, std::make_unique<DiffuseMaterial>(DiffuseMaterial(diffuseColor)))
-        : PathMaterialPair(materialPath, std::make_unique<DiffuseMaterial>(DiffuseMaterial(diffuseColor)))
-    );
+    ApplyRenderSettings();
+}
+
 
+void OnyxRenderer::ApplyRenderSettings()
+{
+    RenderSettings integratorSettings = m_RenderSettings;
+
+    // Tryb oszczędzania pamięci - moc ścieżek przechowywana w formacie half zmniejsza bufor promieni.
+    if (m_MemoryBudgetFallback) integratorSettings.HalfPrecisionThroughput = true;
+
+    m_Integrator.value()->SetRenderSettings(integratorSettings);
+
+    // Zmiana ustawień unieważnia dotychczasowy wynik integracji.
     m_ResetIntegratorState = true;
 }
 
 
+bool OnyxRenderer::EmbreeMemoryMonitor(void* userPtr, ssize_t bytes, bool post)
+{
+    auto* renderer = static_cast<OnyxRenderer*>(userPtr);
+
+    int64_t allocatedBytes = renderer->m_EmbreeMemoryBytes.fetch_add(bytes) + bytes;
+
+    // Aktualizujemy maksimum bez blokady - wiele wątków budujących BVH może alokować jednocześnie.
+    auto& peakMemoryBytes = renderer->m_EmbreePeakMemoryBytes;
+    int64_t peakBytes = peakMemoryBytes.load();
+    while (allocatedBytes > peakBytes && !peakMemoryBytes.compare_exchange_weak(peakBytes, allocatedBytes))
+    {
+    }
+
+    return true;
+}
+
+
+MemoryStatistics OnyxRenderer::GetMemoryStatistics(size_t geometryBufferBytes) const
+{
+    MemoryStatistics statistics;
+    statistics.EmbreeBytes = size_t(std::max<int64_t>(m_EmbreeMemoryBytes.load(), 0));
+    statistics.EmbreePeakBytes = size_t(std::max<int64_t>(m_EmbreePeakMemoryBytes.load(), 0));
+    statistics.RayPayloadBytes = m_Integrator.value()->GetRayPayloadMemoryFootprint();
+    statistics.AccumulationBytes = m_Integrator.value()->GetAccumulationMemoryFootprint();
+    statistics.GeometryBufferBytes = geometryBufferBytes;
+    statistics.TextureCacheBytes = m_TextureCache.GetResidentBytes();
+    statistics.BudgetBytes = size_t(m_RenderSettings.MemoryBudgetMB) * 1024 * 1024;
+    statistics.BudgetFallback = m_MemoryBudgetFallback;
+
+    return statistics;
+}
+
+
+bool OnyxRenderer::IsMemoryBudgetExceeded(size_t geometryBufferBytes) const
+{
+    MemoryStatistics statistics = GetMemoryStatistics(geometryBufferBytes);
+    return statistics.BudgetBytes > 0 && statistics.GetTotalBytes() > statistics.BudgetBytes;
+}
+
+
+bool OnyxRenderer::EnforceMemoryBudget(size_t geometryBufferBytes)
+{
+    if (m_MemoryBudgetFallback || !IsMemoryBudgetExceeded(geometryBufferBytes)) return false;
+
+    std::cout << "[Onyx] Przekroczono limit pamięci (" << m_RenderSettings.MemoryBudgetMB
+        << " MB) - włączono tryb oszczędzania pamięci." << std::endl;
+
+    m_MemoryBudgetFallback = true;
+
+    // Kompaktowy format BVH głównej sceny, przebudowa nastąpi przy kolejnym zatwierdzeniu sceny.
+    rtcSetSceneFlags(m_EmbreeScene, RTC_SCENE_FLAG_COMPACT);
+    m_SceneDirty = true;
+
+    ApplyRenderSettings();
+    return true;
+}
+
+
+MaterialHandle OnyxRenderer::AttachOrUpdateMaterial(
+    const MaterialParameters& parameters,
+    const pxr::SdfPath& materialPath)
+{
+    // Uchwyt jest rezerwowany natychmiast, natomiast tabela materiałów odczytywana przez integrator
+    // jest modyfikowana dopiero po zatrzymaniu wątku renderującego.
+    MaterialHandle materialHandle = m_MaterialRegistry.GetOrCreateHandle(materialPath);
+
+    QueueSceneUpdate([this, materialHandle, parameters]()
+    {
+        m_MaterialRegistry.SetMaterialParameters(materialHandle, parameters);
+    });
+
+    return materialHandle;
+}
+
+
+void OnyxRenderer::DetachMaterial(const pxr::SdfPath& materialPath)
+{
+    MaterialHandle materialHandle = m_MaterialRegistry.GetOrCreateHandle(materialPath);
+
+    // Program materiału (przechwycony w parametrach rekordu) jest zwalniany przy zatrzymanym wątku renderującym.
+    QueueSceneUpdate([this, materialHandle]()
+    {
+        m_MaterialRegistry.ReleaseMaterial(materialHandle);
+    });
+}
+
+
 void OnyxRenderer::DetachGeometryFromScene(uint geometryID)
 {
     // Odpinamy geometrię od sceny.
     rtcDetachGeometry(m_EmbreeScene, geometryID);
+    m_SceneDirty = true;
+
+    {
+        std::lock_guard<std::mutex> sceneOperationLock(m_SceneOperationLock);
+        m_FreeGeometryIDs.push_back(geometryID);
+    }
 
     m_ResetIntegratorState = true;
 }
 
 
-uint OnyxRenderer::GetIndexOfMaterialByPath(const pxr::SdfPath& materialPath) const
+uint OnyxRenderer::GetIndexOfMaterialByPath(const pxr::SdfPath& materialPath)
 {
-    // Iterujemy przez dostępne materiały szukając materiału którego ścieżka odpowiada
-    // ścieżce powiązania (binding) materiału. Funkcja jest wywoływana z poziomu synchronizacji geometrii.
-    for (int index = 0; index < m_MaterialDataBuffer.size(); index++)
-    {
-        if(m_MaterialDataBuffer[index].first != materialPath) continue;
+    // Funkcja jest wywoływana z poziomu (równoległej) synchronizacji geometrii.
+    // W przypadku braku prawidłowego powiązania (pusta ścieżka) rejestr zwraca uchwyt domyślnego materiału.
+    bool newHandle = false;
+    MaterialHandle materialHandle = m_MaterialRegistry.GetOrCreateHandle(materialPath, &newHandle);
 
-        return index;
-    }
+    // Rekord nowego uchwytu jest przydzielany przed podpięciem geometrii, która z niego korzysta
+    // (operacje kolejki są wykonywane w kolejności zgłoszenia).
+    if (newHandle) QueueSceneUpdate([this]() { m_MaterialRegistry.CommitHandles(); });
 
-    // W przypadku braku prawidłowego powiązania używamy indeksu domyślnego materiału.
-    // Bufor przechowuje domyślny materiał na początku wektora.
-    return 0;
+    return materialHandle;
 }
 
 
@@ -203,6 +510,8 @@ void OnyxRenderer::PrepareRectLightGeometrySource()
     rtcCommitGeometry(localRectangleGeometry);
     // Powiązujemy geometrię ze sceną.
     rtcAttachGeometry(m_RectLightPrimitiveScene.value(), localRectangleGeometry);
+    // Scena przechowuje referencję do geometrii - zwalniamy lokalny uchwyt.
+    rtcReleaseGeometry(localRectangleGeometry);
 
     // Wnioskujemy o zbudowanie obiektu sceny (czworokąta który będzie instancjonowany).
     rtcCommitScene(m_RectLightPrimitiveScene.value());
@@ -235,9 +544,19 @@ void OnyxRenderer::MainRenderingEntrypoint(pxr::HdRenderThread* renderThread)
 bool OnyxRenderer::RenderAllAOV()
 {
     // Zatwierdzamy scenę w obecnej postaci przed wywołaniem testów intersekcji.
-    // Modyfikacje sceny nie są możliwe. Modyfikacja sceny przez obiekty HdOnyx* jest możliwa
-    // poprzez HdOnyxRenderParam. Obiekt ten wymusza StopRender na wątku renderowania.
-    rtcCommitScene(m_EmbreeScene);
+    // Modyfikacje sceny nie są możliwe. Obiekty HdOnyx* kolejkują modyfikacje sceny podczas synchronizacji,
+    // a Render Delegate wykonuje je w CommitResources po zatrzymaniu wątku renderowania.
+    // Niezmieniona scena nie wymaga ponownego zatwierdzenia - dla statycznej sceny pomijamy
+    // koszt przejścia przez wszystkie geometrie sceny przy każdej iteracji.
+    if (m_SceneDirty.exchange(false))
+    {
+        rtcCommitScene(m_EmbreeScene);
+        m_SceneCommitCount++;
+    }
+    else
+    {
+        m_SkippedSceneCommitCount++;
+    }
 
     if(m_ResetIntegratorState)
     {
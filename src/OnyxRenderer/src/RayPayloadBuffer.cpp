@@ -0,0 +1,180 @@
+#include "RayPayloadBuffer.h"
+
+#include <limits>
+
+using namespace Onyx;
+
+
+void RayPayloadBuffer::Resize(size_t rayCount, bool halfPrecisionThroughput)
+{
+    m_Size = rayCount;
+    m_HalfPrecisionThroughput = halfPrecisionThroughput;
+
+    for (auto* floatArray : {&OriginX, &OriginY, &OriginZ, &DirectionX, &DirectionY, &DirectionZ, &TFar,
+                             &HitU, &HitV, &NormalX, &NormalY, &NormalZ, &RadianceR, &RadianceG, &RadianceB, &BsdfPdf,
+                             &ShadowDirectionX, &ShadowDirectionY, &ShadowDirectionZ, &ShadowTFar,
+                             &ShadowRadianceR, &ShadowRadianceG, &ShadowRadianceB})
+    {
+        floatArray->Resize(rayCount);
+    }
+
+    InstanceID.Resize(rayCount);
+    InstancePrimID.Resize(rayCount);
+    PrimitiveID.Resize(rayCount);
+    Bounce.Resize(rayCount);
+    PendingSamples.Resize(rayCount);
+
+    // Alokujemy tablice mocy ścieżki jedynie w wybranym formacie.
+    // Nieużywany format zwalnia pamięć.
+    size_t floatThroughputSize = halfPrecisionThroughput ? 0 : rayCount;
+    size_t halfThroughputSize = halfPrecisionThroughput ? rayCount : 0;
+
+    m_ThroughputR.Resize(floatThroughputSize);
+    m_ThroughputG.Resize(floatThroughputSize);
+    m_ThroughputB.Resize(floatThroughputSize);
+
+    m_ThroughputHalfR.Resize(halfThroughputSize);
+    m_ThroughputHalfG.Resize(halfThroughputSize);
+    m_ThroughputHalfB.Resize(halfThroughputSize);
+}
+
+
+size_t RayPayloadBuffer::GetMemoryFootprint() const
+{
+    size_t footprint = 0;
+
+    for (auto* floatArray : {&OriginX, &OriginY, &OriginZ, &DirectionX, &DirectionY, &DirectionZ, &TFar,
+                             &HitU, &HitV, &NormalX, &NormalY, &NormalZ, &RadianceR, &RadianceG, &RadianceB, &BsdfPdf,
+                             &ShadowDirectionX, &ShadowDirectionY, &ShadowDirectionZ, &ShadowTFar,
+                             &ShadowRadianceR, &ShadowRadianceG, &ShadowRadianceB,
+                             &m_ThroughputR, &m_ThroughputG, &m_ThroughputB})
+    {
+        footprint += floatArray->ByteSize();
+    }
+
+    footprint += m_ThroughputHalfR.ByteSize() + m_ThroughputHalfG.ByteSize() + m_ThroughputHalfB.ByteSize();
+    footprint += InstanceID.ByteSize() + InstancePrimID.ByteSize() + PrimitiveID.ByteSize();
+    footprint += Bounce.ByteSize() + PendingSamples.ByteSize();
+
+    return footprint;
+}
+
+
+void RayPayloadBuffer::SetRay(size_t rayIndex, const RTCRay& ray)
+{
+    OriginX[rayIndex] = ray.org_x;
+    OriginY[rayIndex] = ray.org_y;
+    OriginZ[rayIndex] = ray.org_z;
+
+    DirectionX[rayIndex] = ray.dir_x;
+    DirectionY[rayIndex] = ray.dir_y;
+    DirectionZ[rayIndex] = ray.dir_z;
+
+    TFar[rayIndex] = ray.tfar;
+
+    // Nowy promień nie posiada jeszcze danych intersekcji.
+    InstanceID[rayIndex] = RTC_INVALID_GEOMETRY_ID;
+}
+
+
+RTCRayHit RayPayloadBuffer::GetRayHit(size_t rayIndex) const
+{
+    return {.ray = {.org_x = OriginX[rayIndex],
+                    .org_y = OriginY[rayIndex],
+                    .org_z = OriginZ[rayIndex],
+                    .dir_x = DirectionX[rayIndex],
+                    .dir_y = DirectionY[rayIndex],
+                    .dir_z = DirectionZ[rayIndex],
+                    // Pola stałe nie są przechowywane w buforze (zgodne z OnyxHelper).
+                    .tnear = 0.0,
+                    .tfar = TFar[rayIndex],
+                    .mask = UINT_MAX,
+                    .time = 0.0},
+            .hit = {.geomID = RTC_INVALID_GEOMETRY_ID}};
+}
+
+
+void RayPayloadBuffer::SetHit(size_t rayIndex, const RTCRayHit& rayHit)
+{
+    TFar[rayIndex] = rayHit.ray.tfar;
+
+    // Wszystkie obiekty w głównej scenie są instancjami. Brak trafienia w geometrię
+    // oznacza brak identyfikatora instancji.
+    InstanceID[rayIndex] = rayHit.hit.geomID == RTC_INVALID_GEOMETRY_ID
+        ? RTC_INVALID_GEOMETRY_ID
+        : rayHit.hit.instID[0];
+
+    // Indeks kopii w tablicy instancji (instancer). Dla pojedynczych instancji wynosi 0.
+#if defined(RTC_GEOMETRY_INSTANCE_ARRAY)
+    InstancePrimID[rayIndex] = rayHit.hit.instPrimID[0];
+#else
+    InstancePrimID[rayIndex] = 0;
+#endif
+
+    PrimitiveID[rayIndex] = rayHit.hit.primID;
+    HitU[rayIndex] = rayHit.hit.u;
+    HitV[rayIndex] = rayHit.hit.v;
+
+    NormalX[rayIndex] = rayHit.hit.Ng_x;
+    NormalY[rayIndex] = rayHit.hit.Ng_y;
+    NormalZ[rayIndex] = rayHit.hit.Ng_z;
+}
+
+
+void RayPayloadBuffer::SetShadowRay(
+    size_t rayIndex, const pxr::GfVec3f& direction, float distance, const pxr::GfVec3f& radiance)
+{
+    ShadowDirectionX[rayIndex] = direction[0];
+    ShadowDirectionY[rayIndex] = direction[1];
+    ShadowDirectionZ[rayIndex] = direction[2];
+    ShadowTFar[rayIndex] = distance;
+
+    ShadowRadianceR[rayIndex] = radiance[0];
+    ShadowRadianceG[rayIndex] = radiance[1];
+    ShadowRadianceB[rayIndex] = radiance[2];
+}
+
+
+RTCRay RayPayloadBuffer::GetShadowRay(size_t rayIndex) const
+{
+    return {.org_x = OriginX[rayIndex],
+            .org_y = OriginY[rayIndex],
+            .org_z = OriginZ[rayIndex],
+            .tnear = 0.0,
+            .dir_x = ShadowDirectionX[rayIndex],
+            .dir_y = ShadowDirectionY[rayIndex],
+            .dir_z = ShadowDirectionZ[rayIndex],
+            .time = 0.0,
+            .tfar = ShadowTFar[rayIndex],
+            .mask = UINT_MAX,
+            .flags = 0};
+}
+
+
+pxr::GfVec3f RayPayloadBuffer::GetThroughput(size_t rayIndex) const
+{
+    if (m_HalfPrecisionThroughput)
+    {
+        return {float(m_ThroughputHalfR[rayIndex]),
+                float(m_ThroughputHalfG[rayIndex]),
+                float(m_ThroughputHalfB[rayIndex])};
+    }
+
+    return {m_ThroughputR[rayIndex], m_ThroughputG[rayIndex], m_ThroughputB[rayIndex]};
+}
+
+
+void RayPayloadBuffer::SetThroughput(size_t rayIndex, const pxr::GfVec3f& throughput)
+{
+    if (m_HalfPrecisionThroughput)
+    {
+        m_ThroughputHalfR[rayIndex] = pxr::GfHalf(throughput[0]);
+        m_ThroughputHalfG[rayIndex] = pxr::GfHalf(throughput[1]);
+        m_ThroughputHalfB[rayIndex] = pxr::GfHalf(throughput[2]);
+        return;
+    }
+
+    m_ThroughputR[rayIndex] = throughput[0];
+    m_ThroughputG[rayIndex] = throughput[1];
+    m_ThroughputB[rayIndex] = throughput[2];
+}
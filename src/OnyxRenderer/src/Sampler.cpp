@@ -0,0 +1,226 @@
+#include "Sampler.h"
+
+#include <algorithm>
+
+using namespace Onyx;
+
+
+namespace
+{
+    /**
+     * Funkcja mieszająca PCG (Jarzynski, Olano - "Hash Functions for GPU Rendering").
+     * Bezstanowy odpowiednik generatora PCG - wynik zależy wyłącznie od wartości wejściowej.
+     */
+    uint32_t PcgHash(uint32_t value)
+    {
+        uint32_t state = value * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    uint32_t HashCombine(uint32_t seed, uint32_t value)
+    {
+        return PcgHash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+    }
+
+    // Funkcja mieszająca bity 64-bitowej wartości (finalizer MurmurHash3 / SplitMix).
+    uint64_t MixBits(uint64_t value)
+    {
+        value ^= (value >> 31);
+        value *= 0x7fb5d329728ea185ull;
+        value ^= (value >> 27);
+        value *= 0x81dadef4bc2dd44dull;
+        value ^= (value >> 33);
+        return value;
+    }
+
+    // Zamiana 32 bitów na liczbę z przedziału [0, 1). 24 bity mantysy gwarantują wynik mniejszy od 1.
+    float ToUnitFloat(uint32_t value)
+    {
+        return float(value >> 8) * 0x1p-24f;
+    }
+
+    uint32_t ReverseBits32(uint32_t value)
+    {
+        value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+        value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+        value = ((value >> 4) & 0x0f0f0f0fu) | ((value & 0x0f0f0f0fu) << 4);
+        value = ((value >> 8) & 0x00ff00ffu) | ((value & 0x00ff00ffu) << 8);
+        return (value >> 16) | (value << 16);
+    }
+
+    uint64_t ReverseBits64(uint64_t value)
+    {
+        return (uint64_t(ReverseBits32(uint32_t(value))) << 32) | ReverseBits32(uint32_t(value >> 32));
+    }
+
+    /**
+     * Permutacja Laine-Karras - odpowiednik mieszania Owen dla bitów w odwróconej kolejności
+     * (zmiana bitu wpływa jedynie na bity bardziej znaczące).
+     */
+    uint32_t LaineKarrasPermutation(uint32_t value, uint32_t seed)
+    {
+        value += seed;
+        value ^= value * 0x6c50b47cu;
+        value ^= value * 0xb82f1e52u;
+        value ^= value * 0xc7afe638u;
+        value ^= value * 0x8d22f6e6u;
+        return value;
+    }
+
+    /**
+     * Mieszanie Owen (Burley - "Practical Hash-based Owen Scrambling").
+     * Zachowuje stratyfikację sekwencji Sobol przy jednoczesnym usunięciu korelacji pomiędzy wymiarami.
+     */
+    uint32_t NestedUniformScramble(uint32_t value, uint32_t seed)
+    {
+        return ReverseBits32(LaineKarrasPermutation(ReverseBits32(value), seed));
+    }
+
+    // Pierwszy wymiar sekwencji Sobol (sekwencja van der Corput).
+    uint32_t SobolDimension0(uint64_t index)
+    {
+        return uint32_t(ReverseBits64(index) >> 32);
+    }
+
+    // Drugi wymiar sekwencji Sobol - macierz generująca odpowiada trójkątowi Pascala modulo 2.
+    uint32_t SobolDimension1(uint64_t index)
+    {
+        uint64_t result = 0;
+        for (uint64_t direction = uint64_t(1) << 63; index != 0; index >>= 1, direction ^= direction >> 1)
+        {
+            if (index & 1) result ^= direction;
+        }
+
+        return uint32_t(result >> 32);
+    }
+
+    // Rozsunięcie bitów wartości tak, aby pomiędzy nimi powstały puste bity (kod Mortona).
+    uint64_t LeftShift2(uint64_t value)
+    {
+        value &= 0xffffffffull;
+        value = (value ^ (value << 16)) & 0x0000ffff0000ffffull;
+        value = (value ^ (value << 8)) & 0x00ff00ff00ff00ffull;
+        value = (value ^ (value << 4)) & 0x0f0f0f0f0f0f0f0full;
+        value = (value ^ (value << 2)) & 0x3333333333333333ull;
+        value = (value ^ (value << 1)) & 0x5555555555555555ull;
+        return value;
+    }
+
+    uint64_t EncodeMorton2(uint32_t x, uint32_t y)
+    {
+        return (LeftShift2(y) << 1) | LeftShift2(x);
+    }
+
+    uint CeilLog2(uint value)
+    {
+        uint log2 = 0;
+        while ((1u << log2) < value) log2++;
+        return log2;
+    }
+}
+
+
+void Sampler::Configure(SamplerType samplerType, uint width, uint height, uint samplesPerPixel, uint32_t seed)
+{
+    m_Type = samplerType;
+    m_Width = std::max(width, 1u);
+    m_Seed = seed;
+
+    // Sekwencja Z-Sobol dzieli indeks na kod Mortona piksela oraz indeks próbki piksela.
+    // Kod Mortona obejmuje kwadrat o boku będącym potęgą dwójki.
+    m_Log2SamplesPerPixel = CeilLog2(std::max(samplesPerPixel, 1u));
+    uint log2Resolution = CeilLog2(std::max({width, height, 1u}));
+    m_Base4DigitCount = log2Resolution + (m_Log2SamplesPerPixel + 1) / 2;
+}
+
+
+pxr::GfVec2f Sampler::Get2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const
+{
+    switch (m_Type)
+    {
+        case SamplerType::Independent: return GetIndependent2D(pixelIndex, sampleIndex, dimension);
+        case SamplerType::BlueNoise:   return GetBlueNoise2D(pixelIndex, sampleIndex, dimension);
+        case SamplerType::Sobol:
+        default:                       return GetSobol2D(pixelIndex, sampleIndex, dimension);
+    }
+}
+
+
+pxr::GfVec2f Sampler::GetIndependent2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const
+{
+    // Klucz generatora łączy wszystkie współrzędne próbki.
+    uint32_t key = HashCombine(HashCombine(HashCombine(m_Seed, pixelIndex), sampleIndex), dimension);
+
+    return {ToUnitFloat(HashCombine(key, 0)), ToUnitFloat(HashCombine(key, 1))};
+}
+
+
+pxr::GfVec2f Sampler::GetSobol2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const
+{
+    // Każdy piksel oraz wymiar otrzymuje własne ziarno. Wymiary wyższe niż 2 są realizowane
+    // jako niezależnie przemieszane pary pierwszych wymiarów Sobol (padding).
+    uint32_t seed = HashCombine(HashCombine(m_Seed, pixelIndex), dimension);
+
+    // Przemieszanie indeksu zmienia kolejność próbek, zachowując stratyfikację każdej potęgi dwójki.
+    uint32_t shuffledIndex = NestedUniformScramble(sampleIndex, seed);
+
+    return {
+        ToUnitFloat(NestedUniformScramble(SobolDimension0(shuffledIndex), HashCombine(seed, 0))),
+        ToUnitFloat(NestedUniformScramble(SobolDimension1(shuffledIndex), HashCombine(seed, 1)))};
+}
+
+
+pxr::GfVec2f Sampler::GetBlueNoise2D(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const
+{
+    uint64_t sequenceIndex = GetBlueNoiseSequenceIndex(pixelIndex, sampleIndex, dimension);
+
+    // Ziarno mieszania zależy jedynie od wymiaru - piksele dzielą jedną sekwencję.
+    uint32_t seed = HashCombine(m_Seed, dimension);
+
+    return {
+        ToUnitFloat(NestedUniformScramble(SobolDimension0(sequenceIndex), HashCombine(seed, 0))),
+        ToUnitFloat(NestedUniformScramble(SobolDimension1(sequenceIndex), HashCombine(seed, 1)))};
+}
+
+
+uint64_t Sampler::GetBlueNoiseSequenceIndex(uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) const
+{
+    // Wszystkie permutacje cyfr o podstawie 4.
+    static constexpr uint8_t permutations[24][4] = {
+        {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 2, 1}, {0, 3, 1, 2},
+        {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 2, 0}, {1, 3, 0, 2},
+        {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 3, 0, 1}, {2, 3, 1, 0},
+        {3, 1, 2, 0}, {3, 1, 0, 2}, {3, 2, 1, 0}, {3, 2, 0, 1}, {3, 0, 2, 1}, {3, 0, 1, 2}};
+
+    uint32_t pixelX = pixelIndex % m_Width;
+    uint32_t pixelY = pixelIndex / m_Width;
+
+    uint64_t mortonIndex = (EncodeMorton2(pixelX, pixelY) << m_Log2SamplesPerPixel) | sampleIndex;
+    uint64_t dimensionHash = (0x55555555ull * dimension) ^ m_Seed;
+
+    // Nieparzysta liczba bitów indeksu próbki pozostawia ostatnią cyfrę o podstawie 2.
+    bool oddSampleBits = m_Log2SamplesPerPixel & 1;
+    int lastDigit = oddSampleBits ? 1 : 0;
+
+    uint64_t sequenceIndex = 0;
+    for (int digitIndex = int(m_Base4DigitCount) - 1; digitIndex >= lastDigit; digitIndex--)
+    {
+        int digitShift = 2 * digitIndex - (oddSampleBits ? 1 : 0);
+        uint64_t digit = (mortonIndex >> digitShift) & 3;
+
+        // Permutacja cyfry zależy od wszystkich bardziej znaczących cyfr (węzła drzewa czwórkowego).
+        uint64_t higherDigits = mortonIndex >> (digitShift + 2);
+        uint permutation = uint((MixBits(higherDigits ^ dimensionHash) >> 24) % 24);
+
+        sequenceIndex |= uint64_t(permutations[permutation][digit]) << digitShift;
+    }
+
+    if (oddSampleBits)
+    {
+        uint64_t digit = mortonIndex & 1;
+        sequenceIndex |= digit ^ (MixBits((mortonIndex >> 1) ^ dimensionHash) & 1);
+    }
+
+    return sequenceIndex;
+}
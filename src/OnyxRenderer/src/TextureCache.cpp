@@ -0,0 +1,709 @@
+#include "TextureCache.h"
+
+#include <pxr/base/gf/half.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/imaging/hio/image.h>
+#include <pxr/imaging/hio/types.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <iostream>
+
+using namespace Onyx;
+
+
+namespace
+{
+    float DecodeSRGB(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+
+    float EncodeSRGB(float value)
+    {
+        value = std::clamp(value, 0.0f, 1.0f);
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+
+    // Tablice konwersji danych 8-bitowych do wartości liniowych (sRGB oraz dane liniowe).
+    const std::array<float, 256>& GetByteDecodeTable(bool srgb)
+    {
+        static const auto decodeTables = []
+        {
+            std::array<std::array<float, 256>, 2> tables;
+            for (int value = 0; value < 256; value++)
+            {
+                tables[0][value] = float(value) / 255.0f;
+                tables[1][value] = DecodeSRGB(float(value) / 255.0f);
+            }
+            return tables;
+        }();
+
+        return decodeTables[srgb ? 1 : 0];
+    }
+
+
+    // Współrzędna teksela po zastosowaniu adresowania tekstury. -1 oznacza teksel poza teksturą (czarny).
+    int32_t WrapCoordinate(int32_t coordinate, int32_t size, TextureWrap wrap)
+    {
+        switch (wrap)
+        {
+            case TextureWrap::Repeat:
+                return ((coordinate % size) + size) % size;
+            case TextureWrap::Clamp:
+                return std::clamp(coordinate, 0, size - 1);
+            case TextureWrap::Mirror:
+            {
+                int32_t mirrored = ((coordinate % (2 * size)) + 2 * size) % (2 * size);
+                return mirrored < size ? mirrored : 2 * size - 1 - mirrored;
+            }
+            case TextureWrap::Black:
+                return coordinate < 0 || coordinate >= size ? -1 : coordinate;
+        }
+
+        return -1;
+    }
+
+
+    // Formaty odczytywane przez bibliotekę stb (Hio) dekodują cały obraz przy każdym odczycie, także fragmentu.
+    // Pozostałe formaty (OpenImageIO - OpenEXR, TIFF, TX) odczytują jedynie kafelki lub linie fragmentu.
+    bool SupportsCroppedReads(const std::string& filePath)
+    {
+        std::string extension = pxr::TfGetExtension(filePath);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char character) { return char(std::tolower(character)); });
+
+        static const char* decodedFormats[] = { "png", "jpg", "jpeg", "bmp", "tga", "hdr" };
+        return std::none_of(std::begin(decodedFormats), std::end(decodedFormats),
+            [&extension](const char* format) { return extension == format; });
+    }
+
+
+    pxr::HioImage::SourceColorSpace GetHioColorSpace(TextureColorSpace colorSpace)
+    {
+        switch (colorSpace)
+        {
+            case TextureColorSpace::Raw:  return pxr::HioImage::SourceColorSpace::Raw;
+            case TextureColorSpace::SRGB: return pxr::HioImage::SourceColorSpace::SRGB;
+            default:                      return pxr::HioImage::SourceColorSpace::Auto;
+        }
+    }
+}
+
+
+pxr::GfVec3f TextureCache::TextureTile::GetTexel(uint32_t x, uint32_t y) const
+{
+    // Kafelek którego nie udało się wczytać jest pusty - zwracamy czarny teksel.
+    if (Texels.empty()) return pxr::GfVec3f(0.0f);
+
+    size_t texelIndex = 3 * (size_t(std::min(y, Height - 1)) * Width + std::min(x, Width - 1));
+
+    if (FloatTexels)
+    {
+        const float* texel = reinterpret_cast<const float*>(Texels.data()) + texelIndex;
+        return pxr::GfVec3f(texel[0], texel[1], texel[2]);
+    }
+
+    const std::array<float, 256>& decodeTable = GetByteDecodeTable(SRGB);
+    const uint8_t* texel = Texels.data() + texelIndex;
+
+    return pxr::GfVec3f(decodeTable[texel[0]], decodeTable[texel[1]], decodeTable[texel[2]]);
+}
+
+
+TextureHandle TextureCache::RegisterTexture(const std::string& filePath, TextureColorSpace colorSpace)
+{
+    {
+        std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+        auto textureHandle = m_TextureHandles.find({filePath, colorSpace});
+        if (textureHandle != m_TextureHandles.end()) return textureHandle->second;
+    }
+
+    // Odczytujemy jedynie nagłówek pliku - dane tekseli są wczytywane kafelkami przy pierwszym odczycie.
+    pxr::HioImageSharedPtr image = pxr::HioImage::OpenForReading(
+        filePath, 0, 0, GetHioColorSpace(colorSpace), true);
+
+    if (!image)
+    {
+        std::cout << "[Onyx] Nie można odczytać tekstury: " << filePath << std::endl;
+        return InvalidTextureHandle;
+    }
+
+    const pxr::HioType texelType = pxr::HioGetHioType(image->GetFormat());
+
+    const bool byteTexels = texelType == pxr::HioTypeUnsignedByte || texelType == pxr::HioTypeUnsignedByteSRGB;
+    const bool supportedTexels = byteTexels || texelType == pxr::HioTypeUnsignedShort
+        || texelType == pxr::HioTypeHalfFloat || texelType == pxr::HioTypeFloat;
+
+    if (!supportedTexels || image->GetWidth() <= 0 || image->GetHeight() <= 0)
+    {
+        std::cout << "[Onyx] Nieobsługiwany format tekstury: " << filePath << std::endl;
+        return InvalidTextureHandle;
+    }
+
+    TextureEntry texture;
+    texture.FilePath = filePath;
+    texture.ColorSpace = colorSpace;
+    texture.FloatTexels = !byteTexels;
+    texture.SRGB = colorSpace == TextureColorSpace::SRGB
+        || (colorSpace == TextureColorSpace::Auto && image->IsColorSpaceSRGB());
+    texture.FileLevelCount = std::max(image->GetNumMipLevels(), 1);
+    texture.CroppedReads = SupportsCroppedReads(filePath);
+    texture.DecodeLock = std::make_shared<std::mutex>();
+
+    // Pełny łańcuch poziomów MIP aż do poziomu 1 x 1.
+    uint32_t levelWidth = uint32_t(image->GetWidth());
+    uint32_t levelHeight = uint32_t(image->GetHeight());
+    while (true)
+    {
+        texture.Levels.push_back(TextureLevel{
+            .Width = levelWidth,
+            .Height = levelHeight,
+            .TilesX = (levelWidth + TileSize - 1) / TileSize,
+            .TilesY = (levelHeight + TileSize - 1) / TileSize
+        });
+
+        if (levelWidth == 1 && levelHeight == 1) break;
+
+        levelWidth = std::max(levelWidth / 2, 1u);
+        levelHeight = std::max(levelHeight / 2, 1u);
+    }
+
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+    // Inny wątek synchronizacji mógł w międzyczasie zarejestrować ten sam plik.
+    auto [textureHandle, newTexture] = m_TextureHandles.try_emplace(
+        {filePath, colorSpace}, TextureHandle(m_Textures.size() + 1));
+
+    if (newTexture) m_Textures.push_back(std::move(texture));
+
+    return textureHandle->second;
+}
+
+
+void TextureCache::SampleBatch(
+    const TextureBinding& binding,
+    const TextureLookup* lookups, size_t lookupCount,
+    pxr::GfVec3f* results)
+{
+    if (!binding.IsValid())
+    {
+        std::fill_n(results, lookupCount, binding.Bias);
+        return;
+    }
+
+    const TextureEntry& texture = GetTextureEntry(binding.Texture);
+    const uint32_t levelCount = uint32_t(texture.Levels.size());
+    const float baseResolution = float(std::max(texture.Levels[0].Width, texture.Levels[0].Height));
+
+    // Bufory wątku zachowują pojemność pomiędzy paczkami - cieniowanie nie alokuje pamięci na paczkę.
+    SampleScratch& scratch = m_SampleScratch.local();
+
+    std::vector<BilinearFootprint>& footprints = scratch.Footprints;
+    footprints.resize(lookupCount);
+
+    std::vector<uint64_t>& tileKeys = scratch.TileKeys;
+    tileKeys.clear();
+
+    // Etap pierwszy (bez blokady) - wybór poziomu MIP, tekseli oraz kafelków wymaganych przez paczkę.
+    for (size_t lookupIndex = 0; lookupIndex < lookupCount; lookupIndex++)
+    {
+        const TextureLookup& lookup = lookups[lookupIndex];
+        BilinearFootprint& footprint = footprints[lookupIndex];
+
+        // Poziom, na którym ślad zapytania obejmuje około jednego teksela.
+        float levelSelection = std::log2(std::max(lookup.Footprint * baseResolution, 1.0f));
+        footprint.Level = std::min(uint32_t(levelSelection), levelCount - 1);
+
+        const TextureLevel& level = texture.Levels[footprint.Level];
+
+        // Współrzędna V rośnie w górę tekstury (konwencja USD), a wiersze pliku są zapisane od góry.
+        float x = lookup.U * float(level.Width) - 0.5f;
+        float y = (1.0f - lookup.V) * float(level.Height) - 0.5f;
+
+        float floorX = std::floor(x);
+        float floorY = std::floor(y);
+
+        footprint.WeightX = x - floorX;
+        footprint.WeightY = y - floorY;
+
+        for (int corner = 0; corner < 2; corner++)
+        {
+            footprint.X[corner] = WrapCoordinate(int32_t(floorX) + corner, int32_t(level.Width), binding.WrapS);
+            footprint.Y[corner] = WrapCoordinate(int32_t(floorY) + corner, int32_t(level.Height), binding.WrapT);
+        }
+
+        for (int32_t texelY : footprint.Y)
+        {
+            for (int32_t texelX : footprint.X)
+            {
+                if (texelX < 0 || texelY < 0) continue;
+
+                tileKeys.push_back(GetTileKey(
+                    binding.Texture, footprint.Level, uint32_t(texelX) / TileSize, uint32_t(texelY) / TileSize));
+            }
+        }
+    }
+
+    std::sort(tileKeys.begin(), tileKeys.end());
+    tileKeys.erase(std::unique(tileKeys.begin(), tileKeys.end()), tileKeys.end());
+
+    // Etap drugi - jedna blokada na paczkę. Kafelki są przechowywane przez paczkę (shared_ptr),
+    // dlatego usunięcie kafelka z pamięci podręcznej przez inny wątek nie unieważnia odczytu.
+    std::vector<TileHandle>& tiles = scratch.Tiles;
+    tiles.assign(tileKeys.size(), nullptr);
+    {
+        std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+        for (size_t tileIndex = 0; tileIndex < tileKeys.size(); tileIndex++)
+        {
+            tiles[tileIndex] = FindTile(tileKeys[tileIndex]);
+            if (tiles[tileIndex]) m_TileHits++;
+        }
+    }
+
+    // Etap trzeci - brakujące kafelki wczytujemy poza blokadą.
+    for (size_t tileIndex = 0; tileIndex < tileKeys.size(); tileIndex++)
+    {
+        if (tiles[tileIndex]) continue;
+
+        const uint64_t tileKey = tileKeys[tileIndex];
+        const uint32_t level = uint32_t(tileKey >> 32) & 0xFF;
+        const uint32_t tileX = uint32_t(tileKey) & 0xFFFF;
+        const uint32_t tileY = uint32_t(tileKey >> 16) & 0xFFFF;
+
+        tiles[tileIndex] = AcquireTile(binding.Texture, level, tileX, tileY);
+    }
+
+    // Etap czwarty - filtrowanie dwuliniowe.
+    auto fetchTexel = [&](uint32_t level, int32_t texelX, int32_t texelY)
+    {
+        if (texelX < 0 || texelY < 0) return pxr::GfVec3f(0.0f);
+
+        const uint64_t tileKey = GetTileKey(
+            binding.Texture, level, uint32_t(texelX) / TileSize, uint32_t(texelY) / TileSize);
+        const size_t tileIndex = std::lower_bound(tileKeys.begin(), tileKeys.end(), tileKey) - tileKeys.begin();
+
+        const TileHandle& tile = tiles[tileIndex];
+        return tile ? tile->GetTexel(uint32_t(texelX) % TileSize, uint32_t(texelY) % TileSize) : pxr::GfVec3f(0.0f);
+    };
+
+    for (size_t lookupIndex = 0; lookupIndex < lookupCount; lookupIndex++)
+    {
+        const BilinearFootprint& footprint = footprints[lookupIndex];
+
+        pxr::GfVec3f top = (1.0f - footprint.WeightX) * fetchTexel(footprint.Level, footprint.X[0], footprint.Y[0])
+            + footprint.WeightX * fetchTexel(footprint.Level, footprint.X[1], footprint.Y[0]);
+        pxr::GfVec3f bottom = (1.0f - footprint.WeightX) * fetchTexel(footprint.Level, footprint.X[0], footprint.Y[1])
+            + footprint.WeightX * fetchTexel(footprint.Level, footprint.X[1], footprint.Y[1]);
+
+        pxr::GfVec3f texel = (1.0f - footprint.WeightY) * top + footprint.WeightY * bottom;
+        results[lookupIndex] = pxr::GfCompMult(texel, binding.Scale) + binding.Bias;
+    }
+
+    // Paczka nie przechowuje kafelków po odczycie - kafelki usunięte z pamięci podręcznej są zwalniane.
+    tiles.clear();
+}
+
+
+void TextureCache::SetBudget(size_t budgetBytes)
+{
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+    m_BudgetBytes = budgetBytes;
+    EvictOverBudget();
+}
+
+
+TextureCacheStatistics TextureCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+    return TextureCacheStatistics{
+        .TextureCount = m_Textures.size(),
+        .ResidentTileCount = m_Tiles.size(),
+        .ResidentBytes = m_ResidentBytes,
+        .BudgetBytes = m_BudgetBytes,
+        .TileHits = m_TileHits,
+        .TileMisses = m_TileMisses,
+        .EvictedTiles = m_EvictedTiles
+    };
+}
+
+
+TextureCache::TileHandle TextureCache::AcquireTile(
+    TextureHandle texture, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+    const uint64_t tileKey = GetTileKey(texture, level, tileX, tileY);
+
+    {
+        std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+        if (TileHandle tile = FindTile(tileKey))
+        {
+            m_TileHits++;
+            return tile;
+        }
+    }
+
+    const TextureEntry& textureEntry = GetTextureEntry(texture);
+
+    TileHandle tile;
+    if (int(level) < textureEntry.FileLevelCount)
+    {
+        tile = textureEntry.CroppedReads ? LoadTileFromFile(textureEntry, level, tileX, tileY)
+            : LoadLevelFromFile(texture, textureEntry, level, tileX, tileY);
+    }
+    if (!tile && level > 0) tile = BuildTileFromFinerLevel(texture, level, tileX, tileY);
+
+    // Kafelek którego nie udało się wczytać zapamiętujemy jako pusty (czarny),
+    // aby kolejne odczyty nie otwierały ponownie pliku.
+    if (!tile)
+    {
+        auto emptyTile = std::make_shared<TextureTile>();
+        emptyTile->Width = 0;
+        emptyTile->Height = 0;
+        emptyTile->FloatTexels = false;
+        emptyTile->SRGB = false;
+        tile = emptyTile;
+    }
+
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+    m_TileMisses++;
+    return InsertTile(tileKey, tile);
+}
+
+
+TextureCache::TileHandle TextureCache::FindTile(uint64_t tileKey)
+{
+    auto cacheEntry = m_Tiles.find(tileKey);
+    if (cacheEntry == m_Tiles.end()) return nullptr;
+
+    // Kafelek staje się ostatnio używanym (początek listy LRU).
+    m_RecentTiles.splice(m_RecentTiles.begin(), m_RecentTiles, cacheEntry->second.RecentUse);
+
+    return cacheEntry->second.Tile;
+}
+
+
+TextureCache::TileHandle TextureCache::InsertTile(uint64_t tileKey, TileHandle tile)
+{
+    auto [cacheEntry, newTile] = m_Tiles.try_emplace(tileKey);
+
+    // Kafelek wczytany równolegle przez inny wątek - odrzucamy kopię.
+    if (!newTile)
+    {
+        m_RecentTiles.splice(m_RecentTiles.begin(), m_RecentTiles, cacheEntry->second.RecentUse);
+        return cacheEntry->second.Tile;
+    }
+
+    m_RecentTiles.push_front(tileKey);
+    cacheEntry->second = CacheEntry{tile, m_RecentTiles.begin()};
+
+    m_ResidentBytes += tile->ByteSize();
+    EvictOverBudget();
+
+    return tile;
+}
+
+
+void TextureCache::EvictOverBudget()
+{
+    // Ostatnio dodany kafelek (początek listy) nie jest usuwany nawet przy limicie mniejszym niż jeden kafelek.
+    while (m_BudgetBytes > 0 && m_ResidentBytes > m_BudgetBytes && m_Tiles.size() > 1)
+    {
+        auto cacheEntry = m_Tiles.find(m_RecentTiles.back());
+
+        m_ResidentBytes -= cacheEntry->second.Tile->ByteSize();
+        m_Tiles.erase(cacheEntry);
+        m_RecentTiles.pop_back();
+
+        m_EvictedTiles++;
+    }
+}
+
+
+TextureCache::TileHandle TextureCache::LoadTileFromFile(
+    const TextureEntry& texture, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+    pxr::HioImageSharedPtr image = pxr::HioImage::OpenForReading(
+        texture.FilePath, 0, int(level), GetHioColorSpace(texture.ColorSpace), true);
+
+    const TextureLevel& textureLevel = texture.Levels[level];
+
+    // Poziom MIP zapisany w pliku musi odpowiadać rozmiarem poziomowi pamięci podręcznej.
+    if (!image || uint32_t(image->GetWidth()) != textureLevel.Width
+        || uint32_t(image->GetHeight()) != textureLevel.Height)
+    {
+        return nullptr;
+    }
+
+    const uint32_t originX = tileX * TileSize;
+    const uint32_t originY = tileY * TileSize;
+    const uint32_t tileWidth = std::min(TileSize, textureLevel.Width - originX);
+    const uint32_t tileHeight = std::min(TileSize, textureLevel.Height - originY);
+
+    // Wczytujemy jedynie obszar kafelka w formacie pliku.
+    const pxr::HioFormat fileFormat = image->GetFormat();
+    std::vector<uint8_t> fileTexels(size_t(tileWidth) * tileHeight * image->GetBytesPerPixel());
+
+    pxr::HioImage::StorageSpec storage;
+    storage.width = int(tileWidth);
+    storage.height = int(tileHeight);
+    storage.depth = 1;
+    storage.format = fileFormat;
+    storage.flipped = false;
+    storage.data = fileTexels.data();
+
+    const bool readSuccessful = image->ReadCropped(
+        int(originY), int(textureLevel.Height - originY - tileHeight),
+        int(originX), int(textureLevel.Width - originX - tileWidth),
+        storage);
+
+    if (!readSuccessful) return nullptr;
+
+    return CreateTileFromFileTexels(texture, fileFormat, fileTexels.data(), tileWidth, 0, 0, tileWidth, tileHeight);
+}
+
+
+TextureCache::TileHandle TextureCache::LoadLevelFromFile(
+    TextureHandle texture, const TextureEntry& textureEntry, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+    // Wątki którym brakuje kafelków tego samego pliku czekają na jedno dekodowanie.
+    std::lock_guard<std::mutex> decodeLock(*textureEntry.DecodeLock);
+
+    const uint64_t tileKey = GetTileKey(texture, level, tileX, tileY);
+    {
+        std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+        if (TileHandle tile = FindTile(tileKey)) return tile;
+    }
+
+    pxr::HioImageSharedPtr image = pxr::HioImage::OpenForReading(
+        textureEntry.FilePath, 0, int(level), GetHioColorSpace(textureEntry.ColorSpace), true);
+
+    const TextureLevel& textureLevel = textureEntry.Levels[level];
+
+    if (!image || uint32_t(image->GetWidth()) != textureLevel.Width
+        || uint32_t(image->GetHeight()) != textureLevel.Height)
+    {
+        return nullptr;
+    }
+
+    const pxr::HioFormat fileFormat = image->GetFormat();
+    std::vector<uint8_t> fileTexels(size_t(textureLevel.Width) * textureLevel.Height * image->GetBytesPerPixel());
+
+    pxr::HioImage::StorageSpec storage;
+    storage.width = int(textureLevel.Width);
+    storage.height = int(textureLevel.Height);
+    storage.depth = 1;
+    storage.format = fileFormat;
+    storage.flipped = false;
+    storage.data = fileTexels.data();
+
+    if (!image->Read(storage)) return nullptr;
+
+    TileHandle requestedTile;
+    std::vector<std::pair<uint64_t, TileHandle>> levelTiles;
+    size_t levelTileBytes = 0;
+
+    for (uint32_t levelTileY = 0; levelTileY < textureLevel.TilesY; levelTileY++)
+    {
+        for (uint32_t levelTileX = 0; levelTileX < textureLevel.TilesX; levelTileX++)
+        {
+            const uint32_t originX = levelTileX * TileSize;
+            const uint32_t originY = levelTileY * TileSize;
+
+            TileHandle tile = CreateTileFromFileTexels(
+                textureEntry, fileFormat, fileTexels.data(), textureLevel.Width, originX, originY,
+                std::min(TileSize, textureLevel.Width - originX), std::min(TileSize, textureLevel.Height - originY));
+
+            if (levelTileX == tileX && levelTileY == tileY)
+            {
+                requestedTile = tile;
+                continue;
+            }
+
+            levelTileBytes += tile->ByteSize();
+            levelTiles.emplace_back(GetTileKey(texture, level, levelTileX, levelTileY), std::move(tile));
+        }
+    }
+
+    if (!requestedTile) return nullptr;
+
+    // Pozostałe kafelki poziomu dodajemy jedynie jeśli mieszczą się w limicie pamięci - w przeciwnym razie
+    // wypierałyby kafelki używane przez inne tekstury. Wskazany kafelek dodaje wywołujący (AcquireTile).
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+
+    if (m_BudgetBytes == 0 || m_ResidentBytes + levelTileBytes + requestedTile->ByteSize() <= m_BudgetBytes)
+    {
+        for (auto& [levelTileKey, levelTile] : levelTiles)
+        {
+            InsertTile(levelTileKey, std::move(levelTile));
+        }
+    }
+
+    return requestedTile;
+}
+
+
+TextureCache::TileHandle TextureCache::CreateTileFromFileTexels(
+    const TextureEntry& texture, pxr::HioFormat fileFormat,
+    const uint8_t* fileTexels, uint32_t rowTexelCount,
+    uint32_t originX, uint32_t originY, uint32_t tileWidth, uint32_t tileHeight)
+{
+    auto tile = std::make_shared<TextureTile>();
+    tile->Width = tileWidth;
+    tile->Height = tileHeight;
+    tile->FloatTexels = texture.FloatTexels;
+    tile->SRGB = texture.SRGB && !texture.FloatTexels;
+    tile->Texels.resize(size_t(tileWidth) * tileHeight * 3 * (texture.FloatTexels ? sizeof(float) : 1));
+
+    // Konwersja do RGB - tekstury jedno- i dwukanałowe (skala szarości) powielają pierwszy kanał.
+    const size_t componentCount = size_t(pxr::HioGetComponentCount(fileFormat));
+    const size_t componentBytes = size_t(pxr::HioGetDataSizeOfType(fileFormat));
+    const pxr::HioType texelType = pxr::HioGetHioType(fileFormat);
+
+    auto* floatTexels = reinterpret_cast<float*>(tile->Texels.data());
+
+    for (uint32_t y = 0; y < tileHeight; y++)
+    {
+        // Pierwszy teksel wiersza kafelka w danych pliku.
+        const size_t rowStart = (size_t(originY + y) * rowTexelCount + originX) * componentCount;
+
+        for (uint32_t x = 0; x < tileWidth; x++)
+        {
+            for (size_t channel = 0; channel < 3; channel++)
+            {
+                const size_t sourceIndex = rowStart + size_t(x) * componentCount + (componentCount >= 3 ? channel : 0);
+                const size_t targetIndex = (size_t(y) * tileWidth + x) * 3 + channel;
+                const uint8_t* sourceValue = fileTexels + sourceIndex * componentBytes;
+
+                if (!texture.FloatTexels)
+                {
+                    tile->Texels[targetIndex] = *sourceValue;
+                    continue;
+                }
+
+                float value = 0.0f;
+                switch (texelType)
+                {
+                    case pxr::HioTypeUnsignedShort:
+                    {
+                        uint16_t shortValue;
+                        std::memcpy(&shortValue, sourceValue, sizeof(uint16_t));
+                        value = float(shortValue) / 65535.0f;
+                        break;
+                    }
+                    case pxr::HioTypeHalfFloat:
+                    {
+                        pxr::GfHalf halfValue;
+                        std::memcpy(&halfValue, sourceValue, sizeof(pxr::GfHalf));
+                        value = float(halfValue);
+                        break;
+                    }
+                    default:
+                        std::memcpy(&value, sourceValue, sizeof(float));
+                        break;
+                }
+
+                // Dane zmiennoprzecinkowe przechowujemy w przestrzeni liniowej.
+                floatTexels[targetIndex] = texture.SRGB ? DecodeSRGB(value) : value;
+            }
+        }
+    }
+
+    return tile;
+}
+
+
+TextureCache::TileHandle TextureCache::BuildTileFromFinerLevel(
+    TextureHandle texture, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+    const TextureEntry& textureEntry = GetTextureEntry(texture);
+
+    const TextureLevel& textureLevel = textureEntry.Levels[level];
+    const TextureLevel& finerLevel = textureEntry.Levels[level - 1];
+
+    const uint32_t originX = tileX * TileSize;
+    const uint32_t originY = tileY * TileSize;
+    const uint32_t tileWidth = std::min(TileSize, textureLevel.Width - originX);
+    const uint32_t tileHeight = std::min(TileSize, textureLevel.Height - originY);
+
+    // Kafelek pokrywa (2 x 2) kafelki poziomu poprzedniego - wczytujemy je (lub budujemy) rekurencyjnie.
+    TileHandle finerTiles[2][2];
+    for (uint32_t offsetY = 0; offsetY < 2; offsetY++)
+    {
+        for (uint32_t offsetX = 0; offsetX < 2; offsetX++)
+        {
+            uint32_t finerTileX = 2 * tileX + offsetX;
+            uint32_t finerTileY = 2 * tileY + offsetY;
+
+            if (finerTileX < finerLevel.TilesX && finerTileY < finerLevel.TilesY)
+            {
+                finerTiles[offsetY][offsetX] = AcquireTile(texture, level - 1, finerTileX, finerTileY);
+            }
+        }
+    }
+
+    auto fetchFinerTexel = [&](uint32_t texelX, uint32_t texelY)
+    {
+        texelX = std::min(texelX, finerLevel.Width - 1);
+        texelY = std::min(texelY, finerLevel.Height - 1);
+
+        const TileHandle& finerTile = finerTiles[texelY / TileSize - 2 * tileY][texelX / TileSize - 2 * tileX];
+        return finerTile ? finerTile->GetTexel(texelX % TileSize, texelY % TileSize) : pxr::GfVec3f(0.0f);
+    };
+
+    auto tile = std::make_shared<TextureTile>();
+    tile->Width = tileWidth;
+    tile->Height = tileHeight;
+    tile->FloatTexels = textureEntry.FloatTexels;
+    tile->SRGB = textureEntry.SRGB && !textureEntry.FloatTexels;
+    tile->Texels.resize(size_t(tileWidth) * tileHeight * 3 * (textureEntry.FloatTexels ? sizeof(float) : 1));
+
+    auto* floatTexels = reinterpret_cast<float*>(tile->Texels.data());
+
+    for (uint32_t y = 0; y < tileHeight; y++)
+    {
+        for (uint32_t x = 0; x < tileWidth; x++)
+        {
+            const uint32_t finerX = 2 * (originX + x);
+            const uint32_t finerY = 2 * (originY + y);
+
+            // Filtr pudełkowy (2 x 2) w przestrzeni liniowej.
+            pxr::GfVec3f averageTexel = 0.25f * (fetchFinerTexel(finerX, finerY) + fetchFinerTexel(finerX + 1, finerY)
+                + fetchFinerTexel(finerX, finerY + 1) + fetchFinerTexel(finerX + 1, finerY + 1));
+
+            const size_t targetIndex = 3 * (size_t(y) * tileWidth + x);
+            for (size_t channel = 0; channel < 3; channel++)
+            {
+                if (tile->FloatTexels)
+                {
+                    floatTexels[targetIndex + channel] = averageTexel[channel];
+                    continue;
+                }
+
+                float encodedValue = tile->SRGB ? EncodeSRGB(averageTexel[channel])
+                    : std::clamp(averageTexel[channel], 0.0f, 1.0f);
+                tile->Texels[targetIndex + channel] = uint8_t(std::lround(encodedValue * 255.0f));
+            }
+        }
+    }
+
+    return tile;
+}
+
+
+const TextureCache::TextureEntry& TextureCache::GetTextureEntry(TextureHandle texture) const
+{
+    std::lock_guard<std::mutex> cacheLock(m_CacheLock);
+    return m_Textures[texture - 1];
+}
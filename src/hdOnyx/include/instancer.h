@@ -0,0 +1,54 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/imaging/hd/instancer.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/types.h>
+#include <pxr/base/vt/value.h>
+
+#include <mutex>
+#include <unordered_map>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Instancer Hydry (np. UsdGeomPointInstancer). Przechowuje dane instancji (primvary o interpolacji "instance")
+// i na ich podstawie wylicza transformacje kopii prototypu. Prototypy (meshe) budują jedną geometrię BLAS,
+// a każda kopia jest jedynie transformacją w tablicy instancji Embree.
+class HdOnyxInstancer final : public HdInstancer
+{
+public:
+
+    HdOnyxInstancer(HdSceneDelegate* delegate, SdfPath const& id);
+    ~HdOnyxInstancer() override = default;
+
+    // Synchronizacja primvarów instancji. Wywoływana przez Hydrę przed synchronizacją prototypów.
+    void Sync(HdSceneDelegate* sceneDelegate,
+              HdRenderParam* renderParam,
+              HdDirtyBits* dirtyBits) override;
+
+    /**
+     * Metoda wyliczająca transformacje wszystkich kopii prototypu (object-space prototypu -> world-space).
+     * Transformacje zagnieżdżonych instancerów są uwzględniane rekurencyjnie, w efekcie liczba transformacji
+     * jest iloczynem liczby instancji na każdym poziomie zagnieżdżenia.
+     * @note Transformacja prima prototypu nie jest uwzględniona, mesh mnoży ją samodzielnie.
+     * @param prototypeId Ścieżka prima prototypu.
+     * @return Tablica transformacji instancji prototypu.
+     */
+    VtMatrix4dArray ComputeInstanceTransforms(SdfPath const& prototypeId);
+
+private:
+
+    // Pobiera primvary o interpolacji "instance" które uległy zmianie.
+    void SyncPrimvars(HdSceneDelegate* sceneDelegate, HdDirtyBits dirtyBits);
+
+    // Synchronizacja instancerów może odbywać się równolegle (np. instancer współdzielony przez prototypy).
+    std::mutex m_InstanceLock;
+
+    // Dane instancji indeksowane nazwą primvara (instanceTransforms, instanceTranslations...).
+    std::unordered_map<TfToken, VtValue, TfToken::HashFunctor> m_PrimvarMap;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
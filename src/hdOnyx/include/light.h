@@ -5,6 +5,8 @@
 
 #include "mesh.h"
 
+#include <optional>
+
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -22,6 +24,9 @@ public:
 
     HdDirtyBits GetInitialDirtyBitsMask() const override;
 
+    // Wywoływana przed usunięciem prima. Odpina instancję światła i zwalnia miejsce w buforze świateł.
+    void Finalize(HdRenderParam* renderParam) override;
+
 private:
 
     /**
@@ -55,7 +60,11 @@ private:
      */
     GfVec3f m_TotalEmissivePower;
 
-    HdOnyxInstanceData m_LightInstanceData;
+    /**
+     * Indeks światła w buforze świateł silnika. Brak wartości oznacza światło które
+     * nie zostało jeszcze podpięte do sceny.
+     */
+    std::optional<uint> m_LightIndexInBuffer;
 };
 
 
@@ -13,15 +13,18 @@ public:
 
     void Sync(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam, HdDirtyBits* dirtyBits) override;
 
+    // Zwalnia materiał w rejestrze materiałów silnika.
+    void Finalize(HdRenderParam* renderParam) override;
+
 
 protected:
     HdDirtyBits GetInitialDirtyBitsMask() const override;
 
 private:
     /**
-     * Indeks materiału przypisany przez renderer w buforze materiałów sceny.
+     * Stabilny uchwyt materiału przypisany przez rejestr materiałów silnika.
      */
-    uint m_MaterialBufferID;
+    uint m_MaterialBufferID = 0;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/imaging/hd/material.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <map>
+#include <utility>
+
+#include "resourceRegistry.h"
+
+namespace Onyx
+{
+    class OnyxRenderer;
+}
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Kompilator sieci węzłów materiału do programu materiału silnika (Onyx::MaterialProgram).
+// Obsługiwane węzły: UsdPrimvarReader_float2, UsdTransform2d oraz UsdUVTexture podłączone do wejścia
+// diffuseColor węzła UsdPreviewSurface. Węzły nieobsługiwane są zastępowane wartością domyślną wejścia.
+class HdOnyxMaterialCompiler
+{
+public:
+
+    /**
+     * Metoda budująca kanoniczną postać sieci (klucz pamięci podręcznej kompilacji) z węzłów osiągalnych
+     * z węzła powierzchni. Cykle w sieci są przerywane (połączenie zamykające cykl jest pomijane).
+     * @param materialGraph Sieć materiału.
+     * @param surfaceNodePath Ścieżka węzła podłączonego do wyjścia "surface" materiału.
+     */
+    static HdOnyxMaterialNetworkKey BuildNetworkKey(
+        const HdMaterialNetwork2& materialGraph,
+        const SdfPath& surfaceNodePath);
+
+    HdOnyxMaterialCompiler(const HdOnyxMaterialNetworkKey& networkKey, Onyx::OnyxRenderer* renderer);
+
+    /**
+     * Metoda kompilująca program. Tekstury sieci są rejestrowane w pamięci podręcznej tekstur silnika.
+     * @return Program lub nullptr jeśli żadne z obsługiwanych wejść węzła powierzchni nie jest podłączone.
+     */
+    HdOnyxMaterialProgramHandle Compile();
+
+private:
+
+    // Każda funkcja kompilacji zwraca rejestr programu zawierający wartość.
+
+    // Wartość wejścia węzła - wyjście podłączonego węzła lub parametr (stała).
+    uint8_t CompileInput(uint32_t nodeIndex, const TfToken& inputName, const GfVec3f& fallback);
+
+    uint8_t CompileNodeOutput(uint32_t nodeIndex, const TfToken& outputName, const GfVec3f& fallback);
+
+    uint8_t CompileTexture(uint32_t nodeIndex, const TfToken& outputName);
+    uint8_t CompilePrimvarReader(uint32_t nodeIndex);
+    uint8_t CompileTransform2d(uint32_t nodeIndex);
+
+    uint8_t EmitConstant(const GfVec3f& value);
+    uint8_t AllocateRegister();
+
+    const VtValue* FindParameter(uint32_t nodeIndex, const TfToken& name) const;
+    const HdOnyxMaterialNetworkKey::Connection* FindConnection(uint32_t nodeIndex, const TfToken& inputName) const;
+
+    const HdOnyxMaterialNetworkKey& m_NetworkKey;
+    Onyx::OnyxRenderer* m_Renderer;
+
+    Onyx::MaterialProgram m_Program;
+
+    // Rejestry wyjść skompilowanych węzłów - węzeł współdzielony przez kilka wejść jest kompilowany raz.
+    std::map<std::pair<uint32_t, TfToken>, uint8_t> m_NodeOutputRegisters;
+
+    // Flaga ustawiana po przekroczeniu liczby rejestrów programu (256).
+    bool m_RegisterOverflow = false;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
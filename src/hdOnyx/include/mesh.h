@@ -6,6 +6,11 @@
 #include <pxr/imaging/hd/mesh.h>
 #include <pxr/base/gf/matrix4f.h>
 
+#include <memory>
+#include <vector>
+
+#include "resourceRegistry.h"
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 
@@ -14,7 +19,9 @@ struct HdOnyxInstanceData
 {
     // Transformacja instancji.
     GfMatrix4f TransformMatrix;
-    VtVec3fArray* SmoothNormalsArray;
+
+    // Geometria instancji (wektory normalne cieniowania). Pusty wskaźnik dla świateł.
+    const HdOnyxSharedGeometry* Geometry;
 
     // Korzystamy z jednego indeksu do bufora danych
     // W zależności od typu instancji (Light = true/false)
@@ -22,6 +29,62 @@ struct HdOnyxInstanceData
     uint DataIndexInBuffer;
 
     bool Light;
+
+    // Opcjonalna tablica transformacji kopii instancera indeksowana identyfikatorem kopii (instPrimID).
+    // Wszystkie kopie prototypu współdzielą jedną strukturę pomocniczą oraz jedną geometrię BLAS.
+    const GfMatrix4f* InstanceTransforms = nullptr;
+
+    // Zwraca transformację kopii instancji. Pojedyncza instancja używa TransformMatrix.
+    const GfMatrix4f& GetTransform(uint instancePrimitiveID) const
+    {
+        return InstanceTransforms ? InstanceTransforms[instancePrimitiveID] : TransformMatrix;
+    }
+};
+
+
+// Instancje mesha w głównej scenie silnika wraz z danymi odczytywanymi przez integrator podczas intersekcji
+// (struktury pomocnicze, bufor transformacji kopii) oraz geometrią BLAS, na którą wskazują.
+// Zestaw jest zastępowany w całości - poprzedni zestaw trafia do zakolejkowanego odpięcia i jest zwalniany
+// dopiero po jego wykonaniu, gdy wątek renderujący jest zatrzymany.
+struct HdOnyxMeshInstances
+{
+    HdOnyxMeshInstances() = default;
+    ~HdOnyxMeshInstances();
+
+    HdOnyxMeshInstances(const HdOnyxMeshInstances&) = delete;
+    HdOnyxMeshInstances& operator=(const HdOnyxMeshInstances&) = delete;
+
+    // Deskryptory instancji w strukturze przyspieszenia intersekcji.
+    // Zwykły mesh posiada jedną instancję, prototyp instancera jedną tablicę instancji
+    // (lub jedną instancję na kopię jeśli Embree nie wspiera tablic instancji).
+    std::vector<RTCGeometry> Sources;
+
+    // Indeksy pod jakimi instancje zostały powiązane ze sceną główną silnika (ID instancji).
+    std::vector<uint> AttachmentIDs;
+
+    // Transformacje kopii prototypu instancera (world-space). Bufor jest współdzielony z tablicą instancji Embree.
+    std::vector<GfMatrix4f> Transforms;
+
+    // Struktury pomocnicze kopii, używane gdy każda kopia jest osobną instancją Embree.
+    std::vector<HdOnyxInstanceData> DataTable;
+
+    // Struktura pomocnicza instancji przekazywana do sceny za pomocą wskaźnika do "User Data".
+    HdOnyxInstanceData Data;
+
+    // Geometria instancji - bufory punktów, indeksów i wektorów normalnych odczytywane przez Embree.
+    HdOnyxSharedGeometryHandle Geometry;
+};
+
+
+// Sposób aktualizacji geometrii mesha przy zmianie wyłącznie punktów (primvar "onyx:deformUpdate").
+enum class HdOnyxDeformUpdateMode
+{
+    // Dopasowanie brył ograniczających BVH bez zmiany jego struktury (najszybsze, dla małych deformacji).
+    Refit,
+    // Szybka przebudowa BVH o niskiej jakości (dla dużych deformacji).
+    Rebuild,
+    // Brak ścieżki deformacji - każda zmiana punktów tworzy nową (współdzieloną) geometrię.
+    None
 };
 
 
@@ -46,6 +109,9 @@ public:
         , HdDirtyBits* dirtyBits
         , TfToken const &reprToken) override;
 
+    // Wywoływana przed usunięciem prima. Odpina instancje od sceny silnika i zwalnia geometrię.
+    void Finalize(HdRenderParam* renderParam) override;
+
 protected:
 
     void _InitRepr(TfToken const &reprToken, HdDirtyBits *dirtyBits) override;
@@ -57,39 +123,50 @@ protected:
 
 private:
 
-    // Deskryptor instancji w strukturze przyspieszenia intersekcji
-    // która zostaje powiązana z główną sceną silnika.
-    RTCGeometry m_MeshInstanceSource;
+    // Tworzy instancje geometrii w głównej scenie silnika: jedną instancję dla zwykłego mesha
+    // lub tablicę instancji dla prototypu instancera. Poprzednie instancje są odpinane i zwalniane.
+    void RebuildInstances(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam);
 
-    // Indeks pod jakim instancja mesha została powiązana ze sceną główną silnika (ID instancji).
-    std::optional<uint> m_InstanceAttachmentID;
+    // Aktualizuje transformacje istniejących instancji bez ich ponownego tworzenia.
+    // Instancje zachowują identyfikatory w scenie silnika.
+    void UpdateInstanceTransforms(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam);
 
-    // Struktura pomocnicza instancji obiektu przekazywana
-    // do struktury sceny za pomocą wskaźnika do "User Data".
-    // W ten sposób przekazywane są dane (aktualnie transformacja) podczas
-    // intersekcji ze sceną w silniku.
-    HdOnyxInstanceData m_InstanceData;
+    // Kolejkuje odpięcie instancji mesha od głównej sceny silnika. Zestaw instancji jest zwalniany
+    // po wykonaniu odpięcia.
+    void ReleaseInstances(HdRenderParam* renderParam);
 
-    // Struktura przyspieszenia intersekcji Embree zbudowana na podstawie
+    // Instancje mesha powiązane z główną sceną silnika. Pusty wskaźnik oznacza brak instancji.
+    std::shared_ptr<HdOnyxMeshInstances> m_Instances;
+
+    // Uchwyt struktury przyspieszenia intersekcji Embree zbudowanej na podstawie
     // punktów oraz indeksów geometrii. Aby uniknąć transformacji
     // bufora punktów przez transformację obiektu w scenie
     // wykorzystujemy tzw. instancing.
-    // Tworzymy strukturę którą później wykorzystamy do stworzenia instancji.
-    // Scena używana przez silnik używa tylko instancji geometrii.
-    RTCScene m_MeshRTAS;
-
-    // Desktryptor geometrii dla której powinna zostać zbuowana
-    // struktura przyspieszenia intersekcji.
+    // Struktura jest współdzielona przez wszystkie meshe o identycznych danych (rejestr zasobów),
+    // a scena używana przez silnik używa tylko instancji geometrii.
     // (RTAS / BVH - Ray Tracing Acceleration Structure / Bounding Volume Hierarchy)
-    // Zawiera bufory punktów oraz indeksów trójkątów budujących mesh.
-    RTCGeometry m_MeshGeometrySource;
+    HdOnyxSharedGeometryHandle m_SharedGeometry;
+
+    // Prywatna geometria mesha deformowanego (ten sam obiekt co m_SharedGeometry).
+    // Pusty uchwyt oznacza geometrię współdzieloną przez rejestr zasobów.
+    HdOnyxDeformingGeometryHandle m_DeformingGeometry;
+
+    HdOnyxDeformUpdateMode m_DeformUpdateMode = HdOnyxDeformUpdateMode::Refit;
+
+    // Flaga wskazująca na jawnie ustawiony tryb deformacji (refit / rebuild) - geometria deformowana jest
+    // tworzona od razu. Bez niej mesh otrzymuje geometrię deformowaną dopiero przy pierwszej deformacji.
+    bool m_DeformUpdateAuthored = false;
 
     // Bufor punktów (points / vertices) geometrii.
     VtVec3fArray m_PointArray;
 
-    // Opcjonalny bufor wektorów normalnych. Wektory normalne mogą zostać dodane do geometrii
-    // w celu ich wygładzenia. Alternatywnie - silnik oblicza wektor normalny z wierzchołków punktów trójkąta.
-    std::optional<VtVec3fArray> m_SmoothNormalArray;
+    // Opcjonalne wektory normalne. Wektory normalne mogą zostać dodane do geometrii w celu jej wygładzenia
+    // (jeden wektor na punkt lub ztriangulowane dane face-varying). Alternatywnie - silnik oblicza
+    // wektor normalny z wierzchołków punktów trójkąta.
+    HdOnyxShadingNormals m_ShadingNormals;
+
+    // Opcjonalne współrzędne tekstur (primvar "st") używane przez tekstury materiałów.
+    HdOnyxTextureCoordinates m_TextureCoordinates;
 
     // Bufor ztriangulowanych indeksów (indices) punktów geometrii
     pxr::VtVec3iArray m_IndexArray;
@@ -28,6 +28,11 @@ public:
 
     virtual bool IsConverged() const override;
 
+    /**
+     * Metoda ustawiająca stan zbieżności danych bufora na podstawie stanu silnika.
+     */
+    void SetConverged(bool converged);
+
     virtual void Resolve() override;
 
 private:
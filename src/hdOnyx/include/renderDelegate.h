@@ -49,10 +49,23 @@ public:
 
     HdAovDescriptor GetDefaultAovDescriptor(const TfToken& aovName) const override;
 
+    HdRenderSettingDescriptorList GetRenderSettingDescriptors() const override;
+
+    // Statystyki silnika (pamięć Embree, bufory geometrii, bufor promieni, bufory akumulacji, limit pamięci)
+    // oraz przepustowość integratora (onyx:integrator:*).
+    VtDictionary GetRenderStats() const override;
+
     bool IsPauseSupported() const override;
     bool Pause() override;
     bool Resume() override;
 
+    // Zatrzymanie renderowania w tle (np. przed odczytem buforów AOV). Wątek renderujący kończy bieżącą
+    // iterację i nie rozpoczyna kolejnych do wywołania Restart.
+    bool IsStopSupported() const override;
+    bool IsStopped() const override;
+    bool Stop(bool blocking = true) override;
+    bool Restart() override;
+
 private:
 
     static const TfTokenVector SUPPORTED_RPRIM_TYPES;
@@ -75,9 +88,19 @@ private:
     // oraz wskaźnik do backendu silnika w celu wywoływania modyfikacji danych.
     std::shared_ptr<HdOnyxRenderParam> m_RenderParam;
 
+    // Lista ustawień silnika udostępnianych użytkownikowi (Render Settings).
+    HdRenderSettingDescriptorList m_SettingDescriptors;
+
+    // Wersja ustawień która została ostatnio przekazana do backendu silnika.
+    // Pusta wartość wymusza przekazanie ustawień przy pierwszym wywołaniu CommitResources.
+    std::optional<unsigned int> m_SettingsVersion;
+
     void _Initialize();
     void _RenderCallback();
 
+    // Metoda tłumacząca mapę ustawień Hydra na strukturę ustawień silnika.
+    Onyx::RenderSettings _CreateBackendRenderSettings() const;
+
     HdOnyxRenderDelegate(const HdOnyxRenderDelegate &) = delete;
     HdOnyxRenderDelegate &operator =(const HdOnyxRenderDelegate &) = delete;
 };
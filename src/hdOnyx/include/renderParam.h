@@ -24,7 +24,6 @@ private:
 
     RTCDevice m_EmbreeDevice;
     Onyx::OnyxRenderer* m_RendererBackend;
-    std::shared_ptr<HdRenderThread> m_BackgroundRenderThread;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
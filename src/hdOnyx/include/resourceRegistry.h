@@ -0,0 +1,389 @@
+#pragma once
+
+#include <embree4/rtcore.h>
+
+#include <pxr/pxr.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/dictionary.h>
+#include <pxr/base/vt/types.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/imaging/hd/resourceRegistry.h>
+
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MaterialProgram.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Sposób powiązania danych primvar (wektory normalne, współrzędne tekstur) z trójkątami geometrii.
+enum class HdOnyxPrimvarInterpolation : uint8_t
+{
+    // Brak danych - silnik używa wektora geometrycznego trójkąta.
+    None,
+    // Jedna wartość na punkt geometrii (wektory normalne w pełnej precyzji interpoluje Embree).
+    Vertex,
+    // Trzy wartości na trójkąt (dane face-varying po triangulacji).
+    FaceVarying
+};
+
+
+// Wektory normalne cieniowania geometrii. Wektory są przechowywane w pełnej precyzji
+// lub zakodowane oktaedralnie w 32 bitach (2 x 16 bit), co zmniejsza bufor trzykrotnie.
+struct HdOnyxShadingNormals
+{
+    HdOnyxPrimvarInterpolation Interpolation = HdOnyxPrimvarInterpolation::None;
+
+    VtVec3fArray Normals;
+
+    // Wektory zakodowane oktaedralnie. Zastępują bufor Normals (pusty po kwantyzacji).
+    VtArray<uint32_t> QuantizedNormals;
+
+
+    bool HasNormals() const { return Interpolation != HdOnyxPrimvarInterpolation::None; }
+
+    bool IsQuantized() const { return !QuantizedNormals.empty(); }
+
+    size_t Size() const { return IsQuantized() ? QuantizedNormals.size() : Normals.size(); }
+
+    size_t ByteSize() const { return Normals.size() * sizeof(GfVec3f) + QuantizedNormals.size() * sizeof(uint32_t); }
+
+    // Zwraca wektor (object-space) o wskazanym indeksie niezależnie od sposobu przechowywania.
+    GfVec3f GetNormal(size_t index) const
+    {
+        return IsQuantized() ? DecodeOctahedral(QuantizedNormals[index]) : Normals[index];
+    }
+
+    // Zastępuje wektory pełnej precyzji wektorami zakodowanymi oktaedralnie.
+    void Quantize();
+
+    static uint32_t EncodeOctahedral(const GfVec3f& normal);
+
+    static GfVec3f DecodeOctahedral(uint32_t encodedNormal)
+    {
+        float u = float(int16_t(encodedNormal & 0xFFFF)) / 32767.0f;
+        float v = float(int16_t(encodedNormal >> 16)) / 32767.0f;
+        float z = 1.0f - std::abs(u) - std::abs(v);
+
+        // Dolna półsfera jest zapisana w "rozłożonych" narożnikach kwadratu.
+        if (z < 0.0f)
+        {
+            float foldedU = (1.0f - std::abs(v)) * std::copysign(1.0f, u);
+            float foldedV = (1.0f - std::abs(u)) * std::copysign(1.0f, v);
+            u = foldedU;
+            v = foldedV;
+        }
+
+        return GfVec3f(u, v, z).GetNormalized();
+    }
+
+    bool operator==(const HdOnyxShadingNormals& other) const
+    {
+        return Interpolation == other.Interpolation
+            && Normals == other.Normals
+            && QuantizedNormals == other.QuantizedNormals;
+    }
+};
+
+
+// Współrzędne tekstur geometrii (primvar "st") używane przez tekstury materiałów (UsdUVTexture).
+struct HdOnyxTextureCoordinates
+{
+    HdOnyxPrimvarInterpolation Interpolation = HdOnyxPrimvarInterpolation::None;
+
+    VtVec2fArray Coordinates;
+
+
+    bool HasCoordinates() const { return Interpolation != HdOnyxPrimvarInterpolation::None; }
+
+    size_t ByteSize() const { return Coordinates.size() * sizeof(GfVec2f); }
+
+    bool operator==(const HdOnyxTextureCoordinates& other) const
+    {
+        return Interpolation == other.Interpolation && Coordinates == other.Coordinates;
+    }
+};
+
+
+// Geometria (BLAS) współdzielona przez wszystkie meshe o identycznych danych.
+// Bufory punktów oraz indeksów są współdzielone z geometrią Embree (rtcSetSharedGeometryBuffer),
+// dlatego ich czas życia jest powiązany z czasem życia sceny Embree.
+struct HdOnyxSharedGeometry
+{
+    // Struktura przyspieszenia intersekcji zbudowana z jednej geometrii trójkątów.
+    // Meshe tworzą instancje tej sceny w głównej scenie silnika.
+    RTCScene Scene = nullptr;
+    RTCGeometry Geometry = nullptr;
+
+    VtVec3fArray PointArray;
+    VtVec3iArray IndexArray;
+
+    // Opcjonalne wektory normalne używane do wygładzenia powierzchni. Wektory typu "vertex" w pełnej precyzji
+    // są przekazywane do Embree jako bufor atrybutu wierzchołków (rtcInterpolate).
+    HdOnyxShadingNormals ShadingNormals;
+
+    // Opcjonalne współrzędne tekstur. Nie są przekazywane do Embree - interpoluje je integrator.
+    HdOnyxTextureCoordinates TextureCoordinates;
+
+    // Skrót danych geometrii będący kluczem w pamięci podręcznej rejestru.
+    uint64_t ContentHash = 0;
+
+    // Geometria deformowana nie jest współdzielona (brak wpisu w pamięci podręcznej),
+    // jej punkty są aktualizowane w miejscu bez tworzenia nowej sceny Embree.
+    bool Deforming = false;
+};
+
+using HdOnyxSharedGeometryHandle = std::shared_ptr<const HdOnyxSharedGeometry>;
+
+// Uchwyt geometrii deformowanej należącej do jednego mesha - pozwala na modyfikację bufora punktów.
+using HdOnyxDeformingGeometryHandle = std::shared_ptr<HdOnyxSharedGeometry>;
+
+
+// Sieć węzłów materiału w postaci kanonicznej - niezależnej od ścieżek węzłów w scenie, dzięki czemu
+// identyczne sieci tysięcy materiałów (np. kopie jednego materiału z teksturą) dają ten sam klucz.
+// Klucz pamięci podręcznej kompilacji programów materiałów.
+struct HdOnyxMaterialNetworkKey
+{
+    // Połączenie wejścia węzła z wyjściem węzła poprzedzającego (indeks w tablicy Nodes).
+    struct Connection
+    {
+        TfToken InputName;
+        uint32_t UpstreamNode;
+        TfToken UpstreamOutput;
+
+        bool operator==(const Connection& other) const
+        {
+            return InputName == other.InputName && UpstreamNode == other.UpstreamNode
+                && UpstreamOutput == other.UpstreamOutput;
+        }
+    };
+
+    struct Node
+    {
+        TfToken NodeType;
+
+        // Parametry posortowane nazwą (kolejność mapy parametrów sieci).
+        std::vector<std::pair<TfToken, VtValue>> Parameters;
+        std::vector<Connection> Connections;
+
+        bool operator==(const Node& other) const
+        {
+            return NodeType == other.NodeType && Parameters == other.Parameters && Connections == other.Connections;
+        }
+    };
+
+    // Węzły osiągalne z węzła powierzchni w kolejności post-order - węzeł poprzedzający ma zawsze mniejszy
+    // indeks niż węzły z niego korzystające. Ostatni węzeł jest węzłem powierzchni (UsdPreviewSurface).
+    std::vector<Node> Nodes;
+
+    uint64_t Hash = 0;
+
+
+    const Node& GetSurfaceNode() const { return Nodes.back(); }
+
+    bool operator==(const HdOnyxMaterialNetworkKey& other) const
+    {
+        return Hash == other.Hash && Nodes == other.Nodes;
+    }
+};
+
+using HdOnyxMaterialProgramHandle = std::shared_ptr<const Onyx::MaterialProgram>;
+
+
+// Rejestr zasobów Render Delegate. Przechowuje pamięć podręczną geometrii indeksowaną
+// skrótem danych (punkty, indeksy, wektory normalne, współrzędne tekstur). Meshe o identycznych danych
+// otrzymują ten sam uchwyt - geometria Embree jest budowana tylko raz, a każdy duplikat
+// jest jedynie instancją w głównej scenie silnika. Rejestr przechowuje również pamięć podręczną
+// programów materiałów indeksowaną kanoniczną postacią sieci węzłów materiału.
+class HdOnyxResourceRegistry final : public HdResourceRegistry
+{
+public:
+
+    HdOnyxResourceRegistry() = default;
+    ~HdOnyxResourceRegistry() override = default;
+
+    /**
+     * Metoda zwracająca geometrię dla przekazanych danych. Jeśli geometria o identycznych danych
+     * istnieje, zwracany jest jej uchwyt. W przeciwnym wypadku tworzona jest nowa geometria Embree.
+     * Geometria jest zwalniana gdy ostatni uchwyt przestaje istnieć.
+     * @note Metoda może być wywoływana równolegle przez wiele wątków synchronizacji Hydra.
+     * BVH geometrii jest budowane poza sekcją krytyczną, dzięki czemu meshe o różnych danych budują
+     * swoje geometrie równolegle.
+     * @param embreeDevice Urządzenie Embree tworzące zasoby.
+     * @param points Bufor punktów geometrii.
+     * @param indices Bufor ztriangulowanych indeksów punktów.
+     * @param shadingNormals Opcjonalne wektory normalne (vertex lub ztriangulowane face-varying).
+     * @param textureCoordinates Opcjonalne współrzędne tekstur (vertex lub ztriangulowane face-varying).
+     * @return Uchwyt współdzielonej geometrii.
+     */
+    HdOnyxSharedGeometryHandle GetOrCreateGeometry(
+        RTCDevice embreeDevice,
+        const VtVec3fArray& points,
+        const VtVec3iArray& indices,
+        const HdOnyxShadingNormals& shadingNormals,
+        const HdOnyxTextureCoordinates& textureCoordinates);
+
+    /**
+     * Metoda tworząca prywatną geometrię dla mesha którego punkty zmieniają się w czasie (symulacja, skinning).
+     * Geometria nie trafia do pamięci podręcznej, a jej scena Embree jest przygotowana do częstych aktualizacji.
+     * @param embreeDevice Urządzenie Embree tworzące zasoby.
+     * @param points Bufor punktów geometrii.
+     * @param indices Bufor ztriangulowanych indeksów punktów.
+     * @param shadingNormals Opcjonalne wektory normalne (vertex lub ztriangulowane face-varying).
+     * @param textureCoordinates Opcjonalne współrzędne tekstur (vertex lub ztriangulowane face-varying).
+     * @param updateQuality Jakość aktualizacji BVH: RTC_BUILD_QUALITY_REFIT (dopasowanie brył ograniczających
+     * bez zmiany struktury drzewa) lub RTC_BUILD_QUALITY_LOW (szybka przebudowa).
+     * @return Uchwyt geometrii deformowanej.
+     */
+    HdOnyxDeformingGeometryHandle CreateDeformingGeometry(
+        RTCDevice embreeDevice,
+        const VtVec3fArray& points,
+        const VtVec3iArray& indices,
+        const HdOnyxShadingNormals& shadingNormals,
+        const HdOnyxTextureCoordinates& textureCoordinates,
+        RTCBuildQuality updateQuality);
+
+    /**
+     * Metoda aktualizująca punkty geometrii deformowanej. Topologia (liczba punktów, indeksy) musi pozostać
+     * bez zmian. Scena Embree oraz geometria są ponownie używane, BVH jest dopasowywane lub szybko przebudowane.
+     * @param deformingGeometry Geometria deformowana utworzona przez CreateDeformingGeometry.
+     * @param points Nowy bufor punktów o niezmienionym rozmiarze.
+     * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany - meshe kolejkują
+     * aktualizację w silniku (OnyxRenderer::QueueSceneUpdate).
+     */
+    void UpdateDeformingGeometryPoints(HdOnyxSharedGeometry& deformingGeometry, const VtVec3fArray& points);
+
+    /**
+     * Metoda aktualizująca wektory normalne geometrii deformowanej (np. normalne zmieniające się wraz z punktami).
+     * Interpolacja oraz liczba wektorów muszą pozostać bez zmian. Wektory "vertex" w pełnej precyzji są
+     * podmieniane w buforze atrybutu wierzchołków Embree, pozostałe są odczytywane przez integrator z geometrii.
+     * Scena Embree nie jest zatwierdzana - zmiana wektorów nie zmienia BVH, a scenę zatwierdza aktualizacja
+     * punktów lub wywołujący.
+     * @param deformingGeometry Geometria deformowana utworzona przez CreateDeformingGeometry.
+     * @param shadingNormals Nowe wektory normalne (przed kwantyzacją).
+     * @note Wywołanie jest bezpieczne jedynie gdy wątek renderujący jest zatrzymany - meshe kolejkują
+     * aktualizację w silniku (OnyxRenderer::QueueSceneUpdate).
+     */
+    void UpdateDeformingGeometryNormals(
+        HdOnyxSharedGeometry& deformingGeometry,
+        const HdOnyxShadingNormals& shadingNormals);
+
+    /**
+     * Metoda zwracająca program materiału dla sieci węzłów. Jeśli identyczna sieć została już skompilowana,
+     * zwracany jest istniejący program - materiały o identycznych sieciach współdzielą program,
+     * a rejestr materiałów silnika deduplikuje je porównaniem wskaźników.
+     * Program jest zwalniany gdy ostatni materiał przestaje z niego korzystać.
+     * @note Metoda może być wywoływana równolegle. Kompilacja odbywa się poza sekcją krytyczną.
+     * @param networkKey Kanoniczna postać sieci materiału (HdOnyxMaterialCompiler::BuildNetworkKey).
+     * @param compileProgram Funkcja kompilująca program (wywoływana jedynie przy braku programu w pamięci).
+     * @return Uchwyt programu lub nullptr jeśli sieć nie wymaga programu.
+     */
+    HdOnyxMaterialProgramHandle GetOrCompileMaterialProgram(
+        const HdOnyxMaterialNetworkKey& networkKey,
+        const std::function<HdOnyxMaterialProgramHandle()>& compileProgram);
+
+    /**
+     * Metoda przełączająca budowę nowych geometrii w tryb oszczędzania pamięci (RTC_SCENE_FLAG_COMPACT).
+     * Używana przez Render Delegate po przekroczeniu limitu pamięci silnika.
+     */
+    void SetCompactBuild(bool compactBuild) { m_CompactBuild = compactBuild; }
+
+    /**
+     * Metoda włączająca kwantyzację (kodowanie oktaedralne) wektorów normalnych nowych geometrii.
+     */
+    void SetNormalQuantization(bool quantizeNormals) { m_QuantizeNormals = quantizeNormals; }
+
+    /**
+     * @return Rozmiar buforów punktów, indeksów, wektorów normalnych i współrzędnych tekstur
+     * wszystkich geometrii (w bajtach).
+     * Bufory są współdzielone z Embree, dlatego nie są uwzględnione w pamięci raportowanej przez urządzenie.
+     */
+    size_t GetGeometryBufferBytes() const { return *m_GeometryBufferBytes; }
+
+    /**
+     * @return Statystyki pamięci podręcznej geometrii oraz programów materiałów
+     * (liczba unikalnych zasobów, trafienia, chybienia).
+     */
+    VtDictionary GetResourceAllocation() const override;
+
+protected:
+
+    // Usuwa z pamięci podręcznej wpisy geometrii oraz programów materiałów które nie posiadają już uchwytów.
+    void _GarbageCollect() override;
+
+private:
+
+    static uint64_t ComputeContentHash(
+        const VtVec3fArray& points,
+        const VtVec3iArray& indices,
+        const HdOnyxShadingNormals& shadingNormals,
+        const HdOnyxTextureCoordinates& textureCoordinates);
+
+    // Szuka geometrii o identycznych danych w pamięci podręcznej. Wymaga blokady m_GeometryCacheMutex.
+    HdOnyxSharedGeometryHandle FindCachedGeometry(
+        uint64_t contentHash,
+        const VtVec3fArray& points,
+        const VtVec3iArray& indices,
+        const HdOnyxShadingNormals& shadingNormals,
+        const HdOnyxTextureCoordinates& textureCoordinates) const;
+
+    HdOnyxSharedGeometryHandle CreateGeometry(
+        RTCDevice embreeDevice,
+        const VtVec3fArray& points,
+        const VtVec3iArray& indices,
+        const HdOnyxShadingNormals& shadingNormals,
+        const HdOnyxTextureCoordinates& textureCoordinates,
+        uint64_t contentHash,
+        RTCBuildQuality buildQuality = RTC_BUILD_QUALITY_MEDIUM,
+        bool deforming = false);
+
+    mutable std::mutex m_GeometryCacheMutex;
+
+    // Kolizje skrótu są możliwe, dlatego jeden skrót może wskazywać na wiele geometrii.
+    // Rejestr nie przedłuża czasu życia geometrii (słabe wskaźniki).
+    std::unordered_multimap<uint64_t, std::weak_ptr<const HdOnyxSharedGeometry>> m_GeometryCache;
+
+    size_t m_GeometryCacheHits = 0;
+    size_t m_GeometryCacheMisses = 0;
+
+    // Liczba geometrii zbudowanych równolegle przez dwa wątki dla identycznych danych (kopia została odrzucona).
+    size_t m_GeometryBuildRaces = 0;
+
+    std::atomic<bool> m_CompactBuild = false;
+    std::atomic<bool> m_QuantizeNormals = false;
+
+    // Licznik współdzielony z funkcją zwalniającą geometrię (może zostać wywołana po usunięciu rejestru).
+    std::shared_ptr<std::atomic<size_t>> m_GeometryBufferBytes = std::make_shared<std::atomic<size_t>>(0);
+
+    // Liczba aktualizacji punktów geometrii deformowanych (bez tworzenia nowych scen Embree).
+    std::atomic<size_t> m_DeformingGeometryUpdates = 0;
+
+    // Wpis pamięci podręcznej programów - klucz jest przechowywany do porównania przy kolizji skrótu.
+    struct MaterialProgramCacheEntry
+    {
+        HdOnyxMaterialNetworkKey NetworkKey;
+        std::weak_ptr<const Onyx::MaterialProgram> Program;
+    };
+
+    mutable std::mutex m_MaterialProgramCacheMutex;
+
+    std::unordered_multimap<uint64_t, MaterialProgramCacheEntry> m_MaterialProgramCache;
+
+    size_t m_MaterialProgramCacheHits = 0;
+    size_t m_MaterialProgramCacheMisses = 0;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,192 @@
+#include "instancer.h"
+
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/sceneDelegate.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/quatd.h>
+#include <pxr/base/gf/quatf.h>
+#include <pxr/base/gf/quath.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/diagnostic.h>
+
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+namespace
+{
+    // Pobiera tablicę danych instancji pod jedną z nazw primvara.
+    // Nowsze wersje OpenUSD używają nazw "instanceTranslations" itd., starsze "translate" itd.
+    template<typename ArrayType>
+    const ArrayType* FindInstancePrimvar(
+        const std::unordered_map<TfToken, VtValue, TfToken::HashFunctor>& primvarMap,
+        const TfToken& name,
+        const TfToken& legacyName)
+    {
+        for (const TfToken& token : {name, legacyName})
+        {
+            auto primvarIt = primvarMap.find(token);
+            if (primvarIt != primvarMap.end() && primvarIt->second.IsHolding<ArrayType>())
+            {
+                return &primvarIt->second.UncheckedGet<ArrayType>();
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    template<typename QuatType>
+    GfMatrix4d GetRotationMatrix(const QuatType& rotation)
+    {
+        GfMatrix4d rotationMatrix(1.0);
+        rotationMatrix.SetRotate(GfQuatd(rotation.GetReal(), GfVec3d(rotation.GetImaginary())));
+        return rotationMatrix;
+    }
+}
+
+
+HdOnyxInstancer::HdOnyxInstancer(HdSceneDelegate* delegate, SdfPath const& id)
+: HdInstancer(delegate, id)
+{
+
+}
+
+
+void HdOnyxInstancer::Sync(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam, HdDirtyBits* dirtyBits)
+{
+    // Aktualizujemy powiązanie z instancerem nadrzędnym (zagnieżdżony instancing).
+    _UpdateInstancer(sceneDelegate, dirtyBits);
+
+    if (HdChangeTracker::IsAnyPrimvarDirty(*dirtyBits, GetId()))
+    {
+        SyncPrimvars(sceneDelegate, *dirtyBits);
+    }
+}
+
+
+void HdOnyxInstancer::SyncPrimvars(HdSceneDelegate* sceneDelegate, HdDirtyBits dirtyBits)
+{
+    std::lock_guard<std::mutex> instanceLock(m_InstanceLock);
+
+    const SdfPath& instancerID = GetId();
+
+    const HdPrimvarDescriptorVector primvars =
+        sceneDelegate->GetPrimvarDescriptors(instancerID, HdInterpolationInstance);
+
+    for (const HdPrimvarDescriptor& primvar : primvars)
+    {
+        if (!HdChangeTracker::IsPrimvarDirty(dirtyBits, instancerID, primvar.name))
+        {
+            continue;
+        }
+
+        VtValue primvarValue = sceneDelegate->Get(instancerID, primvar.name);
+        if (primvarValue.IsEmpty())
+        {
+            m_PrimvarMap.erase(primvar.name);
+            continue;
+        }
+
+        m_PrimvarMap[primvar.name] = primvarValue;
+    }
+}
+
+
+VtMatrix4dArray HdOnyxInstancer::ComputeInstanceTransforms(SdfPath const& prototypeId)
+{
+    HdSceneDelegate* sceneDelegate = GetDelegate();
+    const SdfPath& instancerID = GetId();
+
+    // Indeksy instancji wskazują które elementy tablic primvarów należą do danego prototypu.
+    const VtIntArray instanceIndices = sceneDelegate->GetInstanceIndices(instancerID, prototypeId);
+    const GfMatrix4d instancerTransform = sceneDelegate->GetInstancerTransform(instancerID);
+
+    VtMatrix4dArray instanceTransforms(instanceIndices.size());
+
+    {
+        std::lock_guard<std::mutex> instanceLock(m_InstanceLock);
+
+        const auto* translations = FindInstancePrimvar<VtVec3fArray>(
+            m_PrimvarMap, HdInstancerTokens->instanceTranslations, HdInstancerTokens->translate);
+        const auto* rotationsHalf = FindInstancePrimvar<VtQuathArray>(
+            m_PrimvarMap, HdInstancerTokens->instanceRotations, HdInstancerTokens->rotate);
+        const auto* rotationsFloat = FindInstancePrimvar<VtQuatfArray>(
+            m_PrimvarMap, HdInstancerTokens->instanceRotations, HdInstancerTokens->rotate);
+        const auto* scales = FindInstancePrimvar<VtVec3fArray>(
+            m_PrimvarMap, HdInstancerTokens->instanceScales, HdInstancerTokens->scale);
+        const auto* transforms = FindInstancePrimvar<VtMatrix4dArray>(
+            m_PrimvarMap, HdInstancerTokens->instanceTransforms, HdInstancerTokens->instanceTransform);
+
+        // Konwencja wektorów wierszowych: transformacja = instanceTransform * scale * rotate * translate * instancer.
+        for (size_t instance = 0; instance < instanceIndices.size(); instance++)
+        {
+            const size_t dataIndex = instanceIndices[instance];
+            GfMatrix4d instanceTransform = instancerTransform;
+
+            if (translations && dataIndex < translations->size())
+            {
+                GfMatrix4d translateMatrix(1.0);
+                translateMatrix.SetTranslate(GfVec3d((*translations)[dataIndex]));
+                instanceTransform = translateMatrix * instanceTransform;
+            }
+
+            if (rotationsHalf && dataIndex < rotationsHalf->size())
+            {
+                instanceTransform = GetRotationMatrix((*rotationsHalf)[dataIndex]) * instanceTransform;
+            }
+            else if (rotationsFloat && dataIndex < rotationsFloat->size())
+            {
+                instanceTransform = GetRotationMatrix((*rotationsFloat)[dataIndex]) * instanceTransform;
+            }
+
+            if (scales && dataIndex < scales->size())
+            {
+                GfMatrix4d scaleMatrix(1.0);
+                scaleMatrix.SetScale(GfVec3d((*scales)[dataIndex]));
+                instanceTransform = scaleMatrix * instanceTransform;
+            }
+
+            if (transforms && dataIndex < transforms->size())
+            {
+                instanceTransform = (*transforms)[dataIndex] * instanceTransform;
+            }
+
+            instanceTransforms[instance] = instanceTransform;
+        }
+    }
+
+    if (GetParentId().IsEmpty())
+    {
+        return instanceTransforms;
+    }
+
+    // Zagnieżdżony instancer - każda kopia tego instancera jest powielana
+    // przez każdą kopię instancera nadrzędnego.
+    auto* parentInstancer = static_cast<HdOnyxInstancer*>(
+        sceneDelegate->GetRenderIndex().GetInstancer(GetParentId()));
+
+    if (!TF_VERIFY(parentInstancer))
+    {
+        return instanceTransforms;
+    }
+
+    const VtMatrix4dArray parentTransforms = parentInstancer->ComputeInstanceTransforms(instancerID);
+
+    VtMatrix4dArray nestedTransforms(parentTransforms.size() * instanceTransforms.size());
+    for (size_t parent = 0; parent < parentTransforms.size(); parent++)
+    {
+        for (size_t instance = 0; instance < instanceTransforms.size(); instance++)
+        {
+            nestedTransforms[parent * instanceTransforms.size() + instance] =
+                instanceTransforms[instance] * parentTransforms[parent];
+        }
+    }
+
+    return nestedTransforms;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -60,7 +60,8 @@ void pxr::HdOnyxLight::Sync(HdSceneDelegate* sceneDelegate, HdRenderParam* rende
         m_ParameterScalingTransformation = GfMatrix4d().SetScale(GfVec3d(width, height, 1.0));
     }
 
-    if (newLight || dirtyTransformFlag)
+    // Zmiana rozmiaru światła (parametry) również wymaga ponownego obliczenia transformacji instancji.
+    if (newLight || dirtyTransformFlag || dirtyParamsFlag)
     {
         // Pobieramy nową macierz transformacji.
         m_InstanceTransformation = sceneDelegate->GetTransform(primID);
@@ -71,27 +72,40 @@ void pxr::HdOnyxLight::Sync(HdSceneDelegate* sceneDelegate, HdRenderParam* rende
 
     auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
 
-    // Transformacja uwzględnia skalowanie parametrów oraz macierzy transformacji.
-    // Moc emisji uwzględnia intensity oraz exposure wraz z kolorem emisji.
-    // Ustawiamy flagę Light w celu rozróżnienia instancji geometrii i świateł
-    // które są zdefiniowanej w tej samej globalnej scenie silnika.
-    m_LightInstanceData = HdOnyxInstanceData{
-        .Light = true,
-        .DataIndexInBuffer = 0,
-        .SmoothNormalsArray = nullptr,
-        .TransformMatrix = GfMatrix4f(m_InstanceTransformation),
-    };
+    if (!m_LightIndexInBuffer.has_value())
+    {
+        // Transformacja uwzględnia skalowanie parametrów oraz macierzy transformacji.
+        // Moc emisji uwzględnia intensity oraz exposure wraz z kolorem emisji.
+        // Dodajemy instancję światła do sceny - silnik rezerwuje miejsce w buforze świateł i zwraca jego indeks,
+        // a instancję (wraz ze strukturą pomocniczą) tworzy po zatrzymaniu wątku renderującego.
+        m_LightIndexInBuffer = onyxRenderParam->GetRendererHandle()->AttachLightInstanceToScene(
+            GfMatrix4f(m_InstanceTransformation),
+            m_TotalEmissivePower
+        );
+    }
+    else if (dirtyTransformFlag || dirtyParamsFlag)
+    {
+        // Światło jest już podpięte do sceny - aktualizujemy istniejącą instancję w miejscu,
+        // zachowując jej identyfikator w scenie oraz indeks w buforze świateł.
+        // Struktura pomocnicza instancji jest odczytywana przez wątek renderujący - aktualizację wykonuje silnik
+        // po jego zatrzymaniu.
+        onyxRenderParam->GetRendererHandle()->UpdateLightInstance(
+            m_LightIndexInBuffer.value(),
+            GfMatrix4f(m_InstanceTransformation),
+            m_TotalEmissivePower
+        );
+    }
 
+    *dirtyBits = HdLight::Clean;
+}
 
-    // Dodajemy instancję światła do sceny.
-    // Metoda zwróci indeks pod jakim światło
-    auto lightIndexInBuffer = onyxRenderParam->GetRendererHandle()->AttachLightInstanceToScene(
-        &m_LightInstanceData,
-        m_TotalEmissivePower
-    );
 
-    // Aktualizujemy indeks do bufora danych świateł po wysłaniu danych do silnika.
-    m_LightInstanceData.DataIndexInBuffer = lightIndexInBuffer;
+void pxr::HdOnyxLight::Finalize(HdRenderParam* renderParam)
+{
+    if (!m_LightIndexInBuffer.has_value()) return;
 
-    *dirtyBits = HdLight::Clean;
-}
\ No newline at end of file
+    auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
+    onyxRenderParam->GetRendererHandle()->DetachLightInstance(m_LightIndexInBuffer.value());
+
+    m_LightIndexInBuffer = std::nullopt;
+}
@@ -3,7 +3,9 @@
 #include <iostream>
 #include <pxr/imaging/hd/sceneDelegate.h>
 
+#include "materialCompiler.h"
 #include "renderParam.h"
+#include "resourceRegistry.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -16,7 +18,6 @@ TF_DEFINE_PRIVATE_TOKENS(m_PrivateTokens,
 );
 
 
-
 HdOnyxMaterial::HdOnyxMaterial(SdfPath const& id)
 :HdMaterial(id)
 {}
@@ -38,16 +39,12 @@ void HdOnyxMaterial::Sync(
     // Pobieramy unikalne ID prima typu Mesh
     auto& primID = GetId();
 
-    // Flaga wskazująca na to czy mesh został zsynchronizowany pierwszy raz.
-    bool newMaterial = false;
-
     auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
 
     // Warunek będzie prawdziwy tylko dla całkowicie nowych obiektów
     if (*dirtyBits == AllDirty)
     {
         std::cout << "[hdOnyx] - Utworzono nowy materiał: " << primID.GetString() << std::endl;
-        newMaterial = true;
     }
 
     // Materiały w USD są reprezentowane jako sieć połączeń komórek (nodes).
@@ -97,30 +94,52 @@ void HdOnyxMaterial::Sync(
         previewSurfaceNode = node.second;
     }
 
-    pxr::GfVec3f diffuseColor;
-    float indexOfRefraction;
+    // Parametry nieobecne w sieci przyjmują wartości domyślne UsdPreviewSurface.
+    // Pełna inicjalizacja jest wymagana - parametry są kluczem deduplikacji materiałów.
+    Onyx::MaterialParameters materialParameters;
 
     for (auto& nodeParameter : previewSurfaceNode->parameters)
     {
         if(nodeParameter.first == m_PrivateTokens->diffuseColor)
         {
-            diffuseColor = nodeParameter.second.GetWithDefault<GfVec3f>(GfVec3f{0.18, 0.18, 0.18});
+            materialParameters.DiffuseColor =
+                nodeParameter.second.GetWithDefault<GfVec3f>(GfVec3f{0.18, 0.18, 0.18});
         }
         else if(nodeParameter.first == m_PrivateTokens->ior)
         {
-            indexOfRefraction = nodeParameter.second.GetWithDefault<float>(1.5);
+            materialParameters.IOR = nodeParameter.second.GetWithDefault<float>(1.5);
         }
     }
 
-    // Jeśli dotarliśmy tutaj, pobraliśmy dane materiału.
-    onyxRenderParam->GetRendererHandle()->AttachOrUpdateMaterial(
-        diffuseColor, indexOfRefraction, primID, newMaterial
-    );
+    // Sieć węzłów podłączonych do wejść UsdPreviewSurface jest kompilowana do programu materiału, który zastępuje
+    // wartości stałe parametrów. Identyczne sieci (niezależnie od ścieżek węzłów) współdzielą jeden program.
+    HdOnyxMaterialNetworkKey networkKey =
+        HdOnyxMaterialCompiler::BuildNetworkKey(materialGraph, surfaceOutput->second.upstreamNode);
+
+    auto resourceRegistry = std::static_pointer_cast<HdOnyxResourceRegistry>(
+        sceneDelegate->GetRenderIndex().GetResourceRegistry());
+
+    materialParameters.Program = resourceRegistry->GetOrCompileMaterialProgram(networkKey, [&]()
+    {
+        return HdOnyxMaterialCompiler(networkKey, onyxRenderParam->GetRendererHandle()).Compile();
+    });
+
+    // Jeśli dotarliśmy tutaj, pobraliśmy dane materiału. Parametry są aktualizowane w miejscu,
+    // uchwyt materiału przechowywany przez geometrię nie ulega zmianie.
+    m_MaterialBufferID = onyxRenderParam->GetRendererHandle()->AttachOrUpdateMaterial(materialParameters, primID);
 
 
     *dirtyBits = Clean;
 }
 
 
+void HdOnyxMaterial::Finalize(HdRenderParam* renderParam)
+{
+    // Geometria powiązana z usuniętym materiałem używa od teraz materiału domyślnego.
+    auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
+    onyxRenderParam->GetRendererHandle()->DetachMaterial(GetId());
+}
+
+
 
 PXR_NAMESPACE_CLOSE_SCOPE
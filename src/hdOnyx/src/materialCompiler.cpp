@@ -0,0 +1,443 @@
+#include "materialCompiler.h"
+
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/usd/sdf/assetPath.h>
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <string>
+
+#include "OnyxRenderer.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Węzły, wejścia oraz wyjścia sieci UsdPreviewSurface obsługiwane przez kompilator.
+TF_DEFINE_PRIVATE_TOKENS(m_CompilerTokens,
+    (diffuseColor)
+    (UsdUVTexture)
+    (UsdPrimvarReader_float2)
+    (UsdTransform2d)
+    (file)
+    (st)
+    (wrapS)
+    (wrapT)
+    (scale)
+    (bias)
+    (fallback)
+    (sourceColorSpace)
+    (varname)
+    (rotation)
+    (translation)
+    (in)
+    (rgb)
+    (r)
+    (g)
+    (b)
+    (a)
+    (clamp)
+    (mirror)
+    (black)
+    (raw)
+    (sRGB)
+);
+
+
+namespace
+{
+    constexpr uint32_t InvalidNodeIndex = std::numeric_limits<uint32_t>::max();
+
+
+    // Wartość parametru jako wektor trzech składowych (kolor lub współrzędne tekstury z zerową składową Z).
+    GfVec3f GetVectorValue(const VtValue* value, const GfVec3f& fallback)
+    {
+        if (!value) return fallback;
+
+        if (value->IsHolding<GfVec3f>()) return value->UncheckedGet<GfVec3f>();
+
+        if (value->IsHolding<GfVec4f>())
+        {
+            const GfVec4f& vector = value->UncheckedGet<GfVec4f>();
+            return GfVec3f(vector[0], vector[1], vector[2]);
+        }
+
+        if (value->IsHolding<GfVec2f>())
+        {
+            const GfVec2f& vector = value->UncheckedGet<GfVec2f>();
+            return GfVec3f(vector[0], vector[1], 0.0f);
+        }
+
+        if (value->IsHolding<float>()) return GfVec3f(value->UncheckedGet<float>());
+
+        return fallback;
+    }
+
+
+    Onyx::TextureWrap GetTextureWrap(const VtValue* value)
+    {
+        TfToken wrap = value ? value->GetWithDefault<TfToken>() : TfToken();
+
+        if (wrap == m_CompilerTokens->clamp) return Onyx::TextureWrap::Clamp;
+        if (wrap == m_CompilerTokens->mirror) return Onyx::TextureWrap::Mirror;
+        if (wrap == m_CompilerTokens->black) return Onyx::TextureWrap::Black;
+
+        // Wartość "useMetadata" (brak metadanych w pliku) oraz wartości nieznane traktujemy jako "repeat".
+        return Onyx::TextureWrap::Repeat;
+    }
+
+
+    Onyx::MaterialChannel GetTextureChannel(const TfToken& outputName)
+    {
+        if (outputName == m_CompilerTokens->r) return Onyx::MaterialChannel::R;
+        if (outputName == m_CompilerTokens->g) return Onyx::MaterialChannel::G;
+        if (outputName == m_CompilerTokens->b) return Onyx::MaterialChannel::B;
+        if (outputName == m_CompilerTokens->a) return Onyx::MaterialChannel::A;
+
+        return Onyx::MaterialChannel::RGB;
+    }
+
+
+    void CombineHash(uint64_t& hash, size_t value)
+    {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    }
+}
+
+
+HdOnyxMaterialNetworkKey HdOnyxMaterialCompiler::BuildNetworkKey(
+    const HdMaterialNetwork2& materialGraph,
+    const SdfPath& surfaceNodePath)
+{
+    HdOnyxMaterialNetworkKey networkKey;
+
+    std::map<SdfPath, uint32_t> nodeIndices;
+    std::set<SdfPath> visitedNodes;
+
+    // Przejście w głąb (post-order) - węzły poprzedzające trafiają do klucza przed węzłami z nich korzystającymi.
+    std::function<uint32_t(const SdfPath&)> addNode = [&](const SdfPath& nodePath) -> uint32_t
+    {
+        auto nodeIndex = nodeIndices.find(nodePath);
+        if (nodeIndex != nodeIndices.end()) return nodeIndex->second;
+
+        // Węzeł odwiedzany (nie posiada jeszcze indeksu) - połączenie zamyka cykl.
+        if (visitedNodes.count(nodePath)) return InvalidNodeIndex;
+
+        auto materialNode = materialGraph.nodes.find(nodePath);
+        if (materialNode == materialGraph.nodes.end()) return InvalidNodeIndex;
+
+        visitedNodes.insert(nodePath);
+
+        HdOnyxMaterialNetworkKey::Node node;
+        node.NodeType = materialNode->second.nodeTypeId;
+        node.Parameters.assign(materialNode->second.parameters.begin(), materialNode->second.parameters.end());
+
+        for (auto& inputConnection : materialNode->second.inputConnections)
+        {
+            if (inputConnection.second.empty()) continue;
+
+            const HdMaterialConnection2& connection = inputConnection.second.front();
+
+            uint32_t upstreamNode = addNode(connection.upstreamNode);
+            if (upstreamNode == InvalidNodeIndex) continue;
+
+            node.Connections.push_back({inputConnection.first, upstreamNode, connection.upstreamOutputName});
+        }
+
+        networkKey.Nodes.push_back(std::move(node));
+
+        uint32_t addedNodeIndex = uint32_t(networkKey.Nodes.size() - 1);
+        nodeIndices[nodePath] = addedNodeIndex;
+
+        return addedNodeIndex;
+    };
+
+    addNode(surfaceNodePath);
+
+    // Skrót nie zależy od ścieżek węzłów - jedynie od ich typów, parametrów oraz połączeń.
+    for (const HdOnyxMaterialNetworkKey::Node& node : networkKey.Nodes)
+    {
+        CombineHash(networkKey.Hash, node.NodeType.Hash());
+
+        for (auto& parameter : node.Parameters)
+        {
+            CombineHash(networkKey.Hash, parameter.first.Hash());
+            CombineHash(networkKey.Hash, parameter.second.GetHash());
+        }
+
+        for (const HdOnyxMaterialNetworkKey::Connection& connection : node.Connections)
+        {
+            CombineHash(networkKey.Hash, connection.InputName.Hash());
+            CombineHash(networkKey.Hash, connection.UpstreamNode);
+            CombineHash(networkKey.Hash, connection.UpstreamOutput.Hash());
+        }
+    }
+
+    return networkKey;
+}
+
+
+HdOnyxMaterialCompiler::HdOnyxMaterialCompiler(
+    const HdOnyxMaterialNetworkKey& networkKey,
+    Onyx::OnyxRenderer* renderer)
+: m_NetworkKey(networkKey)
+, m_Renderer(renderer)
+{
+}
+
+
+HdOnyxMaterialProgramHandle HdOnyxMaterialCompiler::Compile()
+{
+    if (m_NetworkKey.Nodes.empty()) return nullptr;
+
+    const uint32_t surfaceNodeIndex = uint32_t(m_NetworkKey.Nodes.size() - 1);
+
+    // Program wyznacza jedynie wejścia podłączone do sieci - stałe są odczytywane z parametrów materiału.
+    if (!FindConnection(surfaceNodeIndex, m_CompilerTokens->diffuseColor)) return nullptr;
+
+    uint8_t baseColorRegister = CompileInput(
+        surfaceNodeIndex, m_CompilerTokens->diffuseColor, GfVec3f(0.18f, 0.18f, 0.18f));
+
+    if (m_RegisterOverflow)
+    {
+        std::cout << "[hdOnyx] Sieć materiału przekracza limit rejestrów programu - pominięto kompilację."
+            << std::endl;
+        return nullptr;
+    }
+
+    m_Program.Instructions.push_back(Onyx::MaterialInstruction{
+        .Opcode = Onyx::MaterialOpcode::StoreOutput,
+        .Target = uint8_t(Onyx::MaterialProgramOutput::BaseColor),
+        .Source = baseColorRegister,
+        .Channel = Onyx::MaterialChannel::RGB,
+        .Operand = 0
+    });
+
+    return std::make_shared<const Onyx::MaterialProgram>(std::move(m_Program));
+}
+
+
+uint8_t HdOnyxMaterialCompiler::CompileInput(uint32_t nodeIndex, const TfToken& inputName, const GfVec3f& fallback)
+{
+    if (const HdOnyxMaterialNetworkKey::Connection* connection = FindConnection(nodeIndex, inputName))
+    {
+        return CompileNodeOutput(connection->UpstreamNode, connection->UpstreamOutput, fallback);
+    }
+
+    return EmitConstant(GetVectorValue(FindParameter(nodeIndex, inputName), fallback));
+}
+
+
+uint8_t HdOnyxMaterialCompiler::CompileNodeOutput(
+    uint32_t nodeIndex, const TfToken& outputName, const GfVec3f& fallback)
+{
+    auto outputRegister = m_NodeOutputRegisters.find({nodeIndex, outputName});
+    if (outputRegister != m_NodeOutputRegisters.end()) return outputRegister->second;
+
+    const TfToken& nodeType = m_NetworkKey.Nodes[nodeIndex].NodeType;
+
+    uint8_t targetRegister;
+    if (nodeType == m_CompilerTokens->UsdUVTexture)
+    {
+        targetRegister = CompileTexture(nodeIndex, outputName);
+    }
+    else if (nodeType == m_CompilerTokens->UsdPrimvarReader_float2)
+    {
+        targetRegister = CompilePrimvarReader(nodeIndex);
+    }
+    else if (nodeType == m_CompilerTokens->UsdTransform2d)
+    {
+        targetRegister = CompileTransform2d(nodeIndex);
+    }
+    else
+    {
+        // Węzeł nieobsługiwany - wejście przyjmuje wartość domyślną.
+        targetRegister = EmitConstant(fallback);
+    }
+
+    m_NodeOutputRegisters[{nodeIndex, outputName}] = targetRegister;
+    return targetRegister;
+}
+
+
+uint8_t HdOnyxMaterialCompiler::CompileTexture(uint32_t nodeIndex, const TfToken& outputName)
+{
+    const Onyx::MaterialChannel channel = GetTextureChannel(outputName);
+
+    std::string filePath;
+    if (const VtValue* file = FindParameter(nodeIndex, m_CompilerTokens->file);
+        file && file->IsHolding<SdfAssetPath>())
+    {
+        // Ścieżka rozwiązana przez Asset Resolver, a w przypadku jej braku - ścieżka zapisana w scenie.
+        const SdfAssetPath& assetPath = file->UncheckedGet<SdfAssetPath>();
+        filePath = assetPath.GetResolvedPath().empty() ? assetPath.GetAssetPath() : assetPath.GetResolvedPath();
+    }
+
+    Onyx::TextureColorSpace colorSpace = Onyx::TextureColorSpace::Auto;
+    if (const VtValue* sourceColorSpace = FindParameter(nodeIndex, m_CompilerTokens->sourceColorSpace))
+    {
+        TfToken colorSpaceToken = sourceColorSpace->GetWithDefault<TfToken>();
+        if (colorSpaceToken == m_CompilerTokens->raw) colorSpace = Onyx::TextureColorSpace::Raw;
+        if (colorSpaceToken == m_CompilerTokens->sRGB) colorSpace = Onyx::TextureColorSpace::SRGB;
+    }
+
+    // Plik jest otwierany jedynie w celu odczytu nagłówka - teksele są wczytywane przez integrator.
+    Onyx::TextureBinding textureBinding;
+    if (!filePath.empty()) textureBinding.Texture = m_Renderer->RegisterTexture(filePath, colorSpace);
+
+    // Brak pliku lub pliku nie można odczytać - węzeł zwraca wartość "fallback" (domyślnie (0, 0, 0, 1)).
+    if (!textureBinding.IsValid())
+    {
+        const VtValue* fallbackValue = FindParameter(nodeIndex, m_CompilerTokens->fallback);
+        GfVec4f fallback = fallbackValue ? fallbackValue->GetWithDefault<GfVec4f>(GfVec4f(0.0f, 0.0f, 0.0f, 1.0f))
+            : GfVec4f(0.0f, 0.0f, 0.0f, 1.0f);
+
+        switch (channel)
+        {
+            case Onyx::MaterialChannel::R: return EmitConstant(GfVec3f(fallback[0]));
+            case Onyx::MaterialChannel::G: return EmitConstant(GfVec3f(fallback[1]));
+            case Onyx::MaterialChannel::B: return EmitConstant(GfVec3f(fallback[2]));
+            case Onyx::MaterialChannel::A: return EmitConstant(GfVec3f(fallback[3]));
+            default: return EmitConstant(GfVec3f(fallback[0], fallback[1], fallback[2]));
+        }
+    }
+
+    textureBinding.WrapS = GetTextureWrap(FindParameter(nodeIndex, m_CompilerTokens->wrapS));
+    textureBinding.WrapT = GetTextureWrap(FindParameter(nodeIndex, m_CompilerTokens->wrapT));
+    textureBinding.Scale = GetVectorValue(FindParameter(nodeIndex, m_CompilerTokens->scale), GfVec3f(1.0f));
+    textureBinding.Bias = GetVectorValue(FindParameter(nodeIndex, m_CompilerTokens->bias), GfVec3f(0.0f));
+
+    uint8_t coordinateRegister = CompileInput(nodeIndex, m_CompilerTokens->st, GfVec3f(0.0f));
+
+    m_Program.Textures.push_back(textureBinding);
+
+    uint8_t targetRegister = AllocateRegister();
+    m_Program.Instructions.push_back(Onyx::MaterialInstruction{
+        .Opcode = Onyx::MaterialOpcode::SampleTexture,
+        .Target = targetRegister,
+        .Source = coordinateRegister,
+        .Channel = channel,
+        .Operand = uint32_t(m_Program.Textures.size() - 1)
+    });
+
+    return targetRegister;
+}
+
+
+uint8_t HdOnyxMaterialCompiler::CompilePrimvarReader(uint32_t nodeIndex)
+{
+    // Nazwa primvara jest zapisywana jako token lub (w nowszych wersjach OpenUSD) jako tekst.
+    std::string primvarName;
+    if (const VtValue* varname = FindParameter(nodeIndex, m_CompilerTokens->varname))
+    {
+        if (varname->IsHolding<TfToken>()) primvarName = varname->UncheckedGet<TfToken>().GetString();
+        else if (varname->IsHolding<std::string>()) primvarName = varname->UncheckedGet<std::string>();
+    }
+
+    // Geometria przechowuje jedynie primvar "st" - pozostałe primvary zwracają wartość "fallback".
+    if (primvarName != m_CompilerTokens->st.GetString())
+    {
+        return EmitConstant(GetVectorValue(FindParameter(nodeIndex, m_CompilerTokens->fallback), GfVec3f(0.0f)));
+    }
+
+    uint8_t targetRegister = AllocateRegister();
+    m_Program.Instructions.push_back(Onyx::MaterialInstruction{
+        .Opcode = Onyx::MaterialOpcode::LoadTextureCoordinate,
+        .Target = targetRegister,
+        .Source = 0,
+        .Channel = Onyx::MaterialChannel::RGB,
+        .Operand = 0
+    });
+
+    return targetRegister;
+}
+
+
+uint8_t HdOnyxMaterialCompiler::CompileTransform2d(uint32_t nodeIndex)
+{
+    uint8_t coordinateRegister = CompileInput(nodeIndex, m_CompilerTokens->in, GfVec3f(0.0f));
+
+    const VtValue* rotationValue = FindParameter(nodeIndex, m_CompilerTokens->rotation);
+    float rotation = rotationValue ? rotationValue->GetWithDefault<float>(0.0f) : 0.0f;
+
+    GfVec3f scale = GetVectorValue(FindParameter(nodeIndex, m_CompilerTokens->scale), GfVec3f(1.0f, 1.0f, 0.0f));
+    GfVec3f translation = GetVectorValue(FindParameter(nodeIndex, m_CompilerTokens->translation), GfVec3f(0.0f));
+
+    // Specyfikacja UsdTransform2d: skalowanie, obrót przeciwnie do ruchu wskazówek zegara (w stopniach),
+    // a następnie przesunięcie. Wiersze macierzy 2 x 3 są zapisywane jako dwie kolejne stałe.
+    float sine = std::sin(rotation * float(M_PI) / 180.0f);
+    float cosine = std::cos(rotation * float(M_PI) / 180.0f);
+
+    uint32_t matrixOperand = uint32_t(m_Program.Constants.size());
+    m_Program.Constants.push_back(GfVec3f(scale[0] * cosine, -scale[1] * sine, translation[0]));
+    m_Program.Constants.push_back(GfVec3f(scale[0] * sine, scale[1] * cosine, translation[1]));
+
+    uint8_t targetRegister = AllocateRegister();
+    m_Program.Instructions.push_back(Onyx::MaterialInstruction{
+        .Opcode = Onyx::MaterialOpcode::TransformTextureCoordinate,
+        .Target = targetRegister,
+        .Source = coordinateRegister,
+        .Channel = Onyx::MaterialChannel::RGB,
+        .Operand = matrixOperand
+    });
+
+    return targetRegister;
+}
+
+
+uint8_t HdOnyxMaterialCompiler::EmitConstant(const GfVec3f& value)
+{
+    m_Program.Constants.push_back(value);
+
+    uint8_t targetRegister = AllocateRegister();
+    m_Program.Instructions.push_back(Onyx::MaterialInstruction{
+        .Opcode = Onyx::MaterialOpcode::LoadConstant,
+        .Target = targetRegister,
+        .Source = 0,
+        .Channel = Onyx::MaterialChannel::RGB,
+        .Operand = uint32_t(m_Program.Constants.size() - 1)
+    });
+
+    return targetRegister;
+}
+
+
+uint8_t HdOnyxMaterialCompiler::AllocateRegister()
+{
+    if (m_Program.RegisterCount > std::numeric_limits<uint8_t>::max())
+    {
+        m_RegisterOverflow = true;
+        return 0;
+    }
+
+    return uint8_t(m_Program.RegisterCount++);
+}
+
+
+const VtValue* HdOnyxMaterialCompiler::FindParameter(uint32_t nodeIndex, const TfToken& name) const
+{
+    for (auto& parameter : m_NetworkKey.Nodes[nodeIndex].Parameters)
+    {
+        if (parameter.first == name) return &parameter.second;
+    }
+
+    return nullptr;
+}
+
+
+const HdOnyxMaterialNetworkKey::Connection* HdOnyxMaterialCompiler::FindConnection(
+    uint32_t nodeIndex, const TfToken& inputName) const
+{
+    for (const HdOnyxMaterialNetworkKey::Connection& connection : m_NetworkKey.Nodes[nodeIndex].Connections)
+    {
+        if (connection.InputName == inputName) return &connection;
+    }
+
+    return nullptr;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -1,14 +1,28 @@
 #include "mesh.h"
 
+#include <algorithm>
 #include <iostream>
+#include <optional>
 
 #include <pxr/imaging/hd/meshUtil.h>
 #include <pxr/imaging/hd/vtBufferSource.h>
+#include <pxr/base/tf/staticTokens.h>
 
+#include "instancer.h"
 #include "renderParam.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+// Primvar (constant) wybierający sposób aktualizacji BLAS mesha przy zmianie wyłącznie punktów
+// oraz primvar współrzędnych tekstur (konwencja UsdPreviewSurface).
+TF_DEFINE_PRIVATE_TOKENS(m_MeshTokens,
+    ((deformUpdate, "onyx:deformUpdate"))
+    (refit)
+    (rebuild)
+    (none)
+    (st)
+);
+
 
 HdOnyxMesh::HdOnyxMesh(SdfPath const& id)
 : HdMesh(id)
@@ -25,7 +39,11 @@ HdDirtyBits HdOnyxMesh::GetInitialDirtyBitsMask() const
     // raz zsynchronizowane.
     return HdChangeTracker::Clean
     | HdChangeTracker::DirtyPoints
-    | HdChangeTracker::DirtyTopology;
+    | HdChangeTracker::DirtyTopology
+    | HdChangeTracker::DirtyInstancer
+    | HdChangeTracker::DirtyInstanceIndex
+    | HdChangeTracker::DirtyTransform
+    | HdChangeTracker::DirtyMaterialId;
 }
 
 
@@ -56,20 +74,41 @@ void HdOnyxMesh::Sync(
 
     auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
 
+    // Mesh może być prototypem instancera. Aktualizujemy powiązanie z instancerem
+    // i synchronizujemy instancer (oraz jego instancery nadrzędne) przed odczytem transformacji kopii.
+    _UpdateInstancer(sceneDelegate, dirtyBits);
+    HdInstancer::_SyncInstancerAndParents(sceneDelegate->GetRenderIndex(), GetInstancerId());
+
     // Warunek będzie prawdziwy tylko dla całkowicie nowych obiektów
     if (HdChangeTracker::IsTopologyDirty(*dirtyBits, primID))
     {
         std::cout  << "[hdOnyx] - Utworzono nową geometrię: " << primID.GetString() <<  std::endl;
 
-        // Tworzymy reprezentację obiektu geometrii złożonej z trójkątów w Embree
-        // która zostanie powiązana z drzewem BVH sceny.
-        m_MeshGeometrySource = rtcNewGeometry(onyxRenderParam->GetEmbreeDevice(), RTC_GEOMETRY_TYPE_TRIANGLE);
-
         // Nowy obiekt, wskazujemy na konieczność wgrania danych punktów i indeksów punktów.
         rebuildMesh = true;
     }
 
+    // Sposób aktualizacji geometrii deformowanej jest wybierany per mesh (domyślnie - refit).
+    if (rebuildMesh || HdChangeTracker::IsPrimvarDirty(*dirtyBits, primID, m_MeshTokens->deformUpdate))
+    {
+        const VtValue deformUpdate = GetPrimvar(sceneDelegate, m_MeshTokens->deformUpdate);
+
+        TfToken deformUpdateMode = m_MeshTokens->refit;
+        if (deformUpdate.IsHolding<TfToken>()) deformUpdateMode = deformUpdate.UncheckedGet<TfToken>();
+        if (deformUpdate.IsHolding<std::string>()) deformUpdateMode = TfToken(deformUpdate.UncheckedGet<std::string>());
+
+        m_DeformUpdateMode = deformUpdateMode == m_MeshTokens->rebuild ? HdOnyxDeformUpdateMode::Rebuild
+            : deformUpdateMode == m_MeshTokens->none ? HdOnyxDeformUpdateMode::None
+            : HdOnyxDeformUpdateMode::Refit;
+
+        // Jawnie ustawiony tryb refit / rebuild oznacza mesh deformowany - geometria deformowana
+        // jest tworzona od razu, bez kosztu zamiany geometrii przy pierwszej deformacji.
+        m_DeformUpdateAuthored = !deformUpdate.IsEmpty() && m_DeformUpdateMode != HdOnyxDeformUpdateMode::None;
+    }
+
     bool topologyChanged = false;
+    bool pointsChanged = false;
+    bool normalsChanged = false;
 
     // Jeśli mesh nie został jeszcze zainicjalizowany lub buffer punktów uległ zmianie
     if (rebuildMesh || HdChangeTracker::IsPrimvarDirty(*dirtyBits, primID, HdTokens->points))
@@ -82,18 +121,7 @@ void HdOnyxMesh::Sync(
             m_PointArray = points.UncheckedGet<pxr::VtVec3fArray>();
         }
 
-        rtcSetSharedGeometryBuffer(
-            m_MeshGeometrySource,
-            RTC_BUFFER_TYPE_VERTEX,
-            0,
-            RTC_FORMAT_FLOAT3,
-            m_PointArray.cdata(),
-            0,
-            sizeof(GfVec3f),
-            m_PointArray.size()
-        );
-
-        topologyChanged = true;
+        pointsChanged = true;
     }
 
     // Pobieramy deskryptor topologii geometrii który posłuży w triangulacji.
@@ -114,17 +142,6 @@ void HdOnyxMesh::Sync(
         // się do punktów (points) geometrii.
         meshUtil.ComputeTriangleIndices(&m_IndexArray, &primitiveParams);
 
-        rtcSetSharedGeometryBuffer(
-            m_MeshGeometrySource,
-            RTC_BUFFER_TYPE_INDEX,
-            0,
-            RTC_FORMAT_UINT3,
-            m_IndexArray.cdata(),
-            0,
-            sizeof(GfVec3i),
-            m_IndexArray.size()
-        );
-
         topologyChanged = true;
     }
 
@@ -136,126 +153,487 @@ void HdOnyxMesh::Sync(
         // do figur z których zbudowana jest geometria.
         pxr::VtValue smoothNormalPrimvar = GetPrimvar(sceneDelegate, pxr::HdTokens->normals);
 
-        // Podobnie jak w przypadku indesków punktów, wektory mogą być zdefiniowane dla mieszanki czworokątów
-        // jak i trójkątów, ponownie używamy klasy pomocniczej USD do uzyskania wektorów po triangulacji.
-        pxr::HdVtBufferSource inputBufferNormals{pxr::HdTokens->normals, smoothNormalPrimvar};
-        pxr::VtValue triangulationOutput;
+        // Sprawdzamy interpolację primvara. Wektory "vertex" / "varying" (jeden na punkt) nie wymagają triangulacji,
+        // Embree interpoluje je w punkcie trafienia. Trzy kopie wektora na trójkąt tworzymy tylko dla face-varying.
+        HdInterpolation normalInterpolation = HdInterpolationConstant;
+        for (HdInterpolation interpolation :
+            {HdInterpolationVertex, HdInterpolationVarying, HdInterpolationFaceVarying})
+        {
+            for (const HdPrimvarDescriptor& primvar : GetPrimvarDescriptors(sceneDelegate, interpolation))
+            {
+                if (primvar.name == pxr::HdTokens->normals) normalInterpolation = interpolation;
+            }
+        }
 
-        bool normalTriangulationValid = meshUtil.ComputeTriangulatedFaceVaryingPrimvar(
-            inputBufferNormals.GetData(),
-            inputBufferNormals.GetNumElements(),
-            inputBufferNormals.GetTupleType().type,
-            &triangulationOutput);
+        // Wektory normalne są częścią klucza geometrii współdzielonej - usuwamy nieaktualne dane.
+        m_ShadingNormals = HdOnyxShadingNormals();
 
-        // Jeśli dane istnieją i mają poprawny format.
-        if (normalTriangulationValid && triangulationOutput.IsHolding<pxr::VtVec3fArray>())
+        bool perPointNormals = (normalInterpolation == HdInterpolationVertex
+            || normalInterpolation == HdInterpolationVarying)
+            && smoothNormalPrimvar.IsHolding<pxr::VtVec3fArray>()
+            && smoothNormalPrimvar.UncheckedGet<pxr::VtVec3fArray>().size() == m_PointArray.size();
+
+        if (perPointNormals)
         {
-            m_SmoothNormalArray = triangulationOutput.UncheckedGet<pxr::VtVec3fArray>();
+            m_ShadingNormals.Interpolation = HdOnyxPrimvarInterpolation::Vertex;
+            m_ShadingNormals.Normals = smoothNormalPrimvar.UncheckedGet<pxr::VtVec3fArray>();
+        }
+        else
+        {
+            // Podobnie jak w przypadku indesków punktów, wektory mogą być zdefiniowane dla mieszanki czworokątów
+            // jak i trójkątów, ponownie używamy klasy pomocniczej USD do uzyskania wektorów po triangulacji.
+            pxr::HdVtBufferSource inputBufferNormals{pxr::HdTokens->normals, smoothNormalPrimvar};
+            pxr::VtValue triangulationOutput;
+
+            bool normalTriangulationValid = meshUtil.ComputeTriangulatedFaceVaryingPrimvar(
+                inputBufferNormals.GetData(),
+                inputBufferNormals.GetNumElements(),
+                inputBufferNormals.GetTupleType().type,
+                &triangulationOutput);
+
+            // Jeśli dane istnieją i mają poprawny format.
+            if (normalTriangulationValid && triangulationOutput.IsHolding<pxr::VtVec3fArray>())
+            {
+                m_ShadingNormals.Interpolation = HdOnyxPrimvarInterpolation::FaceVarying;
+                m_ShadingNormals.Normals = triangulationOutput.UncheckedGet<pxr::VtVec3fArray>();
+            }
         }
 
-        rtcSetSharedGeometryBuffer(
-            m_MeshGeometrySource,
-            RTC_BUFFER_TYPE_INDEX,
-            0,
-            RTC_FORMAT_UINT3,
-            m_IndexArray.cdata(),
-            0,
-            sizeof(GfVec3i),
-            m_IndexArray.size()
-        );
+        normalsChanged = true;
+    }
+
+    // Współrzędne tekstur są opcjonalne - bez nich tekstury materiału są próbkowane w punkcie (0, 0).
+    if (rebuildMesh || HdChangeTracker::IsPrimvarDirty(*dirtyBits, primID, m_MeshTokens->st))
+    {
+        pxr::VtValue textureCoordinatePrimvar = GetPrimvar(sceneDelegate, m_MeshTokens->st);
+
+        HdInterpolation coordinateInterpolation = HdInterpolationConstant;
+        for (HdInterpolation interpolation :
+            {HdInterpolationVertex, HdInterpolationVarying, HdInterpolationFaceVarying})
+        {
+            for (const HdPrimvarDescriptor& primvar : GetPrimvarDescriptors(sceneDelegate, interpolation))
+            {
+                if (primvar.name == m_MeshTokens->st) coordinateInterpolation = interpolation;
+            }
+        }
+
+        // Współrzędne są częścią klucza geometrii współdzielonej - usuwamy nieaktualne dane.
+        m_TextureCoordinates = HdOnyxTextureCoordinates();
+
+        bool perPointCoordinates = (coordinateInterpolation == HdInterpolationVertex
+            || coordinateInterpolation == HdInterpolationVarying)
+            && textureCoordinatePrimvar.IsHolding<pxr::VtVec2fArray>()
+            && textureCoordinatePrimvar.UncheckedGet<pxr::VtVec2fArray>().size() == m_PointArray.size();
+
+        if (perPointCoordinates)
+        {
+            m_TextureCoordinates.Interpolation = HdOnyxPrimvarInterpolation::Vertex;
+            m_TextureCoordinates.Coordinates = textureCoordinatePrimvar.UncheckedGet<pxr::VtVec2fArray>();
+        }
+        else if (coordinateInterpolation == HdInterpolationFaceVarying)
+        {
+            pxr::HdVtBufferSource inputBufferCoordinates{m_MeshTokens->st, textureCoordinatePrimvar};
+            pxr::VtValue triangulationOutput;
+
+            bool coordinateTriangulationValid = meshUtil.ComputeTriangulatedFaceVaryingPrimvar(
+                inputBufferCoordinates.GetData(),
+                inputBufferCoordinates.GetNumElements(),
+                inputBufferCoordinates.GetTupleType().type,
+                &triangulationOutput);
+
+            if (coordinateTriangulationValid && triangulationOutput.IsHolding<pxr::VtVec2fArray>())
+            {
+                m_TextureCoordinates.Interpolation = HdOnyxPrimvarInterpolation::FaceVarying;
+                m_TextureCoordinates.Coordinates = triangulationOutput.UncheckedGet<pxr::VtVec2fArray>();
+            }
+        }
 
         topologyChanged = true;
     }
 
-    // Jeśli topologia geometrii uległa zmianie, musimy wywołać budowę triangle BVH geometrii.
-    if (topologyChanged)
+    auto resourceRegistry = std::static_pointer_cast<HdOnyxResourceRegistry>(
+        sceneDelegate->GetRenderIndex().GetResourceRegistry());
+
+    // Wektory normalne o niezmienionej interpolacji i liczbie (np. normalne zmieniające się wraz z punktami)
+    // mogą zostać podmienione w istniejącej geometrii deformowanej. Inna zmiana wektorów wymaga nowej geometrii.
+    bool normalsLayoutUnchanged = m_SharedGeometry
+        && m_ShadingNormals.Interpolation == m_SharedGeometry->ShadingNormals.Interpolation
+        && m_ShadingNormals.Size() == m_SharedGeometry->ShadingNormals.Size();
+
+    // Zmiana wyłącznie punktów lub wektorów normalnych przy niezmienionej topologii (symulacja, skinning).
+    // Zamiast nowej sceny Embree aktualizujemy bufory istniejącej geometrii i dopasowujemy BVH.
+    bool deformOnly = (pointsChanged || normalsChanged) && !rebuildMesh && !topologyChanged && m_SharedGeometry
+        && m_PointArray.size() == m_SharedGeometry->PointArray.size()
+        && (!normalsChanged || normalsLayoutUnchanged)
+        && m_DeformUpdateMode != HdOnyxDeformUpdateMode::None;
+
+    bool geometryDataChanged = topologyChanged || pointsChanged || normalsChanged;
+
+    // Flaga wskazująca na nową geometrię BLAS - instancje muszą wskazywać na nową scenę Embree.
+    bool geometryReplaced = false;
+
+    const RTCBuildQuality deformUpdateQuality = m_DeformUpdateMode == HdOnyxDeformUpdateMode::Refit
+        ? RTC_BUILD_QUALITY_REFIT
+        : RTC_BUILD_QUALITY_LOW;
+
+    if (deformOnly && m_DeformingGeometry)
+    {
+        // Wątek renderujący przechodzi przez BLAS geometrii oraz odczytuje jej bufory punktów i wektorów normalnych
+        // aż do zatrzymania w CommitResources. Podmiana buforów oraz dopasowanie BVH są kolejkowane - kolejka
+        // przechowuje nowe bufory, a poprzednie bufory są zwalniane dopiero po podmianie.
+        std::optional<HdOnyxShadingNormals> shadingNormals;
+        if (normalsChanged) shadingNormals = m_ShadingNormals;
+
+        onyxRenderParam->GetRendererHandle()->QueueSceneUpdate([resourceRegistry,
+            deformingGeometry = m_DeformingGeometry, points = m_PointArray, pointsChanged,
+            shadingNormals = std::move(shadingNormals), instances = m_Instances]()
+        {
+            // Wektory normalne nie zmieniają BVH - scenę zatwierdza aktualizacja punktów.
+            if (shadingNormals) resourceRegistry->UpdateDeformingGeometryNormals(*deformingGeometry, *shadingNormals);
+
+            if (pointsChanged)
+            {
+                resourceRegistry->UpdateDeformingGeometryPoints(*deformingGeometry, points);
+            }
+            else
+            {
+                rtcCommitScene(deformingGeometry->Scene);
+            }
+
+            // Instancje wskazują na tę samą scenę - zatwierdzamy je aby TLAS uwzględnił nowe bryły ograniczające.
+            if (!instances) return;
+
+            for (RTCGeometry meshInstanceSource : instances->Sources)
+            {
+                rtcCommitGeometry(meshInstanceSource);
+            }
+        });
+    }
+    else if (deformOnly)
+    {
+        // Pierwsza deformacja mesha bez jawnie ustawionego trybu "onyx:deformUpdate" - mesh przestaje
+        // współdzielić geometrię i otrzymuje prywatną kopię, której punkty będą od teraz aktualizowane w miejscu.
+        // Koszt jest jednorazowy, lecz pełny: budowa nowego BVH (bez ponownego użycia geometrii współdzielonej)
+        // oraz wymiana instancji. Poprzednia geometria jest zwalniana po wykonaniu zakolejkowanego odpięcia.
+        m_DeformingGeometry = resourceRegistry->CreateDeformingGeometry(
+            onyxRenderParam->GetEmbreeDevice(), m_PointArray, m_IndexArray, m_ShadingNormals, m_TextureCoordinates,
+            deformUpdateQuality);
+
+        m_SharedGeometry = m_DeformingGeometry;
+        geometryReplaced = true;
+    }
+    // Mesh z jawnie ustawionym trybem deformacji otrzymuje geometrię deformowaną przy każdej zmianie topologii.
+    else if (geometryDataChanged && m_DeformUpdateAuthored)
+    {
+        m_DeformingGeometry = resourceRegistry->CreateDeformingGeometry(
+            onyxRenderParam->GetEmbreeDevice(), m_PointArray, m_IndexArray, m_ShadingNormals, m_TextureCoordinates,
+            deformUpdateQuality);
+
+        m_SharedGeometry = m_DeformingGeometry;
+        geometryReplaced = true;
+    }
+    // Jeśli topologia geometrii uległa zmianie, potrzebujemy triangle BVH geometrii.
+    // Rejestr zasobów zwraca istniejącą strukturę jeśli inny mesh posiada identyczne dane,
+    // w przeciwnym wypadku buduje nową. Poprzedni uchwyt zwalnia geometrię jeśli był ostatnim.
+    else if (geometryDataChanged)
     {
-        // Dane zostały uzupełnione, wnioskujemy o zbudowanie obiektu geometrii Embree.
-        // CommitGeometry musi zostać wywołane przed utworzeniem prymitywnego obiektu geometrii.
-        rtcCommitGeometry(m_MeshGeometrySource);
+        m_DeformingGeometry.reset();
 
-        m_MeshRTAS = rtcNewScene(onyxRenderParam->GetEmbreeDevice());
+        m_SharedGeometry = resourceRegistry->GetOrCreateGeometry(
+            onyxRenderParam->GetEmbreeDevice(), m_PointArray, m_IndexArray, m_ShadingNormals, m_TextureCoordinates);
 
-        // Podpinamy deskryptor geometrii do prymitywnego obiektu geometrii
-        rtcAttachGeometry(m_MeshRTAS, m_MeshGeometrySource);
+        // Przejmujemy bufory współdzielonej geometrii - duplikaty nie przechowują własnej kopii danych.
+        m_PointArray = m_SharedGeometry->PointArray;
+        m_IndexArray = m_SharedGeometry->IndexArray;
+        m_ShadingNormals = m_SharedGeometry->ShadingNormals;
+        m_TextureCoordinates = m_SharedGeometry->TextureCoordinates;
 
-        // Wnioskujemy o zbudowanie prymitywnego obiektu geometrii
-        // Embree którego użyjemy do stworzenia instancji w scenie.
-        rtcCommitScene(m_MeshRTAS);
+        geometryReplaced = true;
     }
 
     // Sprawdzamy czy materiał powiązany z geometrią został zmieniony.
-    // Powiązanie materiału oraz geometrii odbywa sięza pomocą ścieżki do rprima typu "Material".
-    bool isMaterialBindingDirty = *dirtyBits & HdChangeTracker::DirtyMaterialId != 0;
-
-    // Jeśli mesh nie został zainicjalizowany lub jego transformacja uległa zmianie
-    if (rebuildMesh || topologyChanged || isMaterialBindingDirty
-        || HdChangeTracker::IsTransformDirty(*dirtyBits, primID))
+    // Powiązanie materiału oraz geometrii odbywa się za pomocą ścieżki do rprima typu "Material".
+    bool isMaterialBindingDirty = (*dirtyBits & HdChangeTracker::DirtyMaterialId) != 0;
+
+    // Jeśli mesh nie został zainicjalizowany, zmieniła się jego geometria, materiał
+    // lub dane instancera dla którego mesh jest prototypem - tworzymy instancje od nowa.
+    // Nowe instancje otrzymują aktualną transformację, dlatego zmiana materiału wraz z transformacją
+    // nie trafia do ścieżki aktualizacji samych transformacji (która nie zmienia uchwytu materiału).
+    if (rebuildMesh || geometryReplaced || isMaterialBindingDirty
+        || HdChangeTracker::IsInstancerDirty(*dirtyBits, primID)
+        || HdChangeTracker::IsInstanceIndexDirty(*dirtyBits, primID))
     {
-        // Jeśli instancja została wcześniej podpięta pod główną scenę
-        if (m_InstanceAttachmentID.has_value())
-        {
-            // Dokonujemy odpięcia instancji geometrii od głównej sceny silnika w celu aktualizacji.
-            onyxRenderParam->GetRendererHandle()->DetachGeometryFromScene(m_InstanceAttachmentID.value());
+        RebuildInstances(sceneDelegate, renderParam);
+    }
+    // Zmiana wyłącznie transformacji (animacja, manipulacja w viewporcie) nie wymaga nowych instancji.
+    // Aktualizujemy transformacje istniejących instancji, silnik przebuduje jedynie TLAS sceny.
+    else if (HdChangeTracker::IsTransformDirty(*dirtyBits, primID))
+    {
+        UpdateInstanceTransforms(sceneDelegate, renderParam);
+    }
 
-            // Jednocześnie zaznaczamy że instancja została odpięta i nie ma już przypisanego identyfikatora.
-            m_InstanceAttachmentID = std::nullopt;
-        }
+    // Dokonaliśmy niezbędnej synchronizacji danych na których nam zależy.
+    // Oznaczamy prim jako wolny od zmian.
+    // W przypadku modyfikacji parametrów, USD zadba o ustawienie wymaganych bitów.
+    *dirtyBits = HdChangeTracker::Clean;
+}
+
+
+void HdOnyxMesh::Finalize(HdRenderParam* renderParam)
+{
+    ReleaseInstances(renderParam);
+
+    // Zakolejkowane odpięcie przechowuje własny uchwyt geometrii - ostatni uchwyt zwalnia scenę
+    // oraz geometrię Embree (BLAS) dopiero po wykonaniu odpięcia.
+    m_DeformingGeometry.reset();
+    m_SharedGeometry.reset();
+}
+
+
+void HdOnyxMesh::RebuildInstances(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam)
+{
+    auto& primID = GetId();
+    auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
+    RTCDevice embreeDevice = onyxRenderParam->GetEmbreeDevice();
+
+    // Dokonujemy odpięcia poprzednich instancji geometrii od głównej sceny silnika w celu aktualizacji.
+    // Wątek renderujący może nadal korzystać z poprzednich instancji - zestaw jest zwalniany po odpięciu,
+    // dlatego nowe instancje są budowane w osobnym zestawie.
+    ReleaseInstances(renderParam);
+
+    auto instances = std::make_shared<HdOnyxMeshInstances>();
+    instances->Geometry = m_SharedGeometry;
+
+    // Pobieramy ścieżkę do materiału przypisaną geometrii.
+    SdfPath materialPath = sceneDelegate->GetMaterialId(primID);
+    // Szukamy materiału "po ścieżce" w mapie materialów silnika.
+    // Silnik zwróci index materiału w buforze materiałów.
+    auto matInBufferID = onyxRenderParam->GetRendererHandle()->GetIndexOfMaterialByPath(materialPath);
 
-        // Pobieramy ścieżkę do materiału przypisaną geometrii.
-        SdfPath materialPath = sceneDelegate->GetMaterialId(primID);
-        // Szukamy materiału "po ścieżce" w mapie materialów silnika.
-        // Silnik zwróci index materiału w buforze materiałów.
-        auto matInBufferID = onyxRenderParam->GetRendererHandle()->GetIndexOfMaterialByPath(materialPath);
-
-        // Pobieramy aktualną transformację obiektu i uzupełniamy nią strukturę danych instancji.
-        m_InstanceData = {
-            .TransformMatrix = GfMatrix4f(sceneDelegate->GetTransform(primID)),
-            .SmoothNormalsArray = m_SmoothNormalArray.has_value()
-                ? &(m_SmoothNormalArray.value())
-                : nullptr,
-            .DataIndexInBuffer = matInBufferID,
-            .Light = false
-        };
+    const GfMatrix4d primTransform = sceneDelegate->GetTransform(primID);
 
+    // Pobieramy aktualną transformację obiektu i uzupełniamy nią strukturę danych instancji.
+    instances->Data = {
+        .TransformMatrix = GfMatrix4f(primTransform),
+        .Geometry = instances->Geometry.get(),
+        .DataIndexInBuffer = matInBufferID,
+        .Light = false
+    };
+
+    if (GetInstancerId().IsEmpty())
+    {
         // Tworzymy nową geometrię typu - instance
         // Korzystamy w ten sposób z możliwości utworzenia wirtualnej kopii bazowej geometrii
         // z własnym przekształceniem, zamiast modyfikacji bazowej geometrii transformacją.
-        m_MeshInstanceSource = rtcNewGeometry(onyxRenderParam->GetEmbreeDevice(), RTC_GEOMETRY_TYPE_INSTANCE);
+        RTCGeometry meshInstanceSource = rtcNewGeometry(embreeDevice, RTC_GEOMETRY_TYPE_INSTANCE);
 
         // Ustawiamy źródło instancji - bazowy obiekt geometrii
-        rtcSetGeometryInstancedScene(m_MeshInstanceSource, m_MeshRTAS);
-        rtcSetGeometryTimeStepCount(m_MeshInstanceSource, 1);
+        rtcSetGeometryInstancedScene(meshInstanceSource, instances->Geometry->Scene);
+        rtcSetGeometryTimeStepCount(meshInstanceSource, 1);
 
         // Wywołanie funkcji SetGeometryTransform jest możliwe tylko i wyłącznie na
         // instancjach. Korzystająć z prymitywnego typu geometrii - triangle w Embree
         // możemy osiągnąć poprawną transformację, transformując wierzchołki (punkty) geometrii.
         // Jednak, lepszym rozwiązaniem jest wykorzystanie instancingu.
         rtcSetGeometryTransform(
-            m_MeshInstanceSource,
+            meshInstanceSource,
             0,
             RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
-            m_InstanceData.TransformMatrix.GetArray()
+            instances->Data.TransformMatrix.GetArray()
         );
 
         // Powiązujemy małą strukturę z instancją. Podczas testu intersekcji,
         // możemy otrzymać poniższy wskaźnik do struktury powiązany z instancją.
-        rtcSetGeometryUserData(m_MeshInstanceSource, &m_InstanceData);
+        rtcSetGeometryUserData(meshInstanceSource, &instances->Data);
+
+        rtcCommitGeometry(meshInstanceSource);
+        instances->Sources.push_back(meshInstanceSource);
+    }
+    else
+    {
+        // Mesh jest prototypem instancera. Wszystkie kopie współdzielą geometrię BLAS,
+        // każda kopia wnosi jedynie własną transformację (64 bajty).
+        auto* instancer = static_cast<HdOnyxInstancer*>(
+            sceneDelegate->GetRenderIndex().GetInstancer(GetInstancerId()));
+
+        const VtMatrix4dArray instanceTransforms = instancer
+            ? instancer->ComputeInstanceTransforms(primID)
+            : VtMatrix4dArray();
+
+        // Transformacja prima prototypu jest wykonywana przed transformacją kopii (wektory wierszowe).
+        instances->Transforms.reserve(instanceTransforms.size());
+        for (const GfMatrix4d& instanceTransform : instanceTransforms)
+        {
+            instances->Transforms.emplace_back(primTransform * instanceTransform);
+        }
+
+#if defined(RTC_GEOMETRY_INSTANCE_ARRAY)
+        if (!instances->Transforms.empty())
+        {
+            // Jedna tablica instancji dla wszystkich kopii prototypu. Embree odczytuje transformacje
+            // bezpośrednio z bufora zestawu instancji, a identyfikator kopii zwraca w polu instPrimID intersekcji.
+            RTCGeometry instanceArraySource = rtcNewGeometry(embreeDevice, RTC_GEOMETRY_TYPE_INSTANCE_ARRAY);
+
+            rtcSetGeometryInstancedScene(instanceArraySource, instances->Geometry->Scene);
+            rtcSetGeometryTimeStepCount(instanceArraySource, 1);
+
+            rtcSetSharedGeometryBuffer(
+                instanceArraySource,
+                RTC_BUFFER_TYPE_TRANSFORM,
+                0,
+                RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                instances->Transforms.data(),
+                0,
+                sizeof(GfMatrix4f),
+                instances->Transforms.size()
+            );
+
+            // Struktura pomocnicza jest wspólna dla wszystkich kopii, transformacja kopii jest wybierana indeksem.
+            instances->Data.InstanceTransforms = instances->Transforms.data();
+            rtcSetGeometryUserData(instanceArraySource, &instances->Data);
+
+            rtcCommitGeometry(instanceArraySource);
+            instances->Sources.push_back(instanceArraySource);
+        }
+#else
+        // Embree bez wsparcia tablic instancji - każda kopia jest osobną instancją w głównej scenie.
+        // Struktury pomocnicze są przechowywane w płaskiej tablicy,
+        // wskaźniki pozostają stałe do czasu zwolnienia zestawu instancji.
+        instances->DataTable.assign(instances->Transforms.size(), instances->Data);
 
-        rtcCommitGeometry(m_MeshInstanceSource);
+        for (size_t instance = 0; instance < instances->Transforms.size(); instance++)
+        {
+            instances->DataTable[instance].TransformMatrix = instances->Transforms[instance];
+
+            RTCGeometry meshInstanceSource = rtcNewGeometry(embreeDevice, RTC_GEOMETRY_TYPE_INSTANCE);
+
+            rtcSetGeometryInstancedScene(meshInstanceSource, instances->Geometry->Scene);
+            rtcSetGeometryTimeStepCount(meshInstanceSource, 1);
+            rtcSetGeometryTransform(
+                meshInstanceSource,
+                0,
+                RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                instances->DataTable[instance].TransformMatrix.GetArray()
+            );
+            rtcSetGeometryUserData(meshInstanceSource, &instances->DataTable[instance]);
+
+            rtcCommitGeometry(meshInstanceSource);
+            instances->Sources.push_back(meshInstanceSource);
+        }
+#endif
     }
 
-    // Jeśli instancja nie jest aktualnie powiązana z główną sceną silnika.
-    if (!m_InstanceAttachmentID.has_value())
+    // Zgłaszamy powiązanie instancji z główną sceną silnika. Meshe są synchronizowane równolegle,
+    // dlatego scena nie jest modyfikowana - Render Delegate podepnie instancje w CommitResources.
+    for (RTCGeometry meshInstanceSource : instances->Sources)
     {
-        // Powiązujemy instancę z główną sceną silnika.
-        m_InstanceAttachmentID = onyxRenderParam->GetRendererHandle()->AttachGeometryToScene(m_MeshInstanceSource);
+        instances->AttachmentIDs.push_back(
+            onyxRenderParam->GetRendererHandle()->QueueAttachGeometry(meshInstanceSource));
     }
 
-    // Dokonaliśmy niezbędnej synchronizacji danych na których nam zależy.
-    // Oznaczamy prim jako wolny od zmian.
-    // W przypadku modyfikacji parametrów, USD zadba o ustawienie wymaganych bitów.
-    *dirtyBits = HdChangeTracker::Clean;
+    m_Instances = std::move(instances);
+}
+
+
+void HdOnyxMesh::UpdateInstanceTransforms(HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam)
+{
+    if (!m_Instances) return;
+
+    auto& primID = GetId();
+    auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
+    auto* renderer = onyxRenderParam->GetRendererHandle();
+
+    const GfMatrix4d primTransform = sceneDelegate->GetTransform(primID);
+    const GfMatrix4f primTransformMatrix = GfMatrix4f(primTransform);
+
+    // Transformacje są odczytywane przez wątek renderujący (user data, bufor transformacji tablicy instancji).
+    // Nowe wartości wyznaczamy podczas synchronizacji, a zapis kolejkujemy - silnik wykona go po zatrzymaniu
+    // wątku renderującego, w kolejności względem podpięć i odpięć instancji.
+    if (GetInstancerId().IsEmpty())
+    {
+        renderer->QueueSceneUpdate([renderer, instances = m_Instances, primTransformMatrix]()
+        {
+            instances->Data.TransformMatrix = primTransformMatrix;
+
+            for (RTCGeometry meshInstanceSource : instances->Sources)
+            {
+                renderer->UpdateInstanceTransform(meshInstanceSource, primTransformMatrix);
+            }
+        });
+        return;
+    }
+
+    // Prototyp instancera - transformacja prima prototypu jest częścią transformacji każdej kopii.
+    auto* instancer = static_cast<HdOnyxInstancer*>(
+        sceneDelegate->GetRenderIndex().GetInstancer(GetInstancerId()));
+
+    const VtMatrix4dArray instanceTransforms = instancer
+        ? instancer->ComputeInstanceTransforms(primID)
+        : VtMatrix4dArray();
+
+    // Liczba kopii uległa zmianie - bufory instancji muszą zostać utworzone od nowa.
+    if (instanceTransforms.size() != m_Instances->Transforms.size())
+    {
+        RebuildInstances(sceneDelegate, renderParam);
+        return;
+    }
+
+    std::vector<GfMatrix4f> updatedTransforms;
+    updatedTransforms.reserve(instanceTransforms.size());
+    for (const GfMatrix4d& instanceTransform : instanceTransforms)
+    {
+        updatedTransforms.emplace_back(primTransform * instanceTransform);
+    }
+
+    renderer->QueueSceneUpdate(
+        [renderer, instances = m_Instances, primTransformMatrix, updatedTransforms = std::move(updatedTransforms)]()
+    {
+        instances->Data.TransformMatrix = primTransformMatrix;
+        std::copy(updatedTransforms.begin(), updatedTransforms.end(), instances->Transforms.begin());
+
+#if defined(RTC_GEOMETRY_INSTANCE_ARRAY)
+        // Bufor transformacji jest współdzielony z tablicą instancji - wystarczy oznaczyć go jako zmieniony.
+        for (RTCGeometry instanceArraySource : instances->Sources)
+        {
+            rtcUpdateGeometryBuffer(instanceArraySource, RTC_BUFFER_TYPE_TRANSFORM, 0);
+            rtcCommitGeometry(instanceArraySource);
+        }
+#else
+        for (size_t instance = 0; instance < instances->Sources.size(); instance++)
+        {
+            instances->DataTable[instance].TransformMatrix = instances->Transforms[instance];
+            renderer->UpdateInstanceTransform(instances->Sources[instance], instances->Transforms[instance]);
+        }
+#endif
+    });
+}
+
+
+void HdOnyxMesh::ReleaseInstances(HdRenderParam* renderParam)
+{
+    if (!m_Instances) return;
+
+    auto* onyxRenderParam = static_cast<HdOnyxRenderParam*>(renderParam);
+
+    // Odpięcie jest kolejkowane, podobnie jak podpięcie instancji. Kolejka przechowuje zestaw instancji
+    // (user data, bufor transformacji, geometrię BLAS) do czasu wykonania odpięcia - wątek renderujący
+    // może odczytywać te dane aż do zatrzymania w CommitResources.
+    for (uint instanceAttachmentID : m_Instances->AttachmentIDs)
+    {
+        onyxRenderParam->GetRendererHandle()->QueueDetachGeometry(instanceAttachmentID, m_Instances);
+    }
+
+    m_Instances.reset();
+}
+
+
+HdOnyxMeshInstances::~HdOnyxMeshInstances()
+{
+    // Scena przechowuje własne referencje podpiętych instancji - zwalniamy referencje zestawu.
+    for (RTCGeometry meshInstanceSource : Sources)
+    {
+        rtcReleaseGeometry(meshInstanceSource);
+    }
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
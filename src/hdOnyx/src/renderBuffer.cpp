@@ -98,6 +98,12 @@ bool HdOnyxRenderBuffer::IsConverged() const
 }
 
 
+void HdOnyxRenderBuffer::SetConverged(bool converged)
+{
+    m_Converged.store(converged);
+}
+
+
 void HdOnyxRenderBuffer::Resolve()
 {
     // Dane nie wymagają zmian przed wyświetleniem.
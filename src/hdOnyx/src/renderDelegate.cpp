@@ -4,18 +4,43 @@
 #include "mesh.h"
 #include "material.h"
 #include "light.h"
+#include "instancer.h"
+#include "resourceRegistry.h"
 
 #include <pxr/imaging/hd/renderBuffer.h>
 #include <pxr/imaging/hd/camera.h>
+#include <pxr/base/tf/staticTokens.h>
 
 #include <OnyxRenderer.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include "../include/material.h"
 
 
 PXR_NAMESPACE_OPEN_SCOPE
+
+// Tokeny ustawień silnika (Render Settings) przekazywanych przez aplikację.
+TF_DEFINE_PRIVATE_TOKENS(m_SettingsTokens,
+    ((threadLimit, "onyx:threadLimit"))
+    ((packetWidth, "onyx:packetWidth"))
+    ((halfPrecisionThroughput, "onyx:halfPrecisionThroughput"))
+    ((pathRegeneration, "onyx:pathRegeneration"))
+    ((samplesPerIteration, "onyx:samplesPerIteration"))
+    ((sampler, "onyx:sampler"))
+    ((sampleLimit, "onyx:sampleLimit"))
+    ((noiseThreshold, "onyx:noiseThreshold"))
+    ((adaptiveMinSamples, "onyx:adaptiveMinSamples"))
+    ((maxBounces, "onyx:maxBounces"))
+    ((maxDiffuseBounces, "onyx:maxDiffuseBounces"))
+    ((russianRouletteMinBounce, "onyx:russianRouletteMinBounce"))
+    ((memoryBudgetMB, "onyx:memoryBudgetMB"))
+    ((textureCacheMB, "onyx:textureCacheMB"))
+    ((quantizeNormals, "onyx:quantizeNormals"))
+);
+
+
 const TfTokenVector HdOnyxRenderDelegate::SUPPORTED_RPRIM_TYPES =
 {
     HdPrimTypeTokens->mesh,
@@ -72,11 +97,39 @@ HdOnyxRenderDelegate::HdOnyxRenderDelegate(HdRenderSettingsMap const& settingsMa
 void HdOnyxRenderDelegate::_Initialize()
 {
     std::cout << "[hdOnyx] Inicjalizacja Render Delegate" << std::endl;
-    m_ResourceRegistry = std::make_shared<HdResourceRegistry>();
+    // Rejestr zasobów przechowuje geometrię współdzieloną przez meshe o identycznych danych.
+    m_ResourceRegistry = std::make_shared<HdOnyxResourceRegistry>();
     m_RendererBackend = std::make_shared<Onyx::OnyxRenderer>();
 
     m_BackgroundRenderThread = std::make_unique<HdRenderThread>();
 
+    // Definiujemy ustawienia silnika dostępne dla użytkownika wraz z wartościami domyślnymi.
+    m_SettingDescriptors = {
+        {"Thread Limit (0 = All Cores)", m_SettingsTokens->threadLimit, VtValue(0)},
+        {"Ray Packet Width (1 = Scalar, 4, 8, 16)", m_SettingsTokens->packetWidth, VtValue(1)},
+        {"Half Precision Path Throughput", m_SettingsTokens->halfPrecisionThroughput, VtValue(false)},
+        {"Path Regeneration", m_SettingsTokens->pathRegeneration, VtValue(false)},
+        {"Samples Per Iteration (Path Regeneration)", m_SettingsTokens->samplesPerIteration, VtValue(4)},
+        {"Sampler (0 = Independent, 1 = Sobol, 2 = Blue Noise)", m_SettingsTokens->sampler, VtValue(1)},
+        {"Sample Limit", m_SettingsTokens->sampleLimit, VtValue(1000)},
+        {"Adaptive Noise Threshold (0 = Disabled)", m_SettingsTokens->noiseThreshold, VtValue(0.0f)},
+        {"Adaptive Min Samples", m_SettingsTokens->adaptiveMinSamples, VtValue(32)},
+        {"Max Bounces", m_SettingsTokens->maxBounces, VtValue(1)},
+        {"Max Diffuse Bounces", m_SettingsTokens->maxDiffuseBounces, VtValue(1)},
+        {"Russian Roulette Min Bounce", m_SettingsTokens->russianRouletteMinBounce, VtValue(3)},
+        {"Memory Budget (MB)", m_SettingsTokens->memoryBudgetMB, VtValue(0)},
+        {"Texture Cache (MB, 0 = Unlimited)", m_SettingsTokens->textureCacheMB, VtValue(2048)},
+        {"Quantize Shading Normals", m_SettingsTokens->quantizeNormals, VtValue(false)},
+    };
+
+    // Uzupełniamy mapę ustawień wartościami domyślnymi jeśli nie zostały przekazane w konstruktorze.
+    _PopulateDefaultSettings(m_SettingDescriptors);
+
+    // Kwantyzacja wektorów normalnych dotyczy geometrii tworzonych podczas synchronizacji - ustawiamy ją
+    // przed pierwszą synchronizacją meshy.
+    std::static_pointer_cast<HdOnyxResourceRegistry>(m_ResourceRegistry)->SetNormalQuantization(
+        GetRenderSetting<bool>(m_SettingsTokens->quantizeNormals, false));
+
     // Backend silnika tworzy Embree device który jest wymagany do tworzenia
     // zasobów biblioteki Embree. Pobieramy wskaźnik i przekazujemy go podczas
     // synchronizacji obiektów prim.
@@ -129,6 +182,39 @@ bool HdOnyxRenderDelegate::Resume()
 }
 
 
+bool HdOnyxRenderDelegate::IsStopSupported() const
+{
+    return true;
+}
+
+
+bool HdOnyxRenderDelegate::IsStopped() const
+{
+    return m_BackgroundRenderThread->IsPauseRequested() && !m_BackgroundRenderThread->IsRendering();
+}
+
+
+bool HdOnyxRenderDelegate::Stop(bool blocking)
+{
+    // Render Pass uruchamia wątek przy każdym wykonaniu - wstrzymanie sprawia, że kolejne uruchomienia
+    // oczekują w MainRenderingEntrypoint bez wykonywania iteracji.
+    m_BackgroundRenderThread->PauseRender();
+
+    // HdRenderThread::StopRender oczekuje na zakończenie bieżącej iteracji.
+    if (blocking && m_BackgroundRenderThread->IsRendering()) m_BackgroundRenderThread->StopRender();
+
+    return !blocking || IsStopped();
+}
+
+
+bool HdOnyxRenderDelegate::Restart()
+{
+    m_BackgroundRenderThread->ResumeRender();
+
+    return true;
+}
+
+
 HdResourceRegistrySharedPtr HdOnyxRenderDelegate::GetResourceRegistry() const
 {
     return m_ResourceRegistry;
@@ -137,6 +223,155 @@ HdResourceRegistrySharedPtr HdOnyxRenderDelegate::GetResourceRegistry() const
 void HdOnyxRenderDelegate::CommitResources(HdChangeTracker *tracker)
 {
     // std::cout << "[hdOnyx] => CommitResources RenderDelegate" << std::endl;
+
+    // Jeśli ustawienia silnika uległy zmianie od ostatniej synchronizacji.
+    if (!m_SettingsVersion.has_value() || m_SettingsVersion.value() != GetRenderSettingsVersion())
+    {
+        // Modyfikacja ustawień integratora wymaga zatrzymania wątku renderującego.
+        // Render Pass wznowi renderowanie podczas wykonania.
+        if (m_BackgroundRenderThread->IsRendering()) m_BackgroundRenderThread->StopRender();
+
+        m_RendererBackend->SetRenderSettings(_CreateBackendRenderSettings());
+        m_SettingsVersion = GetRenderSettingsVersion();
+    }
+
+    // Primy synchronizowane podczas renderowania jedynie kolejkują podpięcia, odpięcia i modyfikacje
+    // instancji (np. zmiany transformacji). Wykonujemy je w jednej partii po zatrzymaniu wątku renderującego -
+    // scena zostanie zatwierdzona raz, przed kolejną iteracją.
+    if (m_RendererBackend->HasPendingSceneOperations())
+    {
+        if (m_BackgroundRenderThread->IsRendering()) m_BackgroundRenderThread->StopRender();
+        m_RendererBackend->ApplyPendingSceneOperations();
+    }
+
+    // Usuwamy z pamięci podręcznej geometrie których meshe zostały usunięte lub zmienione.
+    m_ResourceRegistry->GarbageCollect();
+
+    auto resourceRegistry = std::static_pointer_cast<HdOnyxResourceRegistry>(m_ResourceRegistry);
+    const size_t geometryBufferBytes = resourceRegistry->GetGeometryBufferBytes();
+
+    // Po przekroczeniu limitu pamięci silnik przechodzi w tryb oszczędzania pamięci.
+    // Zmiana ustawień integratora wymaga zatrzymania wątku renderującego.
+    if (m_RendererBackend->IsMemoryBudgetExceeded(geometryBufferBytes)
+        && !m_RendererBackend->IsMemoryBudgetFallbackEnabled())
+    {
+        if (m_BackgroundRenderThread->IsRendering()) m_BackgroundRenderThread->StopRender();
+        m_RendererBackend->EnforceMemoryBudget(geometryBufferBytes);
+    }
+
+    // Nowe geometrie są budowane w formacie kompaktowym dopóki aktywny jest tryb oszczędzania pamięci.
+    // W trybie oszczędzania pamięci kwantyzujemy również wektory normalne nowych geometrii.
+    resourceRegistry->SetCompactBuild(m_RendererBackend->IsMemoryBudgetFallbackEnabled());
+    resourceRegistry->SetNormalQuantization(GetRenderSetting<bool>(m_SettingsTokens->quantizeNormals, false)
+        || m_RendererBackend->IsMemoryBudgetFallbackEnabled());
+}
+
+
+VtDictionary HdOnyxRenderDelegate::GetRenderStats() const
+{
+    auto resourceRegistry = std::static_pointer_cast<HdOnyxResourceRegistry>(m_ResourceRegistry);
+    const Onyx::MemoryStatistics memoryStatistics = m_RendererBackend->GetMemoryStatistics(
+        resourceRegistry->GetGeometryBufferBytes());
+
+    VtDictionary renderStats = resourceRegistry->GetResourceAllocation();
+    renderStats["onyx:memory:embreeBytes"] = VtValue(memoryStatistics.EmbreeBytes);
+    renderStats["onyx:memory:embreePeakBytes"] = VtValue(memoryStatistics.EmbreePeakBytes);
+    renderStats["onyx:memory:geometryBufferBytes"] = VtValue(memoryStatistics.GeometryBufferBytes);
+    renderStats["onyx:memory:rayPayloadBytes"] = VtValue(memoryStatistics.RayPayloadBytes);
+    renderStats["onyx:memory:accumulationBytes"] = VtValue(memoryStatistics.AccumulationBytes);
+    renderStats["onyx:memory:textureCacheBytes"] = VtValue(memoryStatistics.TextureCacheBytes);
+    renderStats["onyx:memory:totalBytes"] = VtValue(memoryStatistics.GetTotalBytes());
+    renderStats["onyx:memory:budgetBytes"] = VtValue(memoryStatistics.BudgetBytes);
+    renderStats["onyx:memory:budgetFallback"] = VtValue(memoryStatistics.BudgetFallback);
+    renderStats["onyx:sceneCommits"] = VtValue(m_RendererBackend->GetSceneCommitCount());
+    renderStats["onyx:skippedSceneCommits"] = VtValue(m_RendererBackend->GetSkippedSceneCommitCount());
+    renderStats["onyx:lightSlotCount"] = VtValue(m_RendererBackend->GetLightSlotCount());
+
+    const Onyx::IntegratorStatistics integratorStatistics = m_RendererBackend->GetIntegratorStatistics();
+    renderStats["onyx:integrator:sampleCount"] = VtValue(integratorStatistics.SampleCount);
+    renderStats["onyx:integrator:packetWidth"] = VtValue(integratorStatistics.PacketWidth);
+    renderStats["onyx:integrator:activeTiles"] = VtValue(integratorStatistics.ActiveTileCount);
+    renderStats["onyx:integrator:tileCount"] = VtValue(integratorStatistics.TileCount);
+    renderStats["onyx:integrator:iterationRays"] = VtValue(integratorStatistics.IterationRayCount);
+    renderStats["onyx:integrator:iterationSeconds"] = VtValue(integratorStatistics.IterationSeconds);
+    renderStats["onyx:integrator:totalRays"] = VtValue(integratorStatistics.TotalRayCount);
+    renderStats["onyx:integrator:totalSeconds"] = VtValue(integratorStatistics.TotalSeconds);
+    renderStats["onyx:integrator:raysPerSecond"] = VtValue(integratorStatistics.GetRaysPerSecond());
+    renderStats["onyx:integrator:pathSamples"] = VtValue(integratorStatistics.TotalPathSampleCount);
+    renderStats["onyx:integrator:raysPerSample"] = VtValue(integratorStatistics.GetRaysPerSample());
+    renderStats["onyx:integrator:meanRelativeError"] = VtValue(integratorStatistics.MeanRelativeError);
+
+    const Onyx::TextureCacheStatistics textureStatistics = m_RendererBackend->GetTextureCacheStatistics();
+    renderStats["onyx:textures:textureCount"] = VtValue(textureStatistics.TextureCount);
+    renderStats["onyx:textures:residentTiles"] = VtValue(textureStatistics.ResidentTileCount);
+    renderStats["onyx:textures:budgetBytes"] = VtValue(textureStatistics.BudgetBytes);
+    renderStats["onyx:textures:tileHits"] = VtValue(textureStatistics.TileHits);
+    renderStats["onyx:textures:tileMisses"] = VtValue(textureStatistics.TileMisses);
+    renderStats["onyx:textures:evictedTiles"] = VtValue(textureStatistics.EvictedTiles);
+
+    return renderStats;
+}
+
+
+Onyx::RenderSettings HdOnyxRenderDelegate::_CreateBackendRenderSettings() const
+{
+    Onyx::RenderSettings backendSettings;
+
+    // Wartości ujemne traktujemy jako brak limitu.
+    int threadLimit = GetRenderSetting<int>(m_SettingsTokens->threadLimit, 0);
+    backendSettings.ThreadLimit = uint(std::max(threadLimit, 0));
+
+    // Nieobsługiwane szerokości pakietu są traktowane przez integrator jako tryb skalarny.
+    int packetWidth = GetRenderSetting<int>(m_SettingsTokens->packetWidth, 1);
+    backendSettings.PacketWidth = uint(std::max(packetWidth, 1));
+
+    backendSettings.HalfPrecisionThroughput =
+        GetRenderSetting<bool>(m_SettingsTokens->halfPrecisionThroughput, false);
+
+    backendSettings.PathRegeneration = GetRenderSetting<bool>(m_SettingsTokens->pathRegeneration, false);
+
+    int samplesPerIteration = GetRenderSetting<int>(m_SettingsTokens->samplesPerIteration, 4);
+    backendSettings.SamplesPerIteration = uint(std::max(samplesPerIteration, 1));
+
+    // Nieznane wartości traktujemy jako domyślną sekwencję Sobol.
+    int samplerType = GetRenderSetting<int>(m_SettingsTokens->sampler, 1);
+    backendSettings.Sampler = samplerType >= 0 && samplerType <= 2
+        ? Onyx::SamplerType(samplerType)
+        : Onyx::SamplerType::Sobol;
+
+    int sampleLimit = GetRenderSetting<int>(m_SettingsTokens->sampleLimit, 1000);
+    backendSettings.SampleLimit = uint(std::max(sampleLimit, 1));
+
+    backendSettings.NoiseThreshold = std::max(GetRenderSetting<float>(m_SettingsTokens->noiseThreshold, 0.0f), 0.0f);
+
+    int adaptiveMinSamples = GetRenderSetting<int>(m_SettingsTokens->adaptiveMinSamples, 32);
+    backendSettings.AdaptiveMinSamples = uint(std::max(adaptiveMinSamples, 0));
+
+    // Licznik odbić ścieżki jest 8-bitowy, ograniczamy więc limity do jego zakresu.
+    int maxBounces = GetRenderSetting<int>(m_SettingsTokens->maxBounces, 1);
+    backendSettings.MaxBounces = uint(std::clamp(maxBounces, 0, 254));
+
+    int maxDiffuseBounces = GetRenderSetting<int>(m_SettingsTokens->maxDiffuseBounces, 1);
+    backendSettings.MaxDiffuseBounces = uint(std::clamp(maxDiffuseBounces, 0, 254));
+
+    int russianRouletteMinBounce = GetRenderSetting<int>(m_SettingsTokens->russianRouletteMinBounce, 3);
+    backendSettings.RussianRouletteMinBounce = uint(std::max(russianRouletteMinBounce, 1));
+
+    // Wartości ujemne traktujemy jako brak limitu pamięci.
+    int memoryBudget = GetRenderSetting<int>(m_SettingsTokens->memoryBudgetMB, 0);
+    backendSettings.MemoryBudgetMB = uint(std::max(memoryBudget, 0));
+
+    // Wartości ujemne traktujemy jako brak limitu pamięci kafelków tekstur.
+    int textureCacheMB = GetRenderSetting<int>(m_SettingsTokens->textureCacheMB, 2048);
+    backendSettings.TextureCacheMB = uint(std::max(textureCacheMB, 0));
+
+    return backendSettings;
+}
+
+
+HdRenderSettingDescriptorList HdOnyxRenderDelegate::GetRenderSettingDescriptors() const
+{
+    return m_SettingDescriptors;
 }
 
 HdRenderPassSharedPtr HdOnyxRenderDelegate::CreateRenderPass(HdRenderIndex *index, HdRprimCollection const& collection)
@@ -200,7 +435,8 @@ HdSprim *HdOnyxRenderDelegate::CreateFallbackSprim(TfToken const& typeId)
 void
 HdOnyxRenderDelegate::DestroySprim(HdSprim *sPrim)
 {
-    TF_CODING_ERROR("Destroy Sprim not supported");
+    // Zasoby silnika (instancje świateł) zostały zwolnione w Finalize.
+    delete sPrim;
 }
 
 HdBprim *
@@ -228,7 +464,7 @@ HdOnyxRenderDelegate::CreateFallbackBprim(TfToken const& typeId)
 void
 HdOnyxRenderDelegate::DestroyBprim(HdBprim *bPrim)
 {
-    TF_CODING_ERROR("Destroy Bprim not supported");
+    delete bPrim;
 }
 
 HdInstancer *
@@ -236,15 +472,13 @@ HdOnyxRenderDelegate::CreateInstancer(
     HdSceneDelegate *delegate,
     SdfPath const& id)
 {
-    TF_CODING_ERROR("Creating Instancer not supported id=%s",
-        id.GetText());
-    return nullptr;
+    return new HdOnyxInstancer(delegate, id);
 }
 
 void
 HdOnyxRenderDelegate::DestroyInstancer(HdInstancer *instancer)
 {
-    TF_CODING_ERROR("Destroy instancer not supported");
+    delete instancer;
 }
 
 HdRenderParam *HdOnyxRenderDelegate::GetRenderParam() const
@@ -257,7 +491,9 @@ HdAovDescriptor HdOnyxRenderDelegate::GetDefaultAovDescriptor(const TfToken& aov
 {
     if (aovName == HdAovTokens->color)
     {
-        return HdAovDescriptor(HdFormatUNorm8Vec4, true, VtValue(GfVec4f(0.0f)));
+        // Kolor jest akumulowany w formacie zmiennoprzecinkowym (HDR), konwersja do formatu
+        // wyświetlania odbywa się po stronie aplikacji.
+        return HdAovDescriptor(HdFormatFloat32Vec4, true, VtValue(GfVec4f(0.0f)));
     }
 
     if (aovName == HdAovTokens->depth)
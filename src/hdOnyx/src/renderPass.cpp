@@ -76,6 +76,7 @@ void HdOnyxRenderPass::UnmapAllBuffersFromArgument()
 
     m_RenderArgument->MappedBuffers.clear();
     m_RenderArgument->MappedLayout.clear();
+    m_RenderArgument->MappedFormats.clear();
 }
 
 
@@ -95,6 +96,9 @@ void HdOnyxRenderPass::MapAllBuffersToArgument()
         // Dodajemy wskaźnik do mapy wskaźników
         m_RenderArgument->MappedBuffers.emplace_back(mapBuffer);
 
+        // Format pozwala silnikowi na konwersję akumulowanych danych do formatu bufora.
+        m_RenderArgument->MappedFormats.emplace_back(aovBuffer->GetFormat());
+
         auto mapLayout = std::pair<pxr::TfToken, uint>(aovBinding.aovName, m_RenderArgument->MappedBuffers.size() - 1);
 
         // Dodajemy informacje o zmapowanym buforze oraz jego indeksie w wektorze buforów
@@ -107,8 +111,16 @@ void HdOnyxRenderPass::CheckAndUpdateArgumentBindings(HdRenderPassStateSharedPtr
 {
     auto& newFrameBindings = renderPassState->GetAovBindings();
 
-    // Jeśli nowy stan określa taką samą ilość AOV
-    if (m_AovBindingVector->size() == newFrameBindings.size())
+    // Jeśli nowy stan określa taki sam zestaw AOV (nazwy oraz bufory)
+    bool bindingsChanged = m_AovBindingVector->size() != newFrameBindings.size();
+    for (size_t bindingIndex = 0; !bindingsChanged && bindingIndex < newFrameBindings.size(); bindingIndex++)
+    {
+        const HdRenderPassAovBinding& currentBinding = m_AovBindingVector.value()[bindingIndex];
+        bindingsChanged = currentBinding.aovName != newFrameBindings[bindingIndex].aovName
+            || currentBinding.renderBuffer != newFrameBindings[bindingIndex].renderBuffer;
+    }
+
+    if (!bindingsChanged)
     {
         auto* renderBuffer = static_cast<HdOnyxRenderBuffer*>(newFrameBindings[0].renderBuffer);
 
@@ -127,6 +139,10 @@ void HdOnyxRenderPass::CheckAndUpdateArgumentBindings(HdRenderPassStateSharedPtr
 
     // Dokonujemy inicjalizacji na nowo, bufory zostaną zmapowane.
     Initialise(renderPassState);
+
+    // Nowe bufory nie zawierają próbek - bez resetu zbieżny integrator nie zostałby wznowiony,
+    // a bufory zostałyby oznaczone jako zbieżne.
+    m_RendererBackend->InvalidateIntegratorState();
 }
 
 
@@ -139,8 +155,14 @@ void HdOnyxRenderPass::CheckAndUpdateArgumentMatrices(HdRenderPassStateSharedPtr
     if (!m_RenderArgument->ProjectionChanged(passProjection, passView)) return;
 
     // Zmiana macierzy nie wymaga zmian w mapowaniu buforów. Podmieniamy jedynie dane.
+    // Silnik nie może korzystać z macierzy w trakcie ich modyfikacji.
+    if (m_RenderThread->IsRendering()) m_RenderThread->StopRender();
+
     m_RenderArgument->MatrixInverseProjection = passProjection.GetInverse();
     m_RenderArgument->MatrixInverseView = passView.GetInverse();
+
+    // Próbki zebrane dla poprzedniej kamery są nieaktualne.
+    m_RendererBackend->InvalidateIntegratorState();
 }
 
 
@@ -165,13 +187,21 @@ void HdOnyxRenderPass::_Execute(HdRenderPassStateSharedPtr const& renderPassStat
         CheckAndUpdateArgumentMatrices(renderPassState);
     }
 
-    if(!m_RenderThread->IsRendering()) m_RenderThread->StartRender();
+    // Przekazujemy stan zbieżności silnika do buforów AOV.
+    bool rendererConverged = m_RendererBackend->IsConverged();
+    for (auto& aovBinding: m_AovBindingVector.value())
+    {
+        static_cast<HdOnyxRenderBuffer*>(aovBinding.renderBuffer)->SetConverged(rendererConverged);
+    }
+
+    // Po osiągnięciu zbieżności kolejne iteracje nie poprawiają obrazu.
+    if(!rendererConverged && !m_RenderThread->IsRendering()) m_RenderThread->StartRender();
 }
 
 
 bool HdOnyxRenderPass::IsConverged() const
 {
-    return true;
+    return m_RendererBackend->IsConverged();
 }
 
 
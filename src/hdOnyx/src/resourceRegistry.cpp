@@ -0,0 +1,468 @@
+#include "resourceRegistry.h"
+
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/tf/diagnostic.h>
+
+#include <iostream>
+#include <iterator>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+uint32_t HdOnyxShadingNormals::EncodeOctahedral(const GfVec3f& normal)
+{
+    // Rzutujemy wektor na ośmiościan (norma L1 = 1), a następnie na kwadrat [-1, 1]^2.
+    float normL1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    if (normL1 <= 0.0f) return EncodeOctahedral(GfVec3f(0.0f, 0.0f, 1.0f));
+
+    float u = normal[0] / normL1;
+    float v = normal[1] / normL1;
+
+    // Dolna półsfera jest "rozkładana" na narożniki kwadratu.
+    if (normal[2] < 0.0f)
+    {
+        float foldedU = (1.0f - std::abs(v)) * std::copysign(1.0f, u);
+        float foldedV = (1.0f - std::abs(u)) * std::copysign(1.0f, v);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    auto encodeSnorm16 = [](float value)
+    {
+        return uint32_t(uint16_t(int16_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f))));
+    };
+
+    return encodeSnorm16(u) | (encodeSnorm16(v) << 16);
+}
+
+
+void HdOnyxShadingNormals::Quantize()
+{
+    if (!HasNormals() || IsQuantized()) return;
+
+    QuantizedNormals.resize(Normals.size());
+    for (size_t index = 0; index < Normals.size(); index++)
+    {
+        QuantizedNormals[index] = EncodeOctahedral(Normals[index]);
+    }
+
+    Normals = VtVec3fArray();
+}
+
+
+uint64_t HdOnyxResourceRegistry::ComputeContentHash(
+    const VtVec3fArray& points,
+    const VtVec3iArray& indices,
+    const HdOnyxShadingNormals& shadingNormals,
+    const HdOnyxTextureCoordinates& textureCoordinates)
+{
+    // Skrót obejmuje rozmiary buforów, dzięki czemu bufory o różnym podziale danych
+    // (np. inna liczba punktów i indeksów) nie dają tego samego wyniku.
+    uint64_t bufferSizes[6] = {
+        points.size(),
+        indices.size(),
+        shadingNormals.Size(),
+        uint64_t(shadingNormals.Interpolation),
+        textureCoordinates.Coordinates.size(),
+        uint64_t(textureCoordinates.Interpolation)
+    };
+
+    uint64_t hash = ArchHash64(reinterpret_cast<const char*>(bufferSizes), sizeof(bufferSizes));
+    hash = ArchHash64(reinterpret_cast<const char*>(points.cdata()), points.size() * sizeof(GfVec3f), hash);
+    hash = ArchHash64(reinterpret_cast<const char*>(indices.cdata()), indices.size() * sizeof(GfVec3i), hash);
+
+    if (shadingNormals.IsQuantized())
+    {
+        hash = ArchHash64(reinterpret_cast<const char*>(shadingNormals.QuantizedNormals.cdata()),
+            shadingNormals.QuantizedNormals.size() * sizeof(uint32_t), hash);
+    }
+    else if (shadingNormals.HasNormals())
+    {
+        hash = ArchHash64(reinterpret_cast<const char*>(shadingNormals.Normals.cdata()),
+            shadingNormals.Normals.size() * sizeof(GfVec3f), hash);
+    }
+
+    if (textureCoordinates.HasCoordinates())
+    {
+        hash = ArchHash64(reinterpret_cast<const char*>(textureCoordinates.Coordinates.cdata()),
+            textureCoordinates.ByteSize(), hash);
+    }
+
+    return hash;
+}
+
+
+HdOnyxSharedGeometryHandle HdOnyxResourceRegistry::GetOrCreateGeometry(
+    RTCDevice embreeDevice,
+    const VtVec3fArray& points,
+    const VtVec3iArray& indices,
+    const HdOnyxShadingNormals& inputNormals,
+    const HdOnyxTextureCoordinates& textureCoordinates)
+{
+    // Kwantyzacja zmienia dane geometrii, dlatego kluczem pamięci podręcznej są wektory po kwantyzacji.
+    HdOnyxShadingNormals shadingNormals = inputNormals;
+    if (m_QuantizeNormals) shadingNormals.Quantize();
+
+    // Skrót obliczamy poza sekcją krytyczną - synchronizacja meshy odbywa się równolegle.
+    uint64_t contentHash = ComputeContentHash(points, indices, shadingNormals, textureCoordinates);
+
+    {
+        std::lock_guard<std::mutex> cacheLock(m_GeometryCacheMutex);
+
+        if (auto cachedGeometry = FindCachedGeometry(contentHash, points, indices, shadingNormals, textureCoordinates))
+        {
+            m_GeometryCacheHits++;
+            return cachedGeometry;
+        }
+    }
+
+    // Budowa BVH odbywa się poza sekcją krytyczną - synchronizacja meshy o różnych danych skaluje się
+    // z liczbą rdzeni. Uchwyt jest zadeklarowany przed blokadą, więc odrzucona kopia jest zwalniana po jej zdjęciu.
+    HdOnyxSharedGeometryHandle newGeometry = CreateGeometry(
+        embreeDevice, points, indices, shadingNormals, textureCoordinates, contentHash);
+
+    std::lock_guard<std::mutex> cacheLock(m_GeometryCacheMutex);
+
+    // Inny wątek mógł w międzyczasie zbudować geometrię o identycznych danych - używamy jej,
+    // aby duplikaty nadal współdzieliły jedną geometrię.
+    if (auto cachedGeometry = FindCachedGeometry(contentHash, points, indices, shadingNormals, textureCoordinates))
+    {
+        m_GeometryCacheHits++;
+        m_GeometryBuildRaces++;
+        return cachedGeometry;
+    }
+
+    m_GeometryCacheMisses++;
+
+    m_GeometryCache.emplace(contentHash, newGeometry);
+    return newGeometry;
+}
+
+
+HdOnyxSharedGeometryHandle HdOnyxResourceRegistry::FindCachedGeometry(
+    uint64_t contentHash,
+    const VtVec3fArray& points,
+    const VtVec3iArray& indices,
+    const HdOnyxShadingNormals& shadingNormals,
+    const HdOnyxTextureCoordinates& textureCoordinates) const
+{
+    auto [rangeBegin, rangeEnd] = m_GeometryCache.equal_range(contentHash);
+    for (auto cacheEntry = rangeBegin; cacheEntry != rangeEnd; cacheEntry++)
+    {
+        HdOnyxSharedGeometryHandle cachedGeometry = cacheEntry->second.lock();
+        if (!cachedGeometry) continue;
+
+        // Porównujemy dane, aby kolizja skrótu nie powiązała meshy z inną geometrią.
+        bool identicalData = cachedGeometry->PointArray == points
+            && cachedGeometry->IndexArray == indices
+            && cachedGeometry->ShadingNormals == shadingNormals
+            && cachedGeometry->TextureCoordinates == textureCoordinates;
+
+        if (identicalData) return cachedGeometry;
+    }
+
+    return nullptr;
+}
+
+
+HdOnyxSharedGeometryHandle HdOnyxResourceRegistry::CreateGeometry(
+    RTCDevice embreeDevice,
+    const VtVec3fArray& points,
+    const VtVec3iArray& indices,
+    const HdOnyxShadingNormals& shadingNormals,
+    const HdOnyxTextureCoordinates& textureCoordinates,
+    uint64_t contentHash,
+    RTCBuildQuality buildQuality,
+    bool deforming)
+{
+    const size_t bufferBytes = points.size() * sizeof(GfVec3f) + indices.size() * sizeof(GfVec3i)
+        + shadingNormals.ByteSize() + textureCoordinates.ByteSize();
+
+    *m_GeometryBufferBytes += bufferBytes;
+
+    // Zasoby Embree są zwalniane razem z ostatnim uchwytem geometrii.
+    auto releaseGeometry = [geometryBufferBytes = m_GeometryBufferBytes, bufferBytes](
+        HdOnyxSharedGeometry* sharedGeometry)
+    {
+        if (sharedGeometry->Scene) rtcReleaseScene(sharedGeometry->Scene);
+        if (sharedGeometry->Geometry) rtcReleaseGeometry(sharedGeometry->Geometry);
+        delete sharedGeometry;
+
+        *geometryBufferBytes -= bufferBytes;
+    };
+
+    std::shared_ptr<HdOnyxSharedGeometry> sharedGeometry(new HdOnyxSharedGeometry, releaseGeometry);
+
+    // Kopie VtArray współdzielą dane z buforami meshy (copy-on-write), więc nie powielają pamięci.
+    sharedGeometry->PointArray = points;
+    sharedGeometry->IndexArray = indices;
+    sharedGeometry->ShadingNormals = shadingNormals;
+    sharedGeometry->TextureCoordinates = textureCoordinates;
+    sharedGeometry->ContentHash = contentHash;
+    sharedGeometry->Deforming = deforming;
+
+    // Tworzymy reprezentację obiektu geometrii złożonej z trójkątów w Embree.
+    sharedGeometry->Geometry = rtcNewGeometry(embreeDevice, RTC_GEOMETRY_TYPE_TRIANGLE);
+
+    rtcSetSharedGeometryBuffer(
+        sharedGeometry->Geometry,
+        RTC_BUFFER_TYPE_VERTEX,
+        0,
+        RTC_FORMAT_FLOAT3,
+        sharedGeometry->PointArray.cdata(),
+        0,
+        sizeof(GfVec3f),
+        sharedGeometry->PointArray.size()
+    );
+
+    rtcSetSharedGeometryBuffer(
+        sharedGeometry->Geometry,
+        RTC_BUFFER_TYPE_INDEX,
+        0,
+        RTC_FORMAT_UINT3,
+        sharedGeometry->IndexArray.cdata(),
+        0,
+        sizeof(GfVec3i),
+        sharedGeometry->IndexArray.size()
+    );
+
+    // Wektory typu "vertex" w pełnej precyzji interpolujemy za pomocą Embree (rtcInterpolate).
+    // Jeden wektor na punkt zamiast trzech na trójkąt - dla typowej siatki bufor jest ~6 razy mniejszy.
+    const HdOnyxShadingNormals& normals = sharedGeometry->ShadingNormals;
+    if (normals.Interpolation == HdOnyxPrimvarInterpolation::Vertex && !normals.IsQuantized())
+    {
+        rtcSetGeometryVertexAttributeCount(sharedGeometry->Geometry, 1);
+        rtcSetSharedGeometryBuffer(
+            sharedGeometry->Geometry,
+            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE,
+            0,
+            RTC_FORMAT_FLOAT3,
+            normals.Normals.cdata(),
+            0,
+            sizeof(GfVec3f),
+            normals.Normals.size()
+        );
+    }
+
+    // Jakość budowy BVH geometrii. Dla geometrii deformowanej określa sposób aktualizacji (refit / szybka budowa).
+    rtcSetGeometryBuildQuality(sharedGeometry->Geometry, buildQuality);
+
+    // CommitGeometry musi zostać wywołane przed utworzeniem prymitywnego obiektu geometrii.
+    rtcCommitGeometry(sharedGeometry->Geometry);
+
+    // Prymitywny obiekt geometrii (BLAS) którego instancje są tworzone w głównej scenie silnika.
+    sharedGeometry->Scene = rtcNewScene(embreeDevice);
+
+    // Po przekroczeniu limitu pamięci budujemy BVH w formacie kompaktowym (mniej pamięci, wolniejsze intersekcje).
+    int sceneFlags = m_CompactBuild ? RTC_SCENE_FLAG_COMPACT : RTC_SCENE_FLAG_NONE;
+
+    if (deforming)
+    {
+        // Scena będzie zatwierdzana po każdej zmianie punktów - przedkładamy czas budowy nad jakość drzewa.
+        sceneFlags |= RTC_SCENE_FLAG_DYNAMIC;
+        rtcSetSceneBuildQuality(sharedGeometry->Scene, RTC_BUILD_QUALITY_LOW);
+    }
+
+    rtcSetSceneFlags(sharedGeometry->Scene, RTCSceneFlags(sceneFlags));
+
+    rtcAttachGeometry(sharedGeometry->Scene, sharedGeometry->Geometry);
+    rtcCommitScene(sharedGeometry->Scene);
+
+    return sharedGeometry;
+}
+
+
+HdOnyxDeformingGeometryHandle HdOnyxResourceRegistry::CreateDeformingGeometry(
+    RTCDevice embreeDevice,
+    const VtVec3fArray& points,
+    const VtVec3iArray& indices,
+    const HdOnyxShadingNormals& inputNormals,
+    const HdOnyxTextureCoordinates& textureCoordinates,
+    RTCBuildQuality updateQuality)
+{
+    HdOnyxShadingNormals shadingNormals = inputNormals;
+    if (m_QuantizeNormals) shadingNormals.Quantize();
+
+    // Geometria deformowana nie jest kluczem w pamięci podręcznej - skrót nie jest potrzebny.
+    return std::const_pointer_cast<HdOnyxSharedGeometry>(
+        CreateGeometry(embreeDevice, points, indices, shadingNormals, textureCoordinates, 0, updateQuality, true));
+}
+
+
+void HdOnyxResourceRegistry::UpdateDeformingGeometryPoints(
+    HdOnyxSharedGeometry& deformingGeometry,
+    const VtVec3fArray& points)
+{
+    if (!TF_VERIFY(deformingGeometry.Deforming && points.size() == deformingGeometry.PointArray.size()))
+    {
+        return;
+    }
+
+    // Przejmujemy nowy bufor punktów (bez kopiowania) i wskazujemy go geometrii Embree.
+    deformingGeometry.PointArray = points;
+
+    rtcSetSharedGeometryBuffer(
+        deformingGeometry.Geometry,
+        RTC_BUFFER_TYPE_VERTEX,
+        0,
+        RTC_FORMAT_FLOAT3,
+        deformingGeometry.PointArray.cdata(),
+        0,
+        sizeof(GfVec3f),
+        deformingGeometry.PointArray.size()
+    );
+
+    rtcUpdateGeometryBuffer(deformingGeometry.Geometry, RTC_BUFFER_TYPE_VERTEX, 0);
+    rtcCommitGeometry(deformingGeometry.Geometry);
+
+    // Ta sama scena Embree - BVH jest dopasowywane (refit) lub szybko przebudowane, bez nowych alokacji sceny.
+    rtcCommitScene(deformingGeometry.Scene);
+
+    m_DeformingGeometryUpdates++;
+}
+
+
+void HdOnyxResourceRegistry::UpdateDeformingGeometryNormals(
+    HdOnyxSharedGeometry& deformingGeometry,
+    const HdOnyxShadingNormals& inputNormals)
+{
+    // Geometria zachowuje sposób przechowywania wektorów z chwili utworzenia - rozmiar buforów geometrii
+    // (GetGeometryBufferBytes) pozostaje bez zmian.
+    HdOnyxShadingNormals shadingNormals = inputNormals;
+    if (deformingGeometry.ShadingNormals.IsQuantized()) shadingNormals.Quantize();
+
+    if (!TF_VERIFY(deformingGeometry.Deforming
+        && shadingNormals.Interpolation == deformingGeometry.ShadingNormals.Interpolation
+        && shadingNormals.IsQuantized() == deformingGeometry.ShadingNormals.IsQuantized()
+        && shadingNormals.Size() == deformingGeometry.ShadingNormals.Size()))
+    {
+        return;
+    }
+
+    deformingGeometry.ShadingNormals = shadingNormals;
+
+    // Wektory "vertex" w pełnej precyzji interpoluje Embree - wskazujemy nowy bufor atrybutu wierzchołków.
+    const HdOnyxShadingNormals& normals = deformingGeometry.ShadingNormals;
+    if (normals.Interpolation == HdOnyxPrimvarInterpolation::Vertex && !normals.IsQuantized())
+    {
+        rtcSetSharedGeometryBuffer(
+            deformingGeometry.Geometry,
+            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE,
+            0,
+            RTC_FORMAT_FLOAT3,
+            normals.Normals.cdata(),
+            0,
+            sizeof(GfVec3f),
+            normals.Normals.size()
+        );
+
+        rtcUpdateGeometryBuffer(deformingGeometry.Geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0);
+        rtcCommitGeometry(deformingGeometry.Geometry);
+    }
+}
+
+
+HdOnyxMaterialProgramHandle HdOnyxResourceRegistry::GetOrCompileMaterialProgram(
+    const HdOnyxMaterialNetworkKey& networkKey,
+    const std::function<HdOnyxMaterialProgramHandle()>& compileProgram)
+{
+    auto findCachedProgram = [this, &networkKey]() -> HdOnyxMaterialProgramHandle
+    {
+        auto [rangeBegin, rangeEnd] = m_MaterialProgramCache.equal_range(networkKey.Hash);
+        for (auto cacheEntry = rangeBegin; cacheEntry != rangeEnd; cacheEntry++)
+        {
+            HdOnyxMaterialProgramHandle program = cacheEntry->second.Program.lock();
+            if (program && cacheEntry->second.NetworkKey == networkKey) return program;
+        }
+
+        return nullptr;
+    };
+
+    {
+        std::lock_guard<std::mutex> cacheLock(m_MaterialProgramCacheMutex);
+
+        if (HdOnyxMaterialProgramHandle program = findCachedProgram())
+        {
+            m_MaterialProgramCacheHits++;
+            return program;
+        }
+    }
+
+    // Kompilacja rejestruje tekstury (odczyt nagłówków plików) - wykonujemy ją poza sekcją krytyczną.
+    HdOnyxMaterialProgramHandle program = compileProgram();
+    if (!program) return nullptr;
+
+    std::lock_guard<std::mutex> cacheLock(m_MaterialProgramCacheMutex);
+
+    // Inny wątek mógł w międzyczasie skompilować identyczną sieć - zachowujemy jeden program.
+    if (HdOnyxMaterialProgramHandle cachedProgram = findCachedProgram())
+    {
+        m_MaterialProgramCacheHits++;
+        return cachedProgram;
+    }
+
+    m_MaterialProgramCache.emplace(networkKey.Hash, MaterialProgramCacheEntry{networkKey, program});
+    m_MaterialProgramCacheMisses++;
+
+    return program;
+}
+
+
+void HdOnyxResourceRegistry::_GarbageCollect()
+{
+    {
+        std::lock_guard<std::mutex> cacheLock(m_MaterialProgramCacheMutex);
+
+        for (auto cacheEntry = m_MaterialProgramCache.begin(); cacheEntry != m_MaterialProgramCache.end();)
+        {
+            cacheEntry = cacheEntry->second.Program.expired()
+                ? m_MaterialProgramCache.erase(cacheEntry)
+                : std::next(cacheEntry);
+        }
+    }
+
+    std::lock_guard<std::mutex> cacheLock(m_GeometryCacheMutex);
+
+    size_t removedEntries = 0;
+    for (auto cacheEntry = m_GeometryCache.begin(); cacheEntry != m_GeometryCache.end();)
+    {
+        if (!cacheEntry->second.expired())
+        {
+            cacheEntry++;
+            continue;
+        }
+
+        cacheEntry = m_GeometryCache.erase(cacheEntry);
+        removedEntries++;
+    }
+
+    if (removedEntries > 0)
+    {
+        std::cout << "[hdOnyx] Usunięto " << removedEntries << " nieużywanych geometrii z pamięci podręcznej."
+            << std::endl;
+    }
+}
+
+
+VtDictionary HdOnyxResourceRegistry::GetResourceAllocation() const
+{
+    std::lock_guard<std::mutex> cacheLock(m_GeometryCacheMutex);
+
+    VtDictionary allocation;
+    allocation["onyx:uniqueGeometryCount"] = VtValue(m_GeometryCache.size());
+    allocation["onyx:geometryCacheHits"] = VtValue(m_GeometryCacheHits);
+    allocation["onyx:geometryCacheMisses"] = VtValue(m_GeometryCacheMisses);
+    allocation["onyx:geometryBuildRaces"] = VtValue(m_GeometryBuildRaces);
+    allocation["onyx:geometryBufferBytes"] = VtValue(GetGeometryBufferBytes());
+    allocation["onyx:deformingGeometryUpdates"] = VtValue(m_DeformingGeometryUpdates.load());
+
+    std::lock_guard<std::mutex> materialCacheLock(m_MaterialProgramCacheMutex);
+    allocation["onyx:uniqueMaterialProgramCount"] = VtValue(m_MaterialProgramCache.size());
+    allocation["onyx:materialProgramCacheHits"] = VtValue(m_MaterialProgramCacheHits);
+    allocation["onyx:materialProgramCacheMisses"] = VtValue(m_MaterialProgramCacheMisses);
+
+    return allocation;
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,269 @@
+// Test paczkowego próbkowania materiałów (MaterialKernel::SampleBatch, BsdfSampling.h).
+//
+// - Zgodność ze ścieżką skalarną: dla tych samych danych wejściowych SampleBatch zwraca te same kierunki co Sample,
+//   to samo prawdopodobieństwo co PDF oraz wagę równą Evaluate * cos / PDF.
+// - Rozkład próbek: test chi-kwadrat próbek paczkowych względem rozkładu cosinusowego. Dla rozkładu cosinusowego
+//   sin^2(theta) oraz kąt phi mają rozkład jednostajny - przedziały siatki (sin^2(theta), phi) mają równe
+//   oczekiwane liczności.
+//
+// Test nie korzysta z Hydry ani Embree - wywołuje jądra cieniowania bezpośrednio.
+
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "BsdfSampling.h"
+#include "DiffuseMaterial.h"
+#include "Material.h"
+
+using namespace Onyx;
+
+using DiffuseKernel = MaterialKernel<MaterialKind::Diffuse>;
+
+constexpr uint32_t ONYX_BSDF_TEST_BATCHES = 4096;
+
+// Dopuszczalna różnica ścieżki paczkowej i skalarnej (kontrakcja FMA może różnić się po wektoryzacji).
+constexpr float ONYX_BSDF_TEST_TOLERANCE = 1e-5f;
+
+// Siatka testu chi-kwadrat (sin^2(theta) x phi) oraz liczba próbek na przedział.
+constexpr int ONYX_BSDF_CHI_SQUARE_THETA_BINS = 16;
+constexpr int ONYX_BSDF_CHI_SQUARE_PHI_BINS = 32;
+constexpr uint32_t ONYX_BSDF_CHI_SQUARE_SAMPLES_PER_BIN = 512;
+
+// Kwantyl standardowego rozkładu normalnego dla poziomu istotności 0.001.
+constexpr double ONYX_BSDF_CHI_SQUARE_Z = 3.090;
+
+
+static pxr::GfVec3f RandomDirection(std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    const float z = 2.0f * uniform(generator) - 1.0f;
+    const float phi = 2.0f * float(M_PI) * uniform(generator);
+    const float radius = std::sqrt(std::max(1.0f - z * z, 0.0f));
+
+    return pxr::GfVec3f(radius * std::cos(phi), radius * std::sin(phi), z);
+}
+
+
+// Wypełnia paczkę wektorami normalnymi, numerami losowymi oraz kolorem bazowym.
+static void FillBatch(
+    MaterialSampleBatch& batch,
+    const std::vector<pxr::GfVec3f>& normals,
+    const std::vector<pxr::GfVec2f>& randoms,
+    const pxr::GfVec3f& baseColor)
+{
+    for (uint32_t lane = 0; lane < MaterialBatchWidth; lane++)
+    {
+        batch.NormalX[lane] = normals[lane][0];
+        batch.NormalY[lane] = normals[lane][1];
+        batch.NormalZ[lane] = normals[lane][2];
+        batch.RandomU[lane] = randoms[lane][0];
+        batch.RandomV[lane] = randoms[lane][1];
+        batch.BaseColorR[lane] = baseColor[0];
+        batch.BaseColorG[lane] = baseColor[1];
+        batch.BaseColorB[lane] = baseColor[2];
+    }
+}
+
+
+static bool NearlyEqual(float a, float b)
+{
+    return std::abs(a - b) <= ONYX_BSDF_TEST_TOLERANCE * std::max(1.0f, std::abs(b));
+}
+
+
+// Porównanie SampleBatch z Sample, PDF oraz Evaluate dla losowych normalnych oraz przypadków brzegowych
+// (osie układu, normalna (0, 0, -1) - punkt nieciągłości bazy ortonormalnej, numery losowe 0 i 1).
+static bool TestBatchMatchesScalar()
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    MaterialParameters materialParameters;
+    materialParameters.DiffuseColor = pxr::GfVec3f(0.8f, 0.4f, 0.2f);
+    const DiffuseKernel::Parameters parameters = DiffuseKernel::CreateParameters(materialParameters);
+    const pxr::GfVec3f baseColor = DiffuseKernel::GetBaseColor(parameters);
+
+    const pxr::GfVec3f edgeNormals[] = {
+        pxr::GfVec3f(0.0f, 0.0f, 1.0f), pxr::GfVec3f(0.0f, 0.0f, -1.0f), pxr::GfVec3f(1.0f, 0.0f, 0.0f),
+        pxr::GfVec3f(0.0f, -1.0f, 0.0f), pxr::GfVec3f(0.0f, 0.0f, 1.0f), pxr::GfVec3f(0.0f, 0.0f, -1.0f),
+        pxr::GfVec3f(0.0f, 1.0f, 0.0f), pxr::GfVec3f(-1.0f, 0.0f, 0.0f)
+    };
+    const pxr::GfVec2f edgeRandoms[] = {
+        pxr::GfVec2f(0.5f, 0.5f), pxr::GfVec2f(0.0f, 0.0f), pxr::GfVec2f(1.0f, 1.0f), pxr::GfVec2f(0.0f, 1.0f),
+        pxr::GfVec2f(1.0f, 0.0f), pxr::GfVec2f(0.5f, 0.0f), pxr::GfVec2f(0.0f, 0.5f), pxr::GfVec2f(0.999f, 0.25f)
+    };
+
+    uint32_t mismatchCount = 0;
+
+    for (uint32_t batchIndex = 0; batchIndex < ONYX_BSDF_TEST_BATCHES; batchIndex++)
+    {
+        std::vector<pxr::GfVec3f> normals(MaterialBatchWidth);
+        std::vector<pxr::GfVec2f> randoms(MaterialBatchWidth);
+
+        for (uint32_t lane = 0; lane < MaterialBatchWidth; lane++)
+        {
+            normals[lane] = batchIndex == 0 ? edgeNormals[lane] : RandomDirection(generator);
+            randoms[lane] = batchIndex == 0
+                ? edgeRandoms[lane]
+                : pxr::GfVec2f(uniform(generator), uniform(generator));
+        }
+
+        MaterialSampleBatch batch;
+        FillBatch(batch, normals, randoms, baseColor);
+        DiffuseKernel::SampleBatch(parameters, batch);
+
+        for (uint32_t lane = 0; lane < MaterialBatchWidth; lane++)
+        {
+            const pxr::GfVec3f& N = normals[lane];
+            const pxr::GfVec3f sample = DiffuseKernel::Sample(parameters, N, randoms[lane]);
+            const float pdf = DiffuseKernel::PDF(parameters, N, sample);
+
+            bool laneMatches = NearlyEqual(batch.DirectionX[lane], sample[0])
+                && NearlyEqual(batch.DirectionY[lane], sample[1])
+                && NearlyEqual(batch.DirectionZ[lane], sample[2])
+                && NearlyEqual(batch.Pdf[lane], pdf);
+
+            // Waga próbki z niezerowym PDF jest ilorazem BXDF * cos / PDF ścieżki skalarnej.
+            if (pdf > 0.0f)
+            {
+                const pxr::GfVec3f weight = DiffuseKernel::Evaluate(parameters, baseColor, N, sample)
+                    * (pxr::GfDot(N, sample) / pdf);
+
+                laneMatches = laneMatches
+                    && NearlyEqual(batch.WeightR[lane], weight[0])
+                    && NearlyEqual(batch.WeightG[lane], weight[1])
+                    && NearlyEqual(batch.WeightB[lane], weight[2]);
+            }
+
+            // Próbka jest jednostkowym wektorem w górnej hemisferze normalnej.
+            const pxr::GfVec3f direction(batch.DirectionX[lane], batch.DirectionY[lane], batch.DirectionZ[lane]);
+            laneMatches = laneMatches
+                && NearlyEqual(pxr::GfDot(direction, direction), 1.0f)
+                && pxr::GfDot(direction, N) >= -ONYX_BSDF_TEST_TOLERANCE;
+
+            if (!laneMatches)
+            {
+                if (mismatchCount == 0)
+                {
+                    std::cerr << "[OnyxBsdfSamplingTest] Niezgodna próbka: paczka " << batchIndex
+                              << ", pozycja " << lane << ", N = (" << N[0] << ", " << N[1] << ", " << N[2]
+                              << "), paczka (" << batch.DirectionX[lane] << ", " << batch.DirectionY[lane]
+                              << ", " << batch.DirectionZ[lane] << ", pdf " << batch.Pdf[lane]
+                              << "), skalarnie (" << sample[0] << ", " << sample[1] << ", " << sample[2]
+                              << ", pdf " << pdf << ")." << std::endl;
+                }
+
+                mismatchCount++;
+            }
+        }
+    }
+
+    std::cout << "[OnyxBsdfSamplingTest] Zgodność ze ścieżką skalarną: "
+              << ONYX_BSDF_TEST_BATCHES * MaterialBatchWidth << " próbek, niezgodnych " << mismatchCount
+              << std::endl;
+
+    return mismatchCount == 0;
+}
+
+
+// Test chi-kwadrat rozkładu próbek paczkowych względem rozkładu cosinusowego dla wskazanej normalnej.
+static bool TestCosineDistribution(const pxr::GfVec3f& N, uint32_t seed)
+{
+    constexpr int binCount = ONYX_BSDF_CHI_SQUARE_THETA_BINS * ONYX_BSDF_CHI_SQUARE_PHI_BINS;
+    const uint32_t sampleCount = binCount * ONYX_BSDF_CHI_SQUARE_SAMPLES_PER_BIN;
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    const DiffuseKernel::Parameters parameters = DiffuseKernel::CreateParameters(MaterialParameters());
+
+    // Baza lokalna normalnej - kąt phi jest mierzony względem dowolnej stycznej.
+    float tx, ty, tz, bx, by, bz;
+    BsdfSampling::BuildOrthonormalBasis(N[0], N[1], N[2], tx, ty, tz, bx, by, bz);
+    const pxr::GfVec3f tangent(tx, ty, tz);
+    const pxr::GfVec3f bitangent(bx, by, bz);
+
+    std::vector<uint32_t> binCounts(binCount, 0);
+    const std::vector<pxr::GfVec3f> normals(MaterialBatchWidth, N);
+    std::vector<pxr::GfVec2f> randoms(MaterialBatchWidth);
+
+    for (uint32_t batchStart = 0; batchStart < sampleCount; batchStart += MaterialBatchWidth)
+    {
+        for (pxr::GfVec2f& random : randoms) random = pxr::GfVec2f(uniform(generator), uniform(generator));
+
+        MaterialSampleBatch batch;
+        FillBatch(batch, normals, randoms, pxr::GfVec3f(1.0f));
+        DiffuseKernel::SampleBatch(parameters, batch);
+
+        for (uint32_t lane = 0; lane < MaterialBatchWidth; lane++)
+        {
+            const pxr::GfVec3f direction(batch.DirectionX[lane], batch.DirectionY[lane], batch.DirectionZ[lane]);
+
+            const float cosine = std::clamp(pxr::GfDot(direction, N), 0.0f, 1.0f);
+            const float sineSquared = 1.0f - cosine * cosine;
+            float phi = std::atan2(pxr::GfDot(direction, bitangent), pxr::GfDot(direction, tangent));
+            if (phi < 0.0f) phi += 2.0f * float(M_PI);
+
+            const int thetaBin = std::min(int(sineSquared * ONYX_BSDF_CHI_SQUARE_THETA_BINS),
+                ONYX_BSDF_CHI_SQUARE_THETA_BINS - 1);
+            const int phiBin = std::min(int(phi / (2.0f * float(M_PI)) * ONYX_BSDF_CHI_SQUARE_PHI_BINS),
+                ONYX_BSDF_CHI_SQUARE_PHI_BINS - 1);
+
+            binCounts[thetaBin * ONYX_BSDF_CHI_SQUARE_PHI_BINS + phiBin]++;
+        }
+    }
+
+    const double expectedCount = double(ONYX_BSDF_CHI_SQUARE_SAMPLES_PER_BIN);
+    double chiSquare = 0.0;
+    for (uint32_t count : binCounts)
+    {
+        chiSquare += (double(count) - expectedCount) * (double(count) - expectedCount) / expectedCount;
+    }
+
+    // Wartość krytyczna rozkładu chi-kwadrat - przybliżenie Wilsona-Hilferty'ego.
+    const double degreesOfFreedom = double(binCount - 1);
+    const double spread = 2.0 / (9.0 * degreesOfFreedom);
+    const double criticalValue =
+        degreesOfFreedom * std::pow(1.0 - spread + ONYX_BSDF_CHI_SQUARE_Z * std::sqrt(spread), 3.0);
+
+    std::cout << "[OnyxBsdfSamplingTest] Rozkład cosinusowy, N = (" << N[0] << ", " << N[1] << ", " << N[2]
+              << "): chi-kwadrat " << chiSquare << ", wartość krytyczna " << criticalValue << std::endl;
+
+    return chiSquare <= criticalValue;
+}
+
+
+int main(int argc, char** argv)
+{
+    bool testsPassed = TestBatchMatchesScalar();
+
+    const pxr::GfVec3f distributionNormals[] = {
+        pxr::GfVec3f(0.0f, 0.0f, 1.0f),
+        pxr::GfVec3f(0.0f, 0.0f, -1.0f),
+        pxr::GfVec3f(0.48f, -0.6f, 0.64f)
+    };
+
+    uint32_t seed = 11;
+    for (const pxr::GfVec3f& N : distributionNormals)
+    {
+        testsPassed = TestCosineDistribution(N, seed++) && testsPassed;
+    }
+
+    if (!testsPassed)
+    {
+        std::cerr << "[OnyxBsdfSamplingTest] Próbkowanie paczkowe jest niezgodne ze ścieżką skalarną "
+                  << "lub rozkładem cosinusowym." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
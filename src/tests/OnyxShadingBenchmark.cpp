@@ -0,0 +1,302 @@
+// Porównanie kosztu cieniowania uderzeń przed i po zastąpieniu wirtualnych materiałów tabelą materiałów.
+//
+// Benchmark nie korzysta z Hydry ani Embree - cieniowane są syntetyczne uderzenia posortowane według materiału
+// (tak jak kolejka cieniowania integratora). Na każde uderzenie przypada Sample, PDF, dwukrotne Evaluate
+// (próbka materiału oraz kierunek do światła) i PDF kierunku do światła:
+// - przed: obiekty materiałów alokowane na stercie, wywołania wirtualne oraz odczyt materiału dla każdego uderzenia
+//   (poprzedni interfejs Material),
+// - po: rekord tabeli materiałów odczytywany raz na przedział uderzeń o wspólnym materiale, jądro cieniowania
+//   wybrane w czasie kompilacji (MaterialTable, MaterialKernel).
+// Obie ścieżki wykonują te same obliczenia BXDF, dlatego różnica czasu wynika jedynie ze sposobu wywołania,
+// a sumy kontrolne obu ścieżek muszą być zgodne. Wyniki są miarodajne dla konfiguracji Release.
+//
+// Użycie: OnyxShadingBenchmark [liczba uderzeń]
+
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "DiffuseMaterial.h"
+#include "Material.h"
+#include "MaterialTable.h"
+
+using namespace Onyx;
+
+// Mierzone funkcje nie są wstawiane w miejsce wywołania - kod pętli cieniowania (np. wybór instrukcji cmov
+// lub skoków warunkowych) nie zależy od kontekstu pomiaru, a obie ścieżki są kompilowane w ten sam sposób.
+#if defined(_MSC_VER)
+#define ONYX_BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define ONYX_BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+constexpr uint32_t ONYX_SHADING_BENCHMARK_MATERIALS = 64;
+constexpr uint32_t ONYX_SHADING_BENCHMARK_REPETITIONS = 5;
+
+// Dopuszczalna różnica względna sum kontrolnych (kontrakcja FMA może różnić się między ścieżkami).
+constexpr double ONYX_SHADING_BENCHMARK_CHECKSUM_TOLERANCE = 1e-5;
+
+
+struct ShadingBenchmarkHit
+{
+    pxr::GfVec3f Normal;
+    pxr::GfVec2f Random2D;
+    pxr::GfVec3f LightDirection;
+    uint32_t MaterialSlot;
+};
+
+
+/**
+ * Poprzedni interfejs materiału - trzy wywołania wirtualne na odbicie.
+ */
+class VirtualMaterial
+{
+public:
+    virtual ~VirtualMaterial() = default;
+
+    virtual pxr::GfVec3f Sample(const pxr::GfVec3f& N, const pxr::GfVec2f& random2D) = 0;
+    virtual pxr::GfVec3f Evaluate(const pxr::GfVec3f& N, const pxr::GfVec3f& sample) = 0;
+    virtual float PDF(const pxr::GfVec3f& N, const pxr::GfVec3f& sample) = 0;
+};
+
+
+// Materiał Lambert za interfejsem wirtualnym - te same obliczenia co jądro cieniowania tabeli materiałów.
+class VirtualDiffuseMaterial final : public VirtualMaterial
+{
+public:
+    using Kernel = MaterialKernel<MaterialKind::Diffuse>;
+
+    explicit VirtualDiffuseMaterial(const MaterialParameters& parameters)
+    : m_Parameters{Kernel::CreateParameters(parameters)}
+    {}
+
+    pxr::GfVec3f Sample(const pxr::GfVec3f& N, const pxr::GfVec2f& random2D) override
+    {
+        return Kernel::Sample(m_Parameters, N, random2D);
+    }
+
+    pxr::GfVec3f Evaluate(const pxr::GfVec3f& N, const pxr::GfVec3f& sample) override
+    {
+        return Kernel::Evaluate(m_Parameters, Kernel::GetBaseColor(m_Parameters), N, sample);
+    }
+
+    float PDF(const pxr::GfVec3f& N, const pxr::GfVec3f& sample) override
+    {
+        return Kernel::PDF(m_Parameters, N, sample);
+    }
+
+private:
+    Kernel::Parameters m_Parameters;
+};
+
+
+// Wkład uderzenia: próbka materiału ważona przez PDF oraz kierunek do światła ważony przez PDF materiału.
+static double AccumulateHit(
+    const pxr::GfVec3f& N, const pxr::GfVec3f& sample, float samplePdf,
+    const pxr::GfVec3f& sampleBxdf, const pxr::GfVec3f& lightBxdf, float lightPdf,
+    const pxr::GfVec3f& lightDirection)
+{
+    double contribution = 0.0;
+
+    if (samplePdf > 0.0f)
+    {
+        const pxr::GfVec3f weight = sampleBxdf * (pxr::GfDot(N, sample) / samplePdf);
+        contribution += double(weight[0] + weight[1] + weight[2]);
+    }
+
+    const pxr::GfVec3f light = lightBxdf * std::max(pxr::GfDot(N, lightDirection), 0.0f);
+    contribution += double(light[0] + light[1] + light[2]) * double(lightPdf);
+
+    return contribution;
+}
+
+
+ONYX_BENCHMARK_NOINLINE static double ShadeVirtual(
+    const std::vector<ShadingBenchmarkHit>& hits,
+    const std::vector<std::unique_ptr<VirtualMaterial>>& materials)
+{
+    double checksum = 0.0;
+
+    for (const ShadingBenchmarkHit& hit : hits)
+    {
+        VirtualMaterial& material = *materials[hit.MaterialSlot];
+
+        const pxr::GfVec3f sample = material.Sample(hit.Normal, hit.Random2D);
+        const float samplePdf = material.PDF(hit.Normal, sample);
+        const pxr::GfVec3f sampleBxdf = material.Evaluate(hit.Normal, sample);
+        const pxr::GfVec3f lightBxdf = material.Evaluate(hit.Normal, hit.LightDirection);
+        const float lightPdf = material.PDF(hit.Normal, hit.LightDirection);
+
+        checksum += AccumulateHit(
+            hit.Normal, sample, samplePdf, sampleBxdf, lightBxdf, lightPdf, hit.LightDirection);
+    }
+
+    return checksum;
+}
+
+
+template<MaterialKind Kind>
+static double ShadeTableBin(
+    const typename MaterialKernel<Kind>::Parameters& parameters,
+    const ShadingBenchmarkHit* hits,
+    size_t hitCount)
+{
+    using Kernel = MaterialKernel<Kind>;
+
+    const pxr::GfVec3f baseColor = Kernel::GetBaseColor(parameters);
+    double checksum = 0.0;
+
+    for (size_t hitIndex = 0; hitIndex < hitCount; hitIndex++)
+    {
+        const ShadingBenchmarkHit& hit = hits[hitIndex];
+
+        const pxr::GfVec3f sample = Kernel::Sample(parameters, hit.Normal, hit.Random2D);
+        const float samplePdf = Kernel::PDF(parameters, hit.Normal, sample);
+        const pxr::GfVec3f sampleBxdf = Kernel::Evaluate(parameters, baseColor, hit.Normal, sample);
+        const pxr::GfVec3f lightBxdf = Kernel::Evaluate(parameters, baseColor, hit.Normal, hit.LightDirection);
+        const float lightPdf = Kernel::PDF(parameters, hit.Normal, hit.LightDirection);
+
+        checksum += AccumulateHit(
+            hit.Normal, sample, samplePdf, sampleBxdf, lightBxdf, lightPdf, hit.LightDirection);
+    }
+
+    return checksum;
+}
+
+
+ONYX_BENCHMARK_NOINLINE static double ShadeTable(
+    const std::vector<ShadingBenchmarkHit>& hits,
+    const MaterialTable& materialTable)
+{
+    double checksum = 0.0;
+
+    size_t binStart = 0;
+    while (binStart < hits.size())
+    {
+        // Przedział uderzeń o wspólnym materiale - rekord jest odczytywany raz na przedział.
+        const uint32_t materialSlot = hits[binStart].MaterialSlot;
+
+        size_t binEnd = binStart + 1;
+        while (binEnd < hits.size() && hits[binEnd].MaterialSlot == materialSlot) binEnd++;
+
+        const MaterialRecord& record = materialTable.GetRecord(materialSlot);
+        switch (record.Kind)
+        {
+            case MaterialKind::Diffuse:
+                checksum += ShadeTableBin<MaterialKind::Diffuse>(
+                    materialTable.GetParameters<MaterialKind::Diffuse>(record.ParameterIndex),
+                    hits.data() + binStart, binEnd - binStart);
+                break;
+        }
+
+        binStart = binEnd;
+    }
+
+    return checksum;
+}
+
+
+// Najkrótszy czas z kilku powtórzeń w nanosekundach na uderzenie.
+template<typename ShadeFunction>
+static double MeasureNanosecondsPerHit(size_t hitCount, double& checksum, ShadeFunction&& shade)
+{
+    double bestSeconds = INFINITY;
+
+    for (uint32_t repetition = 0; repetition < ONYX_SHADING_BENCHMARK_REPETITIONS; repetition++)
+    {
+        auto shadeStart = std::chrono::steady_clock::now();
+        checksum = shade();
+        bestSeconds = std::min(
+            bestSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - shadeStart).count());
+    }
+
+    return 1.0e9 * bestSeconds / double(hitCount);
+}
+
+
+int main(int argc, char** argv)
+{
+    const size_t hitCount = argc > 1 ? std::max(std::atol(argv[1]), 1024L) : size_t(1) << 22;
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> materialDistribution(0, ONYX_SHADING_BENCHMARK_MATERIALS - 1);
+
+    auto randomDirection = [&]()
+    {
+        const float z = 2.0f * uniform(generator) - 1.0f;
+        const float phi = 2.0f * float(M_PI) * uniform(generator);
+        const float radius = std::sqrt(std::max(1.0f - z * z, 0.0f));
+
+        return pxr::GfVec3f(radius * std::cos(phi), radius * std::sin(phi), z);
+    };
+
+    std::vector<ShadingBenchmarkHit> hits(hitCount);
+    for (ShadingBenchmarkHit& hit : hits)
+    {
+        hit.Normal = randomDirection();
+        hit.Random2D = pxr::GfVec2f(uniform(generator), uniform(generator));
+        hit.LightDirection = randomDirection();
+        hit.MaterialSlot = materialDistribution(generator);
+    }
+
+    // Kolejka cieniowania integratora jest posortowana według materiału.
+    std::stable_sort(hits.begin(), hits.end(), [](const ShadingBenchmarkHit& a, const ShadingBenchmarkHit& b)
+    {
+        return a.MaterialSlot < b.MaterialSlot;
+    });
+
+    MaterialTable materialTable;
+    std::vector<std::unique_ptr<VirtualMaterial>> virtualMaterials;
+
+    for (uint32_t slot = 0; slot < ONYX_SHADING_BENCHMARK_MATERIALS; slot++)
+    {
+        MaterialParameters parameters;
+        parameters.DiffuseColor = pxr::GfVec3f(
+            0.2f + 0.6f * float(slot) / float(ONYX_SHADING_BENCHMARK_MATERIALS), 0.5f, 0.3f);
+
+        materialTable.Assign(slot, parameters);
+        virtualMaterials.push_back(std::make_unique<VirtualDiffuseMaterial>(parameters));
+    }
+
+    double virtualChecksum = 0.0;
+    double tableChecksum = 0.0;
+
+    const double virtualNanoseconds = MeasureNanosecondsPerHit(hitCount, virtualChecksum, [&]()
+    {
+        return ShadeVirtual(hits, virtualMaterials);
+    });
+
+    const double tableNanoseconds = MeasureNanosecondsPerHit(hitCount, tableChecksum, [&]()
+    {
+        return ShadeTable(hits, materialTable);
+    });
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[OnyxShadingBenchmark] Uderzenia " << hitCount
+              << " | materiały " << ONYX_SHADING_BENCHMARK_MATERIALS << std::endl;
+    std::cout << "[OnyxShadingBenchmark] Wywołania wirtualne | " << virtualNanoseconds << " ns/uderzenie" << std::endl;
+    std::cout << "[OnyxShadingBenchmark] Tabela materiałów   | " << tableNanoseconds << " ns/uderzenie"
+              << " | względem wywołań wirtualnych " << virtualNanoseconds / tableNanoseconds << "x" << std::endl;
+
+    const double checksumDifference = std::abs(virtualChecksum - tableChecksum);
+    if (!std::isfinite(tableChecksum)
+        || checksumDifference > ONYX_SHADING_BENCHMARK_CHECKSUM_TOLERANCE * std::abs(virtualChecksum))
+    {
+        std::cerr << "[OnyxShadingBenchmark] Niezgodne sumy kontrolne: " << virtualChecksum
+                  << " oraz " << tableChecksum << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
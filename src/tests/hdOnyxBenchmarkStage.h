@@ -0,0 +1,156 @@
+#pragma once
+
+// Statyczna scena benchmarków hdOnyx: pomieszczenie otwarte w stronę kamery, kopie instancera oraz światło.
+// Scena jest renderowana przez zadany czas (pomiary przy równym czasie renderowania).
+// Wszystkie benchmarki renderują tę samą scenę, dzięki czemu wyniki poszczególnych pomiarów są porównywalne.
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/camera.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointInstancer.h>
+#include <pxr/usd/usdGeom/xformCommonAPI.h>
+#include <pxr/usd/usdLux/rectLight.h>
+
+#include <chrono>
+#include <cmath>
+
+#include "hdOnyxTestRenderer.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+constexpr int ONYX_BENCHMARK_RESOLUTION = 256;
+
+
+inline SdfPath HdOnyxBenchmarkCameraPath()
+{
+    return SdfPath("/Camera");
+}
+
+
+// Siatka czworokątów w płaszczyźnie XY z przesunięciem w osi Z (nieregularna powierzchnia dla promieni wtórnych).
+inline void HdOnyxDefineBenchmarkGrid(
+    const UsdStageRefPtr& stage,
+    const SdfPath& path,
+    int resolution,
+    float size,
+    float amplitude)
+{
+    UsdGeomMesh mesh = UsdGeomMesh::Define(stage, path);
+
+    VtVec3fArray points;
+    VtIntArray faceVertexCounts(resolution * resolution, 4);
+    VtIntArray faceVertexIndices;
+
+    for (int y = 0; y <= resolution; y++)
+    {
+        for (int x = 0; x <= resolution; x++)
+        {
+            float u = float(x) / float(resolution);
+            float v = float(y) / float(resolution);
+            float z = amplitude * std::sin(25.0f * u) * std::cos(25.0f * v);
+            points.push_back(GfVec3f((u - 0.5f) * size, (v - 0.5f) * size, z));
+        }
+    }
+
+    for (int y = 0; y < resolution; y++)
+    {
+        for (int x = 0; x < resolution; x++)
+        {
+            int corner = y * (resolution + 1) + x;
+            faceVertexIndices.push_back(corner);
+            faceVertexIndices.push_back(corner + 1);
+            faceVertexIndices.push_back(corner + resolution + 2);
+            faceVertexIndices.push_back(corner + resolution + 1);
+        }
+    }
+
+    mesh.GetPointsAttr().Set(points);
+    mesh.GetFaceVertexCountsAttr().Set(faceVertexCounts);
+    mesh.GetFaceVertexIndicesAttr().Set(faceVertexIndices);
+}
+
+
+inline UsdStageRefPtr HdOnyxCreateBenchmarkStage()
+{
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+
+    UsdGeomCamera camera = UsdGeomCamera::Define(stage, HdOnyxBenchmarkCameraPath());
+    UsdGeomXformCommonAPI(camera).SetTranslate(GfVec3d(0.0, 0.0, 9.0));
+
+    // Pomieszczenie otwarte w stronę kamery - promienie wtórne trafiają w kolejne ściany.
+    HdOnyxDefineBenchmarkGrid(stage, SdfPath("/World/Back"), 256, 12.0f, 0.2f);
+
+    const SdfPath wallPaths[] = {
+        SdfPath("/World/Left"), SdfPath("/World/Right"), SdfPath("/World/Floor"), SdfPath("/World/Ceiling")
+    };
+    const GfVec3f wallRotations[] = {
+        GfVec3f(0.0f, 90.0f, 0.0f), GfVec3f(0.0f, -90.0f, 0.0f),
+        GfVec3f(-90.0f, 0.0f, 0.0f), GfVec3f(90.0f, 0.0f, 0.0f)
+    };
+    const GfVec3d wallTranslations[] = {
+        GfVec3d(-6.0, 0.0, 6.0), GfVec3d(6.0, 0.0, 6.0), GfVec3d(0.0, -6.0, 6.0), GfVec3d(0.0, 6.0, 6.0)
+    };
+
+    for (int wall = 0; wall < 4; wall++)
+    {
+        HdOnyxDefineBenchmarkGrid(stage, wallPaths[wall], 64, 12.0f, 0.0f);
+        UsdGeomXformCommonAPI(UsdGeomMesh::Get(stage, wallPaths[wall]))
+            .SetXformVectors(wallTranslations[wall], wallRotations[wall], GfVec3f(1.0f), GfVec3f(0.0f),
+                UsdGeomXformCommonAPI::RotationOrderXYZ, UsdTimeCode::Default());
+    }
+
+    // Kopie instancera wypełniają pomieszczenie geometrią o wielu poziomach BVH (TLAS / BLAS).
+    UsdGeomPointInstancer instancer = UsdGeomPointInstancer::Define(stage, SdfPath("/World/Instancer"));
+    HdOnyxDefineBenchmarkGrid(stage, SdfPath("/World/Instancer/Prototypes/Tile"), 16, 1.0f, 0.1f);
+    instancer.CreatePrototypesRel().AddTarget(SdfPath("/World/Instancer/Prototypes/Tile"));
+
+    VtVec3fArray positions;
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            float depth = 2.0f + 0.25f * float(x % 3);
+            positions.push_back(GfVec3f(-4.2f + 1.2f * float(x), -4.2f + 1.2f * float(y), depth));
+        }
+    }
+
+    instancer.GetPositionsAttr().Set(positions);
+    instancer.GetProtoIndicesAttr().Set(VtIntArray(positions.size(), 0));
+
+    UsdLuxRectLight light = UsdLuxRectLight::Define(stage, SdfPath("/World/Light"));
+    light.CreateIntensityAttr().Set(30.0f);
+    light.CreateWidthAttr().Set(4.0f);
+    light.CreateHeightAttr().Set(4.0f);
+    UsdGeomXformCommonAPI(light).SetTranslate(GfVec3d(0.0, 5.5, 5.0));
+    UsdGeomXformCommonAPI(light).SetRotate(GfVec3f(-90.0f, 0.0f, 0.0f));
+
+    return stage;
+}
+
+
+// Renderuje scenę przez zadany czas i zwraca rzeczywisty czas pomiaru w sekundach. Pierwsze wykonanie
+// synchronizuje scenę, buduje BVH i uruchamia wątek renderujący - pomiar nie obejmuje tego czasu.
+// Wątek renderujący wykonuje jedną iterację na uruchomienie, dlatego wykonania następują bez przerw -
+// każda przerwa między iteracjami zaniżałaby liczbę próbek zebranych w zadanym czasie.
+inline double HdOnyxRenderForDuration(HdOnyxTestRenderer& renderer, double seconds)
+{
+    renderer.Execute();
+
+    auto renderStart = std::chrono::steady_clock::now();
+    auto renderEnd = renderStart + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < renderEnd)
+    {
+        renderer.Execute();
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+}
+
+
+PXR_NAMESPACE_CLOSE_SCOPE
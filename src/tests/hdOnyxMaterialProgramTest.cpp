@@ -0,0 +1,243 @@
+// Test renderowania sieci materiałowej wykonywanej przez program materiału (ShadeMaterialBin).
+//
+// Czworokąt z materiałem UsdPreviewSurface, którego kolor pochodzi z tekstury szachownicy (czerwony / zielony)
+// odczytywanej przez UsdUVTexture <- UsdTransform2d <- UsdPrimvarReader_float2 ("st"). Obraz jest renderowany
+// do osiągnięcia limitu próbek (onyx:sampleLimit), po czym sprawdzane są:
+// - skończone wartości wszystkich pikseli,
+// - obecność pikseli z przewagą koloru czerwonego oraz zielonego (tekstura została odczytana przez program),
+// - statystyki silnika (trafienia kafelków tekstur, liczba unikalnych programów materiałów).
+//
+// Użycie: hdOnyxMaterialProgramTest [limit czasu renderowania w sekundach]
+
+#include <pxr/pxr.h>
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/imaging/hio/image.h>
+#include <pxr/usd/sdf/assetPath.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/sdf/types.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/camera.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdGeom/xformCommonAPI.h>
+#include <pxr/usd/usdLux/rectLight.h>
+#include <pxr/usd/usdShade/material.h>
+#include <pxr/usd/usdShade/materialBindingAPI.h>
+#include <pxr/usd/usdShade/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hdOnyxTestRenderer.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+constexpr int ONYX_MATERIAL_TEST_RESOLUTION = 32;
+constexpr int ONYX_MATERIAL_TEST_TEXTURE_SIZE = 16;
+constexpr int ONYX_MATERIAL_TEST_SAMPLE_LIMIT = 16;
+
+
+// Zapisuje teksturę szachownicy 2x2 pól (czerwone / zielone) w formacie PNG.
+static bool WriteCheckerTexture(const std::string& filePath)
+{
+    const int size = ONYX_MATERIAL_TEST_TEXTURE_SIZE;
+    std::vector<uint8_t> texels(size * size * 3);
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool red = ((x * 2 / size) + (y * 2 / size)) % 2 == 0;
+            uint8_t* texel = &texels[(y * size + x) * 3];
+            texel[0] = red ? 255 : 0;
+            texel[1] = red ? 0 : 255;
+            texel[2] = 0;
+        }
+    }
+
+    HioImageSharedPtr image = HioImage::OpenForWriting(filePath);
+    if (!image) return false;
+
+    HioImage::StorageSpec storage;
+    storage.width = size;
+    storage.height = size;
+    storage.format = HioFormatUNorm8Vec3srgb;
+    storage.flipped = false;
+    storage.data = texels.data();
+
+    return image->Write(storage);
+}
+
+
+static UsdStageRefPtr CreateMaterialStage(const std::string& texturePath)
+{
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+
+    UsdGeomCamera camera = UsdGeomCamera::Define(stage, SdfPath("/Camera"));
+    UsdGeomXformCommonAPI(camera).SetTranslate(GfVec3d(0.0, 0.0, 8.0));
+
+    // Czworokąt wypełniający kadr, współrzędne tekstury (0, 0) - (1, 1) w narożnikach.
+    UsdGeomMesh quad = UsdGeomMesh::Define(stage, SdfPath("/World/Quad"));
+    quad.GetPointsAttr().Set(VtVec3fArray{
+        GfVec3f(-2.0f, -2.0f, 0.0f), GfVec3f(2.0f, -2.0f, 0.0f), GfVec3f(2.0f, 2.0f, 0.0f), GfVec3f(-2.0f, 2.0f, 0.0f)
+    });
+    quad.GetFaceVertexCountsAttr().Set(VtIntArray{ 4 });
+    quad.GetFaceVertexIndicesAttr().Set(VtIntArray{ 0, 1, 2, 3 });
+
+    UsdGeomPrimvar st = UsdGeomPrimvarsAPI(quad).CreatePrimvar(
+        TfToken("st"), SdfValueTypeNames->TexCoord2fArray, UsdGeomTokens->vertex);
+    st.Set(VtVec2fArray{ GfVec2f(0.0f, 0.0f), GfVec2f(1.0f, 0.0f), GfVec2f(1.0f, 1.0f), GfVec2f(0.0f, 1.0f) });
+
+    // UsdPreviewSurface <- UsdUVTexture <- UsdTransform2d <- UsdPrimvarReader_float2.
+    UsdShadeMaterial material = UsdShadeMaterial::Define(stage, SdfPath("/World/Material"));
+
+    UsdShadeShader primvarReader = UsdShadeShader::Define(stage, SdfPath("/World/Material/PrimvarReader"));
+    primvarReader.CreateIdAttr(VtValue(TfToken("UsdPrimvarReader_float2")));
+    primvarReader.CreateInput(TfToken("varname"), SdfValueTypeNames->Token).Set(TfToken("st"));
+    UsdShadeOutput primvarOutput = primvarReader.CreateOutput(TfToken("result"), SdfValueTypeNames->Float2);
+
+    // Przekształcenie zachowuje zakres współrzędnych - sprawdzany jest jedynie przepływ rejestrów programu.
+    UsdShadeShader transform = UsdShadeShader::Define(stage, SdfPath("/World/Material/Transform"));
+    transform.CreateIdAttr(VtValue(TfToken("UsdTransform2d")));
+    transform.CreateInput(TfToken("in"), SdfValueTypeNames->Float2).ConnectToSource(primvarOutput);
+    transform.CreateInput(TfToken("scale"), SdfValueTypeNames->Float2).Set(GfVec2f(1.0f, 1.0f));
+    UsdShadeOutput transformOutput = transform.CreateOutput(TfToken("result"), SdfValueTypeNames->Float2);
+
+    UsdShadeShader texture = UsdShadeShader::Define(stage, SdfPath("/World/Material/Texture"));
+    texture.CreateIdAttr(VtValue(TfToken("UsdUVTexture")));
+    texture.CreateInput(TfToken("file"), SdfValueTypeNames->Asset).Set(SdfAssetPath(texturePath));
+    texture.CreateInput(TfToken("st"), SdfValueTypeNames->Float2).ConnectToSource(transformOutput);
+    texture.CreateInput(TfToken("sourceColorSpace"), SdfValueTypeNames->Token).Set(TfToken("raw"));
+    UsdShadeOutput textureOutput = texture.CreateOutput(TfToken("rgb"), SdfValueTypeNames->Float3);
+
+    UsdShadeShader surface = UsdShadeShader::Define(stage, SdfPath("/World/Material/Surface"));
+    surface.CreateIdAttr(VtValue(TfToken("UsdPreviewSurface")));
+    surface.CreateInput(TfToken("diffuseColor"), SdfValueTypeNames->Color3f).ConnectToSource(textureOutput);
+    surface.CreateInput(TfToken("roughness"), SdfValueTypeNames->Float).Set(1.0f);
+    material.CreateSurfaceOutput().ConnectToSource(surface.ConnectableAPI(), TfToken("surface"));
+
+    UsdShadeMaterialBindingAPI::Apply(quad.GetPrim()).Bind(material);
+
+    UsdLuxRectLight light = UsdLuxRectLight::Define(stage, SdfPath("/World/Light"));
+    light.CreateIntensityAttr().Set(50.0f);
+    light.CreateWidthAttr().Set(4.0f);
+    light.CreateHeightAttr().Set(4.0f);
+    UsdGeomXformCommonAPI(light).SetTranslate(GfVec3d(0.0, 3.0, 3.0));
+    UsdGeomXformCommonAPI(light).SetRotate(GfVec3f(-45.0f, 0.0f, 0.0f));
+
+    return stage;
+}
+
+
+int main(int argc, char** argv)
+{
+    const double timeoutSeconds = argc > 1 ? std::max(std::atof(argv[1]), 1.0) : 60.0;
+
+    const std::string texturePath = ArchGetTmpDir() + std::string("/hdOnyxMaterialProgramTest.png");
+    if (!WriteCheckerTexture(texturePath))
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Nie udało się zapisać tekstury " << texturePath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    UsdStageRefPtr stage = CreateMaterialStage(texturePath);
+
+    // Niski limit próbek - każde wykonanie Render Pass wznawia wątek renderujący na jedną iterację
+    // (jedna próbka bez regeneracji ścieżek), a test sprawdza przepływ danych programu, nie zbieżność szumu.
+    HdRenderSettingsMap renderSettings;
+    renderSettings[TfToken("onyx:sampleLimit")] = VtValue(ONYX_MATERIAL_TEST_SAMPLE_LIMIT);
+
+    HdOnyxTestRenderer renderer(stage, SdfPath("/Camera"), ONYX_MATERIAL_TEST_RESOLUTION, renderSettings);
+    if (!renderer.IsValid())
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Nie udało się wczytać pluginu hdOnyx." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    HdRenderBuffer* colorBuffer = renderer.GetColorBuffer();
+
+    renderer.Execute();
+
+    // Wykonania następują bez przerw - limit czasu zabezpiecza jedynie przed zawieszeniem testu.
+    auto renderEnd = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+    while (!colorBuffer->IsConverged() && std::chrono::steady_clock::now() < renderEnd)
+    {
+        renderer.Execute();
+    }
+
+    if (!colorBuffer->IsConverged())
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Obraz nie osiągnął zbieżności w czasie "
+                  << timeoutSeconds << " s." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int invalidPixelCount = 0;
+    int redPixelCount = 0;
+    int greenPixelCount = 0;
+
+    const GfVec4f* pixels = static_cast<const GfVec4f*>(colorBuffer->Map());
+    for (size_t pixel = 0; pixel < size_t(colorBuffer->GetWidth()) * colorBuffer->GetHeight(); pixel++)
+    {
+        const GfVec4f& color = pixels[pixel];
+        if (!std::isfinite(color[0]) || !std::isfinite(color[1]) || !std::isfinite(color[2]))
+        {
+            invalidPixelCount++;
+            continue;
+        }
+
+        if (color[0] > 2.0f * color[1]) redPixelCount++;
+        if (color[1] > 2.0f * color[0]) greenPixelCount++;
+    }
+    colorBuffer->Unmap();
+
+    const size_t textureTileHits = renderer.GetRenderStat<size_t>("onyx:textures:tileHits");
+    const size_t uniqueProgramCount = renderer.GetRenderStat<size_t>("onyx:uniqueMaterialProgramCount");
+
+    std::cout << "[hdOnyxMaterialProgramTest] piksele czerwone " << redPixelCount
+              << " | piksele zielone " << greenPixelCount
+              << " | piksele nieprawidłowe " << invalidPixelCount
+              << " | trafienia kafelków tekstur " << textureTileHits
+              << " | unikalne programy materiałów " << uniqueProgramCount << std::endl;
+
+    bool passed = true;
+
+    if (invalidPixelCount > 0)
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Obraz zawiera wartości NaN / Inf." << std::endl;
+        passed = false;
+    }
+
+    if (redPixelCount == 0 || greenPixelCount == 0)
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Kolor powierzchni nie pochodzi z tekstury szachownicy." << std::endl;
+        passed = false;
+    }
+
+    if (textureTileHits == 0)
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Program materiału nie odczytał tekstury." << std::endl;
+        passed = false;
+    }
+
+    if (uniqueProgramCount == 0)
+    {
+        std::cerr << "[hdOnyxMaterialProgramTest] Materiał nie został skompilowany do programu." << std::endl;
+        passed = false;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
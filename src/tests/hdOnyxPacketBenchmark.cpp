@@ -0,0 +1,83 @@
+// Porównanie przepustowości śledzenia promieni trybu skalarnego oraz trybów pakietowych (4, 8, 16).
+//
+// Dla każdej szerokości pakietu tworzony jest nowy Render Delegate hdOnyx (ustawienie onyx:packetWidth),
+// który renderuje tę samą statyczną scenę przez zadany czas. Przepustowość jest odczytywana ze statystyk
+// silnika (onyx:integrator:*) - pomiar nie obejmuje synchronizacji sceny ani budowy BVH.
+// Wykonania następują bez przerw. Udział czasu śledzenia w czasie pomiaru pokazuje, czy wątek renderujący
+// był zajęty przez cały pomiar (przepustowość nie jest ograniczona przez pętlę benchmarku).
+//
+// Użycie: hdOnyxPacketBenchmark [czas pomiaru jednej szerokości w sekundach]
+
+#include <pxr/pxr.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/value.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "hdOnyxBenchmarkStage.h"
+#include "hdOnyxTestRenderer.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+// Liczba odbić pozwala na pomiar promieni wtórnych (spójność pakietów maleje z każdym odbiciem).
+constexpr int ONYX_PACKET_BENCHMARK_BOUNCES = 4;
+
+
+int main(int argc, char** argv)
+{
+    const double measureSeconds = argc > 1 ? std::max(std::atof(argv[1]), 0.5) : 3.0;
+    const int packetWidths[] = { 1, 4, 8, 16 };
+
+    UsdStageRefPtr stage = HdOnyxCreateBenchmarkStage();
+
+    double scalarRaysPerSecond = 0.0;
+    bool allWidthsMeasured = true;
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (int packetWidth : packetWidths)
+    {
+        // Wyłączamy adaptacyjne próbkowanie - wszystkie kafelki otrzymują promienie przez cały pomiar.
+        HdRenderSettingsMap renderSettings;
+        renderSettings[TfToken("onyx:packetWidth")] = VtValue(packetWidth);
+        renderSettings[TfToken("onyx:noiseThreshold")] = VtValue(0.0f);
+        renderSettings[TfToken("onyx:maxBounces")] = VtValue(ONYX_PACKET_BENCHMARK_BOUNCES);
+        renderSettings[TfToken("onyx:maxDiffuseBounces")] = VtValue(ONYX_PACKET_BENCHMARK_BOUNCES);
+
+        HdOnyxTestRenderer renderer(stage, HdOnyxBenchmarkCameraPath(), ONYX_BENCHMARK_RESOLUTION, renderSettings);
+        if (!renderer.IsValid())
+        {
+            std::cerr << "[hdOnyxPacketBenchmark] Nie udało się wczytać pluginu hdOnyx." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const double wallSeconds = HdOnyxRenderForDuration(renderer, measureSeconds);
+
+        const double raysPerSecond = renderer.GetRenderStat<double>("onyx:integrator:raysPerSecond");
+        const uint64_t totalRays = renderer.GetRenderStat<uint64_t>("onyx:integrator:totalRays");
+        const uint32_t sampleCount = renderer.GetRenderStat<uint32_t>("onyx:integrator:sampleCount");
+        const double traceSeconds = renderer.GetRenderStat<double>("onyx:integrator:totalSeconds");
+
+        if (packetWidth == 1) scalarRaysPerSecond = raysPerSecond;
+        if (totalRays == 0) allWidthsMeasured = false;
+
+        std::cout << "[hdOnyxPacketBenchmark] Szerokość pakietu " << std::setw(2) << packetWidth
+                  << " | " << std::setw(8) << raysPerSecond / 1.0e6 << " Mrays/s"
+                  << " | próbki " << sampleCount
+                  << " | śledzenie " << std::setw(6) << 100.0 * traceSeconds / wallSeconds << "% czasu"
+                  << " | względem trybu skalarnego "
+                  << (scalarRaysPerSecond > 0.0 ? raysPerSecond / scalarRaysPerSecond : 0.0) << "x" << std::endl;
+    }
+
+    if (!allWidthsMeasured)
+    {
+        std::cerr << "[hdOnyxPacketBenchmark] Integrator nie wykonał śledzenia promieni." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
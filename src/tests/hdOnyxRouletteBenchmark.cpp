@@ -0,0 +1,192 @@
+// Porównanie kosztu oraz szumu ścieżek bez ruletki rosyjskiej (Russian Roulette) oraz z ruletką.
+//
+// Każda konfiguracja renderuje tę samą statyczną scenę przez ten sam czas, bez przerw między iteracjami:
+// - głębokie ścieżki bez ruletki (limit odbić osiągany przez każdą ścieżkę),
+// - głębokie ścieżki z ruletką po zadanej liczbie odbić.
+// Obraz każdej konfiguracji jest porównywany z obrazem referencyjnym (ten sam limit odbić, bez ruletki,
+// niezależny sampler, wielokrotnie dłuższy czas renderowania). Raportowana jest liczba promieni na próbkę,
+// liczba zebranych próbek oraz RMSE względem referencji.
+//
+// Ruletka nie może zwiększyć błędu na jednostkę czasu: iloczyn MSE oraz czasu śledzenia konfiguracji
+// z ruletką nie może przekroczyć iloczynu konfiguracji bez ruletki o więcej niż zadaną tolerancję.
+//
+// Użycie: hdOnyxRouletteBenchmark [czas renderowania jednej konfiguracji w sekundach]
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/value.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "hdOnyxBenchmarkStage.h"
+#include "hdOnyxTestRenderer.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+// Ruletka nie jest stosowana gdy liczba odbić przed ruletką przekracza limit odbić.
+constexpr int ONYX_ROULETTE_DISABLED = 255;
+
+constexpr int ONYX_ROULETTE_MAX_BOUNCES = 8;
+constexpr int ONYX_ROULETTE_MIN_BOUNCE = 3;
+
+// Obraz referencyjny jest renderowany wielokrotnie dłużej niż porównywane konfiguracje.
+constexpr double ONYX_ROULETTE_REFERENCE_TIME_FACTOR = 8.0;
+
+// Dopuszczalny wzrost błędu na jednostkę czasu (szum pomiaru czasu oraz szum obrazu referencyjnego).
+constexpr double ONYX_ROULETTE_ERROR_TOLERANCE = 0.1;
+
+// Sampler obrazu referencyjnego (Independent) różni się od samplera porównywanych konfiguracji (Sobol) -
+// próbki referencji nie są skorelowane z próbkami konfiguracji bez ruletki.
+constexpr int ONYX_ROULETTE_REFERENCE_SAMPLER = 0;
+constexpr int ONYX_ROULETTE_MEASURED_SAMPLER = 1;
+
+
+struct RouletteBenchmarkConfiguration
+{
+    std::string Name;
+    int RussianRouletteMinBounce;
+    int Sampler;
+    double RenderSeconds;
+};
+
+
+struct RouletteBenchmarkResult
+{
+    std::vector<GfVec4f> Colors;
+    double RaysPerSample = 0.0;
+    uint32_t SampleCount = 0;
+    double TraceSeconds = 0.0;
+};
+
+
+// Renderuje konfigurację przez zadany czas, zatrzymuje wątek renderujący i odczytuje obraz.
+static std::optional<RouletteBenchmarkResult> RenderConfiguration(
+    const UsdStageRefPtr& stage,
+    const RouletteBenchmarkConfiguration& configuration)
+{
+    // Wyłączamy adaptacyjne próbkowanie - wszystkie piksele otrzymują próbki przez cały pomiar.
+    HdRenderSettingsMap renderSettings;
+    renderSettings[TfToken("onyx:noiseThreshold")] = VtValue(0.0f);
+    renderSettings[TfToken("onyx:sampleLimit")] = VtValue(1000000);
+    renderSettings[TfToken("onyx:sampler")] = VtValue(configuration.Sampler);
+    renderSettings[TfToken("onyx:maxBounces")] = VtValue(ONYX_ROULETTE_MAX_BOUNCES);
+    renderSettings[TfToken("onyx:maxDiffuseBounces")] = VtValue(ONYX_ROULETTE_MAX_BOUNCES);
+    renderSettings[TfToken("onyx:russianRouletteMinBounce")] = VtValue(configuration.RussianRouletteMinBounce);
+
+    HdOnyxTestRenderer renderer(stage, HdOnyxBenchmarkCameraPath(), ONYX_BENCHMARK_RESOLUTION, renderSettings);
+    if (!renderer.IsValid()) return std::nullopt;
+
+    HdOnyxRenderForDuration(renderer, configuration.RenderSeconds);
+    renderer.StopRendering();
+
+    RouletteBenchmarkResult result;
+    result.Colors = renderer.ReadColorBuffer();
+    result.RaysPerSample = renderer.GetRenderStat<double>("onyx:integrator:raysPerSample");
+    result.SampleCount = renderer.GetRenderStat<uint32_t>("onyx:integrator:sampleCount");
+    result.TraceSeconds = renderer.GetRenderStat<double>("onyx:integrator:totalSeconds");
+
+    return result;
+}
+
+
+// Błąd średniokwadratowy kanałów RGB względem obrazu referencyjnego. Piksele nieskończone lub NaN
+// zwracają nieskończony błąd.
+static double ComputeMeanSquaredError(const std::vector<GfVec4f>& colors, const std::vector<GfVec4f>& reference)
+{
+    if (colors.empty() || colors.size() != reference.size()) return INFINITY;
+
+    double squaredErrorSum = 0.0;
+    for (size_t pixel = 0; pixel < colors.size(); pixel++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            const double difference = double(colors[pixel][channel]) - double(reference[pixel][channel]);
+            squaredErrorSum += difference * difference;
+        }
+    }
+
+    return std::isfinite(squaredErrorSum) ? squaredErrorSum / double(3 * colors.size()) : INFINITY;
+}
+
+
+int main(int argc, char** argv)
+{
+    const double renderSeconds = argc > 1 ? std::max(std::atof(argv[1]), 0.5) : 5.0;
+
+    const RouletteBenchmarkConfiguration referenceConfiguration = {
+        "referencja", ONYX_ROULETTE_DISABLED, ONYX_ROULETTE_REFERENCE_SAMPLER,
+        ONYX_ROULETTE_REFERENCE_TIME_FACTOR * renderSeconds
+    };
+    const RouletteBenchmarkConfiguration configurations[] = {
+        { "8 odbić, bez ruletki", ONYX_ROULETTE_DISABLED, ONYX_ROULETTE_MEASURED_SAMPLER, renderSeconds },
+        { "8 odbić, ruletka od 3", ONYX_ROULETTE_MIN_BOUNCE, ONYX_ROULETTE_MEASURED_SAMPLER, renderSeconds },
+    };
+
+    UsdStageRefPtr stage = HdOnyxCreateBenchmarkStage();
+
+    std::optional<RouletteBenchmarkResult> reference = RenderConfiguration(stage, referenceConfiguration);
+    if (!reference)
+    {
+        std::cerr << "[hdOnyxRouletteBenchmark] Nie udało się wczytać pluginu hdOnyx." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "[hdOnyxRouletteBenchmark] " << std::setw(24) << referenceConfiguration.Name
+              << " | próbki piksela " << reference->SampleCount << std::endl;
+
+    // Iloczyn MSE oraz czasu śledzenia - odwrotność wydajności estymatora (błąd na jednostkę czasu).
+    double errorTimeProducts[2] = {};
+    bool allConfigurationsMeasured = reference->SampleCount > 0;
+
+    for (int configurationIndex = 0; configurationIndex < 2; configurationIndex++)
+    {
+        const RouletteBenchmarkConfiguration& configuration = configurations[configurationIndex];
+
+        std::optional<RouletteBenchmarkResult> result = RenderConfiguration(stage, configuration);
+        if (!result)
+        {
+            std::cerr << "[hdOnyxRouletteBenchmark] Nie udało się wczytać pluginu hdOnyx." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (result->SampleCount == 0 || result->TraceSeconds <= 0.0) allConfigurationsMeasured = false;
+
+        const double meanSquaredError = ComputeMeanSquaredError(result->Colors, reference->Colors);
+        errorTimeProducts[configurationIndex] = meanSquaredError * result->TraceSeconds;
+
+        std::cout << "[hdOnyxRouletteBenchmark] " << std::setw(24) << configuration.Name
+                  << " | promienie na próbkę " << result->RaysPerSample
+                  << " | próbki piksela " << result->SampleCount
+                  << " | czas śledzenia " << result->TraceSeconds << " s"
+                  << " | RMSE " << std::sqrt(meanSquaredError) << std::endl;
+    }
+
+    if (!allConfigurationsMeasured)
+    {
+        std::cerr << "[hdOnyxRouletteBenchmark] Integrator nie zebrał próbek." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const double efficiencyRatio = errorTimeProducts[1] / errorTimeProducts[0];
+    std::cout << "[hdOnyxRouletteBenchmark] Błąd na jednostkę czasu z ruletką względem braku ruletki: "
+              << efficiencyRatio << "x" << std::endl;
+
+    if (!(efficiencyRatio <= 1.0 + ONYX_ROULETTE_ERROR_TOLERANCE))
+    {
+        std::cerr << "[hdOnyxRouletteBenchmark] Ruletka zwiększa błąd na jednostkę czasu ponad tolerancję "
+                  << ONYX_ROULETTE_ERROR_TOLERANCE << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
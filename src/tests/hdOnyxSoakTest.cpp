@@ -0,0 +1,390 @@
+// Test długotrwałej edycji sceny (soak test) dla Render Delegate hdOnyx.
+//
+// Test wczytuje plugin hdOnyx tak samo jak aplikacja (rejestr pluginów Hydry), wypełnia indeks renderowania
+// sceną OpenUSD utworzoną w pamięci i wykonuje tysiące edycji w trakcie renderowania: zmiany transformacji,
+// deformacje punktów (refit), dodawanie i usuwanie świateł, zmiany topologii oraz liczby kopii instancera.
+// Po każdej partii edycji Hydra synchronizuje scenę, a wątek renderujący kontynuuje pracę.
+//
+// Wszystkie edycje są okresowe - co ONYX_SOAK_PERIOD iteracji scena wraca do identycznego stanu. Pamięć silnika
+// oraz Embree mierzona w tych samych punktach okresu musi wracać do pomiaru bazowego (po okresie rozgrzewającym)
+// z dokładnością do kilku KB, a jeśli nie wraca dokładnie (niedeterministyczne bloki alokatora Embree),
+// jej trend nie może rosnąć szybciej niż kilkaset bajtów na okres. Pamięć rezydentna procesu zawiera pamięć
+// podręczną alokatora systemowego, dlatego jest sprawdzana z większym zapasem.
+//
+// Użycie: hdOnyxSoakTest [liczba iteracji]
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+#include <pxr/usd/sdf/types.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/camera.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointInstancer.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdGeom/xformCommonAPI.h>
+#include <pxr/usd/usdLux/rectLight.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "hdOnyxTestRenderer.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+// Liczba iteracji po której wszystkie edycje sceny się powtarzają.
+constexpr int ONYX_SOAK_PERIOD = 100;
+
+// Maksymalna liczba świateł tworzonych i usuwanych w trakcie okresu.
+constexpr int ONYX_SOAK_MAX_DYNAMIC_LIGHTS = 8;
+
+// Dopuszczalna różnica pamięci silnika oraz Embree względem pomiaru bazowego po każdym okresie edycji.
+constexpr double ONYX_SOAK_RETURN_TOLERANCE = 4.0 * 1024.0;
+
+// Dopuszczalny trend pamięci silnika oraz Embree (bajty na okres, regresja liniowa pomiarów po pomiarze bazowym)
+// gdy pamięć nie wraca do pomiaru bazowego w granicach ONYX_SOAK_RETURN_TOLERANCE.
+constexpr double ONYX_SOAK_SLOPE_TOLERANCE = 512.0;
+
+// Dopuszczalny wzrost pamięci rezydentnej procesu (względny oraz bezwzględny zapas na fragmentację alokatora).
+constexpr double ONYX_SOAK_RESIDENT_RELATIVE_TOLERANCE = 0.1;
+constexpr size_t ONYX_SOAK_RESIDENT_ABSOLUTE_TOLERANCE = 16 * 1024 * 1024;
+
+constexpr int ONYX_SOAK_RESOLUTION = 64;
+
+
+// Pamięć rezydentna procesu w bajtach. 0 jeśli system nie udostępnia informacji.
+static size_t GetResidentMemoryBytes()
+{
+#if defined(__APPLE__)
+    mach_task_basic_info_data_t taskInfo;
+    mach_msg_type_number_t infoCount = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&taskInfo, &infoCount) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+
+    return taskInfo.resident_size;
+#else
+    // Drugie pole /proc/self/statm - liczba stron rezydentnych.
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (!(statm >> totalPages >> residentPages)) return 0;
+
+    return residentPages * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+
+// Pomiar pamięci w jednym punkcie okresu edycji.
+struct SoakMemorySample
+{
+    size_t RendererBytes = 0;
+    size_t EmbreeBytes = 0;
+    size_t ResidentBytes = 0;
+    size_t LightSlotCount = 0;
+};
+
+
+static SoakMemorySample SampleMemory(const HdOnyxTestRenderer& renderer)
+{
+    return SoakMemorySample{
+        .RendererBytes = renderer.GetRenderStat<size_t>("onyx:memory:totalBytes"),
+        .EmbreeBytes = renderer.GetRenderStat<size_t>("onyx:memory:embreeBytes"),
+        .ResidentBytes = GetResidentMemoryBytes(),
+        .LightSlotCount = renderer.GetRenderStat<size_t>("onyx:lightSlotCount")
+    };
+}
+
+
+// Pamięć mierzona po każdym okresie edycji wraca do pomiaru bazowego (z dokładnością do kilku KB)
+// lub nie wykazuje trendu wzrostowego.
+static bool IsMemoryReturningToBaseline(const char* name, size_t baselineBytes, const std::vector<size_t>& cycleBytes)
+{
+    double maxDifference = 0.0;
+    for (size_t bytes : cycleBytes)
+    {
+        maxDifference = std::max(maxDifference, std::abs(double(bytes) - double(baselineBytes)));
+    }
+
+    // Nachylenie prostej regresji (metoda najmniejszych kwadratów) dla pomiaru bazowego oraz kolejnych okresów.
+    const double sampleCount = double(cycleBytes.size() + 1);
+    double sumCycle = 0.0, sumBytes = double(baselineBytes), sumCycleBytes = 0.0, sumCycleSquared = 0.0;
+    for (size_t cycle = 1; cycle <= cycleBytes.size(); cycle++)
+    {
+        sumCycle += double(cycle);
+        sumBytes += double(cycleBytes[cycle - 1]);
+        sumCycleBytes += double(cycle) * double(cycleBytes[cycle - 1]);
+        sumCycleSquared += double(cycle) * double(cycle);
+    }
+
+    const double slopeDenominator = sampleCount * sumCycleSquared - sumCycle * sumCycle;
+    const double slope = slopeDenominator > 0.0
+        ? (sampleCount * sumCycleBytes - sumCycle * sumBytes) / slopeDenominator
+        : 0.0;
+
+    std::cout << "[hdOnyxSoakTest] " << name << ": pomiar bazowy " << baselineBytes
+              << " B, największa różnica " << maxDifference << " B, trend " << slope << " B/okres" << std::endl;
+
+    return maxDifference <= ONYX_SOAK_RETURN_TOLERANCE || slope <= ONYX_SOAK_SLOPE_TOLERANCE;
+}
+
+
+static bool IsResidentMemoryWithinTolerance(size_t baselineBytes, size_t sampleBytes)
+{
+    return double(sampleBytes) <= double(baselineBytes) * (1.0 + ONYX_SOAK_RESIDENT_RELATIVE_TOLERANCE)
+        + double(ONYX_SOAK_RESIDENT_ABSOLUTE_TOLERANCE);
+}
+
+
+// Siatka czworokątów w płaszczyźnie XY. Przesunięcie w osi Z zależy od fazy (deformacja punktów).
+static void SetGridGeometry(const UsdGeomMesh& mesh, int resolution, float size, float phase, bool topologyChanged)
+{
+    VtVec3fArray points;
+    points.reserve((resolution + 1) * (resolution + 1));
+
+    for (int y = 0; y <= resolution; y++)
+    {
+        for (int x = 0; x <= resolution; x++)
+        {
+            float u = float(x) / float(resolution);
+            float v = float(y) / float(resolution);
+            float z = 0.25f * std::sin(6.2831853f * (u + v + phase));
+            points.push_back(GfVec3f((u - 0.5f) * size, (v - 0.5f) * size, z));
+        }
+    }
+
+    mesh.GetPointsAttr().Set(points);
+
+    if (!topologyChanged) return;
+
+    VtIntArray faceVertexCounts(resolution * resolution, 4);
+    VtIntArray faceVertexIndices;
+    faceVertexIndices.reserve(resolution * resolution * 4);
+
+    for (int y = 0; y < resolution; y++)
+    {
+        for (int x = 0; x < resolution; x++)
+        {
+            int corner = y * (resolution + 1) + x;
+            faceVertexIndices.push_back(corner);
+            faceVertexIndices.push_back(corner + 1);
+            faceVertexIndices.push_back(corner + resolution + 2);
+            faceVertexIndices.push_back(corner + resolution + 1);
+        }
+    }
+
+    mesh.GetFaceVertexCountsAttr().Set(faceVertexCounts);
+    mesh.GetFaceVertexIndicesAttr().Set(faceVertexIndices);
+}
+
+
+static void SetInstancerCopies(const UsdGeomPointInstancer& instancer, int copyCount, float phase)
+{
+    VtVec3fArray positions;
+    VtIntArray protoIndices(copyCount, 0);
+
+    for (int copy = 0; copy < copyCount; copy++)
+    {
+        float angle = 6.2831853f * (float(copy) / float(copyCount) + phase);
+        positions.push_back(GfVec3f(3.0f * std::cos(angle), 3.0f * std::sin(angle), 1.0f));
+    }
+
+    instancer.GetPositionsAttr().Set(positions);
+    instancer.GetProtoIndicesAttr().Set(protoIndices);
+}
+
+
+static SdfPath GetDynamicLightPath(int lightIndex)
+{
+    return SdfPath("/World/Lights").AppendChild(TfToken("DynamicLight" + std::to_string(lightIndex)));
+}
+
+
+static UsdStageRefPtr CreateSoakStage()
+{
+    UsdStageRefPtr stage = UsdStage::CreateInMemory();
+
+    // Kamera patrzy wzdłuż osi -Z na scenę w płaszczyźnie XY.
+    UsdGeomCamera camera = UsdGeomCamera::Define(stage, SdfPath("/Camera"));
+    UsdGeomXformCommonAPI(camera).SetTranslate(GfVec3d(0.0, 0.0, 12.0));
+
+    // Podłoże deformowane w każdej iteracji ścieżką refit.
+    UsdGeomMesh ground = UsdGeomMesh::Define(stage, SdfPath("/World/Ground"));
+    SetGridGeometry(ground, 32, 10.0f, 0.0f, true);
+    UsdGeomPrimvarsAPI(ground)
+        .CreatePrimvar(TfToken("onyx:deformUpdate"), SdfValueTypeNames->Token, UsdGeomTokens->constant)
+        .Set(TfToken("refit"));
+
+    // Mesh przesuwany w każdej iteracji, którego topologia zmienia się dwa razy w okresie.
+    UsdGeomMesh moving = UsdGeomMesh::Define(stage, SdfPath("/World/Moving"));
+    SetGridGeometry(moving, 4, 2.0f, 0.0f, true);
+
+    // Instancer, którego liczba kopii zmienia się cztery razy w okresie.
+    UsdGeomPointInstancer instancer = UsdGeomPointInstancer::Define(stage, SdfPath("/World/Instancer"));
+    UsdGeomMesh prototype = UsdGeomMesh::Define(stage, SdfPath("/World/Instancer/Prototypes/Tile"));
+    SetGridGeometry(prototype, 2, 0.5f, 0.0f, true);
+    instancer.CreatePrototypesRel().AddTarget(prototype.GetPath());
+    SetInstancerCopies(instancer, 16, 0.0f);
+
+    // Stałe światło przesuwane w każdej iteracji.
+    UsdLuxRectLight keyLight = UsdLuxRectLight::Define(stage, SdfPath("/World/KeyLight"));
+    keyLight.CreateIntensityAttr().Set(20.0f);
+    UsdGeomXformCommonAPI(keyLight).SetTranslate(GfVec3d(0.0, 0.0, 6.0));
+
+    return stage;
+}
+
+
+// Wykonuje edycje sceny jednej iteracji. Stan sceny zależy wyłącznie od fazy iteracji w okresie.
+static void EditSoakStage(const UsdStageRefPtr& stage, int iteration)
+{
+    const int periodIteration = iteration % ONYX_SOAK_PERIOD;
+    const float phase = float(periodIteration) / float(ONYX_SOAK_PERIOD);
+
+    // Deformacja punktów podłoża (topologia bez zmian).
+    SetGridGeometry(UsdGeomMesh::Get(stage, SdfPath("/World/Ground")), 32, 10.0f, phase, false);
+
+    // Zmiana transformacji oraz (dwa razy w okresie) topologii.
+    UsdGeomMesh moving = UsdGeomMesh::Get(stage, SdfPath("/World/Moving"));
+    UsdGeomXformCommonAPI(moving).SetTranslate(GfVec3d(3.0 * std::cos(6.2831853 * phase), 0.0, 2.0));
+    UsdGeomXformCommonAPI(moving).SetRotate(GfVec3f(0.0f, 0.0f, 360.0f * phase));
+    if (periodIteration % (ONYX_SOAK_PERIOD / 2) == 0)
+    {
+        SetGridGeometry(moving, periodIteration == 0 ? 4 : 8, 2.0f, 0.0f, true);
+    }
+
+    // Liczba kopii instancera zmienia się co ćwierć okresu, w pozostałych iteracjach zmieniają się pozycje kopii.
+    const int copyCount = 16 * (1 + periodIteration / (ONYX_SOAK_PERIOD / 4));
+    SetInstancerCopies(UsdGeomPointInstancer::Get(stage, SdfPath("/World/Instancer")), copyCount, phase);
+
+    // Zmiana transformacji światła.
+    UsdGeomXformCommonAPI(UsdLuxRectLight::Get(stage, SdfPath("/World/KeyLight")))
+        .SetTranslate(GfVec3d(2.0 * std::sin(6.2831853 * phase), 0.0, 6.0));
+
+    // Dodawanie oraz usuwanie świateł. Na początku okresu wszystkie światła dynamiczne są usuwane.
+    const int dynamicLightCount = periodIteration % (ONYX_SOAK_MAX_DYNAMIC_LIGHTS + 1);
+    for (int lightIndex = 0; lightIndex < ONYX_SOAK_MAX_DYNAMIC_LIGHTS; lightIndex++)
+    {
+        const SdfPath lightPath = GetDynamicLightPath(lightIndex);
+        const bool lightExists = bool(stage->GetPrimAtPath(lightPath));
+
+        if (lightIndex < dynamicLightCount && !lightExists)
+        {
+            UsdLuxRectLight light = UsdLuxRectLight::Define(stage, lightPath);
+            light.CreateIntensityAttr().Set(5.0f);
+            UsdGeomXformCommonAPI(light).SetTranslate(GfVec3d(lightIndex - 4.0, 4.0, 4.0));
+        }
+        else if (lightIndex >= dynamicLightCount && lightExists)
+        {
+            stage->RemovePrim(lightPath);
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    const int iterationCount = argc > 1 ? std::max(std::atoi(argv[1]), 2 * ONYX_SOAK_PERIOD) : 20 * ONYX_SOAK_PERIOD;
+
+    UsdStageRefPtr stage = CreateSoakStage();
+
+    HdOnyxTestRenderer renderer(stage, SdfPath("/Camera"), ONYX_SOAK_RESOLUTION);
+    if (!renderer.IsValid())
+    {
+        std::cerr << "[hdOnyxSoakTest] Nie udało się wczytać pluginu hdOnyx." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Pierwszy okres służy rozgrzaniu pamięci podręcznych (geometria współdzielona, tekstury, pule alokatorów).
+    // Pomiar na jego końcu jest pomiarem bazowym.
+    std::optional<SoakMemorySample> baselineSample;
+    std::vector<size_t> cycleRendererBytes;
+    std::vector<size_t> cycleEmbreeBytes;
+    size_t peakLightSlotCount = 0;
+    bool residentMemoryFlat = true;
+
+    for (int iteration = 0; iteration < iterationCount; iteration++)
+    {
+        EditSoakStage(stage, iteration);
+
+        // Synchronizacja (wraz z CommitResources) oraz wznowienie wątku renderującego.
+        renderer.Execute();
+
+        // Wątek renderujący wykonuje iteracje pomiędzy kolejnymi partiami edycji.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if (iteration % ONYX_SOAK_PERIOD != ONYX_SOAK_PERIOD - 1) continue;
+
+        const SoakMemorySample sample = SampleMemory(renderer);
+        peakLightSlotCount = std::max(peakLightSlotCount, sample.LightSlotCount);
+
+        std::cout << "[hdOnyxSoakTest] Iteracja " << iteration + 1
+                  << ": silnik " << sample.RendererBytes
+                  << " B, Embree " << sample.EmbreeBytes
+                  << " B, pamięć rezydentna " << sample.ResidentBytes
+                  << " B, miejsca świateł " << sample.LightSlotCount << std::endl;
+
+        if (!baselineSample.has_value())
+        {
+            baselineSample = sample;
+            continue;
+        }
+
+        cycleRendererBytes.push_back(sample.RendererBytes);
+        cycleEmbreeBytes.push_back(sample.EmbreeBytes);
+
+        if (!IsResidentMemoryWithinTolerance(baselineSample->ResidentBytes, sample.ResidentBytes))
+        {
+            residentMemoryFlat = false;
+        }
+    }
+
+    const bool rendererMemoryFlat =
+        IsMemoryReturningToBaseline("Pamięć silnika", baselineSample->RendererBytes, cycleRendererBytes);
+    const bool embreeMemoryFlat =
+        IsMemoryReturningToBaseline("Pamięć Embree", baselineSample->EmbreeBytes, cycleEmbreeBytes);
+
+    // Światła są usuwane i dodawane w osobnych partiach, dlatego zwolnione miejsca w buforze świateł są ponownie
+    // używane - bufor nie może przekroczyć liczby jednocześnie istniejących świateł (wraz ze światłem stałym).
+    const bool lightSlotsBounded = peakLightSlotCount <= size_t(ONYX_SOAK_MAX_DYNAMIC_LIGHTS + 1);
+
+    if (!rendererMemoryFlat || !embreeMemoryFlat)
+    {
+        std::cerr << "[hdOnyxSoakTest] Pamięć silnika lub Embree nie wraca do pomiaru bazowego "
+                  << "po okresie edycji sceny." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!residentMemoryFlat)
+    {
+        std::cerr << "[hdOnyxSoakTest] Pamięć rezydentna procesu rośnie wraz z liczbą edycji sceny." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!lightSlotsBounded)
+    {
+        std::cerr << "[hdOnyxSoakTest] Bufor świateł rośnie wraz z liczbą edycji sceny: "
+                  << peakLightSlotCount << " miejsc." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "[hdOnyxSoakTest] Wykonano " << iterationCount << " iteracji edycji sceny." << std::endl;
+    return EXIT_SUCCESS;
+}
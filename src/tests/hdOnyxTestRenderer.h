@@ -0,0 +1,195 @@
+#pragma once
+
+// Wspólne narzędzia testów hdOnyx: indeks renderowania Hydry z Render Delegate wczytanym przez rejestr pluginów
+// (tak samo jak w aplikacji), wypełniony sceną OpenUSD i renderujący do jednego bufora AOV (color).
+
+#include <pxr/pxr.h>
+#include <pxr/base/gf/vec3i.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/dictionary.h>
+#include <pxr/imaging/hd/camera.h>
+#include <pxr/imaging/hd/engine.h>
+#include <pxr/imaging/hd/pluginRenderDelegateUniqueHandle.h>
+#include <pxr/imaging/hd/renderBuffer.h>
+#include <pxr/imaging/hd/renderDelegate.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/renderPass.h>
+#include <pxr/imaging/hd/renderPassState.h>
+#include <pxr/imaging/hd/rendererPluginRegistry.h>
+#include <pxr/imaging/hd/rprimCollection.h>
+#include <pxr/imaging/hd/task.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImaging/delegate.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+
+// Minimalne zadanie Hydry wykonujące render pass hdOnyx do jednego bufora AOV (color).
+class HdOnyxTestRenderTask final : public HdTask
+{
+public:
+    HdOnyxTestRenderTask(HdSceneDelegate* sceneDelegate, SdfPath const& id)
+    : HdTask(id)
+    {}
+
+    void SetRenderPass(const HdRenderPassSharedPtr& renderPass, const HdRenderPassStateSharedPtr& renderPassState)
+    {
+        m_RenderPass = renderPass;
+        m_RenderPassState = renderPassState;
+    }
+
+    void Sync(HdSceneDelegate* sceneDelegate, HdTaskContext* taskContext, HdDirtyBits* dirtyBits) override
+    {
+        m_RenderPass->Sync();
+        *dirtyBits = HdChangeTracker::Clean;
+    }
+
+    void Prepare(HdTaskContext* taskContext, HdRenderIndex* renderIndex) override
+    {
+        m_RenderPassState->Prepare(renderIndex->GetResourceRegistry());
+    }
+
+    void Execute(HdTaskContext* taskContext) override
+    {
+        m_RenderPass->Execute(m_RenderPassState, GetRenderTags());
+    }
+
+    const TfTokenVector& GetRenderTags() const override
+    {
+        static const TfTokenVector renderTags = { HdTokens->geometry };
+        return renderTags;
+    }
+
+private:
+    HdRenderPassSharedPtr m_RenderPass;
+    HdRenderPassStateSharedPtr m_RenderPassState;
+};
+
+
+// Indeks renderowania hdOnyx wypełniony sceną OpenUSD. Każde wywołanie Execute synchronizuje zmiany sceny
+// (wraz z CommitResources) i wznawia wątek renderujący silnika.
+class HdOnyxTestRenderer
+{
+public:
+    HdOnyxTestRenderer(
+        const UsdStageRefPtr& stage,
+        const SdfPath& cameraPath,
+        int resolution,
+        const HdRenderSettingsMap& renderSettings = HdRenderSettingsMap())
+    {
+        m_RenderDelegate = HdRendererPluginRegistry::GetInstance().CreateRenderDelegate(
+            TfToken("HdOnyxRendererPlugin"), renderSettings);
+
+        if (!m_RenderDelegate) return;
+
+        m_RenderIndex.reset(HdRenderIndex::New(m_RenderDelegate.Get(), HdDriverVector()));
+
+        m_SceneDelegate = std::make_unique<UsdImagingDelegate>(m_RenderIndex.get(), SdfPath::AbsoluteRootPath());
+        m_SceneDelegate->Populate(stage->GetPseudoRoot());
+        m_SceneDelegate->SetTime(UsdTimeCode::Default());
+
+        // Bufor AOV nie należy do indeksu - tworzymy go bezpośrednio przez Render Delegate.
+        m_ColorBuffer = static_cast<HdRenderBuffer*>(
+            m_RenderDelegate->CreateBprim(HdPrimTypeTokens->renderBuffer, SdfPath("/TestColorBuffer")));
+        m_ColorBuffer->Allocate(GfVec3i(resolution, resolution, 1), HdFormatFloat32Vec4, false);
+
+        HdRenderPassAovBinding colorBinding;
+        colorBinding.aovName = HdAovTokens->color;
+        colorBinding.renderBuffer = m_ColorBuffer;
+        colorBinding.renderBufferId = m_ColorBuffer->GetId();
+        colorBinding.clearValue = VtValue(GfVec4f(0.0f));
+
+        HdRenderPassStateSharedPtr renderPassState = m_RenderDelegate->CreateRenderPassState();
+        renderPassState->SetAovBindings({ colorBinding });
+        renderPassState->SetViewport(GfVec4d(0.0, 0.0, resolution, resolution));
+        renderPassState->SetCamera(static_cast<const HdCamera*>(m_RenderIndex->GetSprim(
+            HdPrimTypeTokens->camera, m_SceneDelegate->ConvertCachePathToIndexPath(cameraPath))));
+
+        m_RenderIndex->InsertTask<HdOnyxTestRenderTask>(m_SceneDelegate.get(), m_RenderTaskID);
+
+        auto renderTask = std::static_pointer_cast<HdOnyxTestRenderTask>(m_RenderIndex->GetTask(m_RenderTaskID));
+        renderTask->SetRenderPass(
+            m_RenderDelegate->CreateRenderPass(
+                m_RenderIndex.get(),
+                HdRprimCollection(HdTokens->geometry, HdReprSelector(HdReprTokens->smoothHull))),
+            renderPassState);
+
+        m_Tasks = { renderTask };
+    }
+
+    ~HdOnyxTestRenderer()
+    {
+        if (!m_RenderDelegate) return;
+
+        // Kolejność zwalniania: zadanie (render pass mapuje bufor AOV), scena, indeks, bufor AOV, Render Delegate.
+        m_Tasks.clear();
+        m_RenderIndex->RemoveTask(m_RenderTaskID);
+        m_SceneDelegate.reset();
+        m_RenderIndex.reset();
+        m_RenderDelegate->DestroyBprim(m_ColorBuffer);
+    }
+
+    HdOnyxTestRenderer(const HdOnyxTestRenderer&) = delete;
+    HdOnyxTestRenderer& operator=(const HdOnyxTestRenderer&) = delete;
+
+    // Flaga wskazująca na poprawnie wczytany plugin hdOnyx.
+    bool IsValid() const { return bool(m_RenderDelegate); }
+
+    // Pobiera zmiany sceny, synchronizuje indeks renderowania i wznawia wątek renderujący.
+    void Execute()
+    {
+        m_SceneDelegate->ApplyPendingUpdates();
+        m_Engine.Execute(m_RenderIndex.get(), &m_Tasks);
+    }
+
+    // Bufor AOV koloru (HdFormatFloat32Vec4). Odczyt jest bezpieczny po osiągnięciu zbieżności (IsConverged)
+    // lub po zatrzymaniu renderowania (StopRendering).
+    HdRenderBuffer* GetColorBuffer() const { return m_ColorBuffer; }
+
+    // Zatrzymuje wątek renderujący po zakończeniu bieżącej iteracji (obraz przed zbieżnością).
+    void StopRendering() { m_RenderDelegate->Stop(true); }
+
+    // Kopia pikseli bufora AOV koloru. Wymaga zatrzymania renderowania lub osiągnięcia zbieżności.
+    std::vector<GfVec4f> ReadColorBuffer() const
+    {
+        const GfVec4f* pixels = static_cast<const GfVec4f*>(m_ColorBuffer->Map());
+        std::vector<GfVec4f> colors(pixels, pixels + size_t(m_ColorBuffer->GetWidth()) * m_ColorBuffer->GetHeight());
+        m_ColorBuffer->Unmap();
+
+        return colors;
+    }
+
+    VtDictionary GetRenderStats() const { return m_RenderDelegate->GetRenderStats(); }
+
+    // Odczytuje statystykę silnika. Wartość domyślna jest zwracana dla brakującego klucza lub innego typu.
+    template<typename T>
+    T GetRenderStat(const std::string& key, const T& defaultValue = T()) const
+    {
+        const VtDictionary renderStats = GetRenderStats();
+
+        auto statistic = renderStats.find(key);
+        if (statistic == renderStats.end() || !statistic->second.IsHolding<T>()) return defaultValue;
+
+        return statistic->second.UncheckedGet<T>();
+    }
+
+private:
+    HdPluginRenderDelegateUniqueHandle m_RenderDelegate;
+    std::unique_ptr<HdRenderIndex> m_RenderIndex;
+    std::unique_ptr<UsdImagingDelegate> m_SceneDelegate;
+    HdRenderBuffer* m_ColorBuffer = nullptr;
+
+    const SdfPath m_RenderTaskID = SdfPath("/TestRenderTask");
+    HdTaskSharedPtrVector m_Tasks;
+    HdEngine m_Engine;
+};
+
+
+PXR_NAMESPACE_CLOSE_SCOPE